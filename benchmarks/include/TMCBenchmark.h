@@ -0,0 +1,97 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCBenchmark
+#define ROOT_TMCBenchmark
+
+//
+// Class TMCBenchmark
+// ------------------
+// Minimal microbenchmark runner with the machine readable output
+// (JSON or CSV) of the VMC benchmark suite
+//
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Rtypes.h"
+
+class TMCBenchmark {
+public:
+   /// The benchmark body: runs the given number of iterations and returns
+   /// the number of processed items (tracks, calls, events, ...)
+   using Function = std::function<Long64_t(Long64_t nofIterations)>;
+
+   /// The result of one benchmark
+   struct TResult {
+      std::string fName;             ///< The benchmark name
+      std::string fUnit;             ///< The name of the processed items
+      Long64_t fIterations = 0;      ///< The number of iterations per repetition
+      Long64_t fItems = 0;           ///< The number of items per repetition
+      Int_t fRepetitions = 0;        ///< The number of repetitions
+      Double_t fMedianNs = 0.;       ///< The median time per item (ns)
+      Double_t fMinNs = 0.;          ///< The minimal time per item (ns)
+      Double_t fMaxNs = 0.;          ///< The maximal time per item (ns)
+      Double_t fItemsPerSecond = 0.; ///< The throughput at the median time
+   };
+
+   TMCBenchmark();
+
+   // methods
+   void Add(const std::string &name, const std::string &unit, Function function);
+   Int_t Run(const std::string &filter = "");
+   void Fail(const std::string &name, const std::string &message);
+   void List(std::ostream &out) const;
+   void WriteJson(std::ostream &out) const;
+   void WriteCsv(std::ostream &out) const;
+
+   // set methods
+   void SetMinTime(Double_t minTime) { fMinTime = minTime; }
+   void SetRepetitions(Int_t repetitions) { fRepetitions = repetitions; }
+   void SetVerbose(Bool_t verbose) { fVerbose = verbose; }
+
+   // get methods
+   Double_t GetMinTime() const { return fMinTime; }
+   Int_t GetRepetitions() const { return fRepetitions; }
+   Int_t GetNofFailures() const { return fNofFailures; }
+   const std::vector<TResult> &GetResults() const { return fResults; }
+
+   /// Prevent the compiler from optimizing out the computation of the value
+   template <typename T>
+   static void DoNotOptimize(const T &value)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      asm volatile("" : : "r,m"(value) : "memory");
+#else
+      static const T *volatile sink;
+      sink = &value;
+#endif
+   }
+
+private:
+   /// The registered benchmark
+   struct TEntry {
+      std::string fName;  ///< The benchmark name
+      std::string fUnit;  ///< The name of the processed items
+      Function fFunction; ///< The benchmark body
+   };
+
+   TResult Measure(const TEntry &entry) const;
+
+   // data members
+   std::vector<TEntry> fEntries;  ///< The registered benchmarks
+   std::vector<TResult> fResults; ///< The results of the last run
+   Double_t fMinTime;             ///< The minimal duration of one repetition (s)
+   Int_t fRepetitions;            ///< The number of repetitions
+   Bool_t fVerbose;               ///< Option to print the progress on std::cerr
+   Int_t fNofFailures;            ///< The number of the failed checks in the last run
+};
+
+#endif // ROOT_TMCBenchmark
@@ -0,0 +1,101 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCBenchmarkApplication
+#define ROOT_TMCBenchmarkApplication
+
+//
+// Class TMCBenchmarkApplication
+// -----------------------------
+// The MC application of the VMC benchmarks running two toy engines
+// with the TMCManager
+//
+
+#include "TString.h"
+#include "TVirtualMCApplication.h"
+
+#include <vector>
+
+class TMCBenchmarkStack;
+
+class TMCBenchmarkApplication : public TVirtualMCApplication {
+public:
+   /// The action on the tracks
+   enum EMode {
+      kIdle,      ///< The primaries are forwarded but not transported
+      kTransfer,  ///< The tracks are transferred from the engine 0 to 1 before the first step
+      kTransport, ///< The tracks are transported by the engine 0
+      kRouting    ///< The tracks are routed between the engines by TMCManager::ApplyRoutingRules()
+   };
+
+   /// An energy deposit in a step
+   struct THit {
+      Int_t fTrackId; ///< The track id (canonical in the sub-event mode)
+      Int_t fVolId;   ///< The volume id
+      Double_t fEdep; ///< The energy deposit (GeV)
+   };
+
+   TMCBenchmarkApplication(Int_t nofLayers);
+   virtual ~TMCBenchmarkApplication();
+
+   // static methods
+   static TMCBenchmarkApplication *GetOrCreate();
+
+   // methods
+   virtual void ConstructGeometry();
+   virtual void InitGeometry();
+   virtual void GeneratePrimaries();
+   virtual void BeginEvent();
+   virtual void BeginPrimary();
+   virtual void PreTrack();
+   virtual void Stepping();
+   virtual void PostTrack();
+   virtual void FinishPrimary();
+   virtual void FinishEvent();
+   virtual TVirtualMCApplication *CloneForWorker() const;
+   virtual void InitOnWorker();
+   virtual void MergeSubEvent(TVirtualMCApplication *workerMCApplication);
+
+   // set methods
+   void SetMode(EMode mode) { fMode = mode; }
+   void SetPrimaries(Int_t nofPrimaries, Int_t pdg, Double_t energy);
+   void SetRecordHits(Bool_t recordHits) { fRecordHits = recordHits; }
+
+   // get methods
+   TMCBenchmarkStack *GetStack() const { return fStack; }
+   Int_t GetNofLayers() const { return fNofLayers; }
+   TString GetLayerName(Int_t layer) const;
+   TString GetLayerPath(Int_t layer) const;
+   Long64_t GetNofSteps() const { return fNofSteps[0] + fNofSteps[1]; }
+   const std::vector<THit> &GetHits() const { return fHits; }
+
+   // check methods
+   Bool_t CheckTransfers() const;
+
+private:
+   // not implemented
+   TMCBenchmarkApplication(const TMCBenchmarkApplication &rhs);
+   TMCBenchmarkApplication &operator=(const TMCBenchmarkApplication &rhs);
+
+   // methods
+   void CreateEngines();
+
+   // data members
+   TMCBenchmarkStack *fStack;        ///< The user stack
+   Int_t fNofLayers;                 ///< The number of the calorimeter layers
+   EMode fMode;                      ///< The action on the tracks
+   Int_t fNofPrimaries;              ///< The number of primaries per event
+   Int_t fPdg;                       ///< The PDG code of the primaries
+   Double_t fEnergy;                 ///< The kinetic energy of the primaries (GeV)
+   Long64_t fNofSteps[2];            ///< The number of steps per engine since the start
+   std::vector<Int_t> fNofVisits[2]; ///< The number of steps per engine and primary in the current event
+   Bool_t fRecordHits;               ///< Whether the energy deposits are recorded
+   std::vector<THit> fHits;          ///< The energy deposits of the current event
+};
+
+#endif // ROOT_TMCBenchmarkApplication
@@ -0,0 +1,65 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCBenchmarkStack
+#define ROOT_TMCBenchmarkStack
+
+//
+// Class TMCBenchmarkStack
+// -----------------------
+// The user stack of the VMC benchmarks, which forwards the tracks to
+// the TMCManager
+//
+
+#include <memory>
+#include <stack>
+#include <vector>
+
+#include "TParticle.h"
+#include "TVirtualMCStack.h"
+
+class TMCBenchmarkStack : public TVirtualMCStack {
+public:
+   TMCBenchmarkStack();
+   virtual ~TMCBenchmarkStack();
+
+   // methods
+   virtual void PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg, Double_t px, Double_t py, Double_t pz, Double_t e,
+                          Double_t vx, Double_t vy, Double_t vz, Double_t tof, Double_t polx, Double_t poly,
+                          Double_t polz, TMCProcess mech, Int_t &ntr, Double_t weight, Int_t is);
+   virtual TParticle *PopNextTrack(Int_t &itrack);
+   virtual TParticle *PopPrimaryForTracking(Int_t i);
+   void Reset();
+
+   // set methods
+   virtual void SetCurrentTrack(Int_t trackNumber);
+   void SetTargetEngine(Int_t engineId) { fTargetEngine = engineId; }
+
+   // get methods
+   virtual Int_t GetNtrack() const;
+   virtual Int_t GetNprimary() const;
+   virtual TParticle *GetCurrentTrack() const;
+   virtual Int_t GetCurrentTrackNumber() const;
+   virtual Int_t GetCurrentParentTrackNumber() const;
+   TParticle *GetParticle(Int_t trackId) const;
+
+private:
+   // not implemented
+   TMCBenchmarkStack(const TMCBenchmarkStack &rhs);
+   TMCBenchmarkStack &operator=(const TMCBenchmarkStack &rhs);
+
+   // data members
+   std::vector<std::unique_ptr<TParticle>> fParticles; ///< The particles, reused in the following events
+   std::stack<Int_t> fStack;                            ///< The track numbers to be transported
+   Int_t fNofParticles;                                 ///< The number of particles in the current event
+   Int_t fNofPrimaries;                                 ///< The number of primaries in the current event
+   Int_t fCurrentTrack;                                 ///< The current track number
+   Int_t fTargetEngine;                                 ///< The engine the tracks are forwarded to
+};
+
+#endif // ROOT_TMCBenchmarkStack
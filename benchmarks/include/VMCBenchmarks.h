@@ -0,0 +1,38 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_VMCBenchmarks
+#define ROOT_VMCBenchmarks
+
+//
+// The registration of the VMC benchmarks, in the order in which they run
+//
+
+#include "Rtypes.h"
+
+class TMCBenchmark;
+
+/// The geometry building and the TGeoMCGeometry look-ups
+void RegisterGeometryBenchmarks(TMCBenchmark &benchmark);
+
+/// TMCManagerStack, TGeoMCBranchArrayContainer and TMCManager
+void RegisterManagerBenchmarks(TMCBenchmark &benchmark);
+
+/// The toy engine transport
+void RegisterToyMCBenchmarks(TMCBenchmark &benchmark);
+
+/// The magnetic field evaluation
+void RegisterFieldBenchmarks(TMCBenchmark &benchmark);
+
+/// TMCRootManager::Fill()
+void RegisterRootManagerBenchmarks(TMCBenchmark &benchmark);
+
+/// The per-thread accessors and the mutexes with up to maxThreads threads
+void RegisterThreadBenchmarks(TMCBenchmark &benchmark, Int_t maxThreads);
+
+#endif // ROOT_VMCBenchmarks
@@ -0,0 +1,220 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+
+/** \class TMCBenchmark
+    \ingroup vmc
+
+Minimal microbenchmark runner of the VMC benchmark suite.
+
+Each benchmark is a function running a given number of iterations and
+returning the number of processed items. The runner first calibrates the
+number of iterations so that one repetition takes at least the minimal time
+(SetMinTime(), 0.2 s by default), then runs the given number of repetitions
+(SetRepetitions(), 5 by default) and reports the median, minimal and maximal
+time per item. The median is robust against the occasional interference of
+other processes; the calibrated number of iterations is reported with the
+results so that the runs can be compared.
+
+The results are written in JSON or CSV, with one record per benchmark.
+*/
+
+namespace {
+using TClock = std::chrono::steady_clock;
+
+/// Return the string with the JSON special characters escaped
+std::string Escape(const std::string &text)
+{
+   std::string result;
+   for (auto c : text) {
+      if (c == '"' || c == '\\')
+         result += '\\';
+      result += c;
+   }
+   return result;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCBenchmark::TMCBenchmark()
+   : fEntries(), fResults(), fMinTime(0.2), fRepetitions(5), fVerbose(kFALSE), fNofFailures(0)
+{
+}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Calibrate the number of iterations and measure the repetitions of
+/// the given benchmark
+///
+
+TMCBenchmark::TResult TMCBenchmark::Measure(const TEntry &entry) const
+{
+   // the calibration, which also warms up the caches
+   Long64_t nofIterations = 1;
+   Long64_t nofItems = 0;
+   while (true) {
+      auto start = TClock::now();
+      nofItems = entry.fFunction(nofIterations);
+      Double_t time = std::chrono::duration<Double_t>(TClock::now() - start).count();
+      if (time >= fMinTime)
+         break;
+      Double_t factor = time > 0. ? 1.4 * fMinTime / time : 100.;
+      factor = std::min(std::max(factor, 2.), 100.);
+      nofIterations = Long64_t(nofIterations * factor);
+   }
+
+   std::vector<Double_t> times;
+   for (Int_t i = 0; i < fRepetitions; ++i) {
+      auto start = TClock::now();
+      nofItems = entry.fFunction(nofIterations);
+      Double_t time = std::chrono::duration<Double_t, std::nano>(TClock::now() - start).count();
+      times.push_back(time / std::max(nofItems, Long64_t(1)));
+   }
+   std::sort(times.begin(), times.end());
+
+   TResult result;
+   result.fName = entry.fName;
+   result.fUnit = entry.fUnit;
+   result.fIterations = nofIterations;
+   result.fItems = nofItems;
+   result.fRepetitions = fRepetitions;
+   if (!times.empty()) {
+      Int_t middle = times.size() / 2;
+      result.fMedianNs = times.size() % 2 ? times[middle] : 0.5 * (times[middle - 1] + times[middle]);
+      result.fMinNs = times.front();
+      result.fMaxNs = times.back();
+      result.fItemsPerSecond = result.fMedianNs > 0. ? 1e9 / result.fMedianNs : 0.;
+   }
+   return result;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register a benchmark
+/// - name      The benchmark name, with the parameters separated by '/'
+/// - unit      The name of the items counted by the function
+/// - function  The benchmark body
+///
+
+void TMCBenchmark::Add(const std::string &name, const std::string &unit, Function function)
+{
+   fEntries.push_back({name, unit, function});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Run the benchmarks with the name matching the given regular expression
+/// (all if empty), in the order of their registration; return the number of
+/// the benchmarks run
+///
+
+Int_t TMCBenchmark::Run(const std::string &filter)
+{
+   std::regex expression(filter.empty() ? std::string(".*") : filter);
+
+   fResults.clear();
+   fNofFailures = 0;
+   for (const auto &entry : fEntries) {
+      if (!std::regex_search(entry.fName, expression))
+         continue;
+
+      if (fVerbose)
+         std::cerr << "Running " << entry.fName << " ..." << std::flush;
+      fResults.push_back(Measure(entry));
+      if (fVerbose)
+         std::cerr << " " << fResults.back().fMedianNs << " ns/" << entry.fUnit << std::endl;
+   }
+   return fResults.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Report a failed check of the benchmark with the given name; the run goes
+/// on but the program should exit with an error (see GetNofFailures())
+///
+
+void TMCBenchmark::Fail(const std::string &name, const std::string &message)
+{
+   ++fNofFailures;
+   std::cerr << "Check failed in " << name << ": " << message << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the names of the registered benchmarks
+///
+
+void TMCBenchmark::List(std::ostream &out) const
+{
+   for (const auto &entry : fEntries) {
+      out << entry.fName << std::endl;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the results of the last run in JSON (the "benchmarks" array
+/// of the output document)
+///
+
+void TMCBenchmark::WriteJson(std::ostream &out) const
+{
+   out << std::setprecision(6);
+   out << "  \"benchmarks\": [";
+   for (size_t i = 0; i < fResults.size(); ++i) {
+      const TResult &result = fResults[i];
+      out << (i ? "," : "") << "\n    {"
+          << "\"name\": \"" << Escape(result.fName) << "\", "
+          << "\"unit\": \"" << Escape(result.fUnit) << "\", "
+          << "\"iterations\": " << result.fIterations << ", "
+          << "\"items\": " << result.fItems << ", "
+          << "\"repetitions\": " << result.fRepetitions << ", "
+          << "\"ns_per_item_median\": " << result.fMedianNs << ", "
+          << "\"ns_per_item_min\": " << result.fMinNs << ", "
+          << "\"ns_per_item_max\": " << result.fMaxNs << ", "
+          << "\"items_per_second\": " << result.fItemsPerSecond << "}";
+   }
+   out << "\n  ]";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the results of the last run in CSV, with a header line
+///
+
+void TMCBenchmark::WriteCsv(std::ostream &out) const
+{
+   out << std::setprecision(6);
+   out << "name,unit,iterations,items,repetitions,ns_per_item_median,ns_per_item_min,ns_per_item_max,"
+          "items_per_second"
+       << std::endl;
+   for (const auto &result : fResults) {
+      out << result.fName << "," << result.fUnit << "," << result.fIterations << "," << result.fItems << ","
+          << result.fRepetitions << "," << result.fMedianNs << "," << result.fMinNs << "," << result.fMaxNs << ","
+          << result.fItemsPerSecond << std::endl;
+   }
+}
@@ -0,0 +1,363 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCBenchmarkApplication.h"
+#include "TMCBenchmarkStack.h"
+#include "TMCManager.h"
+#include "TMCToyMC.h"
+#include "TVirtualMC.h"
+
+#include "TGeoManager.h"
+#include "TGeoMatrix.h"
+#include "TGeoMaterial.h"
+#include "TGeoMedium.h"
+#include "TGeoVolume.h"
+#include "TRandom.h"
+
+#include <algorithm>
+#include <cmath>
+
+/** \class TMCBenchmarkApplication
+    \ingroup vmc
+
+The MC application of the VMC benchmarks.
+
+The geometry is a calorimeter made of the given number of 1 cm thick layers
+of lead and scintillator, each layer being a distinct volume, so that the
+geometry look-ups run over many names. It is built directly with TGeo, as
+required by the TMCManager.
+
+The application requests the TMCManager; GetOrCreate() creates the
+application with two toy engines (TMCToyMC) on the first call. The action
+on the tracks is selected with SetMode(): the primaries can be only
+forwarded to the engine 0, transferred to the engine 1 before their first
+step (and stopped there), fully transported by the engine 0 or routed
+between the engines by the TMCManager routing rules.
+
+The steps are counted per engine, so that the engines can also run in the
+concurrent mode of the TMCManager; in the kTransfer mode CheckTransfers()
+verifies that each engine saw each primary with the current track of its
+own stack.
+
+With SetRecordHits(), the energy deposits of each event are recorded as
+hits. The application supports the sub-event mode of the TMCManager: each
+worker clones the application with its own two engines, and the hits of the
+workers are merged with the canonical track ids and ordered by them, so
+that they do not depend on the number of workers.
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+/// - nofLayers  The number of the calorimeter layers
+///
+
+TMCBenchmarkApplication::TMCBenchmarkApplication(Int_t nofLayers)
+   : TVirtualMCApplication("VMCBenchmarks", "The VMC benchmarks application"), fStack(new TMCBenchmarkStack()),
+     fNofLayers(nofLayers), fMode(kIdle), fNofPrimaries(1), fPdg(11), fEnergy(1.), fNofSteps{0, 0},
+     fNofVisits(), fRecordHits(kFALSE), fHits()
+{
+   RequestMCManager();
+   fMCManager->SetUserStack(fStack);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCBenchmarkApplication::~TMCBenchmarkApplication()
+{
+   delete fStack;
+}
+
+//
+// static methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the application, created with its two engines and initialized
+/// on the first call
+///
+
+TMCBenchmarkApplication *TMCBenchmarkApplication::GetOrCreate()
+{
+   static TMCBenchmarkApplication *application = nullptr;
+   if (application)
+      return application;
+
+   gRandom->SetSeed(12345);
+   application = new TMCBenchmarkApplication(200);
+   application->CreateEngines();
+
+   return application;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the calorimeter geometry with TGeo
+///
+
+void TMCBenchmarkApplication::ConstructGeometry()
+{
+   TGeoManager *geoManager = gGeoManager ? gGeoManager : new TGeoManager("VMCBenchmarks", "Calorimeter");
+
+   TGeoMaterial *vacuum = new TGeoMaterial("Vacuum", 1.e-16, 1.e-16, 1.e-16);
+   TGeoMaterial *lead = new TGeoMaterial("Lead", 207.19, 82., 11.35);
+   TGeoMaterial *scintillator = new TGeoMaterial("Scintillator", 6.5, 3.5, 1.032);
+   vacuum->SetUniqueID(1);
+   lead->SetUniqueID(2);
+   scintillator->SetUniqueID(3);
+
+   TGeoMedium *vacuumMedium = new TGeoMedium("Vacuum", 1, vacuum);
+   TGeoMedium *leadMedium = new TGeoMedium("Lead", 2, lead);
+   TGeoMedium *scintillatorMedium = new TGeoMedium("Scintillator", 3, scintillator);
+   // the sensitive flag (param[0]) as set by TGeoMCGeometry::Medium()
+   leadMedium->SetParam(0, 1.);
+   scintillatorMedium->SetParam(0, 1.);
+
+   const Double_t kHalfWidth = 50.;
+   const Double_t kHalfThickness = 0.5;
+   Double_t caloHalfLength = fNofLayers * kHalfThickness;
+
+   TGeoVolume *world = geoManager->MakeBox("WORLD", vacuumMedium, 2. * kHalfWidth, 2. * kHalfWidth,
+                                           2. * caloHalfLength + 10.);
+   geoManager->SetTopVolume(world);
+
+   TGeoVolume *calorimeter = geoManager->MakeBox("CALO", vacuumMedium, kHalfWidth, kHalfWidth, caloHalfLength);
+   world->AddNode(calorimeter, 1);
+
+   for (Int_t i = 0; i < fNofLayers; ++i) {
+      TGeoMedium *medium = i % 2 ? scintillatorMedium : leadMedium;
+      TGeoVolume *layer = geoManager->MakeBox(GetLayerName(i), medium, kHalfWidth, kHalfWidth, kHalfThickness);
+      Double_t z = -caloHalfLength + (2 * i + 1) * kHalfThickness;
+      calorimeter->AddNode(layer, 1, new TGeoTranslation(0., 0., z));
+   }
+
+   geoManager->CloseGeometry();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Nothing to be done
+///
+
+void TMCBenchmarkApplication::InitGeometry() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Push the primaries, starting in front of the calorimeter along z;
+/// they are transported unless the mode is kIdle
+///
+
+void TMCBenchmarkApplication::GeneratePrimaries()
+{
+   // the TMCManager generates the primaries before BeginEvent()
+   fStack->Reset();
+   fStack->SetTargetEngine(0);
+   for (auto &nofVisits : fNofVisits)
+      nofVisits.assign(fNofPrimaries, 0);
+
+   Double_t mass = fMC->ParticleMass(fPdg);
+   Double_t momentum = std::sqrt(fEnergy * (fEnergy + 2. * mass));
+   Double_t z = -fNofLayers * 0.5 - 1.;
+   Int_t toBeDone = fMode == kIdle ? 0 : 1;
+
+   for (Int_t i = 0; i < fNofPrimaries; ++i) {
+      Int_t ntr;
+      fStack->PushTrack(toBeDone, -1, fPdg, 0., 0., momentum, fEnergy + mass, 0., 0., z, 0., 0., 0., 0., kPPrimary, ntr,
+                        1., 0);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Reset the hits of the event (on the master and on the sub-event workers)
+///
+
+void TMCBenchmarkApplication::BeginEvent()
+{
+   fHits.clear();
+}
+
+void TMCBenchmarkApplication::BeginPrimary() {}
+
+void TMCBenchmarkApplication::PreTrack() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Count the steps and, in the kTransfer mode, move the tracks from
+/// the engine 0 to the engine 1, which stops them; in the kRouting mode,
+/// apply the routing rules of the TMCManager.
+/// The engine is taken from TVirtualMC::GetMC(), as fMC is not updated
+/// by the engine threads in the concurrent mode.
+///
+
+void TMCBenchmarkApplication::Stepping()
+{
+   TVirtualMC *mc = TVirtualMC::GetMC();
+   Int_t engineId = mc->GetId();
+   ++fNofSteps[engineId];
+
+   if (fRecordHits && mc->Edep() > 0.) {
+      Int_t copyNo;
+      Int_t volId = mc->CurrentVolID(copyNo);
+      fHits.push_back({mc->GetStack()->GetCurrentTrackNumber(), volId, mc->Edep()});
+   }
+
+   if (fMode == kRouting) {
+      fMCManager->ApplyRoutingRules();
+      return;
+   }
+
+   if (fMode != kTransfer)
+      return;
+
+   // each engine counts only in its own vector
+   Int_t trackId = mc->GetStack()->GetCurrentTrackNumber();
+   if (trackId < static_cast<Int_t>(fNofVisits[engineId].size()))
+      ++fNofVisits[engineId][trackId];
+
+   if (engineId == 0) {
+      fMCManager->TransferTrack(1);
+   } else {
+      mc->StopTrack();
+   }
+}
+
+void TMCBenchmarkApplication::PostTrack() {}
+
+void TMCBenchmarkApplication::FinishPrimary() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Order the hits merged from the sub-event workers by the canonical track
+/// ids; the hits of a track keep their order
+///
+
+void TMCBenchmarkApplication::FinishEvent()
+{
+   if (fMCManager->GetNofSubEventWorkers() > 0) {
+      std::stable_sort(fHits.begin(), fHits.end(),
+                       [](const THit &a, const THit &b) { return a.fTrackId < b.fTrackId; });
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return a new application with the settings of this one, for a worker of
+/// the sub-event mode; it is called in the worker thread
+///
+
+TVirtualMCApplication *TMCBenchmarkApplication::CloneForWorker() const
+{
+   TMCBenchmarkApplication *application = new TMCBenchmarkApplication(fNofLayers);
+   application->SetMode(fMode);
+   application->SetPrimaries(fNofPrimaries, fPdg, fEnergy);
+   application->SetRecordHits(fRecordHits);
+   return application;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create the engines of a worker of the sub-event mode; the geometry is
+/// shared with the master
+///
+
+void TMCBenchmarkApplication::InitOnWorker()
+{
+   CreateEngines();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Take over the hits of a sub-event worker, with the canonical track ids
+///
+
+void TMCBenchmarkApplication::MergeSubEvent(TVirtualMCApplication *workerMCApplication)
+{
+   TMCBenchmarkApplication *worker = static_cast<TMCBenchmarkApplication *>(workerMCApplication);
+   for (const THit &hit : worker->fHits)
+      fHits.push_back({fMCManager->GetCanonicalTrackId(hit.fTrackId), hit.fVolId, hit.fEdep});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create the two toy engines, which register themselves to the manager
+/// of this thread (which owns them), and initialize them
+///
+
+void TMCBenchmarkApplication::CreateEngines()
+{
+   TMCToyMC *engine0 = new TMCToyMC("Toy engine 0");
+   TMCToyMC *engine1 = new TMCToyMC("Toy engine 1");
+   engine0->SetEnergyLoss(0.01);
+   engine1->SetEnergyLoss(0.01);
+
+   fMCManager->Init([](TVirtualMC *mc) {
+      mc->Init();
+      mc->BuildPhysics();
+   });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true if, in the last event of the kTransfer mode, each primary
+/// made exactly one step in each engine
+///
+
+Bool_t TMCBenchmarkApplication::CheckTransfers() const
+{
+   for (const auto &nofVisits : fNofVisits) {
+      for (Int_t nofSteps : nofVisits) {
+         if (nofSteps != 1)
+            return kFALSE;
+      }
+   }
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the primaries generated in each event
+/// - nofPrimaries  The number of primaries
+/// - pdg           The PDG code
+/// - energy        The kinetic energy (GeV)
+///
+
+void TMCBenchmarkApplication::SetPrimaries(Int_t nofPrimaries, Int_t pdg, Double_t energy)
+{
+   fNofPrimaries = nofPrimaries;
+   fPdg = pdg;
+   fEnergy = energy;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the name of the given layer volume
+///
+
+TString TMCBenchmarkApplication::GetLayerName(Int_t layer) const
+{
+   return TString::Format("LAYER%d", layer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the path of the given layer volume
+///
+
+TString TMCBenchmarkApplication::GetLayerPath(Int_t layer) const
+{
+   return TString::Format("/WORLD_1/CALO_1/LAYER%d_1", layer);
+}
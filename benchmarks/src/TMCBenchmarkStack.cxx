@@ -0,0 +1,204 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCBenchmarkStack.h"
+#include "TMCManager.h"
+#include "TError.h"
+
+#include <algorithm>
+
+/** \class TMCBenchmarkStack
+    \ingroup vmc
+
+The user stack of the VMC benchmarks. The particles are kept for the whole
+run and reused in the following events, so that the benchmarks measure the
+VMC classes rather than the memory allocation of the stack.
+
+If a TMCManager is instantiated, the tracks are forwarded to the engine
+selected with SetTargetEngine(); otherwise they are stacked here.
+The tracks are then numbered with TMCManager::NextTrackId(), as required
+by its sub-event mode.
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCBenchmarkStack::TMCBenchmarkStack()
+   : TVirtualMCStack(), fParticles(), fStack(), fNofParticles(0), fNofPrimaries(0), fCurrentTrack(-1),
+     fTargetEngine(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCBenchmarkStack::~TMCBenchmarkStack() {}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create a new particle and forward it to the TMCManager or push it
+/// on the stack; see TVirtualMCStack::PushTrack() for the parameters
+///
+
+void TMCBenchmarkStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg, Double_t px, Double_t py, Double_t pz,
+                                  Double_t e, Double_t vx, Double_t vy, Double_t vz, Double_t tof, Double_t polx,
+                                  Double_t poly, Double_t polz, TMCProcess mech, Int_t &ntr, Double_t weight, Int_t is)
+{
+   // the TMCManager numbers the tracks, in the sub-event mode across its workers
+   TMCManager *manager = TMCManager::Instance();
+   ntr = manager ? manager->NextTrackId() : fNofParticles;
+   fNofParticles = std::max(fNofParticles, ntr + 1);
+   while (ntr >= Int_t(fParticles.size()))
+      fParticles.emplace_back(new TParticle());
+
+   TParticle *particle = fParticles[ntr].get();
+   particle->SetPdgCode(pdg);
+   particle->SetStatusCode(is);
+   particle->SetFirstMother(parent);
+   particle->SetMomentum(px, py, pz, e);
+   particle->SetProductionVertex(vx, vy, vz, tof);
+   particle->SetPolarisation(polx, poly, polz);
+   particle->SetWeight(weight);
+   particle->SetUniqueID(mech);
+   if (parent < 0)
+      ++fNofPrimaries;
+
+   if (manager) {
+      manager->ForwardTrack(toBeDone, ntr, parent, particle, fTargetEngine);
+   } else if (toBeDone) {
+      fStack.push(ntr);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Pop the next track to be transported
+///
+
+TParticle *TMCBenchmarkStack::PopNextTrack(Int_t &itrack)
+{
+   if (fStack.empty()) {
+      itrack = -1;
+      return nullptr;
+   }
+
+   itrack = fStack.top();
+   fStack.pop();
+   fCurrentTrack = itrack;
+   return fParticles[itrack].get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the i-th particle; the primaries are the first particles
+///
+
+TParticle *TMCBenchmarkStack::PopPrimaryForTracking(Int_t i)
+{
+   if (i < 0 || i >= fNofPrimaries) {
+      ::Error("TMCBenchmarkStack::PopPrimaryForTracking", "Primary %d out of range.", i);
+      return nullptr;
+   }
+   return fParticles[i].get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Reset the stack for the next event (the particle objects are kept)
+///
+
+void TMCBenchmarkStack::Reset()
+{
+   fNofParticles = 0;
+   fNofPrimaries = 0;
+   fCurrentTrack = -1;
+   while (!fStack.empty())
+      fStack.pop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the current track number
+///
+
+void TMCBenchmarkStack::SetCurrentTrack(Int_t trackNumber)
+{
+   fCurrentTrack = trackNumber;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of tracks in the current event
+///
+
+Int_t TMCBenchmarkStack::GetNtrack() const
+{
+   return fNofParticles;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of primaries in the current event
+///
+
+Int_t TMCBenchmarkStack::GetNprimary() const
+{
+   return fNofPrimaries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the current track
+///
+
+TParticle *TMCBenchmarkStack::GetCurrentTrack() const
+{
+   return GetParticle(fCurrentTrack);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the current track number
+///
+
+Int_t TMCBenchmarkStack::GetCurrentTrackNumber() const
+{
+   return fCurrentTrack;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the parent track number of the current track
+///
+
+Int_t TMCBenchmarkStack::GetCurrentParentTrackNumber() const
+{
+   TParticle *particle = GetParticle(fCurrentTrack);
+   return particle ? particle->GetFirstMother() : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the particle with the given track number, or nullptr
+///
+
+TParticle *TMCBenchmarkStack::GetParticle(Int_t trackId) const
+{
+   if (trackId < 0 || trackId >= fNofParticles)
+      return nullptr;
+
+   return fParticles[trackId].get();
+}
@@ -0,0 +1,232 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The magnetic field benchmarks: the field map evaluation point by point
+// and in batches, at random points and at points along the tracks,
+// compared with a naive reference map, and the batched evaluation via
+// TVirtualMC::EvaluateField()
+//
+
+#include "TMCBenchmark.h"
+#include "TMCBenchmarkApplication.h"
+#include "VMCBenchmarks.h"
+
+#include "TMCGridMagField.h"
+#include "TError.h"
+#include "TMCManager.h"
+#include "TSystem.h"
+#include "TVirtualMC.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+/// The number of points evaluated per iteration
+const Int_t kNofPoints = 4096;
+
+/// The naive reference implementation of a Cartesian field map: the values
+/// are kept in a vector and each point is located and interpolated on its own
+class TNaiveGridField : public TVirtualMCMagField {
+public:
+   TNaiveGridField(const Int_t *n, const Double_t *min, const Double_t *max, const std::vector<Double_t> &values)
+      : TVirtualMCMagField("NaiveField"), fValues(values)
+   {
+      for (Int_t k = 0; k < 3; ++k) {
+         fN[k] = n[k];
+         fMin[k] = min[k];
+         fMax[k] = max[k];
+      }
+   }
+
+   using TVirtualMCMagField::Field;
+
+   virtual void Field(const Double_t *x, Double_t *b)
+   {
+      Int_t cell[3];
+      Double_t f[3];
+      for (Int_t k = 0; k < 3; ++k) {
+         Double_t step = (fMax[k] - fMin[k]) / (fN[k] - 1);
+         Double_t t = (x[k] - fMin[k]) / step;
+         if (t < 0. || t > fN[k] - 1) {
+            b[0] = b[1] = b[2] = 0.;
+            return;
+         }
+         cell[k] = std::min(Int_t(t), fN[k] - 2);
+         f[k] = t - cell[k];
+      }
+
+      b[0] = b[1] = b[2] = 0.;
+      for (Int_t i = 0; i < 2; ++i) {
+         for (Int_t j = 0; j < 2; ++j) {
+            for (Int_t k = 0; k < 2; ++k) {
+               Double_t weight = (i ? f[0] : 1. - f[0]) * (j ? f[1] : 1. - f[1]) * (k ? f[2] : 1. - f[2]);
+               size_t index = ((size_t(cell[0] + i) * fN[1] + cell[1] + j) * fN[2] + cell[2] + k) * 3;
+               for (Int_t c = 0; c < 3; ++c)
+                  b[c] += weight * fValues.at(index + c);
+            }
+         }
+      }
+   }
+
+private:
+   Int_t fN[3];
+   Double_t fMin[3];
+   Double_t fMax[3];
+   std::vector<Double_t> fValues;
+};
+
+/// The field map and the points (x, y, z stored contiguously)
+struct TFieldFixture {
+   TMCGridMagField *fField = nullptr;
+   TNaiveGridField *fReference = nullptr;
+   std::vector<Double_t> fRandomPoints;
+   std::vector<Double_t> fTrackPoints;
+   std::vector<Double_t> fValues;
+};
+
+TFieldFixture &GetFieldFixture()
+{
+   static TFieldFixture fixture;
+   if (fixture.fField)
+      return fixture;
+
+   // a solenoid-like map of 51^3 points in a 2 m cube
+   const Int_t n[3] = {51, 51, 51};
+   const Double_t min[3] = {-100., -100., -100.};
+   const Double_t max[3] = {100., 100., 100.};
+   std::vector<Double_t> values;
+   for (Int_t i = 0; i < n[0]; ++i) {
+      Double_t x = min[0] + i * (max[0] - min[0]) / (n[0] - 1);
+      for (Int_t j = 0; j < n[1]; ++j) {
+         Double_t y = min[1] + j * (max[1] - min[1]) / (n[1] - 1);
+         for (Int_t k = 0; k < n[2]; ++k) {
+            Double_t z = min[2] + k * (max[2] - min[2]) / (n[2] - 1);
+            Double_t falloff = std::exp(-(x * x + y * y + z * z) / 2.e4);
+            values.push_back(-1.e-3 * x * z * falloff);
+            values.push_back(-1.e-3 * y * z * falloff);
+            values.push_back(20. * falloff);
+         }
+      }
+   }
+   TString fileName = TString::Format("%s/vmc_benchmarks_field_%d.map", gSystem->TempDirectory(), gSystem->GetPid());
+   TMCGridMagField::WriteMap(fileName, TMCGridMagField::kCartesian, n, min, max, values.data());
+   fixture.fField = new TMCGridMagField("BenchmarkField", fileName);
+   fixture.fReference = new TNaiveGridField(n, min, max, values);
+   gSystem->Unlink(fileName);
+
+   std::mt19937 generator(4357);
+   std::uniform_real_distribution<Double_t> distribution(-99., 99.);
+   for (Int_t i = 0; i < 3 * kNofPoints; ++i)
+      fixture.fRandomPoints.push_back(distribution(generator));
+
+   // 16 straight tracks from the origin with 0.2 cm steps
+   for (Int_t i = 0; i < 16; ++i) {
+      Double_t direction[3] = {distribution(generator), distribution(generator), distribution(generator)};
+      Double_t norm =
+         std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+      for (Int_t j = 0; j < kNofPoints / 16; ++j) {
+         for (Int_t k = 0; k < 3; ++k)
+            fixture.fTrackPoints.push_back(0.2 * j * direction[k] / norm);
+      }
+   }
+
+   fixture.fValues.resize(3 * kNofPoints);
+
+   // the map must agree with the reference
+   std::vector<Double_t> reference(3 * kNofPoints);
+   fixture.fField->Field(kNofPoints, fixture.fRandomPoints.data(), fixture.fValues.data());
+   for (Int_t j = 0; j < kNofPoints; ++j)
+      fixture.fReference->Field(&fixture.fRandomPoints[3 * j], &reference[3 * j]);
+   Double_t maxDifference = 0.;
+   for (Int_t i = 0; i < 3 * kNofPoints; ++i)
+      maxDifference = std::max(maxDifference, std::fabs(fixture.fValues[i] - reference[i]));
+   if (maxDifference > 1.e-9)
+      ::Error("GetFieldFixture", "The field map differs from the reference by %g.", maxDifference);
+
+   return fixture;
+}
+
+/// Evaluate the field of the map (or of the reference) at all given points,
+/// point by point
+Long64_t EvaluateSingle(Long64_t n, const std::vector<Double_t> &points, Bool_t isReference = kFALSE)
+{
+   TFieldFixture &fixture = GetFieldFixture();
+   TVirtualMCMagField *field = isReference ? static_cast<TVirtualMCMagField *>(fixture.fReference) : fixture.fField;
+   for (Long64_t i = 0; i < n; ++i) {
+      for (Int_t j = 0; j < kNofPoints; ++j)
+         field->Field(&points[3 * j], &fixture.fValues[3 * j]);
+      TMCBenchmark::DoNotOptimize(fixture.fValues[0]);
+   }
+   return n * kNofPoints;
+}
+
+/// Evaluate the field of the map (or of the reference) at all given points,
+/// in batches of the given size
+Long64_t EvaluateBatch(Long64_t n, const std::vector<Double_t> &points, Int_t batchSize, Bool_t isReference = kFALSE)
+{
+   TFieldFixture &fixture = GetFieldFixture();
+   TVirtualMCMagField *field = isReference ? static_cast<TVirtualMCMagField *>(fixture.fReference) : fixture.fField;
+   for (Long64_t i = 0; i < n; ++i) {
+      for (Int_t j = 0; j < kNofPoints; j += batchSize) {
+         field->Field(std::min(batchSize, kNofPoints - j), &points[3 * j], &fixture.fValues[3 * j]);
+      }
+      TMCBenchmark::DoNotOptimize(fixture.fValues[0]);
+   }
+   return n * kNofPoints;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the magnetic field benchmarks
+///
+
+void RegisterFieldBenchmarks(TMCBenchmark &benchmark)
+{
+   benchmark.Add("Field/Grid/Random/Single", "point",
+                 [](Long64_t n) { return EvaluateSingle(n, GetFieldFixture().fRandomPoints); });
+   benchmark.Add("Field/Grid/Track/Single", "point",
+                 [](Long64_t n) { return EvaluateSingle(n, GetFieldFixture().fTrackPoints); });
+
+   // the naive reference map
+   benchmark.Add("Field/Reference/Random/Single", "point",
+                 [](Long64_t n) { return EvaluateSingle(n, GetFieldFixture().fRandomPoints, kTRUE); });
+   benchmark.Add("Field/Reference/Track/Single", "point",
+                 [](Long64_t n) { return EvaluateSingle(n, GetFieldFixture().fTrackPoints, kTRUE); });
+   benchmark.Add("Field/Reference/Random/Batch/256", "point",
+                 [](Long64_t n) { return EvaluateBatch(n, GetFieldFixture().fRandomPoints, 256, kTRUE); });
+
+   for (Int_t batchSize : {16, 256, kNofPoints}) {
+      std::string suffix = "/Batch/" + std::to_string(batchSize);
+      benchmark.Add("Field/Grid/Random" + suffix, "point", [batchSize](Long64_t n) {
+         return EvaluateBatch(n, GetFieldFixture().fRandomPoints, batchSize);
+      });
+      benchmark.Add("Field/Grid/Track" + suffix, "point", [batchSize](Long64_t n) {
+         return EvaluateBatch(n, GetFieldFixture().fTrackPoints, batchSize);
+      });
+   }
+
+   // the engine dispatch to the batched evaluation
+   benchmark.Add("Field/EvaluateField/Batch/256", "point", [](Long64_t n) {
+      TFieldFixture &fixture = GetFieldFixture();
+      TMCBenchmarkApplication::GetOrCreate();
+      TVirtualMC *mc = TMCManager::Instance()->GetEngine(0);
+      mc->SetMagField(fixture.fField);
+      for (Long64_t i = 0; i < n; ++i) {
+         for (Int_t j = 0; j < kNofPoints; j += 256)
+            mc->EvaluateField(256, &fixture.fTrackPoints[3 * j], &fixture.fValues[3 * j]);
+         TMCBenchmark::DoNotOptimize(fixture.fValues[0]);
+      }
+      mc->SetMagField(nullptr);
+      return n * kNofPoints;
+   });
+}
@@ -0,0 +1,316 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The geometry benchmarks:
+// - building a flat geometry with TGeoMCGeometry (the name look-ups
+//   in Gspos() dominate the start-up of large geometries)
+// - the TGeoMCGeometry look-up functions on the benchmark calorimeter
+// - the look-up functions on a flat geometry of 100000 volumes, closed
+//   (served by the name indices) and open (TGeoManager fall-back)
+//
+
+#include "TMCBenchmark.h"
+#include "TMCBenchmarkApplication.h"
+#include "VMCBenchmarks.h"
+
+#include "TArrayD.h"
+#include "TGeoMCGeometry.h"
+#include "TGeoManager.h"
+#include "TGeoMatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+/// The look-up inputs, in a reproducible random order
+struct TLookupFixture {
+   TGeoMCGeometry *fGeometry = nullptr;
+   std::vector<TString> fVolumeNames;
+   std::vector<TString> fVolumePaths;
+   std::vector<Int_t> fVolumeIds;
+   std::vector<TString> fMediumNames;
+};
+
+TLookupFixture &GetLookupFixture()
+{
+   static TLookupFixture fixture;
+   if (fixture.fGeometry)
+      return fixture;
+
+   TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+   fixture.fGeometry = new TGeoMCGeometry("TGeoMCGeometry", "Benchmark geometry look-ups");
+
+   std::vector<Int_t> layers(application->GetNofLayers());
+   for (Int_t i = 0; i < Int_t(layers.size()); ++i)
+      layers[i] = i;
+   std::mt19937 generator(4357);
+   std::shuffle(layers.begin(), layers.end(), generator);
+
+   for (auto layer : layers) {
+      fixture.fVolumeNames.push_back(application->GetLayerName(layer));
+      fixture.fVolumePaths.push_back(application->GetLayerPath(layer));
+      fixture.fVolumeIds.push_back(fixture.fGeometry->VolId(fixture.fVolumeNames.back()));
+   }
+   fixture.fMediumNames = {"Lead", "Scintillator", "Vacuum"};
+
+   return fixture;
+}
+
+/// The number of the media of the flat geometry
+constexpr Int_t kNofFlatMedia = 100;
+
+/// Fill the current gGeoManager with a flat geometry of nofVolumes boxes
+/// made of kNofFlatMedia media
+void FillFlatGeometry(TGeoMCGeometry &geometry, Int_t nofVolumes)
+{
+   Int_t kmat;
+   geometry.Material(kmat, "Air", 14.61, 7.3, 1.205e-3, 30423., 6.75e4, (Double_t *)nullptr, 0);
+   std::vector<Int_t> media(kNofFlatMedia);
+   for (Int_t i = 0; i < kNofFlatMedia; ++i)
+      geometry.Medium(media[i], TString::Format("M%d", i), kmat, 0, 0, 0., 0., 0., 0., 0., 0., (Double_t *)nullptr,
+                      0);
+
+   Double_t worldPar[3] = {1000., 1000., 1000.};
+   geometry.Gsvolu("WRLD", "BOX", media[0], worldPar, 3);
+
+   Double_t boxPar[3] = {0.4, 0.4, 0.4};
+   Int_t side = Int_t(std::cbrt(Double_t(nofVolumes))) + 1;
+   for (Int_t i = 0; i < nofVolumes; ++i) {
+      TString name = TString::Format("V%d", i);
+      geometry.Gsvolu(name, "BOX", media[i % kNofFlatMedia], boxPar, 3);
+      Double_t x = i % side;
+      Double_t y = (i / side) % side;
+      Double_t z = i / (side * side);
+      geometry.Gspos(name, 1, "WRLD", x - 0.5 * side, y - 0.5 * side, z - 0.5 * side, 0, "ONLY");
+   }
+}
+
+/// Build a flat geometry of nofVolumes boxes; return the number of volumes
+Long64_t BuildGeometry(Int_t nofVolumes)
+{
+   TGeoManager *savedGeoManager = gGeoManager;
+   gGeoManager = nullptr;
+
+   TGeoMCGeometry geometry("TGeoMCGeometry", "Benchmark geometry build", kFALSE);
+   FillFlatGeometry(geometry, nofVolumes);
+
+   delete gGeoManager;
+   gGeoManager = savedGeoManager;
+   return nofVolumes;
+}
+
+/// The look-up inputs on a flat geometry of 100000 volumes, in its own
+/// TGeoManager, installed in gGeoManager only while a benchmark runs
+struct TFlatFixture {
+   TGeoManager *fGeoManager = nullptr;
+   TGeoMCGeometry *fGeometry = nullptr;
+   std::vector<TString> fVolumeNames;
+   std::vector<TString> fMediumNames;
+};
+
+/// The number of the volumes of the flat look-up geometry
+constexpr Int_t kNofFlatVolumes = 100000;
+
+/// Return the flat fixture, closed (with the name indices) or open
+TFlatFixture &GetFlatFixture(Bool_t closed)
+{
+   static TFlatFixture fixtures[2];
+   TFlatFixture &fixture = fixtures[closed ? 1 : 0];
+   if (fixture.fGeometry)
+      return fixture;
+
+   TGeoManager *savedGeoManager = gGeoManager;
+   gGeoManager = nullptr;
+   fixture.fGeometry = new TGeoMCGeometry("TGeoMCGeometry", "Benchmark flat geometry look-ups", kFALSE);
+   FillFlatGeometry(*fixture.fGeometry, kNofFlatVolumes);
+   fixture.fGeoManager = gGeoManager;
+   if (closed) {
+      fixture.fGeoManager->SetTopVolume(fixture.fGeoManager->GetVolume("WRLD"));
+      fixture.fGeoManager->CloseGeometry();
+   }
+   gGeoManager = savedGeoManager;
+
+   // a sample of the volumes spread over the whole list
+   std::mt19937 generator(4357);
+   std::uniform_int_distribution<Int_t> volume(0, kNofFlatVolumes - 1);
+   for (Int_t i = 0; i < 1000; ++i)
+      fixture.fVolumeNames.push_back(TString::Format("V%d", volume(generator)));
+   for (Int_t i = 0; i < kNofFlatMedia; ++i)
+      fixture.fMediumNames.push_back(TString::Format("M%d", i));
+   std::shuffle(fixture.fMediumNames.begin(), fixture.fMediumNames.end(), generator);
+
+   return fixture;
+}
+
+/// Run the look-up on the flat geometry with its TGeoManager installed
+template <typename Lookup>
+Long64_t RunFlatLookup(Bool_t closed, Long64_t n, Lookup lookup)
+{
+   TFlatFixture &fixture = GetFlatFixture(closed);
+   TGeoManager *savedGeoManager = gGeoManager;
+   gGeoManager = fixture.fGeoManager;
+   Long64_t items = 0;
+   for (Long64_t i = 0; i < n; ++i)
+      items += lookup(fixture);
+   gGeoManager = savedGeoManager;
+   return items;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the geometry benchmarks
+///
+
+void RegisterGeometryBenchmarks(TMCBenchmark &benchmark)
+{
+   // the build must run before the benchmark application creates its geometry
+   for (Int_t nofVolumes : {1000, 10000, 100000}) {
+      benchmark.Add("Geometry/Build/" + std::to_string(nofVolumes), "volume", [nofVolumes](Long64_t n) {
+         Long64_t items = 0;
+         for (Long64_t i = 0; i < n; ++i)
+            items += BuildGeometry(nofVolumes);
+         return items;
+      });
+   }
+
+   // the name indices are built when the geometry is closed; the open
+   // geometry shows the cost of the TGeoManager look-ups they replace
+   for (Bool_t closed : {kTRUE, kFALSE}) {
+      std::string prefix = std::string("Geometry/Flat100k/") + (closed ? "Closed/" : "Open/");
+
+      benchmark.Add(prefix + "VolId", "call", [closed](Long64_t n) {
+         return RunFlatLookup(closed, n, [](TFlatFixture &fixture) {
+            for (const auto &name : fixture.fVolumeNames) {
+               Int_t id = fixture.fGeometry->VolId(name);
+               TMCBenchmark::DoNotOptimize(id);
+            }
+            return Long64_t(fixture.fVolumeNames.size());
+         });
+      });
+
+      benchmark.Add(prefix + "MediumId", "call", [closed](Long64_t n) {
+         return RunFlatLookup(closed, n, [](TFlatFixture &fixture) {
+            for (const auto &name : fixture.fMediumNames) {
+               Int_t id = fixture.fGeometry->MediumId(name);
+               TMCBenchmark::DoNotOptimize(id);
+            }
+            return Long64_t(fixture.fMediumNames.size());
+         });
+      });
+
+      benchmark.Add(prefix + "NofVolDaughters", "call", [closed](Long64_t n) {
+         return RunFlatLookup(closed, n, [](TFlatFixture &fixture) {
+            for (const auto &name : fixture.fVolumeNames) {
+               Int_t nofDaughters = fixture.fGeometry->NofVolDaughters(name);
+               TMCBenchmark::DoNotOptimize(nofDaughters);
+            }
+            return Long64_t(fixture.fVolumeNames.size());
+         });
+      });
+   }
+
+   benchmark.Add("Geometry/VolId", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (const auto &name : fixture.fVolumeNames) {
+            Int_t id = fixture.fGeometry->VolId(name);
+            TMCBenchmark::DoNotOptimize(id);
+         }
+         items += fixture.fVolumeNames.size();
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/VolName", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (auto id : fixture.fVolumeIds) {
+            const char *name = fixture.fGeometry->VolName(id);
+            TMCBenchmark::DoNotOptimize(name);
+         }
+         items += fixture.fVolumeIds.size();
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/VolId2Mate", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (auto id : fixture.fVolumeIds) {
+            Int_t material = fixture.fGeometry->VolId2Mate(id);
+            TMCBenchmark::DoNotOptimize(material);
+         }
+         items += fixture.fVolumeIds.size();
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/MediumId", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (const auto &name : fixture.fMediumNames) {
+            Int_t id = fixture.fGeometry->MediumId(name);
+            TMCBenchmark::DoNotOptimize(id);
+         }
+         items += fixture.fMediumNames.size();
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/VolDaughterName", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      Int_t nofDaughters = fixture.fGeometry->NofVolDaughters("CALO");
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (Int_t j = 0; j < nofDaughters; ++j) {
+            const char *name = fixture.fGeometry->VolDaughterName("CALO", j);
+            TMCBenchmark::DoNotOptimize(name);
+         }
+         items += nofDaughters;
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/GetTransformation", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      TGeoHMatrix matrix;
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (const auto &path : fixture.fVolumePaths) {
+            Bool_t found = fixture.fGeometry->GetTransformation(path, matrix);
+            TMCBenchmark::DoNotOptimize(found);
+         }
+         items += fixture.fVolumePaths.size();
+      }
+      return items;
+   });
+
+   benchmark.Add("Geometry/GetShape", "call", [](Long64_t n) {
+      TLookupFixture &fixture = GetLookupFixture();
+      TString shapeType;
+      TArrayD parameters;
+      Long64_t items = 0;
+      for (Long64_t i = 0; i < n; ++i) {
+         for (const auto &path : fixture.fVolumePaths) {
+            Bool_t found = fixture.fGeometry->GetShape(path, shapeType, parameters);
+            TMCBenchmark::DoNotOptimize(found);
+         }
+         items += fixture.fVolumePaths.size();
+      }
+      return items;
+   });
+}
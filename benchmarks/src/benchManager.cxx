@@ -0,0 +1,245 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The multiple engines benchmarks, at several numbers of tracks per event:
+// - TMCManagerStack push and pop
+// - TGeoMCBranchArrayContainer get and free
+// - TMCManager::ForwardTrack(), PrepareNewEvent() (via Run()),
+//   TransferTrack(), also in the concurrent mode, and ApplyRoutingRules()
+// - the sub-event mode, checking that the hits do not depend on the number
+//   of workers
+//
+
+#include "TMCBenchmark.h"
+#include "TMCBenchmarkApplication.h"
+#include "TMCBenchmarkStack.h"
+#include "VMCBenchmarks.h"
+
+#include "TGeoBranchArray.h"
+#include "TGeoMCBranchArrayContainer.h"
+#include "TGeoManager.h"
+#include "TGeoNavigator.h"
+#include "TMCManager.h"
+#include "TParticle.h"
+#include "TVirtualMC.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+/// The track counts of the benchmarks
+const Int_t kNofTracks[] = {100, 1000, 10000};
+
+/// The number of the workers of the sub-event mode benchmarks
+const Int_t kNofSubEventWorkers = 4;
+
+/// Return the primaries forwarded directly to the TMCManager
+std::vector<TParticle> &GetParticles()
+{
+   static std::vector<TParticle> particles;
+   if (particles.empty()) {
+      particles.resize(kNofTracks[2]);
+      for (auto &particle : particles) {
+         particle.SetPdgCode(11);
+         particle.SetFirstMother(-1);
+         particle.SetMomentum(0., 0., 1., 1.);
+      }
+   }
+   return particles;
+}
+
+/// Return true if the two hit collections are identical
+Bool_t IsSameHits(const std::vector<TMCBenchmarkApplication::THit> &hits,
+                  const std::vector<TMCBenchmarkApplication::THit> &otherHits)
+{
+   if (hits.size() != otherHits.size())
+      return kFALSE;
+   for (size_t i = 0; i < hits.size(); ++i) {
+      if (hits[i].fTrackId != otherHits[i].fTrackId || hits[i].fVolId != otherHits[i].fVolId ||
+          hits[i].fEdep != otherHits[i].fEdep)
+         return kFALSE;
+   }
+   return kTRUE;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the TMCManager benchmarks
+///
+
+void RegisterManagerBenchmarks(TMCBenchmark &benchmark)
+{
+   for (Int_t nofTracks : kNofTracks) {
+      std::string suffix = "/" + std::to_string(nofTracks);
+
+      // the track ids forwarded to the manager, then popped from the engine stack
+      benchmark.Add("ManagerStack/PushPop" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication::GetOrCreate();
+         TMCManager *manager = TMCManager::Instance();
+         TVirtualMCStack *engineStack = manager->GetEngine(0)->GetStack();
+         std::vector<TParticle> &particles = GetParticles();
+         for (Long64_t i = 0; i < n; ++i) {
+            for (Int_t j = 0; j < nofTracks; ++j)
+               manager->ForwardTrack(1, j, -1, &particles[j], 0);
+            Int_t trackId;
+            while (engineStack->PopNextTrack(trackId))
+               TMCBenchmark::DoNotOptimize(trackId);
+         }
+         return n * nofTracks;
+      });
+
+      // the secondaries pushed by an engine via the user stack
+      benchmark.Add("ManagerStack/PushTrack" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         TVirtualMCStack *engineStack = TMCManager::Instance()->GetEngine(0)->GetStack();
+         for (Long64_t i = 0; i < n; ++i) {
+            application->GetStack()->Reset();
+            for (Int_t j = 0; j < nofTracks; ++j) {
+               Int_t ntr;
+               engineStack->PushTrack(1, j - 1, 22, 0., 0., 0.1, 0.1, 0., 0., 0., 0., 0., 0., 0., kPHadronic, ntr, 1.,
+                                      0);
+            }
+            Int_t trackId;
+            while (engineStack->PopNextTrack(trackId))
+               TMCBenchmark::DoNotOptimize(trackId);
+         }
+         return n * nofTracks;
+      });
+
+      benchmark.Add("BranchArrayContainer/GetFree" + suffix, "state", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication::GetOrCreate();
+         TGeoMCBranchArrayContainer container;
+         container.InitializeFromGeoManager(gGeoManager);
+         std::vector<UInt_t> indices(nofTracks);
+         for (Long64_t i = 0; i < n; ++i) {
+            for (Int_t j = 0; j < nofTracks; ++j) {
+               TGeoBranchArray *state = container.GetNewGeoState(indices[j]);
+               TMCBenchmark::DoNotOptimize(state);
+            }
+            for (Int_t j = 0; j < nofTracks; ++j)
+               container.FreeGeoState(indices[j]);
+         }
+         return n * nofTracks;
+      });
+
+      // the geometry states saved and restored as in TransferTrack()
+      benchmark.Add("BranchArrayContainer/SaveRestore" + suffix, "state", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication::GetOrCreate();
+         TGeoNavigator *navigator = gGeoManager->GetCurrentNavigator();
+         navigator->FindNode(0., 0., 0.);
+         TGeoMCBranchArrayContainer container;
+         container.InitializeFromGeoManager(gGeoManager);
+         std::vector<UInt_t> indices(nofTracks);
+         for (Long64_t i = 0; i < n; ++i) {
+            for (Int_t j = 0; j < nofTracks; ++j)
+               container.GetNewGeoState(indices[j])->InitFromNavigator(navigator);
+            for (Int_t j = 0; j < nofTracks; ++j) {
+               container.GetGeoState(indices[j])->UpdateNavigator(navigator);
+               container.FreeGeoState(indices[j]);
+            }
+         }
+         return n * nofTracks;
+      });
+
+      benchmark.Add("Manager/ForwardTrack" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication::GetOrCreate();
+         TMCManager *manager = TMCManager::Instance();
+         std::vector<TParticle> &particles = GetParticles();
+         for (Long64_t i = 0; i < n; ++i) {
+            for (Int_t j = 0; j < nofTracks; ++j)
+               manager->ForwardTrack(0, j, -1, &particles[j], 0);
+         }
+         return n * nofTracks;
+      });
+
+      // an event with the primaries generated but not transported: the time
+      // is dominated by PrepareNewEvent()
+      benchmark.Add("Manager/PrepareNewEvent" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         application->SetMode(TMCBenchmarkApplication::kIdle);
+         application->SetPrimaries(nofTracks, 11, 1.);
+         for (Long64_t i = 0; i < n; ++i)
+            TMCManager::Instance()->Run(1);
+         return n * nofTracks;
+      });
+
+      // each track is moved to the other engine before its first step
+      // and stopped there
+      benchmark.Add("Manager/TransferTrack" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         application->SetMode(TMCBenchmarkApplication::kTransfer);
+         application->SetPrimaries(nofTracks, 11, 1.);
+         for (Long64_t i = 0; i < n; ++i)
+            TMCManager::Instance()->Run(1);
+         application->SetMode(TMCBenchmarkApplication::kIdle);
+         return n * nofTracks;
+      });
+
+      // the same with the engines running in their own threads: the tracks
+      // are handed over through the queue of the target engine; each engine
+      // must see each primary once with its own current track
+      benchmark.Add("Manager/Concurrent/TransferTrack" + suffix, "track", [&benchmark, nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         TMCManager *manager = TMCManager::Instance();
+         manager->SetConcurrentMode(kTRUE);
+         application->SetMode(TMCBenchmarkApplication::kTransfer);
+         application->SetPrimaries(nofTracks, 11, 1.);
+         for (Long64_t i = 0; i < n; ++i) {
+            manager->Run(1);
+            if (!application->CheckTransfers())
+               benchmark.Fail("Manager/Concurrent/TransferTrack", "The tracks were not seen once by each engine.");
+         }
+         application->SetMode(TMCBenchmarkApplication::kIdle);
+         manager->SetConcurrentMode(kFALSE);
+         return n * nofTracks;
+      });
+
+      // the primaries are transported by the sub-event workers; the hits of
+      // the last event are compared with the ones of a single worker
+      benchmark.Add("Manager/SubEvent" + suffix, "track", [&benchmark, nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         TMCManager *manager = TMCManager::Instance();
+         application->SetMode(TMCBenchmarkApplication::kTransport);
+         application->SetPrimaries(nofTracks, 11, 0.1);
+         application->SetRecordHits(kTRUE);
+         manager->SetSubEventMode(kNofSubEventWorkers);
+         for (Long64_t i = 0; i < n; ++i)
+            manager->Run(1);
+         std::vector<TMCBenchmarkApplication::THit> hits = application->GetHits();
+
+         manager->SetSubEventMode(1);
+         manager->Run(1);
+         if (!IsSameHits(hits, application->GetHits()))
+            benchmark.Fail("Manager/SubEvent", "The hits with " + std::to_string(kNofSubEventWorkers) +
+                                                  " workers differ from the ones with 1 worker.");
+
+         manager->SetSubEventMode(0);
+         application->SetRecordHits(kFALSE);
+         application->SetMode(TMCBenchmarkApplication::kIdle);
+         return n * nofTracks;
+      });
+
+      // the tracks are moved to the other engine at each layer by the
+      // routing rules applied in the application Stepping()
+      benchmark.Add("Manager/ApplyRoutingRules" + suffix, "track", [nofTracks](Long64_t n) {
+         TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+         TMCManager *manager = TMCManager::Instance();
+         manager->AddRoutingRule(TMCRoutingRule(0).AddMedium("Lead"));
+         manager->AddRoutingRule(TMCRoutingRule(1).AddMedium("Scintillator"));
+         application->SetMode(TMCBenchmarkApplication::kRouting);
+         application->SetPrimaries(nofTracks, 11, 0.1);
+         for (Long64_t i = 0; i < n; ++i)
+            manager->Run(1);
+         application->SetMode(TMCBenchmarkApplication::kIdle);
+         manager->ClearRoutingRules();
+         return n * nofTracks;
+      });
+   }
+}
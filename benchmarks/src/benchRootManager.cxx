@@ -0,0 +1,60 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The Root IO benchmarks: TMCRootManager::Fill() of an event with
+// a given number of hits; the file is written in the current directory
+// and removed afterwards
+//
+
+#include "TMCBenchmark.h"
+#include "VMCBenchmarks.h"
+
+#include "TClonesArray.h"
+#include "TMCRootManager.h"
+#include "TSystem.h"
+#include "TVector3.h"
+
+#include <string>
+
+namespace {
+/// Fill n events with the given number of hits; return the number of events
+Long64_t FillEvents(Long64_t n, Int_t nofHits)
+{
+   const char *projectName = "vmc_benchmarks_rootio";
+   TMCRootManager *rootManager = new TMCRootManager(projectName, TMCRootManager::kWrite);
+
+   TClonesArray *hits = new TClonesArray("TVector3", nofHits);
+   for (Int_t i = 0; i < nofHits; ++i)
+      new ((*hits)[i]) TVector3(0.1 * i, 0.2 * i, 0.3 * i);
+   rootManager->Register("hits", "TClonesArray", &hits);
+
+   for (Long64_t i = 0; i < n; ++i)
+      rootManager->Fill();
+
+   rootManager->WriteAndClose();
+   delete rootManager;
+   delete hits;
+   gSystem->Unlink(TString::Format("%s.root", projectName));
+
+   return n;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the Root IO benchmarks
+///
+
+void RegisterRootManagerBenchmarks(TMCBenchmark &benchmark)
+{
+   for (Int_t nofHits : {10, 100, 1000}) {
+      benchmark.Add("RootManager/Fill/" + std::to_string(nofHits), "event",
+                    [nofHits](Long64_t n) { return FillEvents(n, nofHits); });
+   }
+}
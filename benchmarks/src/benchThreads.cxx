@@ -0,0 +1,115 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The multi-threading benchmarks:
+// - the access to the per-thread VMC objects
+// - the short critical sections protected with std::mutex, TMCMutex
+//   and TMCSpinMutex, with 1 to maxThreads threads
+//
+
+#include "TMCBenchmark.h"
+#include "TMCBenchmarkApplication.h"
+#include "VMCBenchmarks.h"
+
+#include "TMCAutoLock.h"
+#include "TMCManager.h"
+#include "TMCThreadContext.h"
+#include "TVirtualMC.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+/// The number of the critical sections per thread and iteration
+const Int_t kNofLocks = 1000;
+
+/// The number of the accessor calls per iteration
+const Int_t kNofCalls = 1000;
+
+/// Run the critical sections in the given number of threads; return
+/// the total number of the critical sections
+template <typename M>
+Long64_t RunLocks(Long64_t n, Int_t nofThreads)
+{
+   M mutex;
+   Long64_t counters[4] = {0, 0, 0, 0};
+   std::atomic<Bool_t> start(kFALSE);
+
+   std::vector<std::thread> threads;
+   for (Int_t i = 0; i < nofThreads; ++i) {
+      threads.emplace_back([&mutex, &counters, &start, n, i]() {
+         while (!start.load(std::memory_order_acquire))
+            std::this_thread::yield();
+         for (Long64_t j = 0; j < n * kNofLocks; ++j) {
+            std::lock_guard<M> lock(mutex);
+            ++counters[(i + j) % 4];
+         }
+      });
+   }
+   start.store(kTRUE, std::memory_order_release);
+   for (auto &thread : threads)
+      thread.join();
+
+   TMCBenchmark::DoNotOptimize(counters[0]);
+   return n * kNofLocks * nofThreads;
+}
+
+/// Register the lock benchmarks of the given mutex type
+template <typename M>
+void AddLockBenchmarks(TMCBenchmark &benchmark, const std::string &mutexName, Int_t maxThreads)
+{
+   for (Int_t nofThreads = 1; nofThreads <= maxThreads; nofThreads *= 2) {
+      benchmark.Add("Lock/" + mutexName + "/" + std::to_string(nofThreads), "lock",
+                    [nofThreads](Long64_t n) { return RunLocks<M>(n, nofThreads); });
+   }
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the multi-threading benchmarks
+///
+
+void RegisterThreadBenchmarks(TMCBenchmark &benchmark, Int_t maxThreads)
+{
+   benchmark.Add("ThreadContext/TVirtualMC::GetMC", "call", [](Long64_t n) {
+      TMCBenchmarkApplication::GetOrCreate();
+      for (Long64_t i = 0; i < n * kNofCalls; ++i) {
+         TVirtualMC *mc = TVirtualMC::GetMC();
+         TMCBenchmark::DoNotOptimize(mc);
+      }
+      return n * kNofCalls;
+   });
+
+   benchmark.Add("ThreadContext/TMCManager::Instance", "call", [](Long64_t n) {
+      TMCBenchmarkApplication::GetOrCreate();
+      for (Long64_t i = 0; i < n * kNofCalls; ++i) {
+         TMCManager *manager = TMCManager::Instance();
+         TMCBenchmark::DoNotOptimize(manager);
+      }
+      return n * kNofCalls;
+   });
+
+   benchmark.Add("ThreadContext/TMCThreadContext::Instance", "call", [](Long64_t n) {
+      TMCBenchmarkApplication::GetOrCreate();
+      for (Long64_t i = 0; i < n * kNofCalls; ++i) {
+         TMCThreadContext &context = TMCThreadContext::Instance();
+         TMCBenchmark::DoNotOptimize(context.fMC);
+         TMCBenchmark::DoNotOptimize(context.fManager);
+      }
+      return n * kNofCalls;
+   });
+
+   AddLockBenchmarks<std::mutex>(benchmark, "std::mutex", maxThreads);
+   AddLockBenchmarks<TMCMutex>(benchmark, "TMCMutex", maxThreads);
+   AddLockBenchmarks<TMCSpinMutex>(benchmark, "TMCSpinMutex", maxThreads);
+}
@@ -0,0 +1,100 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The toy engine benchmarks: the transport of 10 primaries per event
+// through the benchmark calorimeter, measured per step, which includes
+// the navigation, the user stepping and the TMCManager dispatch
+//
+
+#include "TMCBenchmark.h"
+#include "TMCBenchmarkApplication.h"
+#include "VMCBenchmarks.h"
+
+#include "TMCManager.h"
+#include "TMCToyMC.h"
+#include "TRandom.h"
+#include "TVirtualMCMagField.h"
+
+#include <string>
+
+namespace {
+/// The uniform field along z
+class TUniformField : public TVirtualMCMagField {
+public:
+   TUniformField(Double_t bz) : TVirtualMCMagField("UniformField"), fBz(bz) {}
+
+   virtual void Field(const Double_t * /*x*/, Double_t *b)
+   {
+      b[0] = 0.;
+      b[1] = 0.;
+      b[2] = fBz;
+   }
+
+private:
+   Double_t fBz; ///< The field value (kGauss)
+};
+
+/// Run n events with the given primaries; return the number of steps
+Long64_t Transport(Long64_t n, Int_t pdg, Double_t energy)
+{
+   TMCBenchmarkApplication *application = TMCBenchmarkApplication::GetOrCreate();
+   application->SetMode(TMCBenchmarkApplication::kTransport);
+   application->SetPrimaries(10, pdg, energy);
+
+   Long64_t nofSteps = application->GetNofSteps();
+   for (Long64_t i = 0; i < n; ++i) {
+      // the same random sequence in each event
+      gRandom->SetSeed(12345);
+      TMCManager::Instance()->Run(1);
+   }
+   application->SetMode(TMCBenchmarkApplication::kIdle);
+
+   return application->GetNofSteps() - nofSteps;
+}
+
+/// Return the engine 0 of the benchmark application
+TMCToyMC *GetEngine()
+{
+   TMCBenchmarkApplication::GetOrCreate();
+   return static_cast<TMCToyMC *>(TMCManager::Instance()->GetEngine(0));
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Register the toy engine benchmarks
+///
+
+void RegisterToyMCBenchmarks(TMCBenchmark &benchmark)
+{
+   // the straight lines through all layers: the navigation only
+   benchmark.Add("ToyMC/Transport/geantino", "step", [](Long64_t n) { return Transport(n, 0, 1.); });
+
+   // the energy loss stops the electrons after a few tens of layers
+   benchmark.Add("ToyMC/Transport/electron", "step", [](Long64_t n) { return Transport(n, 11, 1.); });
+
+   // the helix steps in a 2 T field
+   benchmark.Add("ToyMC/Transport/electron-field", "step", [](Long64_t n) {
+      TUniformField field(20.);
+      GetEngine()->SetMagField(&field);
+      Long64_t nofSteps = Transport(n, 11, 1.);
+      GetEngine()->SetMagField(nullptr);
+      return nofSteps;
+   });
+
+   // the interactions producing the secondaries pushed via the TMCManager
+   benchmark.Add("ToyMC/Transport/electron-showers", "step", [](Long64_t n) {
+      GetEngine()->SetInteractionLength(50.);
+      GetEngine()->SetSecondaries(2, 0.5, 11);
+      Long64_t nofSteps = Transport(n, 11, 1.);
+      GetEngine()->SetInteractionLength(0.);
+      GetEngine()->SetSecondaries(0, 0.);
+      return nofSteps;
+   });
+}
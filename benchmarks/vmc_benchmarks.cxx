@@ -0,0 +1,164 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// The VMC benchmark suite
+//
+// Usage: vmc_benchmarks [options]
+//   --filter=REGEX      run only the benchmarks with the name matching REGEX
+//   --format=json|csv   the output format (default json)
+//   --output=FILE       write the results in FILE (default standard output)
+//   --min-time=SECONDS  the minimal duration of one repetition (default 0.2)
+//   --repetitions=N     the number of repetitions (default 5)
+//   --max-threads=N     the maximal number of threads of the lock benchmarks
+//                       (default 128)
+//   --list              print the benchmark names and exit
+//   --verbose           print the progress on the standard error
+//
+// The JSON output contains the run context (the VMC and ROOT versions,
+// the compiler, the build type and the host) and one record per benchmark;
+// two outputs can be compared by the benchmark names. The program exits
+// with 1 if the check of a benchmark failed.
+//
+
+#include "TMCBenchmark.h"
+#include "TMCVersion.h"
+#include "VMCBenchmarks.h"
+
+#include "TError.h"
+#include "TROOT.h"
+#include "TSystem.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifndef VMC_BENCHMARKS_BUILD_TYPE
+#define VMC_BENCHMARKS_BUILD_TYPE "unknown"
+#endif
+
+namespace {
+/// Return the value of the option --name=value, or an empty string
+Bool_t GetOption(const std::string &argument, const std::string &name, std::string &value)
+{
+   std::string prefix = "--" + name + "=";
+   if (argument.compare(0, prefix.size(), prefix) != 0)
+      return kFALSE;
+
+   value = argument.substr(prefix.size());
+   return kTRUE;
+}
+
+/// Write the JSON document with the run context and the results
+void WriteJson(const TMCBenchmark &benchmark, std::ostream &out)
+{
+   char date[32];
+   std::time_t now = std::time(nullptr);
+   std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+   out << "{\n";
+   out << "  \"context\": {"
+       << "\"vmc_release\": \"" << VMC_RELEASE << "\", "
+       << "\"root_version\": \"" << gROOT->GetVersion() << "\", "
+#if defined(__VERSION__)
+       << "\"compiler\": \"" << __VERSION__ << "\", "
+#endif
+       << "\"build_type\": \"" << VMC_BENCHMARKS_BUILD_TYPE << "\", "
+       << "\"host\": \"" << gSystem->HostName() << "\", "
+       << "\"hardware_threads\": " << std::thread::hardware_concurrency() << ", "
+       << "\"date\": \"" << date << "\", "
+       << "\"min_time\": " << benchmark.GetMinTime() << ", "
+       << "\"repetitions\": " << benchmark.GetRepetitions() << "},\n";
+   benchmark.WriteJson(out);
+   out << "\n}" << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+   std::string filter;
+   std::string format = "json";
+   std::string outputFile;
+   Int_t maxThreads = 128;
+   Bool_t list = kFALSE;
+
+   TMCBenchmark benchmark;
+   for (Int_t i = 1; i < argc; ++i) {
+      std::string argument(argv[i]);
+      std::string value;
+      if (GetOption(argument, "filter", value)) {
+         filter = value;
+      } else if (GetOption(argument, "format", value)) {
+         format = value;
+      } else if (GetOption(argument, "output", value)) {
+         outputFile = value;
+      } else if (GetOption(argument, "min-time", value)) {
+         benchmark.SetMinTime(std::atof(value.c_str()));
+      } else if (GetOption(argument, "repetitions", value)) {
+         benchmark.SetRepetitions(std::atoi(value.c_str()));
+      } else if (GetOption(argument, "max-threads", value)) {
+         maxThreads = std::atoi(value.c_str());
+      } else if (argument == "--list") {
+         list = kTRUE;
+      } else if (argument == "--verbose") {
+         benchmark.SetVerbose(kTRUE);
+      } else {
+         std::cerr << "Unknown option " << argument << "; see the header of vmc_benchmarks.cxx for the usage."
+                   << std::endl;
+         return 1;
+      }
+   }
+   if (format != "json" && format != "csv") {
+      std::cerr << "Unknown format " << format << "; use json or csv." << std::endl;
+      return 1;
+   }
+
+   // the geometry benchmarks must be registered first (see benchGeometry.cxx)
+   RegisterGeometryBenchmarks(benchmark);
+   RegisterManagerBenchmarks(benchmark);
+   RegisterToyMCBenchmarks(benchmark);
+   RegisterFieldBenchmarks(benchmark);
+   RegisterRootManagerBenchmarks(benchmark);
+   RegisterThreadBenchmarks(benchmark, maxThreads);
+
+   if (list) {
+      benchmark.List(std::cout);
+      return 0;
+   }
+
+   // suppress the per-event messages of the TMCManager
+   gErrorIgnoreLevel = kWarning;
+
+   if (!benchmark.Run(filter)) {
+      std::cerr << "No benchmark matches " << filter << std::endl;
+      return 1;
+   }
+
+   std::ofstream file;
+   if (!outputFile.empty()) {
+      file.open(outputFile);
+      if (!file) {
+         std::cerr << "Cannot open " << outputFile << std::endl;
+         return 1;
+      }
+   }
+   std::ostream &out = outputFile.empty() ? std::cout : file;
+   if (format == "json")
+      WriteJson(benchmark, out);
+   else
+      benchmark.WriteCsv(out);
+
+   if (benchmark.GetNofFailures() > 0) {
+      std::cerr << benchmark.GetNofFailures() << " benchmark checks failed" << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -18,6 +18,9 @@
 #pragma link C++ class TVirtualMCApplication + ;
 #pragma link C++ class TVirtualMCSensitiveDetector + ;
 #pragma link C++ class TVirtualMCStack + ;
+#pragma link C++ class TVirtualMCMagField + ;
+#pragma link C++ class TMCGridMagField + ;
+#pragma link C++ class TMCPhiloxRandom + ;
 #pragma link C++ class TMCVerbose + ;
 #pragma link C++ class TGeoMCGeometry + ;
 #pragma link C++ class TMCManager + ;
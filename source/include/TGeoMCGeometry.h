@@ -27,13 +27,22 @@
 // for building TGeo geometry.
 //
 
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 #include "Rtypes.h"
+#include "TArrayD.h"
+#include "TGeoMatrix.h"
+#include "TString.h"
 #include "TVirtualMCGeometry.h"
 
 class TGeoManager;
-class TGeoHMatrix;
-class TArrayD;
-class TString;
+class TGeoRotation;
+class TGeoShape;
+class TGeoVolume;
 
 class TGeoMCGeometry : public TVirtualMCGeometry {
 
@@ -75,6 +84,11 @@ public:
                        const char *konly, Float_t *upar, Int_t np);
    virtual void Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
                        const char *konly, Double_t *upar, Int_t np);
+   virtual void GsposArray(const char *name, Int_t n, const Int_t *nr, const char *mother, const Double_t *x,
+                           const Double_t *y, const Double_t *z, Int_t irot, const char *konly = "ONLY");
+   virtual void GsposLattice(const char *name, Int_t nr0, const char *mother, Int_t nx, Int_t ny, Int_t nz,
+                             Double_t x0, Double_t y0, Double_t z0, Double_t dx, Double_t dy, Double_t dz, Int_t irot,
+                             const char *konly = "ONLY");
    virtual void Gsbool(const char * /*onlyVolName*/, const char * /*manyVolName*/) {}
 
    // functions for access to geometry
@@ -83,6 +97,10 @@ public:
    // the path volumePath and the top or master volume.
    virtual Bool_t GetTransformation(const TString &volumePath, TGeoHMatrix &matrix);
 
+   // Return the transformation matrices for all volumes specified by
+   // the paths volumePaths; the common path prefixes are navigated only once.
+   virtual Bool_t GetTransformations(const std::vector<TString> &volumePaths, std::vector<TGeoHMatrix> &matrices);
+
    // Return the name of the shape and its parameters for the volume
    // specified by the volume name.
    virtual Bool_t GetShape(const TString &volumePath, TString &shapeType, TArrayD &par);
@@ -117,7 +135,28 @@ public:
    virtual Int_t VolDaughterCopyNo(const char *volName, Int_t i) const;
    virtual Int_t VolId2Mate(Int_t id) const;
 
+   // Clear the cached transformations and shapes
+   void ClearGeometryCache();
+
+   // Align a physical node and invalidate the cached transformations and shapes
+   Bool_t AlignNode(const TString &volumePath, TGeoHMatrix *newMatrix, TGeoShape *newShape = 0, Bool_t check = kFALSE);
+
+   // De-duplication of rotation matrices and materials
+   void SetDeduplication(Bool_t deduplicate, Double_t tolerance = 1e-9);
+   void PrintDeduplicationStatistics() const;
+
+   // Geometry snapshot
+   Bool_t SaveGeometrySnapshot(const char *fileName, const char *key) const;
+   Bool_t LoadGeometrySnapshot(const char *fileName, const char *key);
+   static TString ComputeSnapshotKey(const std::vector<TString> &inputFiles, const char *parameters = "");
+
 private:
+   /// Cached shape type and parameters
+   struct ShapeEntry {
+      TString fType; ///< Shape type
+      TArrayD fPar;  ///< Shape parameters
+   };
+
    TGeoMCGeometry(const TGeoMCGeometry & /*rhs*/);
    TGeoMCGeometry &operator=(const TGeoMCGeometry & /*rhs*/);
 
@@ -126,9 +165,75 @@ private:
    Double_t *CreateDoubleArray(Float_t *array, Int_t size) const;
    void Vname(const char *name, char *vname) const;
 
+   // name indices
+   void InvalidateIndices();
+   Bool_t UpdateIndices() const;
+   TGeoVolume *FindVolume(const char *volName) const;
+
+   // transformation and shape cache
+   void UpdateGeometryCache();
+   TString GetFullPath(const TString &volumePath) const;
+   Bool_t ComputeShape(const TString &volumePath, TString &shapeType, TArrayD &par);
+
+   // de-duplication
+   void AddToKey(std::string &key, Double_t value, Bool_t relative) const;
+   Int_t MaterialAlias(Int_t kmat) const;
+
+   // bulk placement
+   Bool_t ResolvePlacement(const char *name, const char *mother, Int_t irot, const char *konly, TGeoVolume *&volume,
+                           TGeoVolume *&motherVolume, TGeoRotation *&rotation, Bool_t &isOnly);
+   TGeoMatrix *GetPlacementMatrix(Double_t x, Double_t y, Double_t z, TGeoRotation *rotation);
+
    /// Option to convert volumes names to be compatible with G3
    Bool_t fG3CompatibleVolumeNames;
 
+   /// Volume name to volume map, built once the geometry is closed
+   mutable std::unordered_map<std::string, TGeoVolume *> fVolumeIndex; //!
+   /// Medium name to medium id map, built once the geometry is closed
+   mutable std::unordered_map<std::string, Int_t> fMediumIndex; //!
+   /// Number of volumes covered by the indices
+   mutable Int_t fNofIndexedVolumes; //!
+   /// Number of media covered by the indices
+   mutable Int_t fNofIndexedMedia; //!
+   /// The TGeoManager for which the indices were built
+   mutable TGeoManager *fIndexedGeoManager; //!
+   /// Flag if the name indices are up-to-date
+   mutable Bool_t fIsIndexed; //!
+
+   /// Volume path to global transformation cache
+   std::unordered_map<std::string, TGeoHMatrix> fMatrixCache; //!
+   /// Volume path to shape cache
+   std::unordered_map<std::string, ShapeEntry> fShapeCache; //!
+   /// The TGeoManager for which the caches were filled
+   TGeoManager *fCachedGeoManager; //!
+   /// Number of physical nodes (alignment state) when the caches were filled
+   Int_t fNofCachedPhysicalNodes; //!
+   /// Number of the alignments via AlignNode() when the caches were filled
+   ULong64_t fCachedAlignmentGeneration; //!
+
+   /// Option to reuse identical rotation matrices and materials
+   Bool_t fDeduplicate; //!
+   /// Tolerance used to compare the rotation matrix elements (absolute)
+   /// and the material parameters (relative)
+   Double_t fDeduplicationTolerance; //!
+   /// Quantised rotation matrix to rotation matrix number map
+   std::unordered_map<std::string, Int_t> fRotationKeys; //!
+   /// Quantised material composition to material number map
+   std::unordered_map<std::string, Int_t> fMaterialKeys; //!
+   /// Material numbers replaced by the number of an identical material
+   std::unordered_map<Int_t, Int_t> fMaterialAliases; //!
+   /// Number of reused rotation matrices
+   Int_t fNofReusedRotations; //!
+   /// Number of reused materials
+   Int_t fNofReusedMaterials; //!
+   /// Number of reused material elements
+   Int_t fNofReusedElements; //!
+
+   /// Position and rotation to the placement matrix shared by the bulk placements
+   std::map<std::tuple<Double_t, Double_t, Double_t, TGeoRotation *>, TGeoMatrix *> fPlacementMatrices; //!
+   /// The TGeoManager owning the placement matrices
+   TGeoManager *fPlacementGeoManager; //!
+
    static TGeoMCGeometry *fgInstance; ///< Singleton instance
 
    ClassDef(TGeoMCGeometry, 2) // VMC TGeo Geometry builder
@@ -298,17 +298,120 @@ int main()
 #define TMCMULTITHREADED 1
 #endif
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <mutex>
 #include <system_error>
 
 
+// Lock contention instrumentation (VMC_LOCK_PROFILING)
+//
+// When the library is built with VMC_LOCK_PROFILING, TMCMutex is
+// a std::mutex which records, per mutex and per call site of TMCAutoLock,
+// the number of acquisitions, the number of contended acquisitions,
+// the total wait time and the maximum hold time.
+// The report is printed with TMCLockProfiler::Print(), typically at the end
+// of run; without VMC_LOCK_PROFILING the functions have no effect.
+
+class TMCLockProfiler
+{
+ public:
+  static bool IsEnabled();
+  static void Print(std::ostream& out = std::cout);
+  static void Reset();
+
+  // the call site used by the next lock() on a profiled mutex
+  // in this thread (set by TMCAutoLock)
+  static void SetCallSite(const char* file, int line);
+};
+
+#if defined(VMC_LOCK_PROFILING)
+
+struct TMCLockSiteStats;
+
+class TMCProfiledMutex
+{
+ public:
+  constexpr TMCProfiledMutex() noexcept = default;
+  TMCProfiledMutex(const TMCProfiledMutex&) = delete;
+  TMCProfiledMutex& operator=(const TMCProfiledMutex&) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+ private:
+  std::mutex fMutex;
+  TMCLockSiteStats* fOwnerStats = nullptr;  // written by the owner only
+  long long fLockTime           = 0;        // in ns, written by the owner only
+};
+
+#endif  // defined(VMC_LOCK_PROFILING)
+
 // Definitions from G4Threading.hh
 
 // Global mutex types
+#if defined(VMC_LOCK_PROFILING)
+using TMCMutex          = TMCProfiledMutex;
+#else
 using TMCMutex          = std::mutex;
+#endif
 using TMCRecursiveMutex = std::recursive_mutex;
+
+// Mutex for short critical sections: the contended lock spins for a bounded
+// number of iterations with exponential backoff before it blocks (on a futex
+// on Linux, by yielding elsewhere).
+// It satisfies the Lockable requirements and can be used with
+// TMCTemplateAutoLock (see TMCSpinAutoLock below).
+class TMCSpinMutex
+{
+ public:
+  constexpr TMCSpinMutex() noexcept = default;
+  TMCSpinMutex(const TMCSpinMutex&) = delete;
+  TMCSpinMutex& operator=(const TMCSpinMutex&) = delete;
+
+  void lock()
+  {
+    int expected = kUnlocked;
+    if(!fState.compare_exchange_strong(expected, kLocked,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+      LockContended();
+  }
+
+  bool try_lock()
+  {
+    int expected = kUnlocked;
+    return fState.compare_exchange_strong(expected, kLocked,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void unlock()
+  {
+    // wake a waiter only if some thread blocked
+    if(fState.exchange(kUnlocked, std::memory_order_release) == kWaiters)
+      WakeOne();
+  }
+
+  // the tuning of the spin phase (common to all mutexes)
+  static void SetMaxSpins(int maxSpins);
+  static int GetMaxSpins();
+
+ private:
+  enum
+  {
+    kUnlocked = 0,
+    kLocked   = 1,
+    kWaiters  = 2  // locked, and threads may be blocked
+  };
+
+  void LockContended();
+  void WakeOne();
+
+  std::atomic<int> fState{ kUnlocked };
+};
 using thread_lock =
   int (*)(TMCMutex*);  // typedef Int (*thread_lock)(TMCMutex*);
 using thread_unlock =
@@ -360,12 +463,25 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
   // Locks the associated mutex by calling m.lock(). The behavior is
   // undefined if the current thread already owns the mutex except when
   // the mutex is recursive
+#if defined(VMC_LOCK_PROFILING)
+  TMCTemplateAutoLock(mutex_type& _mutex,
+                      const char* _file = __builtin_FILE(),
+                      int _line         = __builtin_LINE())
+    : unique_lock_t(_mutex, std::defer_lock)
+  {
+    TMCLockProfiler::SetCallSite(_file, _line);
+    // call termination-safe locking. if serial, this call has no effect
+    _lock_deferred();
+    TMCLockProfiler::SetCallSite(nullptr, 0);
+  }
+#else
   TMCTemplateAutoLock(mutex_type& _mutex)
     : unique_lock_t(_mutex, std::defer_lock)
   {
     // call termination-safe locking. if serial, this call has no effect
     _lock_deferred();
   }
+#endif
 
   // Tries to lock the associated mutex by calling
   // m.try_lock_for(_timeout_duration). Blocks until specified
@@ -432,12 +548,25 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
   //------------------------------------------------------------------------//
   // Backwards compatibility versions (constructor with pointer to mutex)
   //------------------------------------------------------------------------//
+#if defined(VMC_LOCK_PROFILING)
+  TMCTemplateAutoLock(mutex_type* _mutex,
+                      const char* _file = __builtin_FILE(),
+                      int _line         = __builtin_LINE())
+    : unique_lock_t(*_mutex, std::defer_lock)
+  {
+    TMCLockProfiler::SetCallSite(_file, _line);
+    // call termination-safe locking. if serial, this call has no effect
+    _lock_deferred();
+    TMCLockProfiler::SetCallSite(nullptr, 0);
+  }
+#else
   TMCTemplateAutoLock(mutex_type* _mutex)
     : unique_lock_t(*_mutex, std::defer_lock)
   {
     // call termination-safe locking. if serial, this call has no effect
     _lock_deferred();
   }
+#endif
 
   TMCTemplateAutoLock(mutex_type* _mutex, std::defer_lock_t _lock) noexcept
     : unique_lock_t(*_mutex, _lock)
@@ -509,7 +638,9 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
 // helpful macros
 #define _is_stand_mutex(_Tp) (std::is_same<_Tp, TMCMutex>::value)
 #define _is_recur_mutex(_Tp) (std::is_same<_Tp, TMCRecursiveMutex>::value)
-#define _is_other_mutex(_Tp) (!_is_stand_mutex(_Tp) && !_is_recur_mutex(_Tp))
+#define _is_spin_mutex(_Tp) (std::is_same<_Tp, TMCSpinMutex>::value)
+#define _is_other_mutex(_Tp)                                                \
+  (!_is_stand_mutex(_Tp) && !_is_recur_mutex(_Tp) && !_is_spin_mutex(_Tp))
 
   template <typename _Tp                                             = _Mutex_t,
             typename std::enable_if<_is_stand_mutex(_Tp), int>::type = 0>
@@ -525,6 +656,13 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
     return "TMCAutoLock<TMCRecursiveMutex>";
   }
 
+  template <typename _Tp                                            = _Mutex_t,
+            typename std::enable_if<_is_spin_mutex(_Tp), int>::type = 0>
+  std::string GetTypeString()
+  {
+    return "TMCAutoLock<TMCSpinMutex>";
+  }
+
   template <typename _Tp                                             = _Mutex_t,
             typename std::enable_if<_is_other_mutex(_Tp), int>::type = 0>
   std::string GetTypeString()
@@ -535,6 +673,7 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
 // pollution is bad
 #undef _is_stand_mutex
 #undef _is_recur_mutex
+#undef _is_spin_mutex
 #undef _is_other_mutex
 
   // used in _lock_deferred chrono variants to avoid ununsed-variable warning
@@ -644,11 +783,13 @@ class TMCTemplateAutoLock : public std::unique_lock<_Mutex_t>
 //      Use the non-template types below:
 //          - TMCAutoLock with TMCMutex
 //          - TMCRecursiveAutoLock with TMCRecursiveMutex
+//          - TMCSpinAutoLock with TMCSpinMutex
 //
 // -------------------------------------------------------------------------- //
 
 using TMCAutoLock          = TMCTemplateAutoLock<TMCMutex>;
 using TMCRecursiveAutoLock = TMCTemplateAutoLock<TMCRecursiveMutex>;
+using TMCSpinAutoLock      = TMCTemplateAutoLock<TMCSpinMutex>;
 
 // provide abbriviated type if another mutex type is desired to be used
 // aside from above
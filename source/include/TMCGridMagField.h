@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCGridMagField
+#define ROOT_TMCGridMagField
+
+//
+// Class TMCGridMagField
+// ---------------------
+// Magnetic field map defined on a regular Cartesian or cylindrical grid
+// and loaded from a binary file
+//
+
+#include <memory>
+
+#include "TString.h"
+#include "TVirtualMCMagField.h"
+
+class TMCGridMagField : public TVirtualMCMagField {
+public:
+   /// The grid coordinates
+   enum ECoordinates {
+      kCartesian = 0,  ///< (x, y, z) grid with (Bx, By, Bz) values
+      kCylindrical = 1 ///< (r, phi, z) grid with (Br, Bphi, Bz) values
+   };
+
+   TMCGridMagField(const char *name, const char *fileName, Double_t scale = 1.);
+   TMCGridMagField();
+   virtual ~TMCGridMagField();
+
+   using TVirtualMCMagField::Field;
+
+   // methods
+   virtual void Field(const Double_t *x, Double_t *b);
+   virtual void Field(Int_t n, const Double_t *xyz, Double_t *bxyz);
+
+   static Bool_t WriteMap(const char *fileName, ECoordinates coordinates, const Int_t *n, const Double_t *min,
+                          const Double_t *max, const Double_t *values, Int_t mirror = 0,
+                          const Double_t *mirrorSigns = 0, Double_t phiPeriod = 0.);
+
+   // get methods
+   Bool_t IsValid() const;
+   const char *GetFileName() const { return fFileName.Data(); }
+   Double_t GetScale() const { return fScale; }
+
+   // set methods
+   void SetScale(Double_t scale) { fScale = scale; }
+
+   /// The map data shared between all fields loaded from the same file
+   struct TGridData;
+
+private:
+   // Not implemented
+   TMCGridMagField(const TMCGridMagField &);
+   TMCGridMagField &operator=(const TMCGridMagField &);
+
+   // data members
+   TString fFileName;                     ///< The field map file name
+   Double_t fScale;                       ///< The scale factor applied to the field values
+   std::shared_ptr<const TGridData> fMap; //!< The mapped field map
+
+   ClassDef(TMCGridMagField, 1) // Magnetic field map on a regular grid
+};
+
+#endif // ROOT_TMCGridMagField
@@ -27,10 +27,14 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "TMCtls.h"
+#include "TMCAutoLock.h"
 #include "TGeoMCBranchArrayContainer.h"
 #include "TMCParticleStatus.h"
+#include "TMCRoutingRule.h"
 #include "TGeoManager.h"
 #include "TVirtualMC.h"
 
@@ -44,6 +48,11 @@ class TMCManager {
 
    friend class TVirtualMCApplication;
 
+   /// The state shared with the engine threads in the concurrent mode
+   struct TConcurrentState;
+   /// The state shared with the workers in the sub-event mode
+   struct TSubEventState;
+
 public:
    /// Default constructor
    TMCManager();
@@ -79,7 +88,8 @@ public:
    /// Get engine ID by its name
    Int_t GetEngineId(const char *name) const;
 
-   /// Get the current engine pointer
+   /// Get the current engine pointer (the engine of this thread in the
+   /// concurrent mode)
    TVirtualMC *GetCurrentEngine() const;
 
    /// Connect a pointer which is updated whenever the engine is changed
@@ -106,6 +116,12 @@ public:
    /// Assume current engine Id
    void ForwardTrack(Int_t toBeDone, Int_t trackId, Int_t parentId, TParticle *particle);
 
+   /// User interface to forward a batch of particles; the engines are chosen
+   /// by the track routing function or rules, see SetTrackRoutingFunction()
+   /// and AddTrackRoutingRule(), or the current engine is assumed.
+   void ForwardTracks(Int_t nofTracks, const Int_t *toBeDone, const Int_t *trackIds, const Int_t *parentIds,
+                      TParticle **particles);
+
    /// Transfer track from current engine to engine with engineTargetId
    void TransferTrack(Int_t engineTargetId);
 
@@ -118,6 +134,55 @@ public:
    /// Try to restore geometry for the track currently set
    Bool_t RestoreGeometryState();
 
+   //
+   // Routing of tracks between engines
+   //
+
+   /// Add a rule routing the tracks in a region to an engine; the rules are
+   /// evaluated in the order in which they were added
+   void AddRoutingRule(const TMCRoutingRule &rule);
+
+   /// Remove all routing rules
+   void ClearRoutingRules();
+
+   /// Transfer the current track if it enters (or starts in) a region routed
+   /// to another engine; must be called by the application at each step in
+   /// TVirtualMCApplication::Stepping(), as the manager is not called by the
+   /// engines. Return true if the track was transferred.
+   Bool_t ApplyRoutingRules();
+
+   /// The function assigning the engines to a batch of new tracks from their
+   /// PDG codes, kinetic energies (GeV) and production volumes (TGeoVolume
+   /// numbers); an engine id < 0 leaves the choice to the next rule or to
+   /// the default (the current engine)
+   using TTrackRoutingFunction = std::function<void(Int_t nofTracks, const Int_t *pdg, const Double_t *ekin,
+                                                    const Int_t *volNumbers, Int_t *engineIds)>;
+
+   /// Set the function routing the new tracks forwarded without an engine id
+   void SetTrackRoutingFunction(TTrackRoutingFunction function);
+
+   /// Add a rule routing the new tracks forwarded without an engine id by
+   /// their PDG code, kinetic energy and production volume; a rule without
+   /// volumes and media applies everywhere. The rules are evaluated after
+   /// the routing function, in the order in which they were added. The
+   /// production volume is the current volume of the engine for the tracks
+   /// forwarded during the transport, the volume of the vertex otherwise.
+   void AddTrackRoutingRule(const TMCRoutingRule &rule);
+
+   /// Remove the track routing function and rules
+   void ClearTrackRouting();
+
+   /// Get the numbers of the new tracks routed to each engine and the sums of
+   /// their kinetic energies in the current event, or in the current run if
+   /// isRun is true
+   void GetTrackRoutingStatistics(std::vector<Long64_t> &nofTracks, std::vector<Double_t> &ekin,
+                                  Bool_t isRun = kFALSE) const;
+
+   /// Print the track routing statistics of the current event, or of the
+   /// current run if isRun is true; the run statistics are printed at the
+   /// end of each run with routing
+   void PrintTrackRoutingStatistics(Bool_t isRun = kFALSE) const;
+
    //
    // Steering and control
    //
@@ -155,6 +220,39 @@ public:
    /// Run the event loop
    void Run(Int_t nEvents);
 
+   /// Switch on/off the concurrent mode, where each engine runs in its own
+   /// thread and the engines process the same event concurrently. The engines
+   /// must not be multi-threaded themselves (TVirtualMC::IsMT() false), the run
+   /// is aborted otherwise.
+   void SetConcurrentMode(Bool_t isConcurrent);
+
+   /// Return true if the concurrent mode is switched on
+   Bool_t IsConcurrentMode() const;
+
+   //
+   // Sub-event mode
+   //
+
+   /// Switch on the sub-event mode where the primaries of each event are
+   /// split across nofWorkers worker threads (0 = switched off). The workers
+   /// get a copy of the routing rules and of the track routing function,
+   /// which is then called from several threads.
+   void SetSubEventMode(Int_t nofWorkers);
+
+   /// Return the number of the sub-event workers (0 if the mode is off)
+   Int_t GetNofSubEventWorkers() const;
+
+   /// Return the id for a new track; the user stack must number its tracks
+   /// with this method in the sub-event mode
+   Int_t NextTrackId();
+
+   /// Return the canonical id of the given track, independent of the number
+   /// of the sub-event workers; valid from MergeSubEvent() until the next event
+   Int_t GetCanonicalTrackId(Int_t trackId) const;
+
+   /// Return true if this thread is a sub-event worker
+   static Bool_t IsSubEventWorker();
+
 private:
    /// Do necessary steps before an event is triggered
    void PrepareNewEvent();
@@ -164,13 +262,57 @@ private:
    void UpdateEnginePointers(TVirtualMC *mc);
    /// Terminate a run in all engines
    void TerminateRun();
+   /// Build the per-engine and per-volume lookup tables of the routing rules
+   void BuildRoutingTables();
+   /// Return the engine of this thread in the concurrent mode, the current
+   /// engine otherwise
+   TVirtualMC *CurrentEngine() const;
+   /// Lock the mutex of the track containers in the concurrent mode
+   std::unique_lock<TMCMutex> LockTracks() const;
+   /// Lock the mutex of the track routing in the concurrent mode
+   std::unique_lock<TMCMutex> LockRouting() const;
+   /// Notify the thread of the given engine about new tracks in its stack
+   void NotifyEngine(Int_t engineId);
+   /// Wake up all engine threads after a change of the concurrent state
+   void WakeEngines();
+   /// Start the engine threads of the concurrent mode
+   void StartEngineThreads();
+   /// Stop the engine threads of the concurrent mode
+   void StopEngineThreads();
+   /// The loop of the thread of the engine with the given id
+   void EngineThreadLoop(Int_t engineId);
+   /// Process the current event with all engines concurrently
+   void ProcessEventConcurrently(Int_t eventId);
+   /// Start the sub-event worker threads
+   void StartSubEventWorkers();
+   /// Stop the sub-event worker threads
+   void StopSubEventWorkers();
+   /// The loop of the sub-event worker thread with the given id
+   void SubEventWorkerLoop(Int_t workerId);
+   /// Split the primaries of the current event across the sub-event workers
+   void ProcessEventInSubEvents(Int_t eventId);
+   /// Process the primaries distributed by the master (on a sub-event worker)
+   void ProcessSubEvent(Int_t eventId);
+   /// Build the map of the track ids to the canonical ones
+   void BuildCanonicalTrackIds();
+   /// Return the index of the given track in the track containers (-1 if unknown)
+   Int_t GetTrackIndex(Int_t trackId) const;
+   /// Build the volume masks of the track routing rules and the production
+   /// volume look-ups
+   void BuildTrackRoutingMasks();
+   /// Choose the engines of the new tracks in the routing buffers
+   void RouteTracks(Int_t nofTracks, TParticle **particles);
 
 private:
    // static data members
 #if !defined(__CINT__)
-   static TMCThreadLocal TMCManager *fgInstance; ///< Singleton instance
+   static TMCThreadLocal TMCManager *fgInstance;       ///< Singleton instance
+   static TMCThreadLocal TMCManager *fgSubEventMaster; ///< The master of this sub-event worker thread
+   static TMCThreadLocal Bool_t fgIsInTransport;       ///< Whether an engine of this thread transports tracks
 #else
-   static TMCManager *fgInstance; ///< Singleton instance
+   static TMCManager *fgInstance;       ///< Singleton instance
+   static TMCManager *fgSubEventMaster; ///< The master of this sub-event worker thread
+   static Bool_t fgIsInTransport;       ///< Whether an engine of this thread transports tracks
 #endif
 
    /// Pointer to user application
@@ -189,6 +331,8 @@ private:
    Int_t fTotalNPrimaries;
    /// Total number of tracks ever pushed
    Int_t fTotalNTracks;
+   /// The next free track id in the current event
+   Int_t fNextTrackId;
    /// Connected engine pointers which will be updated everytime the current
    /// engine changes
    std::vector<TVirtualMC **> fConnectedEnginePointers;
@@ -201,6 +345,67 @@ private:
    /// Flag if specific initialization for engines was done
    Bool_t fIsInitializedUser;
    Bool_t fGeometryConstructed;
+   /// The routing rules in the order of their evaluation
+   std::vector<TMCRoutingRule> fRoutingRules;
+   /// Per engine: the offsets in fRoutingTableRules per volume id
+   /// (the rules of volume id i are in [offsets[i], offsets[i+1]))
+   std::vector<std::vector<UInt_t>> fRoutingTableOffsets;
+   /// Per engine: the indices of the rules for all volumes
+   std::vector<std::vector<Int_t>> fRoutingTableRules;
+   /// Flag if the routing tables are up-to-date with the rules
+   Bool_t fIsRoutingTableBuilt;
+   /// The function routing the new tracks
+   TTrackRoutingFunction fTrackRoutingFunction;
+   /// The rules routing the new tracks
+   std::vector<TMCRoutingRule> fTrackRoutingRules;
+   /// Per track routing rule: the flags per TGeoVolume number (empty = all volumes)
+   std::vector<std::vector<UChar_t>> fTrackRoutingMasks;
+   /// Per engine: the TGeoVolume number per engine volume id (-1 if none)
+   std::vector<std::vector<Int_t>> fEngineVolNumbers;
+   /// The navigator locating the primaries, not to disturb the engine navigators
+   std::unique_ptr<TGeoNavigator> fRoutingNavigator;
+   /// Flag if the volume masks are up-to-date with the track routing rules
+   Bool_t fIsTrackRoutingMaskBuilt;
+   /// The PDG codes of the batch of new tracks
+   std::vector<Int_t> fRoutingPdg;
+   /// The kinetic energies of the batch of new tracks
+   std::vector<Double_t> fRoutingEkin;
+   /// The production volume numbers of the batch of new tracks
+   std::vector<Int_t> fRoutingVolNumbers;
+   /// The engines chosen for the batch of new tracks
+   std::vector<Int_t> fRoutingEngineIds;
+   /// Per engine: the number of new tracks routed in the current event
+   std::vector<Long64_t> fNofRoutedTracks;
+   /// Per engine: the kinetic energy of the new tracks routed in the current event
+   std::vector<Double_t> fRoutedEkin;
+   /// Per engine: the number of new tracks routed in the current run
+   std::vector<Long64_t> fRunNofRoutedTracks;
+   /// Per engine: the kinetic energy of the new tracks routed in the current run
+   std::vector<Double_t> fRunRoutedEkin;
+   /// Flag if the concurrent mode is switched on
+   Bool_t fIsConcurrent;
+   /// The engine threads and their synchronization (during a concurrent run)
+   std::unique_ptr<TConcurrentState> fConcurrentState;
+   /// The number of the sub-event workers
+   Int_t fNofSubEventWorkers;
+   /// The workers and their synchronization (during a sub-event run)
+   std::unique_ptr<TSubEventState> fSubEventState;
+   /// The canonical id per track id of the last event (sub-event mode)
+   std::vector<Int_t> fCanonicalTrackIds;
+   /// The master manager (on a sub-event worker)
+   TMCManager *fSubEventMaster;
+   /// The id of the primary being imported from the master (on a sub-event worker)
+   Int_t fImportedTrackId;
+   /// The id of the primary being processed (on a sub-event worker)
+   Int_t fCurrentPrimaryId;
+   /// The number of the tracks created for the current primary (on a sub-event worker)
+   Int_t fPrimarySequence;
+   /// The (track id, primary id, sequence) triples of the tracks created
+   /// in the current event (on a sub-event worker)
+   std::vector<Int_t> fTrackKeys;
+   /// The index in the track containers per track id (on a sub-event worker,
+   /// where the track ids of all workers share one range)
+   std::unordered_map<Int_t, Int_t> fTrackIndices;
 
    ClassDef(TMCManager, 0)
 };
@@ -28,8 +28,11 @@
 #include <vector>
 #include <stack>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "TMCtls.h"
+#include "TMCAutoLock.h"
 #include "TLorentzVector.h"
 #include "TMCProcess.h"
 
@@ -122,19 +125,35 @@ private:
    friend class TMCManager;
    /// Check whether track trackId exists
    Bool_t HasTrackId(Int_t trackId) const;
+   /// Return the index of track trackId in the track containers (-1 if unknown)
+   Int_t GetTrackIndex(Int_t trackId) const;
    /// Set the user stack
    void SetUserStack(TVirtualMCStack *stack);
    /// Set the pointer to vector with all particles and status
    void ConnectTrackContainers(std::vector<TParticle *> *particles,
                                std::vector<std::unique_ptr<TMCParticleStatus>> *tracksStatus,
                                TGeoMCBranchArrayContainer *branchArrayContainer, Int_t *totalNPrimaries,
-                               Int_t *totalNTracks);
+                               Int_t *totalNTracks, const std::unordered_map<Int_t, Int_t> *trackIndices);
    /// Push primary id to be processed
    void PushPrimaryTrackId(Int_t trackId);
    /// Push secondary id to be processed
    void PushSecondaryTrackId(Int_t trackId);
    /// Reset internals, clear engine stack and fParticles and reset buffered values
    void ResetInternals();
+   /// Set the mutexes of the concurrent mode of the TMCManager: the mutex of
+   /// this engine queue, the mutex of the track containers shared by all
+   /// engines and the mutex serializing the calls to the user stack
+   /// (nullptr in the sequential mode)
+   void SetMutexes(TMCMutex *queueMutex, TMCMutex *tracksMutex, TMCRecursiveMutex *userStackMutex);
+   /// Return true if there are tracks to be processed; the queue mutex must
+   /// be locked by the caller
+   Bool_t HasQueuedTracks() const { return !fPrimariesStack.empty() || !fSecondariesStack.empty(); }
+   /// Lock the mutex of this engine queue, if any
+   std::unique_lock<TMCMutex> LockQueue() const;
+   /// Lock the mutex of the track containers, if any
+   std::unique_lock<TMCMutex> LockTracks() const;
+   /// Lock the mutex of the user stack, if any
+   std::unique_lock<TMCRecursiveMutex> LockUserStack() const;
 
 private:
    /// Pointer to current track
@@ -149,12 +168,21 @@ private:
    std::vector<TParticle *> *fParticles;
    /// All TMCParticleStatus linked from the TMCManager
    std::vector<std::unique_ptr<TMCParticleStatus>> *fParticlesStatus;
+   /// The index in the track containers per track id linked from the TMCManager
+   /// (nullptr if the track id is the index)
+   const std::unordered_map<Int_t, Int_t> *fTrackIndices;
    /// Storage of TGeoBranchArray pointers
    TGeoMCBranchArrayContainer *fBranchArrayContainer;
    /// IDs of primaries to be tracked
    std::stack<Int_t> fPrimariesStack;
    /// IDs of secondaries to be trackedk
    std::stack<Int_t> fSecondariesStack;
+   /// Mutex of this engine queue in the concurrent mode
+   TMCMutex *fQueueMutex; //!
+   /// Mutex of the track containers shared by all engines in the concurrent mode
+   TMCMutex *fTracksMutex; //!
+   /// Mutex serializing the calls to the user stack in the concurrent mode
+   TMCRecursiveMutex *fUserStackMutex; //!
 
    ClassDefOverride(TMCManagerStack, 1)
 };
@@ -0,0 +1,60 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCMergeDriver
+#define ROOT_TMCMergeDriver
+
+//
+// Class TMCMergeDriver
+// --------------------
+// Driver merging the worker applications in the master application
+// via a parallel pairwise tree reduction
+//
+
+#include <functional>
+#include <vector>
+
+#include "Rtypes.h"
+
+class TVirtualMCApplication;
+
+class TMCMergeDriver {
+public:
+   /// The function calling the given function on the thread of each worker,
+   /// with the index of the worker application
+   using TExecutor = std::function<void(const std::function<void(Int_t)> &)>;
+
+   TMCMergeDriver(Int_t nofThreads = 0);
+   virtual ~TMCMergeDriver();
+
+   // methods
+   void Merge(TVirtualMCApplication *masterApplication, const std::vector<TVirtualMCApplication *> &workerApplications,
+              const TExecutor &executor = TExecutor());
+   void PrintTimes() const;
+
+   // set methods
+   void SetNofThreads(Int_t nofThreads) { fNofThreads = nofThreads; }
+   void SetVerbose(Bool_t verbose) { fVerbose = verbose; }
+
+   // get methods
+   Int_t GetNofThreads() const { return fNofThreads; }
+   const std::vector<Double_t> &GetLevelTimes() const { return fLevelTimes; }
+
+private:
+   // methods
+   void MergeLevel(std::vector<TVirtualMCApplication *> &applications, size_t stride) const;
+   void MergeLevel(const std::vector<TVirtualMCApplication *> &workerApplications, const std::vector<Int_t> &positions,
+                   size_t stride, const TExecutor &executor) const;
+
+   // data members
+   Int_t fNofThreads;                 ///< The maximum number of own merging threads (0 = hardware concurrency)
+   Bool_t fVerbose;                   ///< Option to print the times after each merge
+   std::vector<Double_t> fLevelTimes; ///< The merge time per tree level in seconds (the last one is the master merge)
+};
+
+#endif // ROOT_TMCMergeDriver
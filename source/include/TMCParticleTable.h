@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCParticleTable
+#define ROOT_TMCParticleTable
+
+//
+// Class TMCParticleTable
+// ----------------------
+// Immutable table of the particle properties with a dense index
+// per PDG code, shared by all threads
+//
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "Rtypes.h"
+#include "TString.h"
+#include "TMCParticleType.h"
+
+class TVirtualMC;
+
+class TMCParticleTable {
+public:
+   ~TMCParticleTable();
+
+   // static methods
+   static const TMCParticleTable *Instance();
+   static const TMCParticleTable *Build(const TVirtualMC &mc, const std::vector<Int_t> &pdgs = std::vector<Int_t>());
+
+   // methods
+   void Print() const;
+
+   // get methods
+   Int_t GetIndex(Int_t pdg) const;
+   Int_t GetNofParticles() const { return fPdg.size(); }
+   Int_t GetPdg(Int_t index) const { return fPdg[index]; }
+   const TString &GetName(Int_t index) const { return fName[index]; }
+   Double_t GetMass(Int_t index) const { return fMass[index]; }
+   Double_t GetCharge(Int_t index) const { return fCharge[index]; }
+   Double_t GetLifeTime(Int_t index) const { return fLifeTime[index]; }
+   TMCParticleType GetMCType(Int_t index) const { return fMCType[index]; }
+
+private:
+   /// The PDG codes in [-kDirectRange, kDirectRange] are indexed via an array
+   static const Int_t kDirectRange = 8191;
+
+   TMCParticleTable();
+   // not implemented
+   TMCParticleTable(const TMCParticleTable &rhs);
+   TMCParticleTable &operator=(const TMCParticleTable &rhs);
+
+   // static data members
+   static std::atomic<const TMCParticleTable *> fgInstance; ///< The published table
+
+   // data members
+   std::vector<Int_t> fDirectIndex;      ///< The index per PDG code in the direct range (-1 if not defined)
+   std::vector<Int_t> fSortedPdg;        ///< The sorted PDG codes outside the direct range
+   std::vector<Int_t> fSortedIndex;      ///< The indices of fSortedPdg
+   std::vector<Int_t> fPdg;              ///< The PDG code per index
+   std::vector<TString> fName;           ///< The name per index
+   std::vector<Double_t> fMass;          ///< The mass (GeV) per index
+   std::vector<Double_t> fCharge;        ///< The charge (e) per index
+   std::vector<Double_t> fLifeTime;      ///< The life time (s) per index
+   std::vector<TMCParticleType> fMCType; ///< The VMC particle type per index
+};
+
+// inline functions
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the published table or nullptr if no table was built;
+/// the table is immutable and can be used from all threads without locking
+///
+
+inline const TMCParticleTable *TMCParticleTable::Instance()
+{
+   return fgInstance.load(std::memory_order_acquire);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the dense index of the particle with the given PDG code,
+/// or -1 if the particle is not in the table
+///
+
+inline Int_t TMCParticleTable::GetIndex(Int_t pdg) const
+{
+   UInt_t direct = UInt_t(pdg + kDirectRange);
+   if (direct <= UInt_t(2 * kDirectRange))
+      return fDirectIndex[direct];
+
+   auto it = std::lower_bound(fSortedPdg.begin(), fSortedPdg.end(), pdg);
+   if (it == fSortedPdg.end() || *it != pdg)
+      return -1;
+   return fSortedIndex[it - fSortedPdg.begin()];
+}
+
+#endif // ROOT_TMCParticleTable
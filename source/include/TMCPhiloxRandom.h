@@ -0,0 +1,62 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCPhiloxRandom
+#define ROOT_TMCPhiloxRandom
+
+//
+// Class TMCPhiloxRandom
+// ---------------------
+// Counter-based random number generator (Philox4x32-10) with
+// the streams keyed by the run, event, engine and sub-stream numbers
+//
+
+#include "TRandom.h"
+
+class TMCPhiloxRandom : public TRandom {
+public:
+   TMCPhiloxRandom(ULong64_t seed = 0);
+   virtual ~TMCPhiloxRandom();
+
+   using TRandom::Rndm;
+
+   // methods
+   virtual Double_t Rndm();
+   virtual void RndmArray(Int_t n, Float_t *array);
+   virtual void RndmArray(Int_t n, Double_t *array);
+
+   void Skip(ULong64_t n);
+
+   static void Philox(const UInt_t *counter, const UInt_t *key, UInt_t *result);
+
+   // set methods
+   virtual void SetSeed(ULong_t seed = 0);
+   void SetMasterSeed(ULong64_t seed);
+   void SetStream(UInt_t run, UInt_t event, UInt_t engine = 0, UInt_t subStream = 0);
+
+   // get methods
+   virtual UInt_t GetSeed() const;
+   ULong64_t GetMasterSeed() const { return fMasterSeed; }
+   ULong64_t GetPosition() const { return fPosition; }
+
+private:
+   void Reset();
+   ULong64_t NextBits();
+
+   // data members
+   ULong64_t fMasterSeed; ///< The master seed
+   UInt_t fKey[2];        ///< The generator key (master seed and engine)
+   UInt_t fCounter[4];    ///< The block counter (block, sub-stream, event, run)
+   UInt_t fBuffer[4];     ///< The current block of random bits
+   ULong64_t fPosition;   ///< The number of values drawn from the stream
+   Bool_t fIsBufferValid; ///< Whether the buffer holds the block of the current position
+
+   ClassDef(TMCPhiloxRandom, 1) // Counter-based random number generator
+};
+
+#endif // ROOT_TMCPhiloxRandom
@@ -0,0 +1,152 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCProfiler
+#define ROOT_TMCProfiler
+
+//
+// Class TMCProfiler
+// -----------------
+// Attribution of the transport time and of the steps to the volumes,
+// particles and engines, called from the user application hooks
+//
+
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Rtypes.h"
+#include "TString.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+class TMCRootManager;
+class TVirtualMC;
+
+class TMCProfiler {
+public:
+   TMCProfiler(const char *name = "MCProfiler");
+   ~TMCProfiler();
+
+   // methods for the worker lifecycle
+   TMCProfiler *CloneForWorker() const;
+   void FinishRunOnWorker();
+   void Merge();
+   void Merge(const TMCProfiler &other);
+
+   // methods called from the user application
+   void PreTrack();
+   void Stepping();
+   void PostTrack();
+   void Reset();
+
+   // output
+   void Print(std::ostream &out = std::cout, Int_t nofRows = 20) const;
+   void Write(TMCRootManager *rootManager) const;
+
+   // set methods
+   void SetSamplingPeriod(Int_t period);
+
+   // get methods
+   const char *GetName() const { return fName.Data(); }
+   Int_t GetSamplingPeriod() const { return fSamplingPeriod; }
+   Double_t GetTotalTime() const;
+   ULong64_t GetTotalSteps() const;
+
+   static Double_t GetTicksPerSecond();
+
+private:
+   /// The bucket key
+   struct TKey {
+      Int_t fVolId;    ///< The volume id in the engine
+      Int_t fPdg;      ///< The particle PDG code
+      Int_t fEngineId; ///< The engine id
+      Bool_t operator==(const TKey &other) const
+      {
+         return fVolId == other.fVolId && fPdg == other.fPdg && fEngineId == other.fEngineId;
+      }
+   };
+
+   /// The hash of the bucket key
+   struct THash {
+      size_t operator()(const TKey &key) const
+      {
+         ULong64_t h = (ULong64_t(UInt_t(key.fVolId)) << 32) ^ UInt_t(key.fPdg) ^ (ULong64_t(key.fEngineId) << 56);
+         return size_t(h * 0x9e3779b97f4a7c15ULL >> 16);
+      }
+   };
+
+   /// The values accumulated per bucket (scaled by the sampling period)
+   struct TBucket {
+      TString fVolName;         ///< The volume name
+      ULong64_t fTicks = 0;     ///< The clock ticks
+      ULong64_t fNofSteps = 0;  ///< The number of steps
+      ULong64_t fNofTracks = 0; ///< The number of tracks which made their first step here
+   };
+
+   using TBucketMap = std::unordered_map<TKey, TBucket, THash>;
+
+   /// The data shared by the master profiler and its worker clones
+   struct TSharedData {
+      TBucketMap fBuckets; ///< The sum of the finished workers
+   };
+
+   // not implemented
+   TMCProfiler(const TMCProfiler &rhs);
+   TMCProfiler &operator=(const TMCProfiler &rhs);
+
+   // methods
+   TMCProfiler(const TMCProfiler &master, Bool_t isWorker);
+
+   static ULong64_t ReadClock();
+   static void Add(TBucketMap &buckets, const TBucketMap &other);
+   TBucket &FindBucket(Int_t volId);
+   Bool_t SampleTrack();
+
+   // data members
+   TString fName;                        ///< The profiler name
+   Int_t fSamplingPeriod;                ///< One track out of fSamplingPeriod is measured (on average)
+   ULong64_t fRandomState;               ///< The state of the track sampling generator
+   TBucketMap fBuckets;                  ///< The buckets filled by this thread
+   std::shared_ptr<TSharedData> fShared; ///< The merge data shared with the worker clones
+
+   // the current track
+   TVirtualMC *fMC;      ///< The engine transporting the current track
+   Bool_t fIsSampled;    ///< Whether the current track is measured
+   Bool_t fIsFirstStep;  ///< Whether the next step is the first one of the track
+   Int_t fPdg;           ///< The current track PDG code
+   Int_t fEngineId;      ///< The current engine id
+   Int_t fLastVolId;     ///< The volume of the last step
+   TBucket *fLastBucket; ///< The bucket of the last step
+   ULong64_t fLastClock; ///< The clock at the last hook
+};
+
+// inline functions
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the current value of the clock: the time stamp counter on x86,
+/// the steady clock in ns elsewhere
+///
+
+inline ULong64_t TMCProfiler::ReadClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+#endif // ROOT_TMCProfiler
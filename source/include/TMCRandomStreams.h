@@ -0,0 +1,54 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCRandomStreams
+#define ROOT_TMCRandomStreams
+
+//
+// Class TMCRandomStreams
+// ----------------------
+// Service providing reproducible random streams keyed by the run,
+// event and engine numbers via per-thread TMCPhiloxRandom generators
+//
+
+#include <atomic>
+
+#include "Rtypes.h"
+
+class TMCPhiloxRandom;
+
+class TMCRandomStreams {
+public:
+   // static access method
+   static TMCRandomStreams *Instance();
+
+   // methods
+   TMCPhiloxRandom *BeginEvent(Int_t eventId, Int_t engineId = -1);
+   TMCPhiloxRandom *SelectStream(Int_t eventId, Int_t engineId, Int_t subStream);
+
+   // set methods
+   void SetMasterSeed(ULong64_t seed);
+   void SetRunNumber(Int_t runNumber);
+
+   // get methods
+   TMCPhiloxRandom *GetRandom() const;
+   ULong64_t GetMasterSeed() const { return fMasterSeed; }
+   Int_t GetRunNumber() const { return fRunNumber; }
+
+private:
+   TMCRandomStreams();
+   // not implemented
+   TMCRandomStreams(const TMCRandomStreams &rhs);
+   TMCRandomStreams &operator=(const TMCRandomStreams &rhs);
+
+   // data members
+   std::atomic<ULong64_t> fMasterSeed; ///< The master seed shared by all threads
+   std::atomic<Int_t> fRunNumber;      ///< The current run number
+};
+
+#endif // ROOT_TMCRandomStreams
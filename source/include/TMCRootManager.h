@@ -20,6 +20,7 @@
 
 class TParticle;
 class TFile;
+class TObject;
 class TTree;
 
 /// \brief The Root IO manager for VMC examples for both sequential and
@@ -52,6 +53,7 @@ public:
    void Register(const char *name, const char *className, const void *objAddress);
    void Fill();
    void WriteAll();
+   void WriteObject(const TObject *object, const char *name = 0);
    void Close();
    void WriteAndClose();
    void ReadEvent(Int_t i);
@@ -0,0 +1,95 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCRoutingRule
+#define ROOT_TMCRoutingRule
+
+//
+// Struct TMCRoutingRule
+// ---------------------
+// declarative rule routing the tracks in a region to an engine,
+// applied by TMCManager::ApplyRoutingRules() called from the
+// application Stepping()
+//
+
+#include <string>
+#include <vector>
+
+#include "Rtypes.h"
+
+struct TMCRoutingRule {
+
+   /// Standard constructor; the rule routes the tracks to the engine with
+   /// the given id
+   explicit TMCRoutingRule(Int_t engineId) : fEngineId(engineId) {}
+
+   /// Add the volume with the given name to the region
+   TMCRoutingRule &AddVolume(const char *volName)
+   {
+      fVolumes.push_back(volName);
+      return *this;
+   }
+
+   /// Add all the volumes made of the medium with the given name to the region
+   TMCRoutingRule &AddMedium(const char *mediumName)
+   {
+      fMedia.push_back(mediumName);
+      return *this;
+   }
+
+   /// Restrict the rule to the particle with the given PDG code;
+   /// can be called several times
+   TMCRoutingRule &AddPdg(Int_t pdg)
+   {
+      fPdgCodes.push_back(pdg);
+      return *this;
+   }
+
+   /// Restrict the rule to the kinetic energies in [ekinMin, ekinMax) (GeV)
+   TMCRoutingRule &SetEnergyRange(Double_t ekinMin, Double_t ekinMax)
+   {
+      fEkinMin = ekinMin;
+      fEkinMax = ekinMax;
+      return *this;
+   }
+
+   /// Return true if the rule applies to the given particle
+   Bool_t IsPdgSelected(Int_t pdg) const
+   {
+      if (fPdgCodes.empty()) {
+         return kTRUE;
+      }
+      for (Int_t selected : fPdgCodes) {
+         if (selected == pdg) {
+            return kTRUE;
+         }
+      }
+      return kFALSE;
+   }
+
+   /// Return true if the rule has an energy window
+   Bool_t HasEnergyRange() const { return fEkinMin > 0. || fEkinMax < kMaxEkin; }
+
+   /// The upper limit of an open energy window
+   static constexpr Double_t kMaxEkin = 1.e+30;
+
+   /// The target engine id
+   Int_t fEngineId;
+   /// The names of the volumes of the region
+   std::vector<std::string> fVolumes;
+   /// The names of the media of the region
+   std::vector<std::string> fMedia;
+   /// The selected PDG codes (all particles if empty)
+   std::vector<Int_t> fPdgCodes;
+   /// The lower limit of the kinetic energy (GeV)
+   Double_t fEkinMin = 0.;
+   /// The upper limit of the kinetic energy (GeV)
+   Double_t fEkinMax = kMaxEkin;
+};
+
+#endif // ROOT_TMCRoutingRule
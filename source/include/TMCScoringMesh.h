@@ -0,0 +1,132 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCScoringMesh
+#define ROOT_TMCScoringMesh
+
+//
+// Class TMCTemplateScoringMesh
+// ----------------------------
+// Dense 3D scoring mesh filled per thread without locking and merged
+// at the end of run
+//
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Rtypes.h"
+#include "TString.h"
+
+class TH3D;
+class TMCRootManager;
+
+template <typename T>
+class TMCTemplateScoringMesh {
+public:
+   TMCTemplateScoringMesh(const char *name, Int_t nx, Double_t xmin, Double_t xmax, Int_t ny, Double_t ymin,
+                          Double_t ymax, Int_t nz, Double_t zmin, Double_t zmax);
+   ~TMCTemplateScoringMesh();
+
+   // methods for the worker lifecycle
+   TMCTemplateScoringMesh *CloneForWorker() const;
+   void FinishRunOnWorker();
+   void Merge();
+   void Merge(const TMCTemplateScoringMesh &other);
+
+   // fill methods
+   void Fill(Double_t x, Double_t y, Double_t z, Double_t w);
+   void FillN(Int_t n, const Double_t *x, const Double_t *y, const Double_t *z, const Double_t *w);
+   void Reset();
+
+   // output
+   TH3D *CreateHistogram(const char *name = 0) const;
+   void Write(TMCRootManager *rootManager) const;
+
+   // get methods
+   const char *GetName() const { return fName.Data(); }
+   Int_t GetNbins(Int_t axis) const { return fNbins[axis]; }
+   T GetBinContent(Int_t ix, Int_t iy, Int_t iz) const;
+   ULong64_t GetNofEntries() const { return fGrid.fNofEntries; }
+
+private:
+   /// The grid of the accumulated values
+   struct TGrid {
+      std::vector<T> fValues;    ///< The values (x running fastest)
+      ULong64_t fNofEntries = 0; ///< The number of fills inside the mesh
+   };
+
+   /// The data shared by the master mesh and its worker clones
+   struct TSharedData {
+      std::atomic<TGrid *> fMergeSlot{nullptr}; ///< The partial sum of the finished workers
+      ~TSharedData() { delete fMergeSlot.load(); }
+   };
+
+   // not implemented
+   TMCTemplateScoringMesh(const TMCTemplateScoringMesh &rhs);
+   TMCTemplateScoringMesh &operator=(const TMCTemplateScoringMesh &rhs);
+
+   // methods
+   TMCTemplateScoringMesh(const TMCTemplateScoringMesh &master, Bool_t isWorker);
+
+   Long64_t FindBin(Double_t x, Double_t y, Double_t z) const;
+   static void Add(TGrid &grid, const TGrid &other);
+
+   // data members
+   TString fName;                        ///< The mesh name
+   Int_t fNbins[3];                      ///< The number of bins per axis
+   Double_t fMin[3];                     ///< The lower edges
+   Double_t fMax[3];                     ///< The upper edges
+   Double_t fInvWidth[3];                ///< The inverse bin widths
+   TGrid fGrid;                          ///< The grid filled by this thread
+   std::shared_ptr<TSharedData> fShared; ///< The merge data shared with the worker clones
+};
+
+using TMCScoringMesh = TMCTemplateScoringMesh<Double_t>;
+using TMCScoringMeshF = TMCTemplateScoringMesh<Float_t>;
+
+// inline functions
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the global bin index of the given point, or -1 if it is outside
+/// the mesh (the form without branches lets the compiler vectorize the batch
+/// fill)
+///
+
+template <typename T>
+inline Long64_t TMCTemplateScoringMesh<T>::FindBin(Double_t x, Double_t y, Double_t z) const
+{
+   Double_t fx = (x - fMin[0]) * fInvWidth[0];
+   Double_t fy = (y - fMin[1]) * fInvWidth[1];
+   Double_t fz = (z - fMin[2]) * fInvWidth[2];
+   // the comparisons are false for NaN
+   Bool_t inside = (fx >= 0.) & (fx < fNbins[0]) & (fy >= 0.) & (fy < fNbins[1]) & (fz >= 0.) & (fz < fNbins[2]);
+   Long64_t index = (Long64_t(inside ? fz : 0.) * fNbins[1] + Long64_t(inside ? fy : 0.)) * fNbins[0] +
+                    Long64_t(inside ? fx : 0.);
+   return inside ? index : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the weight w at the given point in the grid of this thread;
+/// the points outside the mesh are ignored
+///
+
+template <typename T>
+inline void TMCTemplateScoringMesh<T>::Fill(Double_t x, Double_t y, Double_t z, Double_t w)
+{
+   Long64_t index = FindBin(x, y, z);
+   if (index < 0)
+      return;
+
+   fGrid.fValues[index] += T(w);
+   ++fGrid.fNofEntries;
+}
+
+#endif // ROOT_TMCScoringMesh
@@ -0,0 +1,126 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCStepRecorder
+#define ROOT_TMCStepRecorder
+
+//
+// Class TMCStepRecorder
+// ---------------------
+// Recorder of the step history in a compact binary trace file,
+// called from the user application hooks as TMCVerbose;
+// the trace is read with TMCStepTraceReader
+//
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Rtypes.h"
+#include "TArrayI.h"
+#include "TString.h"
+
+/// The packed record of one step (56 bytes, the native byte order)
+struct TMCStepRecord {
+   Int_t fTrackId;         ///< The track id
+   Int_t fStepNumber;      ///< The step number reported by the engine
+   Int_t fPdg;             ///< The particle PDG code
+   Int_t fVolId;           ///< The volume id in the engine
+   Int_t fEngineId;        ///< The engine id
+   Float_t fX;             ///< The post-step position x (cm)
+   Float_t fY;             ///< The post-step position y (cm)
+   Float_t fZ;             ///< The post-step position z (cm)
+   Float_t fT;             ///< The time of flight (s)
+   Float_t fEkin;          ///< The kinetic energy (GeV)
+   Float_t fEdep;          ///< The energy deposit (GeV)
+   Float_t fStep;          ///< The step length (cm)
+   ULong64_t fProcessMask; ///< The bits of the step processes (1 << TMCProcess)
+};
+
+static_assert(sizeof(TMCStepRecord) == 56, "TMCStepRecord must be packed");
+
+/// The trace file format: the file header followed by the blocks, each with
+/// the block header and the (optionally compressed) content
+namespace TMCStepTrace {
+const char kMagic[8] = {'V', 'M', 'C', 'S', 'T', 'E', 'P', '\0'};
+const UInt_t kVersion = 1;
+
+/// The block types
+enum EBlockType : UInt_t {
+   kStepBlock = 1,  ///< TMCStepRecord array of one event
+   kVolumeBlock = 2 ///< Volume names: (Int_t engineId, Int_t volId, Int_t length, chars) entries
+};
+
+/// The file header
+struct TFileHeader {
+   char fMagic[8];     ///< kMagic
+   UInt_t fVersion;    ///< kVersion
+   UInt_t fRecordSize; ///< sizeof(TMCStepRecord)
+   Int_t fCompression; ///< The ROOT compression setting (0 = none)
+   UInt_t fReserved;   ///< Unused
+};
+
+/// The block header
+struct TBlockHeader {
+   UInt_t fType;       ///< EBlockType
+   Int_t fEventId;     ///< The event id (kStepBlock)
+   UInt_t fNofEntries; ///< The number of records or volume names
+   UInt_t fRawSize;    ///< The size of the uncompressed content
+   UInt_t fStoredSize; ///< The size of the content in the file (== fRawSize if not compressed)
+   UInt_t fReserved;   ///< Unused
+};
+} // namespace TMCStepTrace
+
+class TMCStepRecorder {
+public:
+   TMCStepRecorder(const char *fileName, Int_t compression = 0);
+   ~TMCStepRecorder();
+
+   // methods for the worker lifecycle
+   TMCStepRecorder *CloneForWorker() const;
+   void FinishRunOnWorker();
+
+   // methods called from the user application
+   void BeginEvent(Int_t eventId);
+   void Stepping();
+   void FinishEvent();
+   void Close();
+
+   // set methods
+   void SetBufferSize(Int_t nofRecords);
+
+   // get methods
+   ULong64_t GetNofRecords() const { return fNofRecords; }
+
+private:
+   /// The file shared by the master recorder and its worker clones
+   struct TSharedFile;
+
+   // not implemented
+   TMCStepRecorder(const TMCStepRecorder &rhs);
+   TMCStepRecorder &operator=(const TMCStepRecorder &rhs);
+
+   // methods
+   TMCStepRecorder(const TMCStepRecorder &master, Bool_t isWorker);
+   void FlushBuffer();
+
+   // data members
+   std::shared_ptr<TSharedFile> fFile;              ///< The output file
+   std::vector<TMCStepRecord> fRecords;             ///< The records of the current event not yet written
+   Int_t fBufferSize;                               ///< The number of records triggering the writing
+   Int_t fEventId;                                  ///< The current event id
+   ULong64_t fNofRecords;                           ///< The number of records recorded by this object
+   TArrayI fProcesses;                              ///< The step processes (reused)
+   std::set<std::pair<Int_t, Int_t>> fKnownVolumes; ///< The (engine, volume) ids already written by this thread
+   std::vector<char> fNewVolumes;                   ///< The volume entries not yet written
+   UInt_t fNofNewVolumes;                           ///< The number of entries in fNewVolumes
+};
+
+#endif // ROOT_TMCStepRecorder
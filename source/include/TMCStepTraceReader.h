@@ -0,0 +1,59 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCStepTraceReader
+#define ROOT_TMCStepTraceReader
+
+//
+// Class TMCStepTraceReader
+// ------------------------
+// Reader of the step trace files written by TMCStepRecorder
+//
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TMCStepRecorder.h"
+
+class TMCStepTraceReader {
+public:
+   TMCStepTraceReader(const char *fileName);
+   ~TMCStepTraceReader();
+
+   // methods
+   Bool_t IsOpen() const { return fIsOpen; }
+   Bool_t ReadBlock(Int_t &eventId, std::vector<TMCStepRecord> &records);
+   Bool_t ReadEvents(std::map<Int_t, std::vector<TMCStepRecord>> &events, Int_t selectedEvent = -1);
+
+   // get methods
+   Int_t GetCompression() const { return fHeader.fCompression; }
+   const char *GetVolumeName(Int_t engineId, Int_t volId) const;
+
+private:
+   // not implemented
+   TMCStepTraceReader(const TMCStepTraceReader &rhs);
+   TMCStepTraceReader &operator=(const TMCStepTraceReader &rhs);
+
+   // methods
+   Bool_t ReadContent(const TMCStepTrace::TBlockHeader &header, std::vector<char> &content);
+   void AddVolumes(const TMCStepTrace::TBlockHeader &header, const std::vector<char> &content);
+
+   // data members
+   std::ifstream fStream;                                    ///< The input stream
+   TString fFileName;                                        ///< The file name
+   Bool_t fIsOpen;                                           ///< Whether the file header was read
+   TMCStepTrace::TFileHeader fHeader;                        ///< The file header
+   std::map<std::pair<Int_t, Int_t>, std::string> fVolNames; ///< The volume names per (engine, volume) ids
+   std::vector<char> fContent;                               ///< The content of the last block
+   std::vector<char> fZipBuffer;                             ///< The compressed content of the last block
+};
+
+#endif // ROOT_TMCStepTraceReader
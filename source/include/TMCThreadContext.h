@@ -0,0 +1,36 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCThreadContext
+#define ROOT_TMCThreadContext
+
+//
+// Struct TMCThreadContext
+// -----------------------
+// The VMC objects of the current thread gathered in one thread-local
+// structure
+//
+
+class TVirtualMC;
+class TVirtualMCStack;
+class TVirtualMCApplication;
+class TMCManager;
+class TMCRootManager;
+
+struct TMCThreadContext {
+   TVirtualMC *fMC = nullptr;                     ///< The current engine (the same as gMC)
+   TVirtualMCStack *fStack = nullptr;             ///< The stack of the current engine
+   TVirtualMCApplication *fApplication = nullptr; ///< The MC application
+   TMCManager *fManager = nullptr;                ///< The multiple engines manager (if any)
+   TMCRootManager *fRootManager = nullptr;        ///< The Root IO manager (if any)
+
+   static TMCThreadContext &Instance();
+   static void SetMC(TVirtualMC *mc);
+};
+
+#endif // ROOT_TMCThreadContext
@@ -0,0 +1,95 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCTrace
+#define ROOT_TMCTrace
+
+//
+// Class TMCTrace
+// --------------
+// Event-trace recorder of the VMC run lifecycle, written in the Chrome
+// trace JSON format (readable with Perfetto and chrome://tracing).
+//
+// The spans are recorded with the macros:
+//   TMC_TRACE_SCOPE(name)                   - span from here to the end of the scope
+//   TMC_TRACE_SCOPE_ARG(name, arg, value)   - the same with an integer argument
+//   TMC_TRACE_INSTANT(name, arg, value)     - instant event with an integer argument
+// The names must outlive the run (eg. string literals).
+//
+// When the library is built without VMC_WITH_TRACING, the macros expand
+// to nothing and the TMCTrace functions have no effect.
+
+#include "Rtypes.h"
+
+#include <chrono>
+
+class TMCTrace {
+public:
+   static Bool_t IsEnabled();
+   static void SetEnabled(Bool_t enabled);
+   static void SetBufferSize(Int_t nofEvents);
+   static Bool_t Write(const char *fileName);
+   static void Clear();
+
+   // recording (used by the macros)
+   static void RecordSpan(const char *name, const char *argName, Long64_t argValue, Long64_t start, Long64_t end);
+   static void RecordInstant(const char *name, const char *argName, Long64_t argValue);
+   static Long64_t Now();
+};
+
+// inline functions
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the current time of the steady clock (ns)
+///
+
+inline Long64_t TMCTrace::Now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#if defined(VMC_WITH_TRACING)
+
+/// The span recorded at the end of the scope
+class TMCTraceScope {
+public:
+   TMCTraceScope(const char *name, const char *argName = nullptr, Long64_t argValue = 0)
+      : fName(name), fArgName(argName), fArgValue(argValue), fStart(TMCTrace::Now())
+   {
+   }
+   ~TMCTraceScope() { TMCTrace::RecordSpan(fName, fArgName, fArgValue, fStart, TMCTrace::Now()); }
+
+private:
+   // not implemented
+   TMCTraceScope(const TMCTraceScope &rhs);
+   TMCTraceScope &operator=(const TMCTraceScope &rhs);
+
+   const char *fName;    ///< The span name
+   const char *fArgName; ///< The argument name (optional)
+   Long64_t fArgValue;   ///< The argument value
+   Long64_t fStart;      ///< The start time (ns)
+};
+
+#define TMC_TRACE_CONCAT_IMPL(a, b) a##b
+#define TMC_TRACE_CONCAT(a, b) TMC_TRACE_CONCAT_IMPL(a, b)
+#define TMC_TRACE_SCOPE(name) TMCTraceScope TMC_TRACE_CONCAT(tmcTraceScope, __LINE__)(name)
+#define TMC_TRACE_SCOPE_ARG(name, argName, argValue) \
+   TMCTraceScope TMC_TRACE_CONCAT(tmcTraceScope, __LINE__)(name, argName, argValue)
+#define TMC_TRACE_INSTANT(name, argName, argValue) TMCTrace::RecordInstant(name, argName, argValue)
+
+#else
+
+#define TMC_TRACE_SCOPE(name)
+#define TMC_TRACE_SCOPE_ARG(name, argName, argValue)
+#define TMC_TRACE_INSTANT(name, argName, argValue)
+
+#endif // defined(VMC_WITH_TRACING)
+
+#endif // ROOT_TMCTrace
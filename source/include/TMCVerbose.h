@@ -29,10 +29,20 @@
 //  1  info up to event level
 //  2  info up to tracking level
 //  3  detailed info for each step
+// The output is formatted in a buffer and written to std::cout or,
+// asynchronously, to a file; the tracking and stepping info can be
+// restricted with the track, particle, volume and event filters.
 
 #include <TObject.h>
+#include <TArrayI.h>
+#include <TString.h>
 
+#include <memory>
+#include <string>
+
+class TVirtualMC;
 class TVirtualMCStack;
+class TMCVerboseSink;
 
 class TMCVerbose : public TObject {
 public:
@@ -60,23 +70,57 @@ public:
    virtual void EndOfEvent();
    virtual void FinishEvent();
 
+   // output
+   void Flush();
+
    // set methods
    void SetLevel(Int_t level);
+   void SetOutputFile(const char *fileName);
+   void SetBufferSize(Int_t bufferSize);
+
+   // filters
+   void SetTrackIdRange(Int_t minTrackId, Int_t maxTrackId);
+   void SetPdgFilter(Int_t pdg);
+   void SetVolumeFilter(const char *volName);
+   void SetEventRange(Int_t minEvent, Int_t maxEvent);
+   void ResetFilters();
 
    // get methods
    Int_t GetLevel() const;
 
 private:
    // methods
-   void PrintBanner() const;
-   void PrintTrackInfo() const;
-   void PrintStepHeader() const;
+   void PrintBanner();
+   void PrintTrackInfo();
+   void PrintStepHeader();
+   void PrintLine(const char *text);
+   void EndLine();
+   Bool_t IsStepSelected();
+   void SelectEvent();
 
    // data members
    Int_t fLevel;      ///< Verbose level
    Int_t fStepNumber; ///< Current step number
 
-   ClassDef(TMCVerbose, 1) // Verbose class for MC application
+   // transient data members
+   TArrayI fProcesses;                    //!< The processes of the current step (reused)
+   std::string fBuffer;                   //!< The formatted output
+   Int_t fBufferSize;                     //!< The buffer size triggering the flush (0 = flush each line)
+   std::shared_ptr<TMCVerboseSink> fSink; //!< The asynchronous file sink (std::cout if not set)
+
+   // filters
+   Int_t fMinTrackId;       //!< The minimal selected track id
+   Int_t fMaxTrackId;       //!< The maximal selected track id (-1 = no limit)
+   Int_t fPdg;              //!< The selected particle PDG code (0 = all)
+   TString fVolName;        //!< The selected volume name (empty = all)
+   Int_t fVolId;            //!< The selected volume id in fVolIdMC
+   TVirtualMC *fVolIdMC;    //!< The engine for which fVolId was resolved
+   Int_t fMinEvent;         //!< The minimal selected event
+   Int_t fMaxEvent;         //!< The maximal selected event (-1 = no limit)
+   Bool_t fIsEventSelected; //!< Whether the current event is selected
+   Bool_t fIsTrackSelected; //!< Whether the current track is selected
+
+   ClassDef(TMCVerbose, 2) // Verbose class for MC application
 };
 
 // inline functions
@@ -0,0 +1,102 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCWorkerPool
+#define ROOT_TMCWorkerPool
+
+//
+// Class TMCWorkerPool
+// -------------------
+// Pool of worker threads pinned to CPUs which drives the multi-threading
+// hooks of the MC application
+//
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Rtypes.h"
+#include "TMCMergeDriver.h"
+
+class TVirtualMCApplication;
+
+class TMCWorkerPool {
+public:
+   /// The CPU affinity policy
+   enum EAffinity {
+      kNoAffinity, ///< The workers are not pinned
+      kCompact,    ///< The workers fill the CPUs of one NUMA node before using the next one
+      kScatter     ///< The workers are distributed round-robin over the NUMA nodes
+   };
+
+   TMCWorkerPool(TVirtualMCApplication *masterApplication, Int_t nofWorkers, EAffinity affinity = kCompact);
+   virtual ~TMCWorkerPool();
+
+   // static methods
+   static Int_t GetNofNumaNodes();
+   static Int_t GetCurrentWorkerId();
+   static Int_t GetCurrentNumaNode();
+
+   // methods
+   void Initialize();
+   void Run(const std::function<void(Int_t)> &process);
+   void Terminate();
+   void Print() const;
+
+   // set methods
+   void SetCpus(const std::vector<Int_t> &cpus);
+   void SetNodeReplicaHook(const std::function<void(Int_t)> &hook);
+   void SetTreeMerge(Bool_t treeMerge) { fTreeMerge = treeMerge; }
+
+   // get methods
+   Int_t GetNofWorkers() const { return fWorkers.size(); }
+   TVirtualMCApplication *GetWorkerApplication(Int_t workerId) const;
+   Bool_t GetTreeMerge() const { return fTreeMerge; }
+   TMCMergeDriver &GetMergeDriver() { return fMergeDriver; }
+
+private:
+   /// The worker data
+   struct TWorker {
+      Int_t fId = -1;                                ///< The worker id
+      Int_t fCpu = -1;                               ///< The CPU the worker is pinned to (-1 if not pinned)
+      Int_t fNumaNode = 0;                           ///< The NUMA node of the worker CPU
+      TVirtualMCApplication *fApplication = nullptr; ///< The worker application
+      std::thread fThread;                           ///< The worker thread
+   };
+
+   // not implemented
+   TMCWorkerPool(const TMCWorkerPool &rhs);
+   TMCWorkerPool &operator=(const TMCWorkerPool &rhs);
+
+   // methods
+   void AssignCpus();
+   void WorkerLoop(TWorker &worker);
+   void Execute(const std::function<void(TWorker &)> &task);
+
+   // data members
+   TVirtualMCApplication *fMasterApplication;   ///< The master application
+   EAffinity fAffinity;                         ///< The affinity policy
+   std::vector<Int_t> fCpus;                    ///< The CPUs set by the user
+   std::vector<TWorker> fWorkers;               ///< The workers
+   std::function<void(Int_t)> fNodeReplicaHook; ///< The function creating the shared data replica per NUMA node
+   Bool_t fTreeMerge;                           ///< Option to merge the workers via a parallel tree reduction
+   TMCMergeDriver fMergeDriver;                 ///< The driver of the tree reduction merge
+
+   std::mutex fMutex;                      ///< The mutex protecting the task data
+   std::condition_variable fTaskCondition; ///< Notifies the workers about a new task
+   std::condition_variable fDoneCondition; ///< Notifies the master about the task completion
+   std::function<void(TWorker &)> fTask;   ///< The current task
+   ULong64_t fTaskNumber;                  ///< The current task number
+   Int_t fNofPending;                      ///< The number of workers which have not finished the task
+   Bool_t fIsInitialized;                  ///< Whether the worker threads were started
+   Bool_t fStop;                           ///< Whether the worker threads should stop
+};
+
+#endif // ROOT_TMCWorkerPool
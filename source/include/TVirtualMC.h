@@ -45,6 +45,7 @@ class TGeoHMatrix;
 class TArrayI;
 class TArrayD;
 class TVirtualMCSensitiveDetector;
+class TVirtualMCMagField;
 
 class TVirtualMC : public TNamed {
 
@@ -566,6 +567,10 @@ public:
 
    /// Return VMC type of the particle specified by pdg.
    virtual TMCParticleType ParticleMCType(Int_t pdg) const = 0;
+
+   /// Fill the PDG codes of all particles and ions defined in the engine;
+   /// return false if the engine does not provide this information
+   virtual Bool_t GetDefinedParticles(TArrayI &pdgs) const;
    //
    // ------------------------------------------------
    // methods for step management
@@ -737,6 +742,9 @@ public:
    /// Return the PDG of the particle transported
    virtual Int_t TrackPid() const = 0;
 
+   /// Return the index of the particle transported in TMCParticleTable
+   virtual Int_t TrackPidIndex() const;
+
    /// Return the charge of the track currently transported
    virtual Double_t TrackCharge() const = 0;
 
@@ -853,6 +861,10 @@ public:
    /// Set the random number generator
    virtual void SetRandom(TRandom *random);
 
+   /// Set the random number generator of this engine only, gRandom is not changed;
+   /// an engine caching or wrapping its generator must override it, as SetRandom()
+   virtual void SetEngineRandom(TRandom *random);
+
    /// Set the magnetic field
    virtual void SetMagField(TVirtualMagField *field);
 
@@ -877,6 +889,9 @@ public:
    /// Return the magnetic field
    TVirtualMagField *GetMagField() const { return fMagField; }
 
+   /// Evaluate the magnetic field at several points at once
+   void EvaluateField(Int_t n, const Double_t *xyz, Double_t *bxyz) const;
+
    /// Return the VMC's ID
    Int_t GetId() const { return fId; }
 
@@ -919,11 +934,12 @@ private:
    /// An ID is given by the running TVirtualMCApp and not by the user.
    Int_t fId;
 
-   TVirtualMCStack *fStack;        //!< Particles stack
-   TMCManagerStack *fManagerStack; //!< Stack handled by the TMCManager
-   TVirtualMCDecayer *fDecayer;    //!< External decayer
-   TRandom *fRandom;               //!< Random number generator
-   TVirtualMagField *fMagField;    //!< Magnetic field
+   TVirtualMCStack *fStack;         //!< Particles stack
+   TMCManagerStack *fManagerStack;  //!< Stack handled by the TMCManager
+   TVirtualMCDecayer *fDecayer;     //!< External decayer
+   TRandom *fRandom;                //!< Random number generator
+   TVirtualMagField *fMagField;     //!< Magnetic field
+   TVirtualMCMagField *fMCMagField; //!< Magnetic field with batched evaluation (if any)
 
    ClassDef(TVirtualMC, 1) // Interface to Monte Carlo
 };
@@ -35,6 +35,9 @@ class TMCManager;
 
 class TVirtualMCApplication : public TNamed {
 
+   // To set the instance in the engine threads
+   friend class TMCManager;
+
 public:
    /// Standard constructor
    TVirtualMCApplication(const char *name, const char *title);
@@ -119,6 +122,11 @@ public:
    /// Calculate user field \a b at point \a x
    virtual void Field(const Double_t *x, Double_t *b) const;
 
+   /// Calculate user field \a bxyz at \a n points \a xyz
+   /// (arrays of size 3*n, with the point coordinates stored contiguously);
+   /// the default implementation calls the single point Field() for each point
+   virtual void Field(Int_t n, const Double_t *xyz, Double_t *bxyz) const;
+
    /// Define action at each step for Geane
    virtual void GeaneStepping() { ; }
 
@@ -135,6 +143,11 @@ public:
    /// Merge the data accumulated on workers to the master if needed
    virtual void Merge(TVirtualMCApplication * /*localMCApplication*/) {}
 
+   /// Merge the sub-event processed by a worker to the event of the master
+   /// (in the sub-event mode of the TMCManager); called before FinishEvent(),
+   /// the worker data are reset in its BeginEvent()
+   virtual void MergeSubEvent(TVirtualMCApplication * /*workerMCApplication*/) {}
+
 protected:
    /// The current transport engine in use. In case of a multi-run the TMCManager
    /// will update this whenever the engine changes.
@@ -166,4 +179,11 @@ inline void TVirtualMCApplication::Field(const Double_t * /*x*/, Double_t *b) co
    b[2] = 0;
 }
 
+inline void TVirtualMCApplication::Field(Int_t n, const Double_t *xyz, Double_t *bxyz) const
+{
+   for (Int_t i = 0; i < n; ++i) {
+      Field(xyz + 3 * i, bxyz + 3 * i);
+   }
+}
+
 #endif // ROOT_TVirtualMCApplication
@@ -206,6 +206,15 @@ public:
    virtual void Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
                        const char *konly, Double_t *upar, Int_t np) = 0;
 
+   // Position n copies of a volume into an existing one
+   virtual void GsposArray(const char *name, Int_t n, const Int_t *nr, const char *mother, const Double_t *x,
+                           const Double_t *y, const Double_t *z, Int_t irot, const char *konly = "ONLY");
+
+   // Position copies of a volume on a regular lattice into an existing one
+   virtual void GsposLattice(const char *name, Int_t nr0, const char *mother, Int_t nx, Int_t ny, Int_t nz,
+                             Double_t x0, Double_t y0, Double_t z0, Double_t dx, Double_t dy, Double_t dz, Int_t irot,
+                             const char *konly = "ONLY");
+
    /// Helper function for resolving MANY.
    /// Specify the ONLY volume that overlaps with the
    /// specified MANY and has to be substracted.
@@ -0,0 +1,37 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TVirtualMCMagField
+#define ROOT_TVirtualMCMagField
+
+//
+// Class TVirtualMCMagField
+// ------------------------
+// Interface to a magnetic field with the evaluation at several points
+// at once
+//
+
+#include "TVirtualMagField.h"
+
+class TVirtualMCMagField : public TVirtualMagField {
+public:
+   TVirtualMCMagField(const char *name);
+   TVirtualMCMagField();
+   virtual ~TVirtualMCMagField();
+
+   using TVirtualMagField::Field;
+
+   /// Calculate the field \a bxyz at \a n points \a xyz
+   /// (arrays of size 3*n, with the point coordinates stored contiguously);
+   /// the default implementation calls the single point Field() for each point
+   virtual void Field(Int_t n, const Double_t *xyz, Double_t *bxyz);
+
+   ClassDef(TVirtualMCMagField, 1) // Abstract base field class with batched evaluation
+};
+
+#endif // ROOT_TVirtualMCMagField
@@ -25,6 +25,10 @@ for building TGeo geometry.
 */
 
 #include <ctype.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
 #include "TError.h"
 #include "TArrayD.h"
 
@@ -42,7 +46,46 @@ for building TGeo geometry.
 #include "TGeoPara.h"
 #include "TGeoEltu.h"
 #include "TGeoHype.h"
+#include "TGeoMaterial.h"
+#include "TGeoPhysicalNode.h"
+#include "TFile.h"
+#include "TList.h"
 #include "TMath.h"
+#include "TMD5.h"
+#include "TNamed.h"
+#include "TMCAutoLock.h"
+
+namespace {
+// Mutex protecting the name indices which are (re)built lazily from const methods
+TMCMutex indexMutex = TMCMUTEX_INITIALIZER;
+// Mutex protecting the transformation and shape caches and the navigation
+// performed when they are filled
+TMCMutex cacheMutex = TMCMUTEX_INITIALIZER;
+// The number of the alignments performed via TGeoMCGeometry::AlignNode(),
+// shared by all instances (protected by cacheMutex)
+ULong64_t alignmentGeneration = 0;
+
+// Name of the object with the construction key in the geometry snapshot file
+const char *snapshotKeyName = "VMCGeometrySnapshotKey";
+
+//_____________________________________________________________________________
+void SplitPath(const TString &volumePath, std::vector<std::string> &names)
+{
+   /// Split the volume path in the node names
+
+   names.clear();
+   std::string path(volumePath.Data());
+   std::string::size_type begin = 0;
+   while (begin < path.size()) {
+      std::string::size_type end = path.find('/', begin);
+      if (end == std::string::npos)
+         end = path.size();
+      if (end > begin)
+         names.emplace_back(path, begin, end - begin);
+      begin = end + 1;
+   }
+}
+} // namespace
 
 ClassImp(TGeoMCGeometry);
 
@@ -54,7 +97,10 @@ TGeoMCGeometry *TGeoMCGeometry::fgInstance = 0;
 ///
 
 TGeoMCGeometry::TGeoMCGeometry(const char *name, const char *title, Bool_t g3CompatibleVolumeNames)
-   : TVirtualMCGeometry(name, title), fG3CompatibleVolumeNames(g3CompatibleVolumeNames)
+   : TVirtualMCGeometry(name, title), fG3CompatibleVolumeNames(g3CompatibleVolumeNames), fNofIndexedVolumes(0),
+     fNofIndexedMedia(0), fIndexedGeoManager(0), fIsIndexed(kFALSE), fCachedGeoManager(0), fNofCachedPhysicalNodes(0),
+     fCachedAlignmentGeneration(0), fDeduplicate(kFALSE), fDeduplicationTolerance(1e-9), fNofReusedRotations(0),
+     fNofReusedMaterials(0), fNofReusedElements(0), fPlacementMatrices(), fPlacementGeoManager(0)
 {
 }
 
@@ -63,7 +109,13 @@ TGeoMCGeometry::TGeoMCGeometry(const char *name, const char *title, Bool_t g3Com
 /// Default constructor
 ///
 
-TGeoMCGeometry::TGeoMCGeometry() : TVirtualMCGeometry(), fG3CompatibleVolumeNames(kFALSE) {}
+TGeoMCGeometry::TGeoMCGeometry()
+   : TVirtualMCGeometry(), fG3CompatibleVolumeNames(kFALSE), fNofIndexedVolumes(0), fNofIndexedMedia(0),
+     fIndexedGeoManager(0), fIsIndexed(kFALSE), fCachedGeoManager(0), fNofCachedPhysicalNodes(0),
+     fCachedAlignmentGeneration(0), fDeduplicate(kFALSE), fDeduplicationTolerance(1e-9), fNofReusedRotations(0),
+     fNofReusedMaterials(0), fNofReusedElements(0), fPlacementMatrices(), fPlacementGeoManager(0)
+{
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 ///
@@ -135,6 +187,237 @@ void TGeoMCGeometry::Vname(const char *name, char *vname) const
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Mark the name indices as outdated; they are rebuilt on the next lookup
+///
+
+void TGeoMCGeometry::InvalidateIndices()
+{
+   TMCAutoLock lk(&indexMutex);
+   fIsIndexed = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the volume and medium name indices if the geometry is closed
+/// and the indices are missing or outdated.
+/// Volumes or media added directly via TGeoManager after the indices were
+/// built are detected via the list sizes.
+/// Return kTRUE if the indices can be used.
+/// The caller must hold indexMutex.
+///
+
+Bool_t TGeoMCGeometry::UpdateIndices() const
+{
+   TGeoManager *geoManager = gGeoManager;
+   if (!geoManager || !geoManager->IsClosed())
+      return kFALSE;
+
+   Int_t nofVolumes = geoManager->GetListOfVolumes()->GetEntriesFast();
+   Int_t nofMedia = geoManager->GetListOfMedia()->GetSize();
+   if (fIsIndexed && fIndexedGeoManager == geoManager && fNofIndexedVolumes == nofVolumes &&
+       fNofIndexedMedia == nofMedia)
+      return kTRUE;
+
+   // The first object with a given name wins, as with TList/TObjArray::FindObject
+   fVolumeIndex.clear();
+   fVolumeIndex.reserve(nofVolumes);
+   for (Int_t i = 0; i < nofVolumes; i++) {
+      TGeoVolume *volume = (TGeoVolume *)geoManager->GetListOfVolumes()->At(i);
+      if (volume)
+         fVolumeIndex.emplace(volume->GetName(), volume);
+   }
+
+   fMediumIndex.clear();
+   fMediumIndex.reserve(nofMedia);
+   TIter next(geoManager->GetListOfMedia());
+   TGeoMedium *medium;
+   while ((medium = (TGeoMedium *)next()))
+      fMediumIndex.emplace(medium->GetName(), medium->GetId());
+
+   fNofIndexedVolumes = nofVolumes;
+   fNofIndexedMedia = nofMedia;
+   fIndexedGeoManager = geoManager;
+   fIsIndexed = kTRUE;
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the volume with the given name.
+/// The name index is used when the geometry is closed, otherwise the lookup
+/// falls back to TGeoManager::GetVolume().
+///
+
+TGeoVolume *TGeoMCGeometry::FindVolume(const char *volName) const
+{
+   {
+      TMCAutoLock lk(&indexMutex);
+      if (UpdateIndices()) {
+         auto it = fVolumeIndex.find(volName);
+         return (it != fVolumeIndex.end()) ? it->second : 0;
+      }
+   }
+   return GetTGeoManager()->GetVolume(volName);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Clear the transformation and shape caches if the geometry has changed
+/// since they were filled: a new TGeoManager, new physical nodes created
+/// by the misalignment or a (re)alignment via AlignNode().
+/// The caller must hold cacheMutex.
+///
+
+void TGeoMCGeometry::UpdateGeometryCache()
+{
+   TGeoManager *geoManager = GetTGeoManager();
+   Int_t nofPhysicalNodes =
+      geoManager->GetListOfPhysicalNodes() ? geoManager->GetListOfPhysicalNodes()->GetEntriesFast() : 0;
+
+   if (fCachedGeoManager == geoManager && fNofCachedPhysicalNodes == nofPhysicalNodes &&
+       fCachedAlignmentGeneration == alignmentGeneration)
+      return;
+
+   fMatrixCache.clear();
+   fShapeCache.clear();
+   fCachedGeoManager = geoManager;
+   fNofCachedPhysicalNodes = nofPhysicalNodes;
+   fCachedAlignmentGeneration = alignmentGeneration;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the volume path starting with the top node: the top node name
+/// is optional in the paths accepted by GetTransformation(),
+/// GetTransformations(), GetShape() and AlignNode().
+///
+
+TString TGeoMCGeometry::GetFullPath(const TString &volumePath) const
+{
+   TGeoNode *topNode = GetTGeoManager()->GetTopNode();
+   if (!topNode)
+      return volumePath;
+
+   std::vector<std::string> names;
+   SplitPath(volumePath, names);
+   if (!names.empty() && names[0] == topNode->GetName())
+      return volumePath;
+
+   TString fullPath("/");
+   fullPath += topNode->GetName();
+   if (!volumePath.BeginsWith("/"))
+      fullPath += "/";
+   fullPath += volumePath;
+   return fullPath;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Append the value quantised with the de-duplication tolerance
+/// to the key. If relative is true, the tolerance is applied
+/// to the mantissa so that it is relative to the value.
+///
+
+void TGeoMCGeometry::AddToKey(std::string &key, Double_t value, Bool_t relative) const
+{
+   Long64_t quantised[2] = {0, 0};
+   if (relative && value != 0.) {
+      Int_t exponent;
+      Double_t mantissa = std::frexp(value, &exponent);
+      quantised[0] = exponent;
+      quantised[1] = std::llround(mantissa / fDeduplicationTolerance);
+   } else {
+      quantised[1] = std::llround(value / fDeduplicationTolerance);
+   }
+   key.append(reinterpret_cast<const char *>(quantised), sizeof(quantised));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Resolve the volumes, the rotation matrix and the ONLY/MANY flag
+/// of a bulk placement. Return kFALSE if the copies have to be placed
+/// via Gspos(): generic volumes (defined via Gsposp) and divided mothers.
+///
+
+Bool_t TGeoMCGeometry::ResolvePlacement(const char *name, const char *mother, Int_t irot, const char *konly,
+                                        TGeoVolume *&volume, TGeoVolume *&motherVolume, TGeoRotation *&rotation,
+                                        Bool_t &isOnly)
+{
+   TString only = konly;
+   only.ToLower();
+   isOnly = only.Contains("only");
+   char vname[80];
+   Vname(name, vname);
+   char vmother[80];
+   Vname(mother, vmother);
+
+   volume = GetTGeoManager()->FindVolumeFast(vname);
+   motherVolume = GetTGeoManager()->FindVolumeFast(vmother);
+   if (!volume || !motherVolume || GetTGeoManager()->FindVolumeFast(vname, kTRUE) ||
+       GetTGeoManager()->FindVolumeFast(vmother, kTRUE))
+      return kFALSE;
+
+   rotation = 0;
+   if (irot) {
+      TIter next(GetTGeoManager()->GetListOfMatrices());
+      TGeoMatrix *matrix;
+      while ((matrix = (TGeoMatrix *)next())) {
+         if (matrix->GetUniqueID() == UInt_t(irot)) {
+            rotation = dynamic_cast<TGeoRotation *>(matrix);
+            break;
+         }
+      }
+      if (!rotation) {
+         Fatal("ResolvePlacement", "Rotation %d not found", irot);
+         return kFALSE;
+      }
+   }
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the placement matrix for the given position and rotation,
+/// shared by all copies placed in bulk at the same position with the same
+/// rotation; 0 (identity) for the copies at the origin without rotation.
+/// The matrices are owned by the TGeoManager.
+///
+
+TGeoMatrix *TGeoMCGeometry::GetPlacementMatrix(Double_t x, Double_t y, Double_t z, TGeoRotation *rotation)
+{
+   if (!rotation && TMath::Abs(x) <= 1e-10 && TMath::Abs(y) <= 1e-10 && TMath::Abs(z) <= 1e-10)
+      return 0;
+
+   if (fPlacementGeoManager != GetTGeoManager()) {
+      fPlacementMatrices.clear();
+      fPlacementGeoManager = GetTGeoManager();
+   }
+
+   TGeoMatrix *&matrix = fPlacementMatrices[std::make_tuple(x, y, z, rotation)];
+   if (!matrix) {
+      if (rotation) {
+         matrix = new TGeoCombiTrans(x, y, z, rotation);
+      } else {
+         matrix = new TGeoTranslation(x, y, z);
+      }
+   }
+   return matrix;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of the material which replaced the material kmat
+/// when de-duplication is active, kmat otherwise
+///
+
+Int_t TGeoMCGeometry::MaterialAlias(Int_t kmat) const
+{
+   auto it = fMaterialAliases.find(kmat);
+   return (it != fMaterialAliases.end()) ? it->second : kmat;
+}
+
 //
 // public methods
 //
@@ -186,6 +469,29 @@ void TGeoMCGeometry::Material(Int_t &kmat, const char *name, Double_t a, Double_
 void TGeoMCGeometry::Material(Int_t &kmat, const char *name, Double_t a, Double_t z, Double_t dens, Double_t radl,
                               Double_t absl, Double_t * /*buf*/, Int_t /*nwbuf*/)
 {
+   if (fDeduplicate) {
+      // materials are aliased only if also their names match, so that they
+      // can still be found by name
+      std::string key("E");
+      key.append(name).push_back('\0');
+      AddToKey(key, a, kTRUE);
+      AddToKey(key, z, kTRUE);
+      AddToKey(key, dens, kTRUE);
+      // the user defined lengths only
+      AddToKey(key, (radl < 0) ? radl : 0., kTRUE);
+      AddToKey(key, (absl < 0) ? absl : 0., kTRUE);
+
+      auto result = fMaterialKeys.emplace(key, kmat);
+      if (!result.second) {
+         if (result.first->second != kmat) {
+            fMaterialAliases[kmat] = result.first->second;
+         }
+         kmat = result.first->second;
+         ++fNofReusedElements;
+         return;
+      }
+   }
+
    GetTGeoManager()->Material(name, a, z, dens, kmat, radl, absl);
 }
 
@@ -250,6 +556,35 @@ void TGeoMCGeometry::Mixture(Int_t &kmat, const char *name, Double_t *a, Double_
          wmat[i] *= a[i] / amol;
       }
    }
+
+   if (fDeduplicate) {
+      // the components are sorted so that their order does not matter
+      std::vector<std::string> components(nlmat);
+      for (Int_t i = 0; i < nlmat; i++) {
+         AddToKey(components[i], z[i], kTRUE);
+         AddToKey(components[i], a[i], kTRUE);
+         AddToKey(components[i], wmat[i], kTRUE);
+      }
+      std::sort(components.begin(), components.end());
+
+      std::string key("M");
+      key.append(name).push_back('\0');
+      AddToKey(key, dens, kTRUE);
+      for (const auto &component : components) {
+         key.append(component);
+      }
+
+      auto result = fMaterialKeys.emplace(key, kmat);
+      if (!result.second) {
+         if (result.first->second != kmat) {
+            fMaterialAliases[kmat] = result.first->second;
+         }
+         kmat = result.first->second;
+         ++fNofReusedMaterials;
+         return;
+      }
+   }
+
    GetTGeoManager()->Mixture(name, a, z, dens, nlmat, wmat, kmat);
 }
 
@@ -313,7 +648,9 @@ void TGeoMCGeometry::Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isv
                             Double_t tmaxfd, Double_t stemax, Double_t deemax, Double_t epsil, Double_t stmin,
                             Double_t * /*ubuf*/, Int_t /*nbuf*/)
 {
-   GetTGeoManager()->Medium(name, kmed, nmat, isvol, ifield, fieldm, tmaxfd, stemax, deemax, epsil, stmin);
+   GetTGeoManager()->Medium(name, kmed, MaterialAlias(nmat), isvol, ifield, fieldm, tmaxfd, stemax, deemax, epsil,
+                            stmin);
+   InvalidateIndices();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -331,8 +668,33 @@ void TGeoMCGeometry::Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isv
 void TGeoMCGeometry::Matrix(Int_t &krot, Double_t thex, Double_t phix, Double_t they, Double_t phiy, Double_t thez,
                             Double_t phiz)
 {
+   std::string key;
+   if (fDeduplicate) {
+      // The key is made of the rotation matrix elements, as different
+      // sets of angles may define the same rotation
+      const Double_t degrad = TMath::DegToRad();
+      const Double_t theta[3] = {thex, they, thez};
+      const Double_t phi[3] = {phix, phiy, phiz};
+      for (Int_t i = 0; i < 3; i++) {
+         AddToKey(key, std::sin(theta[i] * degrad) * std::cos(phi[i] * degrad), kFALSE);
+         AddToKey(key, std::sin(theta[i] * degrad) * std::sin(phi[i] * degrad), kFALSE);
+         AddToKey(key, std::cos(theta[i] * degrad), kFALSE);
+      }
+
+      auto it = fRotationKeys.find(key);
+      if (it != fRotationKeys.end()) {
+         krot = it->second;
+         ++fNofReusedRotations;
+         return;
+      }
+   }
+
    krot = GetTGeoManager()->GetListOfMatrices()->GetEntriesFast();
    GetTGeoManager()->Matrix(krot, thex, phix, they, phiy, thez, phiz);
+
+   if (fDeduplicate) {
+      fRotationKeys.emplace(key, krot);
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -375,6 +737,7 @@ Int_t TGeoMCGeometry::Gsvolu(const char *name, const char *shape, Int_t nmed, Do
       Fatal("Gsvolu", "Could not create volume %s", name);
       return -1;
    }
+   InvalidateIndices();
    return vol->GetNumber();
 }
 
@@ -397,6 +760,7 @@ void TGeoMCGeometry::Gsdvn(const char *name, const char *mother, Int_t ndiv, Int
    Vname(mother, vmother);
 
    GetTGeoManager()->Division(vname, vmother, iaxis, ndiv, 0, 0, 0, "n");
+   InvalidateIndices();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -415,6 +779,7 @@ void TGeoMCGeometry::Gsdvn2(const char *name, const char *mother, Int_t ndiv, In
    Vname(mother, vmother);
 
    GetTGeoManager()->Division(vname, vmother, iaxis, ndiv, c0i, 0, numed, "nx");
+   InvalidateIndices();
 }
 ////////////////////////////////////////////////////////////////////////////////
 ///
@@ -437,6 +802,7 @@ void TGeoMCGeometry::Gsdvt(const char *name, const char *mother, Double_t step,
    Vname(mother, vmother);
 
    GetTGeoManager()->Division(vname, vmother, iaxis, 0, 0, step, numed, "s");
+   InvalidateIndices();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -460,6 +826,7 @@ void TGeoMCGeometry::Gsdvt2(const char *name, const char *mother, Double_t step,
    Vname(mother, vmother);
 
    GetTGeoManager()->Division(vname, vmother, iaxis, 0, c0, step, numed, "sx");
+   InvalidateIndices();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -547,6 +914,80 @@ void TGeoMCGeometry::Gsposp(const char *name, Int_t nr, const char *mother, Doub
    Vname(mother, vmother);
 
    GetTGeoManager()->Node(vname, nr, vmother, x, y, z, irot, isOnly, upar, np);
+   InvalidateIndices();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position n copies of a previously defined volume in the mother.
+/// See TVirtualMCGeometry::GsposArray() for the parameters.
+///
+/// The volumes, the rotation matrix and the ONLY/MANY flag are resolved
+/// once for all copies and the placement matrices are shared with the
+/// copies placed via GsposArray() or GsposLattice() at the same position
+/// with the same rotation, eg. the cells of all modules, so that only one
+/// matrix is created per distinct local position.
+/// Generic volumes (defined via Gsposp) and divided mothers are placed
+/// via Gspos().
+
+void TGeoMCGeometry::GsposArray(const char *name, Int_t n, const Int_t *nr, const char *mother, const Double_t *x,
+                                const Double_t *y, const Double_t *z, Int_t irot, const char *konly)
+{
+   TGeoVolume *volume;
+   TGeoVolume *motherVolume;
+   TGeoRotation *rotation;
+   Bool_t isOnly;
+   if (!ResolvePlacement(name, mother, irot, konly, volume, motherVolume, rotation, isOnly)) {
+      TVirtualMCGeometry::GsposArray(name, n, nr, mother, x, y, z, irot, konly);
+      return;
+   }
+
+   for (Int_t i = 0; i < n; ++i) {
+      TGeoMatrix *matrix = GetPlacementMatrix(x[i], y[i], z[i], rotation);
+      if (isOnly) {
+         motherVolume->AddNode(volume, nr[i], matrix);
+      } else {
+         motherVolume->AddNodeOverlap(volume, nr[i], matrix);
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position nx*ny*nz copies of a previously defined volume in the mother
+/// on a regular lattice.
+/// See TVirtualMCGeometry::GsposLattice() for the parameters.
+///
+/// The copies are placed directly, without building the position arrays,
+/// and they share the placement matrices as in GsposArray().
+
+void TGeoMCGeometry::GsposLattice(const char *name, Int_t nr0, const char *mother, Int_t nx, Int_t ny, Int_t nz,
+                                  Double_t x0, Double_t y0, Double_t z0, Double_t dx, Double_t dy, Double_t dz,
+                                  Int_t irot, const char *konly)
+{
+   TGeoVolume *volume;
+   TGeoVolume *motherVolume;
+   TGeoRotation *rotation;
+   Bool_t isOnly;
+   if (nx <= 0 || ny <= 0 || nz <= 0 ||
+       !ResolvePlacement(name, mother, irot, konly, volume, motherVolume, rotation, isOnly)) {
+      TVirtualMCGeometry::GsposLattice(name, nr0, mother, nx, ny, nz, x0, y0, z0, dx, dy, dz, irot, konly);
+      return;
+   }
+
+   Int_t nr = nr0;
+   for (Int_t iz = 0; iz < nz; ++iz) {
+      for (Int_t iy = 0; iy < ny; ++iy) {
+         for (Int_t ix = 0; ix < nx; ++ix) {
+            TGeoMatrix *matrix = GetPlacementMatrix(x0 + ix * dx, y0 + iy * dy, z0 + iz * dz, rotation);
+            if (isOnly) {
+               motherVolume->AddNode(volume, nr++, matrix);
+            } else {
+               motherVolume->AddNodeOverlap(volume, nr++, matrix);
+            }
+         }
+      }
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -555,7 +996,10 @@ void TGeoMCGeometry::Gsposp(const char *name, Int_t nr, const char *mother, Doub
 
 Int_t TGeoMCGeometry::VolId(const char *name) const
 {
-   Int_t uid = GetTGeoManager()->GetUID(name);
+   // Volumes which are not in the index (eg. generic volumes defined via Gsposp)
+   // are still searched via TGeoManager
+   TGeoVolume *volume = FindVolume(name);
+   Int_t uid = volume ? volume->GetNumber() : GetTGeoManager()->GetUID(name);
    if (uid < 0) {
       printf("VolId: Volume %s not found\n", name);
       return 0;
@@ -569,6 +1013,17 @@ Int_t TGeoMCGeometry::VolId(const char *name) const
 
 Int_t TGeoMCGeometry::MediumId(const char *name) const
 {
+   {
+      TMCAutoLock lk(&indexMutex);
+      if (UpdateIndices()) {
+         auto it = fMediumIndex.find(name);
+         if (it != fMediumIndex.end())
+            return it->second;
+         printf("MediumId: Medium %s not found\n", name);
+         return 0;
+      }
+   }
+
    TGeoMedium *medium = GetTGeoManager()->GetMedium(name);
    if (medium)
       return medium->GetId();
@@ -606,7 +1061,7 @@ Int_t TGeoMCGeometry::NofVolumes() const
 
 Int_t TGeoMCGeometry::NofVolDaughters(const char *volName) const
 {
-   TGeoVolume *volume = GetTGeoManager()->GetVolume(volName);
+   TGeoVolume *volume = FindVolume(volName);
 
    if (!volume) {
       Error("NofVolDaughters", "Volume %s not found.", volName);
@@ -623,7 +1078,7 @@ Int_t TGeoMCGeometry::NofVolDaughters(const char *volName) const
 const char *TGeoMCGeometry::VolDaughterName(const char *volName, Int_t i) const
 {
    // Get volume
-   TGeoVolume *volume = GetTGeoManager()->GetVolume(volName);
+   TGeoVolume *volume = FindVolume(volName);
    if (!volume) {
       Error("VolDaughterName", "Volume %s not found.", volName);
       return "";
@@ -646,7 +1101,7 @@ const char *TGeoMCGeometry::VolDaughterName(const char *volName, Int_t i) const
 Int_t TGeoMCGeometry::VolDaughterCopyNo(const char *volName, Int_t i) const
 {
    // Get volume
-   TGeoVolume *volume = GetTGeoManager()->GetVolume(volName);
+   TGeoVolume *volume = FindVolume(volName);
    if (!volume) {
       Error("VolDaughterName", "Volume %s not found.", volName);
       return 0;
@@ -688,6 +1143,7 @@ Int_t TGeoMCGeometry::VolId2Mate(Int_t id) const
 /// or master volume which has only 1 instance of. Of all of the daughter
 /// volumes of ALICE, DDIP volume copy #1 is indicated. Similarly for
 /// the daughter volume of DDIP is S05I copy #2 and so on.
+/// The top node can be omitted: "DDIP_1/S05I_2/S05H_1/S05G_3".
 /// - Inputs:
 ///   - TString& volumePath  The volume path to the specific volume
 ///                          for which you want the matrix. Volume name
@@ -702,16 +1158,333 @@ Int_t TGeoMCGeometry::VolId2Mate(Int_t id) const
 
 Bool_t TGeoMCGeometry::GetTransformation(const TString &volumePath, TGeoHMatrix &mat)
 {
+   TMCAutoLock lk(&cacheMutex);
+   UpdateGeometryCache();
+
+   TString fullPath = GetFullPath(volumePath);
+   auto it = fMatrixCache.find(fullPath.Data());
+   if (it != fMatrixCache.end()) {
+      mat = it->second;
+      return kTRUE;
+   }
+
    // We have to preserve the modeler state
    GetTGeoManager()->PushPath();
-   if (!GetTGeoManager()->cd(volumePath.Data())) {
+   if (!GetTGeoManager()->cd(fullPath.Data())) {
       GetTGeoManager()->PopPath();
       return kFALSE;
    }
    mat = *GetTGeoManager()->GetCurrentMatrix();
    GetTGeoManager()->PopPath();
+
+   fMatrixCache.emplace(fullPath.Data(), mat);
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Return the transformation matrices between the volumes specified
+/// by the paths volumePaths and the Top or master volume.
+///
+/// The paths have the same format as in GetTransformation().
+/// The paths which are not yet cached are sorted so that the geometry tree
+/// is navigated only once for the common path prefixes.
+/// - Inputs:
+///   - std::vector<TString>& volumePaths  The volume paths
+/// - Outputs:
+///   - std::vector<TGeoHMatrix> &matrices The matrices in the order of
+///                                        the input paths; an identity
+///                                        matrix is set for unknown paths
+/// - Return:
+///   - kFALSE if any of the paths could not be resolved
+
+Bool_t TGeoMCGeometry::GetTransformations(const std::vector<TString> &volumePaths, std::vector<TGeoHMatrix> &matrices)
+{
+   matrices.resize(volumePaths.size());
+
+   TMCAutoLock lk(&cacheMutex);
+   UpdateGeometryCache();
+
+   // Take the cached matrices and collect the paths to be navigated
+   std::vector<TString> fullPaths(volumePaths.size());
+   std::vector<size_t> toNavigate;
+   for (size_t i = 0; i < volumePaths.size(); i++) {
+      fullPaths[i] = GetFullPath(volumePaths[i]);
+      auto it = fMatrixCache.find(fullPaths[i].Data());
+      if (it != fMatrixCache.end())
+         matrices[i] = it->second;
+      else
+         toNavigate.push_back(i);
+   }
+   if (toNavigate.empty())
+      return kTRUE;
+
+   std::sort(toNavigate.begin(), toNavigate.end(),
+             [&fullPaths](size_t i1, size_t i2) { return fullPaths[i1] < fullPaths[i2]; });
+
+   // We have to preserve the modeler state
+   TGeoManager *geoManager = GetTGeoManager();
+   geoManager->PushPath();
+   geoManager->CdTop();
+
+   Bool_t allFound = kTRUE;
+   std::vector<std::string> currentBranch; // node names below the top node
+   std::vector<std::string> names;
+   for (size_t index : toNavigate) {
+      SplitPath(fullPaths[index], names);
+
+      // Skip the top node
+      size_t first = 1;
+
+      // Go up to the branch shared with the previous path
+      size_t nofCommon = 0;
+      while (nofCommon < currentBranch.size() && first + nofCommon < names.size() &&
+             currentBranch[nofCommon] == names[first + nofCommon])
+         nofCommon++;
+      while (currentBranch.size() > nofCommon) {
+         geoManager->CdUp();
+         currentBranch.pop_back();
+      }
+
+      // Go down to the volume
+      Bool_t found = names.size() > 1 && names[0] == geoManager->GetTopNode()->GetName();
+      for (size_t i = first + nofCommon; found && i < names.size(); i++) {
+         TGeoVolume *volume = geoManager->GetCurrentVolume();
+         TGeoNode *node = volume->GetNode(names[i].c_str());
+         if (!node) {
+            found = kFALSE;
+            break;
+         }
+         geoManager->CdDown(volume->GetIndex(node));
+         currentBranch.push_back(names[i]);
+      }
+
+      if (!found) {
+         matrices[index] = TGeoHMatrix();
+         allFound = kFALSE;
+         continue;
+      }
+      matrices[index] = *geoManager->GetCurrentMatrix();
+      fMatrixCache.emplace(fullPaths[index].Data(), matrices[index]);
+   }
+
+   geoManager->PopPath();
+   return allFound;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Activate/inactivate the de-duplication of rotation matrices and materials.
+///
+/// When activated, Matrix() returns the number of an already defined
+/// rotation matrix with the same matrix elements and Material()/Mixture()
+/// return the number of an already defined material with the same name
+/// and composition instead of creating new objects. The material numbers
+/// passed by the user are then mapped to the reused material in Medium().
+/// Note that the name of the first defined rotation matrix is kept.
+/// Changing the option resets the de-duplication state and statistics.
+/// - Inputs:
+///   - deduplicate  The de-duplication option
+///   - tolerance    The tolerance applied to the rotation matrix elements
+///                  (absolute) and to the material parameters (relative)
+///
+/// The option should be set before the geometry definition starts.
+
+void TGeoMCGeometry::SetDeduplication(Bool_t deduplicate, Double_t tolerance)
+{
+   if (tolerance <= 0.) {
+      Error("SetDeduplication", "The tolerance must be positive, %g was given.", tolerance);
+      return;
+   }
+
+   fDeduplicate = deduplicate;
+   fDeduplicationTolerance = tolerance;
+   fRotationKeys.clear();
+   fMaterialKeys.clear();
+   fMaterialAliases.clear();
+   fNofReusedRotations = 0;
+   fNofReusedMaterials = 0;
+   fNofReusedElements = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Print the numbers of rotation matrices and materials which were reused
+/// and an estimate of the memory which was saved.
+
+void TGeoMCGeometry::PrintDeduplicationStatistics() const
+{
+   Long64_t savedMemory = fNofReusedRotations * (sizeof(TGeoRotation) + sizeof(void *)) +
+                          fNofReusedElements * (sizeof(TGeoMaterial) + sizeof(void *)) +
+                          fNofReusedMaterials * (sizeof(TGeoMixture) + sizeof(void *));
+
+   std::cout << "TGeoMCGeometry de-duplication (tolerance " << fDeduplicationTolerance << ")" << std::endl
+             << "   Reused rotation matrices: " << fNofReusedRotations << " of "
+             << fNofReusedRotations + fRotationKeys.size() << std::endl
+             << "   Reused materials:         " << fNofReusedElements + fNofReusedMaterials << " of "
+             << fNofReusedElements + fNofReusedMaterials + fMaterialKeys.size() << std::endl
+             << "   Estimated memory saved:   " << savedMemory / 1024 << " kB" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Save the closed geometry in the file fileName together with the key
+/// identifying the construction inputs.
+///
+/// The snapshot includes the voxels, the media and materials with their
+/// VMC numbers, so that it can be loaded with LoadGeometrySnapshot()
+/// instead of replaying the geometry construction.
+/// - Inputs:
+///   - fileName  The snapshot ROOT file name (recreated)
+///   - key       The construction key, see ComputeSnapshotKey()
+/// - Return:
+///   - kFALSE if the geometry is not closed or the file cannot be written
+
+Bool_t TGeoMCGeometry::SaveGeometrySnapshot(const char *fileName, const char *key) const
+{
+   TGeoManager *geoManager = GetTGeoManager();
+   if (!geoManager->IsClosed()) {
+      Error("SaveGeometrySnapshot", "The geometry must be closed before saving its snapshot.");
+      return kFALSE;
+   }
+
+   if (!geoManager->Export(fileName, "", "v")) {
+      Error("SaveGeometrySnapshot", "Export of the geometry to %s failed.", fileName);
+      return kFALSE;
+   }
+
+   TFile file(fileName, "UPDATE");
+   if (file.IsZombie()) {
+      Error("SaveGeometrySnapshot", "Cannot open %s.", fileName);
+      return kFALSE;
+   }
+   TNamed keyObject(snapshotKeyName, key);
+   keyObject.Write();
+   file.Close();
+
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Load the geometry from the snapshot file fileName if it was saved
+/// with the same key.
+///
+/// The loaded geometry replaces gGeoManager and it is closed; it should be
+/// called from the application ConstructGeometry() and the geometry
+/// construction is needed only if this function returns kFALSE.
+/// - Inputs:
+///   - fileName  The snapshot ROOT file name
+///   - key       The construction key, see ComputeSnapshotKey()
+/// - Return:
+///   - kFALSE if the file does not exist, or it was saved with another key
+
+Bool_t TGeoMCGeometry::LoadGeometrySnapshot(const char *fileName, const char *key)
+{
+   {
+      std::ifstream input(fileName);
+      if (!input.good())
+         return kFALSE;
+   }
+
+   TFile *file = TFile::Open(fileName, "READ");
+   if (!file || file->IsZombie()) {
+      Warning("LoadGeometrySnapshot", "Cannot open %s.", fileName);
+      delete file;
+      return kFALSE;
+   }
+   TNamed *keyObject = dynamic_cast<TNamed *>(file->Get(snapshotKeyName));
+   Bool_t isMatching = keyObject && TString(keyObject->GetTitle()) == key;
+   delete keyObject;
+   delete file;
+
+   if (!isMatching) {
+      Info("LoadGeometrySnapshot", "The snapshot %s does not match the key %s.", fileName, key);
+      return kFALSE;
+   }
+
+   if (!TGeoManager::Import(fileName)) {
+      Error("LoadGeometrySnapshot", "Import of the geometry from %s failed.", fileName);
+      return kFALSE;
+   }
+   if (!gGeoManager->IsClosed()) {
+      gGeoManager->CloseGeometry();
+   }
+
+   InvalidateIndices();
+   ClearGeometryCache();
    return kTRUE;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+/// Compute the key identifying the geometry construction inputs
+/// from the MD5 checksum of the content of the given files
+/// (eg. the geometry definition sources or data files) and
+/// of the string parameters (eg. the application configuration).
+
+TString TGeoMCGeometry::ComputeSnapshotKey(const std::vector<TString> &inputFiles, const char *parameters)
+{
+   TMD5 md5;
+   std::vector<char> buffer(1 << 16);
+   for (const auto &inputFile : inputFiles) {
+      std::ifstream input(inputFile.Data(), std::ios::binary);
+      if (!input.good()) {
+         ::Warning("TGeoMCGeometry::ComputeSnapshotKey", "Cannot read %s.", inputFile.Data());
+      }
+      while (input.good()) {
+         input.read(buffer.data(), buffer.size());
+         md5.Update(reinterpret_cast<const UChar_t *>(buffer.data()), input.gcount());
+      }
+      // separate the files content
+      md5.Update(reinterpret_cast<const UChar_t *>(inputFile.Data()), inputFile.Length() + 1);
+   }
+   md5.Update(reinterpret_cast<const UChar_t *>(parameters), strlen(parameters));
+   md5.Final();
+
+   return md5.AsString();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Clear the cached transformations and shapes.
+///
+/// The caches are cleared automatically when the TGeoManager changes,
+/// new physical nodes are aligned or a node is (re)aligned via AlignNode();
+/// this function has to be called only if an already aligned physical node
+/// is realigned directly via TGeoPhysicalNode::Align().
+
+void TGeoMCGeometry::ClearGeometryCache()
+{
+   TMCAutoLock lk(&cacheMutex);
+   fMatrixCache.clear();
+   fShapeCache.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Align the physical node specified by the path volumePath
+/// (in the format of GetTransformation()) with the new local matrix
+/// and optionally the new shape, see TGeoPhysicalNode::Align().
+/// The physical node is created if it does not yet exist.
+/// The cached transformations and shapes of all TGeoMCGeometry instances
+/// are invalidated, so this function can also be used to realign
+/// an already aligned node, eg. in TVirtualMCApplication::MisalignGeometry().
+/// - Return:
+///   - kFALSE if the path could not be resolved or the alignment failed
+
+Bool_t TGeoMCGeometry::AlignNode(const TString &volumePath, TGeoHMatrix *newMatrix, TGeoShape *newShape, Bool_t check)
+{
+   TMCAutoLock lk(&cacheMutex);
+
+   TString fullPath = GetFullPath(volumePath);
+   TGeoManager *geoManager = GetTGeoManager();
+   TGeoPhysicalNode *node = nullptr;
+   if (geoManager->GetListOfPhysicalNodes())
+      node = (TGeoPhysicalNode *)geoManager->GetListOfPhysicalNodes()->FindObject(fullPath.Data());
+   if (!node)
+      node = geoManager->MakePhysicalNode(fullPath.Data());
+   if (!node || !node->GetNode()) {
+      Error("AlignNode", "Volume path %s not found.", volumePath.Data());
+      return kFALSE;
+   }
+
+   Bool_t isAligned = node->Align(newMatrix, newShape, check);
+   alignmentGeneration++;
+   return isAligned;
+}
 ////////////////////////////////////////////////////////////////////////////////
 /// Returns the shape and its parameters for the volume specified
 /// by volumeName.
@@ -726,6 +1499,33 @@ Bool_t TGeoMCGeometry::GetTransformation(const TString &volumePath, TGeoHMatrix
 ///     information
 
 Bool_t TGeoMCGeometry::GetShape(const TString &volumePath, TString &shapeType, TArrayD &par)
+{
+   TMCAutoLock lk(&cacheMutex);
+   UpdateGeometryCache();
+
+   TString fullPath = GetFullPath(volumePath);
+   auto it = fShapeCache.find(fullPath.Data());
+   if (it != fShapeCache.end()) {
+      shapeType = it->second.fType;
+      par = it->second.fPar;
+      return kTRUE;
+   }
+
+   if (!ComputeShape(fullPath, shapeType, par))
+      return kFALSE;
+
+   ShapeEntry &entry = fShapeCache[fullPath.Data()];
+   entry.fType = shapeType;
+   entry.fPar = par;
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Navigate to the volume specified by the path volumePath
+/// and fill its shape type and parameters (not cached).
+/// The caller must hold cacheMutex.
+
+Bool_t TGeoMCGeometry::ComputeShape(const TString &volumePath, TString &shapeType, TArrayD &par)
 {
    Int_t npar;
    GetTGeoManager()->PushPath();
@@ -994,7 +1794,7 @@ Bool_t TGeoMCGeometry::GetShape(const TString &volumePath, TString &shapeType, T
 Bool_t TGeoMCGeometry::GetMaterial(const TString &volumeName, TString &name, Int_t &imat, Double_t &a, Double_t &z,
                                    Double_t &dens, Double_t &radl, Double_t &inter, TArrayD &par)
 {
-   TGeoVolume *vol = GetTGeoManager()->GetVolume(volumeName.Data());
+   TGeoVolume *vol = FindVolume(volumeName.Data());
    if (!vol)
       return kFALSE;
    TGeoMedium *med = vol->GetMedium();
@@ -1041,7 +1841,7 @@ Bool_t TGeoMCGeometry::GetMedium(const TString &volumeName, TString &name, Int_t
                                  Int_t &ifield, Double_t &fieldm, Double_t &tmaxfd, Double_t &stemax, Double_t &deemax,
                                  Double_t &epsil, Double_t &stmin, TArrayD &par)
 {
-   TGeoVolume *vol = GetTGeoManager()->GetVolume(volumeName.Data());
+   TGeoVolume *vol = FindVolume(volumeName.Data());
    if (!vol)
       return kFALSE;
    TGeoMedium *med = vol->GetMedium();
@@ -59,9 +59,341 @@
 
 #include "TMCAutoLock.h"
 
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(VMC_LOCK_PROFILING)
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <vector>
+#endif
+
 #if !defined(TMCMULTITHREADED)
 int fake_mutex_lock_unlock(TMCMutex *)
 {
    return 0;
 }
 #endif
+
+//
+// TMCSpinMutex
+//
+
+namespace {
+
+std::atomic<int> spinMaxSpins(64);
+
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   asm volatile("yield" ::: "memory");
+#endif
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the maximum number of the lock attempts in the spin phase
+/// before the thread blocks (the default is 64; 0 disables spinning)
+///
+
+void TMCSpinMutex::SetMaxSpins(int maxSpins)
+{
+   spinMaxSpins = maxSpins > 0 ? maxSpins : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the maximum number of the lock attempts in the spin phase
+///
+
+int TMCSpinMutex::GetMaxSpins()
+{
+   return spinMaxSpins;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The contended lock: spin with exponential backoff while the mutex is held
+/// without waiters, then block until it is released
+///
+
+void TMCSpinMutex::LockContended()
+{
+   const int maxSpins = spinMaxSpins.load(std::memory_order_relaxed);
+   int backoff = 1;
+   for (int spin = 0; spin < maxSpins; ++spin) {
+      // spin on a load, not on the exchange, to keep the cache line shared
+      int state = fState.load(std::memory_order_relaxed);
+      if (state == kUnlocked) {
+         if (fState.compare_exchange_weak(state, kLocked, std::memory_order_acquire, std::memory_order_relaxed))
+            return;
+      } else if (state == kWaiters) {
+         // other threads are already blocked, do not overtake them by spinning
+         break;
+      }
+      for (int i = 0; i < backoff; ++i)
+         CpuRelax();
+      if (backoff < 1024)
+         backoff <<= 1;
+   }
+
+   // mark the mutex as having waiters; we own it if it was unlocked
+   while (fState.exchange(kWaiters, std::memory_order_acquire) != kUnlocked) {
+#if defined(__linux__)
+      syscall(SYS_futex, reinterpret_cast<int *>(&fState), FUTEX_WAIT_PRIVATE, int(kWaiters), nullptr, nullptr, 0);
+#else
+      std::this_thread::yield();
+#endif
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Wake one of the blocked threads
+///
+
+void TMCSpinMutex::WakeOne()
+{
+#if defined(__linux__)
+   syscall(SYS_futex, reinterpret_cast<int *>(&fState), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+//
+// Lock contention instrumentation
+//
+
+#if defined(VMC_LOCK_PROFILING)
+
+/// The lock statistics of one mutex at one call site
+struct TMCLockSiteStats {
+   const void *fMutex = nullptr;              ///< The mutex
+   const char *fFile = nullptr;               ///< The call site file
+   int fLine = 0;                             ///< The call site line
+   std::atomic<unsigned long long> fNofLocks; ///< The number of acquisitions
+   std::atomic<unsigned long long> fNofContended; ///< The number of acquisitions which had to wait
+   std::atomic<long long> fWaitTime;          ///< The total wait time (ns)
+   std::atomic<long long> fMaxHoldTime;       ///< The maximum hold time (ns)
+
+   TMCLockSiteStats(const void *mutex, const char *file, int line)
+      : fMutex(mutex), fFile(file), fLine(line), fNofLocks(0), fNofContended(0), fWaitTime(0), fMaxHoldTime(0)
+   {
+   }
+};
+
+namespace {
+
+using TSiteKey = std::tuple<const void *, const char *, int>;
+
+/// The registry of the statistics; the entries are never removed so that
+/// the pointers cached in the threads and in the mutexes stay valid
+struct TLockRegistry {
+   std::mutex fMutex;
+   std::deque<TMCLockSiteStats> fStats;
+   std::map<TSiteKey, TMCLockSiteStats *> fIndex;
+};
+
+TLockRegistry &GetRegistry()
+{
+   // never deleted, the mutexes may be locked during the static destruction
+   static TLockRegistry *registry = new TLockRegistry();
+   return *registry;
+}
+
+thread_local const char *tlsFile = nullptr;
+thread_local int tlsLine = 0;
+thread_local std::map<TSiteKey, TMCLockSiteStats *> *tlsIndex = nullptr;
+
+long long Now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+TMCLockSiteStats *GetSiteStats(const void *mutex)
+{
+   TSiteKey key(mutex, tlsFile ? tlsFile : "(direct lock)", tlsFile ? tlsLine : 0);
+
+   // per-thread lookup first, without locking
+   if (!tlsIndex)
+      tlsIndex = new std::map<TSiteKey, TMCLockSiteStats *>();
+   auto it = tlsIndex->find(key);
+   if (it != tlsIndex->end())
+      return it->second;
+
+   TLockRegistry &registry = GetRegistry();
+   TMCLockSiteStats *stats = nullptr;
+   {
+      std::lock_guard<std::mutex> lk(registry.fMutex);
+      auto rit = registry.fIndex.find(key);
+      if (rit == registry.fIndex.end()) {
+         registry.fStats.emplace_back(mutex, std::get<1>(key), std::get<2>(key));
+         stats = &registry.fStats.back();
+         registry.fIndex[key] = stats;
+      } else {
+         stats = rit->second;
+      }
+   }
+   (*tlsIndex)[key] = stats;
+   return stats;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex and record the acquisition; the wait time is measured
+/// only when the mutex is already locked
+///
+
+void TMCProfiledMutex::lock()
+{
+   TMCLockSiteStats *stats = GetSiteStats(this);
+   if (!fMutex.try_lock()) {
+      long long start = Now();
+      fMutex.lock();
+      stats->fNofContended.fetch_add(1, std::memory_order_relaxed);
+      stats->fWaitTime.fetch_add(Now() - start, std::memory_order_relaxed);
+   }
+   stats->fNofLocks.fetch_add(1, std::memory_order_relaxed);
+   fOwnerStats = stats;
+   fLockTime = Now();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Try to lock the mutex; a successful try is recorded as an acquisition
+///
+
+bool TMCProfiledMutex::try_lock()
+{
+   if (!fMutex.try_lock())
+      return false;
+
+   TMCLockSiteStats *stats = GetSiteStats(this);
+   stats->fNofLocks.fetch_add(1, std::memory_order_relaxed);
+   fOwnerStats = stats;
+   fLockTime = Now();
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Record the hold time and unlock the mutex
+///
+
+void TMCProfiledMutex::unlock()
+{
+   TMCLockSiteStats *stats = fOwnerStats;
+   long long holdTime = Now() - fLockTime;
+   fOwnerStats = nullptr;
+   fMutex.unlock();
+
+   if (!stats)
+      return;
+   long long maxHoldTime = stats->fMaxHoldTime.load(std::memory_order_relaxed);
+   while (holdTime > maxHoldTime &&
+          !stats->fMaxHoldTime.compare_exchange_weak(maxHoldTime, holdTime, std::memory_order_relaxed)) {
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true as the library was built with VMC_LOCK_PROFILING
+///
+
+bool TMCLockProfiler::IsEnabled()
+{
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the lock statistics sorted by the total wait time
+///
+
+void TMCLockProfiler::Print(std::ostream &out)
+{
+   TLockRegistry &registry = GetRegistry();
+   std::vector<const TMCLockSiteStats *> stats;
+   {
+      std::lock_guard<std::mutex> lk(registry.fMutex);
+      for (const auto &entry : registry.fStats)
+         stats.push_back(&entry);
+   }
+   std::sort(stats.begin(), stats.end(), [](const TMCLockSiteStats *lhs, const TMCLockSiteStats *rhs) {
+      return lhs->fWaitTime.load() > rhs->fWaitTime.load();
+   });
+
+   out << "TMCLockProfiler: " << stats.size() << " lock sites" << std::endl;
+   out << std::setw(18) << "mutex" << std::setw(14) << "locks" << std::setw(14) << "contended" << std::setw(14)
+       << "wait [ms]" << std::setw(14) << "max hold [us]"
+       << "  call site" << std::endl;
+   for (auto site : stats) {
+      out << std::setw(18) << site->fMutex << std::setw(14) << site->fNofLocks.load() << std::setw(14)
+          << site->fNofContended.load() << std::setw(14) << std::fixed << std::setprecision(3)
+          << site->fWaitTime.load() * 1e-6 << std::setw(14) << site->fMaxHoldTime.load() * 1e-3 << "  "
+          << site->fFile << ":" << site->fLine << std::defaultfloat << std::endl;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Reset the counters of all lock sites
+///
+
+void TMCLockProfiler::Reset()
+{
+   TLockRegistry &registry = GetRegistry();
+   std::lock_guard<std::mutex> lk(registry.fMutex);
+   for (auto &site : registry.fStats) {
+      site.fNofLocks = 0;
+      site.fNofContended = 0;
+      site.fWaitTime = 0;
+      site.fMaxHoldTime = 0;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the call site used by the next lock of a profiled mutex in this thread
+///
+
+void TMCLockProfiler::SetCallSite(const char *file, int line)
+{
+   tlsFile = file;
+   tlsLine = line;
+}
+
+#else
+
+bool TMCLockProfiler::IsEnabled()
+{
+   return false;
+}
+
+void TMCLockProfiler::Print(std::ostream &out)
+{
+   out << "TMCLockProfiler: the lock profiling is not enabled "
+       << "(build with VMC_LOCK_PROFILING=ON)" << std::endl;
+}
+
+void TMCLockProfiler::Reset() {}
+
+void TMCLockProfiler::SetCallSite(const char *, int) {}
+
+#endif // defined(VMC_LOCK_PROFILING)
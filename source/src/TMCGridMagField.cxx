@@ -0,0 +1,552 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCGridMagField.h"
+#include "TError.h"
+#include "TMCAutoLock.h"
+#include "TMCtls.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define VMC_GRID_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** \class TMCGridMagField
+    \ingroup vmc
+
+Magnetic field map defined on a regular grid and loaded from a binary file.
+
+The grid can be Cartesian, with (Bx, By, Bz) values at (x, y, z) points,
+or cylindrical, with (Br, Bphi, Bz) values at (r, phi, z) points.
+The field is interpolated trilinearly in the grid cell and it is zero
+outside the grid. The file can define the symmetries of the field:
+- mirroring in the grid axes: the grid covers only the non-negative
+  coordinate values, the field components at the reflected point are
+  multiplied by the given signs;
+- the phi period (cylindrical grids): the grid covers one period
+  [phiMin, phiMin + period].
+
+The file is mapped in the memory (if supported by the system) and
+the map is shared between all TMCGridMagField objects created with the
+same file, eg. on the worker threads. The single point evaluation caches
+the last used grid cell per thread; the batched evaluation processes
+the points in vectorizable passes over the structure of arrays.
+
+The file, written with WriteMap(), consists of a fixed size header
+followed by the field values in native byte order, the index of the
+third coordinate running fastest:
+values[((i0 * n1 + i1) * n2 + i2) * 3 + component]
+*/
+
+ClassImp(TMCGridMagField);
+
+namespace {
+
+/// The file header
+struct TGridHeader {
+   char fMagic[8];             ///< "VMCGRID1"
+   Int_t fCoordinates;         ///< TMCGridMagField::ECoordinates
+   Int_t fMirror;              ///< Bit k set if the field is mirrored in the axis k
+   Int_t fN[3];                ///< Number of grid points per axis
+   Int_t fReserved;            ///< Unused
+   Double_t fMin[3];           ///< Grid minimum per axis
+   Double_t fMax[3];           ///< Grid maximum per axis
+   Double_t fMirrorSign[3][3]; ///< Signs of the field components at the point reflected in the axis k
+   Double_t fPhiPeriod;        ///< The phi period (cylindrical grid), 0 if none
+};
+
+const char gridMagic[8] = {'V', 'M', 'C', 'G', 'R', 'I', 'D', '1'};
+
+// Mutex protecting the registry of the mapped files
+TMCMutex registryMutex = TMCMUTEX_INITIALIZER;
+
+/// The last used cell per thread
+struct TCellCache {
+   Long64_t fMapId = -1;    ///< The identifier of the map of the cached cell
+   Long64_t fCell = -1;     ///< The cached cell index
+   Double_t fCorners[8][3]; ///< The field values at the cell corners
+};
+TMCThreadLocal TCellCache cellCache;
+
+/// The number of the points processed together in the batched evaluation
+const Int_t kBatchSize = 64;
+
+} // namespace
+
+/// The map data shared between all fields loaded from the same file
+struct TMCGridMagField::TGridData {
+   ~TGridData()
+   {
+#ifdef VMC_GRID_MMAP
+      if (fAddress)
+         munmap(fAddress, fSize);
+#endif
+   }
+
+   Long64_t fId = 0;            ///< The unique map identifier
+   TGridHeader fHeader;         ///< A copy of the file header
+   const Double_t *fValues;     ///< The field values
+   Double_t fInvStep[3];        ///< The inverse grid steps
+   void *fAddress = nullptr;    ///< The mapped memory (if mapped)
+   size_t fSize = 0;            ///< The mapped memory size
+   std::vector<Double_t> fData; ///< The values read from the file (if not mapped)
+};
+
+namespace {
+
+//_____________________________________________________________________________
+std::shared_ptr<const TMCGridMagField::TGridData> LoadMap(const std::string &fileName)
+{
+   /// Map the file in memory or return the map already loaded
+
+   static std::map<std::string, std::weak_ptr<const TMCGridMagField::TGridData>> registry;
+   static Long64_t lastMapId = 0;
+
+   TMCAutoLock lk(&registryMutex);
+   auto it = registry.find(fileName);
+   if (it != registry.end()) {
+      auto map = it->second.lock();
+      if (map)
+         return map;
+   }
+
+   auto map = std::make_shared<TMCGridMagField::TGridData>();
+   size_t size = 0;
+   const char *data = nullptr;
+
+#ifdef VMC_GRID_MMAP
+   int fd = open(fileName.c_str(), O_RDONLY);
+   if (fd < 0) {
+      ::Error("TMCGridMagField::LoadMap", "Cannot open the field map file %s", fileName.c_str());
+      return nullptr;
+   }
+   struct stat st;
+   if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size = st.st_size;
+      void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED) {
+         map->fAddress = address;
+         map->fSize = size;
+         data = static_cast<const char *>(address);
+      }
+   }
+   close(fd);
+#endif
+
+   std::vector<char> buffer;
+   if (!data) {
+      std::ifstream input(fileName, std::ios::binary | std::ios::ate);
+      if (!input.good()) {
+         ::Error("TMCGridMagField::LoadMap", "Cannot read the field map file %s", fileName.c_str());
+         return nullptr;
+      }
+      size = input.tellg();
+      buffer.resize(size);
+      input.seekg(0);
+      input.read(buffer.data(), size);
+      data = buffer.data();
+   }
+
+   // Check the header
+   TGridHeader &header = map->fHeader;
+   if (size < sizeof(TGridHeader)) {
+      ::Error("TMCGridMagField::LoadMap", "The file %s is not a field map", fileName.c_str());
+      return nullptr;
+   }
+   std::memcpy(&header, data, sizeof(TGridHeader));
+   if (std::memcmp(header.fMagic, gridMagic, sizeof(gridMagic)) != 0 ||
+       (header.fCoordinates != TMCGridMagField::kCartesian && header.fCoordinates != TMCGridMagField::kCylindrical)) {
+      ::Error("TMCGridMagField::LoadMap", "The file %s is not a field map", fileName.c_str());
+      return nullptr;
+   }
+   size_t nofValues = 3;
+   for (Int_t k = 0; k < 3; ++k) {
+      if (header.fN[k] < 2 || header.fMax[k] <= header.fMin[k]) {
+         ::Error("TMCGridMagField::LoadMap", "Wrong grid definition in axis %d in %s", k, fileName.c_str());
+         return nullptr;
+      }
+      nofValues *= header.fN[k];
+      map->fInvStep[k] = (header.fN[k] - 1) / (header.fMax[k] - header.fMin[k]);
+   }
+   if (size != sizeof(TGridHeader) + nofValues * sizeof(Double_t)) {
+      ::Error("TMCGridMagField::LoadMap", "Wrong size of the field map file %s", fileName.c_str());
+      return nullptr;
+   }
+
+   if (map->fAddress) {
+      map->fValues = reinterpret_cast<const Double_t *>(data + sizeof(TGridHeader));
+   } else {
+      map->fData.resize(nofValues);
+      std::memcpy(map->fData.data(), data + sizeof(TGridHeader), nofValues * sizeof(Double_t));
+      map->fValues = map->fData.data();
+   }
+
+   map->fId = ++lastMapId;
+   registry[fileName] = map;
+   return map;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+/// - name      The field name
+/// - fileName  The field map file written with WriteMap()
+/// - scale     The scale factor applied to the field values
+///
+
+TMCGridMagField::TMCGridMagField(const char *name, const char *fileName, Double_t scale)
+   : TVirtualMCMagField(name), fFileName(fileName), fScale(scale), fMap(LoadMap(fileName))
+{
+   if (!fMap) {
+      Error("TMCGridMagField", "The field map %s was not loaded, the field will be zero.", fileName);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCGridMagField::TMCGridMagField() : TVirtualMCMagField(), fFileName(), fScale(1.), fMap() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCGridMagField::~TMCGridMagField() {}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Calculate the field b at the point x; the corner values of the last used
+/// grid cell are cached per thread
+///
+
+void TMCGridMagField::Field(const Double_t *x, Double_t *b)
+{
+   if (!fMap) {
+      b[0] = 0.;
+      b[1] = 0.;
+      b[2] = 0.;
+      return;
+   }
+
+   const TGridHeader &header = fMap->fHeader;
+   const Double_t *values = fMap->fValues;
+   const Bool_t isCylindrical = (header.fCoordinates == kCylindrical);
+   const Long64_t stride1 = header.fN[2];
+   const Long64_t stride0 = Long64_t(header.fN[1]) * header.fN[2];
+   TCellCache &cache = cellCache;
+   const Double_t(&corners)[8][3] = cache.fCorners;
+
+   // Convert the point in the grid coordinates
+   Double_t u[3] = {x[0], x[1], x[2]};
+   Double_t cosPhi = 1.;
+   Double_t sinPhi = 0.;
+   if (isCylindrical) {
+      u[0] = std::sqrt(x[0] * x[0] + x[1] * x[1]);
+      u[1] = std::atan2(x[1], x[0]);
+      if (u[0] > 0.) {
+         cosPhi = x[0] / u[0];
+         sinPhi = x[1] / u[0];
+      }
+      if (header.fPhiPeriod > 0.) {
+         u[1] = header.fMin[1] + std::fmod(u[1] - header.fMin[1], header.fPhiPeriod);
+         if (u[1] < header.fMin[1])
+            u[1] += header.fPhiPeriod;
+      }
+   }
+
+   // Apply the mirror symmetries
+   Double_t sign[3] = {1., 1., 1.};
+   for (Int_t k = 0; k < 3; ++k) {
+      if ((header.fMirror & (1 << k)) && u[k] < 0.) {
+         u[k] = -u[k];
+         for (Int_t c = 0; c < 3; ++c) {
+            sign[c] *= header.fMirrorSign[k][c];
+         }
+      }
+   }
+
+   // Locate the cell
+   Int_t cell[3];
+   Double_t f[3];
+   for (Int_t k = 0; k < 3; ++k) {
+      Double_t t = (u[k] - header.fMin[k]) * fMap->fInvStep[k];
+      if (!(t >= 0. && t <= header.fN[k] - 1)) {
+         b[0] = 0.;
+         b[1] = 0.;
+         b[2] = 0.;
+         return;
+      }
+      cell[k] = (t < header.fN[k] - 1) ? Int_t(t) : header.fN[k] - 2;
+      f[k] = t - cell[k];
+   }
+
+   // Get the corner values from the cache or from the map
+   Long64_t cellIndex = cell[0] * stride0 + cell[1] * stride1 + cell[2];
+   if (cache.fMapId != fMap->fId || cache.fCell != cellIndex) {
+      for (Int_t corner = 0; corner < 8; ++corner) {
+         Long64_t index = cellIndex + ((corner >> 2) & 1) * stride0 + ((corner >> 1) & 1) * stride1 + (corner & 1);
+         const Double_t *value = values + 3 * index;
+         cache.fCorners[corner][0] = value[0];
+         cache.fCorners[corner][1] = value[1];
+         cache.fCorners[corner][2] = value[2];
+      }
+      cache.fMapId = fMap->fId;
+      cache.fCell = cellIndex;
+   }
+
+   // Interpolate
+   Double_t bg[3];
+   for (Int_t c = 0; c < 3; ++c) {
+      Double_t v00 = corners[0][c] + f[2] * (corners[1][c] - corners[0][c]);
+      Double_t v01 = corners[2][c] + f[2] * (corners[3][c] - corners[2][c]);
+      Double_t v10 = corners[4][c] + f[2] * (corners[5][c] - corners[4][c]);
+      Double_t v11 = corners[6][c] + f[2] * (corners[7][c] - corners[6][c]);
+      Double_t v0 = v00 + f[1] * (v01 - v00);
+      Double_t v1 = v10 + f[1] * (v11 - v10);
+      bg[c] = (v0 + f[0] * (v1 - v0)) * sign[c] * fScale;
+   }
+
+   if (isCylindrical) {
+      b[0] = bg[0] * cosPhi - bg[1] * sinPhi;
+      b[1] = bg[0] * sinPhi + bg[1] * cosPhi;
+      b[2] = bg[2];
+   } else {
+      b[0] = bg[0];
+      b[1] = bg[1];
+      b[2] = bg[2];
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Calculate the field bxyz at n points xyz
+/// (arrays of size 3*n, with the point coordinates stored contiguously)
+///
+/// The points are processed in batches of kBatchSize, in separate passes
+/// over the structure of arrays of the batch: the conversion to the grid
+/// coordinates, the mirror symmetries, the cell indices and weights, and
+/// the gather of the corner values with the interpolation. The passes are
+/// branch-free per point (the points outside the grid get a zero weight),
+/// so that they can be vectorized by the compiler; the cell cache is not
+/// used.
+///
+
+void TMCGridMagField::Field(Int_t n, const Double_t *xyz, Double_t *bxyz)
+{
+   if (!fMap) {
+      for (Int_t i = 0; i < 3 * n; ++i) {
+         bxyz[i] = 0.;
+      }
+      return;
+   }
+   if (n == 1) {
+      Field(xyz, bxyz);
+      return;
+   }
+
+   const TGridHeader &header = fMap->fHeader;
+   const Double_t *values = fMap->fValues;
+   const Bool_t isCylindrical = (header.fCoordinates == kCylindrical);
+   const Long64_t stride[3] = {Long64_t(header.fN[1]) * header.fN[2], header.fN[2], 1};
+
+   // The structure of arrays of one batch
+   Double_t u[3][kBatchSize];
+   Double_t cosPhi[kBatchSize];
+   Double_t sinPhi[kBatchSize];
+   Double_t sign[3][kBatchSize];
+   Double_t f[3][kBatchSize];
+   Double_t weight[kBatchSize];
+   Long64_t index[kBatchSize];
+
+   for (Int_t first = 0; first < n; first += kBatchSize) {
+      const Int_t m = (n - first < kBatchSize) ? n - first : kBatchSize;
+      const Double_t *x = xyz + 3 * first;
+      Double_t *b = bxyz + 3 * first;
+
+      // Convert the points in the grid coordinates
+      if (isCylindrical) {
+         for (Int_t i = 0; i < m; ++i) {
+            Double_t r = std::sqrt(x[3 * i] * x[3 * i] + x[3 * i + 1] * x[3 * i + 1]);
+            Double_t invR = (r > 0.) ? 1. / r : 0.;
+            u[0][i] = r;
+            u[1][i] = std::atan2(x[3 * i + 1], x[3 * i]);
+            u[2][i] = x[3 * i + 2];
+            cosPhi[i] = (r > 0.) ? x[3 * i] * invR : 1.;
+            sinPhi[i] = x[3 * i + 1] * invR;
+         }
+         if (header.fPhiPeriod > 0.) {
+            const Double_t phiMin = header.fMin[1];
+            const Double_t period = header.fPhiPeriod;
+            for (Int_t i = 0; i < m; ++i) {
+               Double_t dPhi = u[1][i] - phiMin;
+               u[1][i] = phiMin + dPhi - period * std::floor(dPhi / period);
+            }
+         }
+      } else {
+         for (Int_t i = 0; i < m; ++i) {
+            u[0][i] = x[3 * i];
+            u[1][i] = x[3 * i + 1];
+            u[2][i] = x[3 * i + 2];
+         }
+      }
+
+      // Apply the mirror symmetries
+      for (Int_t c = 0; c < 3; ++c) {
+         for (Int_t i = 0; i < m; ++i) {
+            sign[c][i] = 1.;
+         }
+      }
+      for (Int_t k = 0; k < 3; ++k) {
+         if (!(header.fMirror & (1 << k)))
+            continue;
+         const Double_t *mirrorSign = header.fMirrorSign[k];
+         for (Int_t i = 0; i < m; ++i) {
+            Double_t isNegative = (u[k][i] < 0.) ? 1. : 0.;
+            u[k][i] = std::fabs(u[k][i]);
+            sign[0][i] *= 1. + isNegative * (mirrorSign[0] - 1.);
+            sign[1][i] *= 1. + isNegative * (mirrorSign[1] - 1.);
+            sign[2][i] *= 1. + isNegative * (mirrorSign[2] - 1.);
+         }
+      }
+
+      // Compute the cell indices and the interpolation weights;
+      // the points outside the grid are moved to the first cell with weight 0
+      for (Int_t i = 0; i < m; ++i) {
+         index[i] = 0;
+         weight[i] = fScale;
+      }
+      for (Int_t k = 0; k < 3; ++k) {
+         const Double_t min = header.fMin[k];
+         const Double_t invStep = fMap->fInvStep[k];
+         const Double_t tMax = header.fN[k] - 1;
+         const Int_t cellMax = header.fN[k] - 2;
+         for (Int_t i = 0; i < m; ++i) {
+            Double_t t = (u[k][i] - min) * invStep;
+            Bool_t isInside = (t >= 0.) & (t <= tMax);
+            t = isInside ? t : 0.;
+            Int_t cell = Int_t(t);
+            cell = (cell < cellMax) ? cell : cellMax;
+            f[k][i] = t - cell;
+            index[i] += cell * stride[k];
+            weight[i] *= isInside ? 1. : 0.;
+         }
+      }
+
+      // Gather the corner values and interpolate
+      for (Int_t i = 0; i < m; ++i) {
+         const Double_t *v = values + 3 * index[i];
+         const Double_t *v0 = v + 3 * stride[0];
+         const Double_t *v01 = v + 3 * stride[1];
+         const Double_t *v11 = v0 + 3 * stride[1];
+         for (Int_t c = 0; c < 3; ++c) {
+            Double_t v00 = v[c] + f[2][i] * (v[3 + c] - v[c]);
+            Double_t v01c = v01[c] + f[2][i] * (v01[3 + c] - v01[c]);
+            Double_t v10 = v0[c] + f[2][i] * (v0[3 + c] - v0[c]);
+            Double_t v11c = v11[c] + f[2][i] * (v11[3 + c] - v11[c]);
+            Double_t w0 = v00 + f[1][i] * (v01c - v00);
+            Double_t w1 = v10 + f[1][i] * (v11c - v10);
+            b[3 * i + c] = (w0 + f[0][i] * (w1 - w0)) * sign[c][i] * weight[i];
+         }
+      }
+
+      // Rotate the cylindrical components
+      if (isCylindrical) {
+         for (Int_t i = 0; i < m; ++i) {
+            Double_t br = b[3 * i];
+            Double_t bphi = b[3 * i + 1];
+            b[3 * i] = br * cosPhi[i] - bphi * sinPhi[i];
+            b[3 * i + 1] = br * sinPhi[i] + bphi * cosPhi[i];
+         }
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the field map file
+///
+/// - fileName     The output file name
+/// - coordinates  The grid coordinates
+/// - n            The number of grid points per axis (array of size 3, >= 2)
+/// - min, max     The grid limits per axis (arrays of size 3); the phi limits
+///                of a cylindrical grid are in radians in [-pi, pi]
+/// - values       The field values (array of size n[0]*n[1]*n[2]*3) with
+///                the index of the third coordinate running fastest
+/// - mirror       The mirror symmetry flags, bit k for the axis k
+/// - mirrorSigns  The signs of the field components at the point reflected
+///                in the axis k: mirrorSigns[3*k + component]
+///                (array of size 9, required if mirror is set)
+/// - phiPeriod    The phi period of a cylindrical grid (0 if none)
+///
+
+Bool_t TMCGridMagField::WriteMap(const char *fileName, ECoordinates coordinates, const Int_t *n, const Double_t *min,
+                                 const Double_t *max, const Double_t *values, Int_t mirror,
+                                 const Double_t *mirrorSigns, Double_t phiPeriod)
+{
+   if (mirror && !mirrorSigns) {
+      ::Error("TMCGridMagField::WriteMap", "The mirror signs must be defined with the mirror symmetry.");
+      return kFALSE;
+   }
+
+   TGridHeader header;
+   std::memset(&header, 0, sizeof(TGridHeader));
+   std::memcpy(header.fMagic, gridMagic, sizeof(gridMagic));
+   header.fCoordinates = coordinates;
+   header.fMirror = mirror;
+   size_t nofValues = 3;
+   for (Int_t k = 0; k < 3; ++k) {
+      header.fN[k] = n[k];
+      header.fMin[k] = min[k];
+      header.fMax[k] = max[k];
+      for (Int_t c = 0; c < 3; ++c) {
+         header.fMirrorSign[k][c] = mirrorSigns ? mirrorSigns[3 * k + c] : 1.;
+      }
+      nofValues *= n[k];
+   }
+   header.fPhiPeriod = phiPeriod;
+
+   std::ofstream output(fileName, std::ios::binary);
+   output.write(reinterpret_cast<const char *>(&header), sizeof(TGridHeader));
+   output.write(reinterpret_cast<const char *>(values), nofValues * sizeof(Double_t));
+   if (!output.good()) {
+      ::Error("TMCGridMagField::WriteMap", "Writing the field map file %s failed.", fileName);
+      return kFALSE;
+   }
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true if the field map was loaded
+///
+
+Bool_t TMCGridMagField::IsValid() const
+{
+   return fMap != nullptr;
+}
@@ -23,6 +23,8 @@
 #include "TParticle.h"
 #include "TGeoBranchArray.h"
 #include "TGeoNavigator.h"
+#include "TGeoVolume.h"
+#include "TGeoMedium.h"
 
 #include "TVirtualMCApplication.h"
 #include "TVirtualMCStack.h"
@@ -30,6 +32,16 @@
 #include "TMCParticleStatus.h"
 
 #include "TMCManager.h"
+#include "TMCPhiloxRandom.h"
+#include "TMCRandomStreams.h"
+#include "TMCThreadContext.h"
+#include "TMCTrace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 
 /** \class TMCManager
     \ingroup vmc
@@ -41,9 +53,105 @@ stacks to each running engine. A registered user stack is kept up-to-date
 automatically seeing a consistent history.
 Track objects (aka TParticle) are still owned by the user who must forward these to
 the manager after creation. Everything else is done automatically.
+The tracks can be routed to the engines by region with declarative
+TMCRoutingRule objects, see AddRoutingRule() and ApplyRoutingRules().
+The engines call TVirtualMCApplication::Stepping() directly, without
+passing through the manager, so the rules are not applied automatically:
+the application has to call ApplyRoutingRules() in its Stepping(), in
+place of its own TransferTrack() calls:
+~~~ {.cpp}
+void MyApplication::Stepping()
+{
+   if (fMCManager->ApplyRoutingRules()) {
+      // the track continues in another engine
+      return;
+   }
+   ...
+}
+~~~
+
+In the concurrent mode, see SetConcurrentMode(), each engine runs in its own
+thread with its own TGeoNavigator and the engines process the same event
+concurrently; the tracks transferred or forwarded to an engine are pushed to
+its queue and wake up only its thread. Each engine queue has its own mutex;
+the track containers and the calls to the user stack have their own mutexes,
+which are held only for the duration of one access, so that the engines do
+not wait for each other while transporting. The current track is kept per
+engine, see TMCManagerStack. The application hooks called from the engines
+must be thread-safe and they must get the current engine with
+TVirtualMC::GetMC() or TMCThreadContext, as the connected engine pointers
+are not updated by the engine threads.
+
+In the sub-event mode, see SetSubEventMode(), the primaries of each event
+generated by the master are split across worker threads. Each worker has
+its own application, created with TVirtualMCApplication::CloneForWorker(),
+whose InitOnWorker() must request its TMCManager, create and initialize its
+engines and set its user stack, which must number the tracks with
+NextTrackId(). A worker processes one primary after the other with
+the random stream of the primary, so that the history of each primary does
+not depend on the number of workers; the track ids allocated concurrently
+by the workers are mapped to the canonical ones, ordered by the primary and
+the creation order, see GetCanonicalTrackId(). At the end of the event the
+master application merges the sub-events in
+TVirtualMCApplication::MergeSubEvent() before its FinishEvent(). The master
+stacks then hold only the tracks generated by the master, the other tracks
+are kept by the workers: the application must take them over in
+MergeSubEvent(). The track routing statistics of the workers are added to
+the ones of the master.
 */
 
+/// The state shared with the engine threads in the concurrent mode
+struct TMCManager::TConcurrentState {
+   /// The queue of an engine
+   struct TEngineQueue {
+      TMCMutex fMutex;                        ///< Protects the track ids stacked in the engine stack
+      std::condition_variable_any fCondition; ///< Notifies the engine thread about new tracks
+   };
+
+   std::vector<std::unique_ptr<TEngineQueue>> fQueues; ///< The engine queues
+   TMCMutex fTracksMutex;                              ///< Protects the track containers and the geometry states
+   TMCMutex fRoutingMutex;                             ///< Protects the track routing buffers and statistics
+   TMCRecursiveMutex fUserStackMutex;                  ///< Serializes the calls to the user stack
+   TMCMutex fMutex;                                    ///< Protects the number of busy engines
+   std::condition_variable_any fCondition;             ///< Notifies the master about the idle engines
+   std::vector<std::thread> fThreads;                  ///< The engine threads
+   std::atomic<Int_t> fEventId{-1};                    ///< The current event id
+   Int_t fNofBusyEngines = 0;                          ///< The number of engines processing tracks
+   std::atomic<Bool_t> fIsEventActive{kFALSE};         ///< Whether the engines process the current event
+   std::atomic<Bool_t> fStop{kFALSE};                  ///< Whether the engine threads should stop
+};
+
+/// The state shared with the workers in the sub-event mode
+struct TMCManager::TSubEventState {
+   /// A primary track to be processed
+   struct TPrimary {
+      Int_t fTrackId;        ///< The track id
+      Int_t fEngineId;       ///< The engine the track was forwarded to
+      TParticle *fParticle;  ///< The particle (owned by the master user stack)
+   };
+   /// A worker
+   struct TWorker {
+      TVirtualMCApplication *fApplication = nullptr; ///< The worker application
+      TMCManager *fManager = nullptr;                ///< The worker manager
+      std::thread fThread;                           ///< The worker thread
+   };
+
+   std::vector<TWorker> fWorkers;          ///< The workers
+   std::vector<TPrimary> fPrimaries;       ///< The primaries of the current event ordered by the track id
+   std::atomic<Int_t> fNextPrimary{0};     ///< The index of the next primary to be processed
+   std::atomic<Int_t> fNextTrackId{0};     ///< The next free track id
+   std::mutex fMutex;                      ///< Protects the state below
+   std::condition_variable fCondition;     ///< Notifies the workers and the master about the changes
+   ULong64_t fEventNumber = 0;             ///< The number of the events started
+   Int_t fEventId = -1;                    ///< The current event id
+   Int_t fNofPending = 0;                  ///< The number of the workers which have not finished the current task
+   Bool_t fStop = kFALSE;                  ///< Whether the workers should stop
+   std::mutex fMergeMutex;                 ///< Serializes the end-of-run merging of the workers
+};
+
 TMCThreadLocal TMCManager *TMCManager::fgInstance = nullptr;
+TMCThreadLocal TMCManager *TMCManager::fgSubEventMaster = nullptr;
+TMCThreadLocal Bool_t TMCManager::fgIsInTransport = kFALSE;
 
 ////////////////////////////////////////////////////////////////////////////////
 ///
@@ -51,13 +159,26 @@ TMCThreadLocal TMCManager *TMCManager::fgInstance = nullptr;
 ///
 
 TMCManager::TMCManager()
-   : fApplication(nullptr), fCurrentEngine(nullptr), fTotalNPrimaries(0), fTotalNTracks(0), fUserStack(nullptr),
-     fBranchArrayContainer(), fIsInitialized(kFALSE), fIsInitializedUser(kFALSE), fGeometryConstructed(kFALSE)
+   : fApplication(nullptr), fCurrentEngine(nullptr), fTotalNPrimaries(0), fTotalNTracks(0), fNextTrackId(0),
+     fUserStack(nullptr),
+     fBranchArrayContainer(), fIsInitialized(kFALSE), fIsInitializedUser(kFALSE), fGeometryConstructed(kFALSE),
+     fRoutingRules(), fRoutingTableOffsets(), fRoutingTableRules(), fIsRoutingTableBuilt(kFALSE),
+     fTrackRoutingFunction(), fTrackRoutingRules(), fTrackRoutingMasks(), fEngineVolNumbers(), fRoutingNavigator(),
+     fIsTrackRoutingMaskBuilt(kFALSE), fRoutingPdg(), fRoutingEkin(), fRoutingVolNumbers(), fRoutingEngineIds(),
+     fNofRoutedTracks(), fRoutedEkin(), fRunNofRoutedTracks(), fRunRoutedEkin(),
+     fIsConcurrent(kFALSE), fConcurrentState(), fNofSubEventWorkers(0), fSubEventState(), fCanonicalTrackIds(),
+     fSubEventMaster(fgSubEventMaster), fImportedTrackId(-1), fCurrentPrimaryId(-1), fPrimarySequence(0),
+     fTrackKeys(), fTrackIndices()
 {
    if (fgInstance) {
       ::Fatal("TMCManager::TMCManager", "Attempt to create two instances of singleton.");
    }
    fgInstance = this;
+   TMCThreadContext::Instance().fManager = this;
+   // The geometry is shared with the master
+   if (fSubEventMaster) {
+      fGeometryConstructed = kTRUE;
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,6 +192,7 @@ TMCManager::~TMCManager()
       delete mc;
    }
    fgInstance = nullptr;
+   TMCThreadContext::Instance().fManager = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -198,7 +320,7 @@ Int_t TMCManager::GetEngineId(const char *engineName) const
 
 TVirtualMC *TMCManager::GetCurrentEngine() const
 {
-   return fCurrentEngine;
+   return CurrentEngine();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -246,18 +368,27 @@ void TMCManager::ForwardTrack(Int_t toBeDone, Int_t trackId, Int_t parentId, TPa
    if (engineId < 0 || engineId >= static_cast<Int_t>(fEngines.size())) {
       ::Fatal("TMCManager::ForwardTrack", "Engine ID %i out of bounds. Have %zu engines.", engineId, fEngines.size());
    }
-   if (trackId >= static_cast<Int_t>(fParticles.size())) {
-      fParticles.resize(trackId + 1, nullptr);
-      fParticlesStatus.resize(trackId + 1);
-   }
-   fParticles[trackId] = particle;
-   fParticlesStatus[trackId].reset(new TMCParticleStatus());
-   fParticlesStatus[trackId]->fId = trackId;
-   fParticlesStatus[trackId]->fParentId = parentId;
-   fParticlesStatus[trackId]->InitFromParticle(particle);
-   fTotalNTracks++;
-   if (particle->IsPrimary()) {
-      fTotalNPrimaries++;
+   {
+      auto lock = LockTracks();
+      // A sub-event worker stores its tracks densely, in the order of their arrival
+      Int_t index = trackId;
+      if (fSubEventMaster) {
+         index = fTrackIndices.emplace(trackId, fTrackIndices.size()).first->second;
+      }
+      if (index >= static_cast<Int_t>(fParticles.size())) {
+         fParticles.resize(index + 1, nullptr);
+         fParticlesStatus.resize(index + 1);
+      }
+      fParticles[index] = particle;
+      fParticlesStatus[index].reset(new TMCParticleStatus());
+      fParticlesStatus[index]->fId = trackId;
+      fParticlesStatus[index]->fParentId = parentId;
+      fParticlesStatus[index]->InitFromParticle(particle);
+      fNextTrackId = std::max(fNextTrackId, trackId + 1);
+      fTotalNTracks++;
+      if (particle->IsPrimary()) {
+         fTotalNPrimaries++;
+      }
    }
 
    if (toBeDone > 0) {
@@ -266,6 +397,7 @@ void TMCManager::ForwardTrack(Int_t toBeDone, Int_t trackId, Int_t parentId, TPa
       } else {
          fStacks[engineId]->PushSecondaryTrackId(trackId);
       }
+      NotifyEngine(engineId);
    }
 }
 
@@ -279,7 +411,47 @@ void TMCManager::ForwardTrack(Int_t toBeDone, Int_t trackId, Int_t parentId, TPa
 
 void TMCManager::ForwardTrack(Int_t toBeDone, Int_t trackId, Int_t parentId, TParticle *particle)
 {
-   ForwardTrack(toBeDone, trackId, parentId, particle, fCurrentEngine->GetId());
+   if (fImportedTrackId < 0 && (fTrackRoutingFunction || !fTrackRoutingRules.empty())) {
+      ForwardTracks(1, &toBeDone, &trackId, &parentId, &particle);
+      return;
+   }
+   ForwardTrack(toBeDone, trackId, parentId, particle, CurrentEngine()->GetId());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// User interface to forward a batch of particles, eg. all secondaries of
+/// a step. The engines are chosen by the track routing function and rules
+/// evaluated over the whole batch; without routing the current engine is
+/// assumed.
+/// It is assumed that the TParticles are owned by the user. They will not be
+/// modified by the TMCManager.
+///
+
+void TMCManager::ForwardTracks(Int_t nofTracks, const Int_t *toBeDone, const Int_t *trackIds, const Int_t *parentIds,
+                               TParticle **particles)
+{
+   if (nofTracks <= 0) {
+      return;
+   }
+   // The tracks imported by a sub-event worker were routed and counted by the
+   // master, they go to its engine, which is the current one
+   if (fImportedTrackId >= 0 || (!fTrackRoutingFunction && fTrackRoutingRules.empty())) {
+      for (Int_t i = 0; i < nofTracks; ++i) {
+         ForwardTrack(toBeDone[i], trackIds[i], parentIds[i], particles[i], CurrentEngine()->GetId());
+      }
+      return;
+   }
+
+   // The routing buffers are shared by the engines running concurrently
+   auto lock = LockRouting();
+   RouteTracks(nofTracks, particles);
+   for (Int_t i = 0; i < nofTracks; ++i) {
+      Int_t engineId = fRoutingEngineIds[i];
+      ForwardTrack(toBeDone[i], trackIds[i], parentIds[i], particles[i], engineId);
+      fNofRoutedTracks[engineId]++;
+      fRoutedEkin[engineId] += fRoutingEkin[i];
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -304,34 +476,46 @@ void TMCManager::TransferTrack(Int_t engineTargetId)
 
 void TMCManager::TransferTrack(TVirtualMC *mc)
 {
+   TVirtualMC *currentEngine = CurrentEngine();
    // Do nothing if target and current engines are the same
-   if (mc == fCurrentEngine) {
+   if (mc == currentEngine) {
       return;
    }
 
    // Get information on current track and extract status from transporting engine
-   Int_t trackId = fStacks[fCurrentEngine->GetId()]->GetCurrentTrackNumber();
-
-   fCurrentEngine->TrackPosition(fParticlesStatus[trackId]->fPosition);
-   fCurrentEngine->TrackMomentum(fParticlesStatus[trackId]->fMomentum);
-   fCurrentEngine->TrackPolarization(fParticlesStatus[trackId]->fPolarization);
-   fParticlesStatus[trackId]->fStepNumber = fCurrentEngine->StepNumber();
-   fParticlesStatus[trackId]->fTrackLength = fCurrentEngine->TrackLength();
-   fParticlesStatus[trackId]->fWeight = fCurrentEngine->TrackWeight();
-
-   // Store TGeoNavidator's fIsOutside state
-   fParticlesStatus[trackId]->fIsOutside = gGeoManager->IsOutside();
-
-   TGeoBranchArray *geoState = fBranchArrayContainer.GetNewGeoState(fParticlesStatus[trackId]->fGeoStateIndex);
-   geoState->InitFromNavigator(gGeoManager->GetCurrentNavigator());
+   Int_t trackId = fStacks[currentEngine->GetId()]->GetCurrentTrackNumber();
+   // The navigator of this thread, which is the one of the current engine
+   // in the concurrent mode
+   TGeoNavigator *navigator = gGeoManager->GetCurrentNavigator();
+
+   Bool_t isPrimary = kFALSE;
+   {
+      auto lock = LockTracks();
+      Int_t index = GetTrackIndex(trackId);
+      TMCParticleStatus *status = fParticlesStatus[index].get();
+      currentEngine->TrackPosition(status->fPosition);
+      currentEngine->TrackMomentum(status->fMomentum);
+      currentEngine->TrackPolarization(status->fPolarization);
+      status->fStepNumber = currentEngine->StepNumber();
+      status->fTrackLength = currentEngine->TrackLength();
+      status->fWeight = currentEngine->TrackWeight();
+
+      // Store TGeoNavidator's fIsOutside state
+      status->fIsOutside = navigator->IsOutside();
+
+      TGeoBranchArray *geoState = fBranchArrayContainer.GetNewGeoState(status->fGeoStateIndex);
+      geoState->InitFromNavigator(navigator);
+      isPrimary = fParticles[index]->IsPrimary();
+   }
 
    // Push only the particle ID
-   if (fParticles[trackId]->IsPrimary()) {
+   if (isPrimary) {
       fStacks[mc->GetId()]->PushPrimaryTrackId(trackId);
    } else {
       fStacks[mc->GetId()]->PushSecondaryTrackId(trackId);
    }
-   fCurrentEngine->InterruptTrack();
+   NotifyEngine(mc->GetId());
+   currentEngine->InterruptTrack();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -341,17 +525,22 @@ void TMCManager::TransferTrack(TVirtualMC *mc)
 
 Bool_t TMCManager::RestoreGeometryState(Int_t trackId, Bool_t checkTrackIdRange)
 {
-   if (checkTrackIdRange && (trackId < 0 || trackId >= static_cast<Int_t>(fParticles.size()) || !fParticles[trackId])) {
+   auto lock = LockTracks();
+   Int_t index = GetTrackIndex(trackId);
+   if (checkTrackIdRange && (index < 0 || index >= static_cast<Int_t>(fParticles.size()) || !fParticles[index])) {
       return kFALSE;
    }
-   UInt_t &geoStateId = fParticlesStatus[trackId]->fGeoStateIndex;
+   UInt_t &geoStateId = fParticlesStatus[index]->fGeoStateIndex;
    if (geoStateId == 0) {
       return kFALSE;
    }
+   // The navigator of this thread, which is the one of the current engine
+   // in the concurrent mode
+   TGeoNavigator *navigator = gGeoManager->GetCurrentNavigator();
    const TGeoBranchArray *branchArray = fBranchArrayContainer.GetGeoState(geoStateId);
-   branchArray->UpdateNavigator(gGeoManager->GetCurrentNavigator());
+   branchArray->UpdateNavigator(navigator);
    fBranchArrayContainer.FreeGeoState(geoStateId);
-   gGeoManager->SetOutside(fParticlesStatus[trackId]->fIsOutside);
+   navigator->SetOutside(fParticlesStatus[index]->fIsOutside);
    geoStateId = 0;
    return kTRUE;
 }
@@ -363,7 +552,186 @@ Bool_t TMCManager::RestoreGeometryState(Int_t trackId, Bool_t checkTrackIdRange)
 
 Bool_t TMCManager::RestoreGeometryState()
 {
-   return RestoreGeometryState(fStacks[fCurrentEngine->GetId()]->GetCurrentTrackNumber(), kFALSE);
+   return RestoreGeometryState(fStacks[CurrentEngine()->GetId()]->GetCurrentTrackNumber(), kFALSE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add a rule routing the tracks in a region (a set of volumes and/or media)
+/// to an engine, optionally only for some particles or a kinetic energy window.
+/// The rules are evaluated in the order in which they were added; the first
+/// rule matching the current volume, particle and energy decides.
+///
+
+void TMCManager::AddRoutingRule(const TMCRoutingRule &rule)
+{
+   if (rule.fVolumes.empty() && rule.fMedia.empty()) {
+      ::Warning("TMCManager::AddRoutingRule", "The rule for engine %i has no volume and no medium; ignored.",
+                rule.fEngineId);
+      return;
+   }
+   if (rule.fEkinMin >= rule.fEkinMax) {
+      ::Fatal("TMCManager::AddRoutingRule", "Empty energy window [%g, %g) for engine %i.", rule.fEkinMin,
+              rule.fEkinMax, rule.fEngineId);
+   }
+   fRoutingRules.push_back(rule);
+   fIsRoutingTableBuilt = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Remove all routing rules
+///
+
+void TMCManager::ClearRoutingRules()
+{
+   fRoutingRules.clear();
+   fRoutingTableOffsets.clear();
+   fRoutingTableRules.clear();
+   fIsRoutingTableBuilt = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Transfer the current track if it enters (or starts in) a region routed
+/// to another engine; to be called from TVirtualMCApplication::Stepping().
+/// Return true if the track was transferred.
+///
+/// This function must be called by the application at each step: the
+/// engines invoke the application hooks directly and the manager has no
+/// per-step hook of its own.
+///
+/// The rules are only evaluated at the boundary crossings and for the new
+/// tracks; the lookup of the current volume in the dense per-engine table
+/// costs one array access, and the kinetic energy is only computed for
+/// the rules with an energy window.
+///
+
+Bool_t TMCManager::ApplyRoutingRules()
+{
+   if (fRoutingRules.empty()) {
+      return kFALSE;
+   }
+   if (!fIsRoutingTableBuilt) {
+      BuildRoutingTables();
+   }
+   TVirtualMC *currentEngine = CurrentEngine();
+   if (!currentEngine->IsTrackEntering() && !currentEngine->IsNewTrack()) {
+      return kFALSE;
+   }
+
+   Int_t engineId = currentEngine->GetId();
+   const std::vector<UInt_t> &offsets = fRoutingTableOffsets[engineId];
+   Int_t copyNo;
+   Int_t volId = currentEngine->CurrentVolID(copyNo);
+   if (volId < 0 || volId + 1 >= static_cast<Int_t>(offsets.size()) || offsets[volId] == offsets[volId + 1]) {
+      return kFALSE;
+   }
+
+   const std::vector<Int_t> &ruleIds = fRoutingTableRules[engineId];
+   Int_t pdg = currentEngine->TrackPid();
+   Double_t ekin = -1.;
+   for (UInt_t i = offsets[volId]; i < offsets[volId + 1]; ++i) {
+      const TMCRoutingRule &rule = fRoutingRules[ruleIds[i]];
+      if (!rule.IsPdgSelected(pdg)) {
+         continue;
+      }
+      if (rule.HasEnergyRange()) {
+         if (ekin < 0.) {
+            Double_t px, py, pz, etot;
+            currentEngine->TrackMomentum(px, py, pz, etot);
+            ekin = etot - currentEngine->TrackMass();
+         }
+         if (ekin < rule.fEkinMin || ekin >= rule.fEkinMax) {
+            continue;
+         }
+      }
+      // The first matching rule decides
+      if (rule.fEngineId == engineId) {
+         return kFALSE;
+      }
+      TransferTrack(rule.fEngineId);
+      return kTRUE;
+   }
+   return kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the function routing the new tracks forwarded without an engine id.
+/// The function is called with the whole batch of ForwardTracks() and fills
+/// the engine ids; it is evaluated before the track routing rules.
+///
+
+void TMCManager::SetTrackRoutingFunction(TTrackRoutingFunction function)
+{
+   fTrackRoutingFunction = function;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add a rule routing the new tracks forwarded without an engine id by their
+/// PDG code, kinetic energy and production volume; a rule without volumes and
+/// media applies everywhere, eg.
+/// \code
+/// // low-energy electromagnetic particles to the fast engine
+/// manager->AddTrackRoutingRule(TMCRoutingRule(fastId).AddPdg(22).AddPdg(11).AddPdg(-11).SetEnergyRange(0., 0.1));
+/// \endcode
+///
+
+void TMCManager::AddTrackRoutingRule(const TMCRoutingRule &rule)
+{
+   if (rule.fEkinMin >= rule.fEkinMax) {
+      ::Fatal("TMCManager::AddTrackRoutingRule", "Empty energy window [%g, %g) for engine %i.", rule.fEkinMin,
+              rule.fEkinMax, rule.fEngineId);
+   }
+   fTrackRoutingRules.push_back(rule);
+   fIsTrackRoutingMaskBuilt = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Remove the track routing function and rules
+///
+
+void TMCManager::ClearTrackRouting()
+{
+   fTrackRoutingFunction = nullptr;
+   fTrackRoutingRules.clear();
+   fTrackRoutingMasks.clear();
+   fIsTrackRoutingMaskBuilt = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Get the numbers of the new tracks routed to each engine and the sums of
+/// their kinetic energies (GeV) in the current event, or in the current run
+/// if isRun is true
+///
+
+void TMCManager::GetTrackRoutingStatistics(std::vector<Long64_t> &nofTracks, std::vector<Double_t> &ekin,
+                                           Bool_t isRun) const
+{
+   nofTracks = isRun ? fRunNofRoutedTracks : fNofRoutedTracks;
+   ekin = isRun ? fRunRoutedEkin : fRoutedEkin;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the track routing statistics of the current event, or of the
+/// current run if isRun is true. The run statistics are printed by Run()
+/// at its end when the tracks are routed; the event statistics are only
+/// printed on request, eg. from TVirtualMCApplication::FinishEvent().
+///
+
+void TMCManager::PrintTrackRoutingStatistics(Bool_t isRun) const
+{
+   const std::vector<Long64_t> &nofTracks = isRun ? fRunNofRoutedTracks : fNofRoutedTracks;
+   const std::vector<Double_t> &ekin = isRun ? fRunRoutedEkin : fRoutedEkin;
+   for (UInt_t i = 0; i < nofTracks.size(); i++) {
+      ::Info("TMCManager::PrintTrackRoutingStatistics", "Engine %s: %lld tracks routed, %g GeV in the %s",
+             fEngines[i]->GetName(), nofTracks[i], ekin[i], isRun ? "run" : "event");
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -394,12 +762,24 @@ void TMCManager::Init()
       fStacks[currentEngineId]->SetUserStack(fUserStack);
       // Connect the engine's stack to the centrally managed vectors
       fStacks[currentEngineId]->ConnectTrackContainers(&fParticles, &fParticlesStatus, &fBranchArrayContainer,
-                                                       &fTotalNPrimaries, &fTotalNTracks);
+                                                       &fTotalNPrimaries, &fTotalNTracks,
+                                                       fSubEventMaster ? &fTrackIndices : nullptr);
    }
 
    // Initialize the fBranchArrayContainer to manage and cache TGeoBranchArrays
    fBranchArrayContainer.InitializeFromGeoManager(gGeoManager);
 
+   if (!fRoutingRules.empty()) {
+      BuildRoutingTables();
+   }
+   if (fTrackRoutingFunction || !fTrackRoutingRules.empty()) {
+      BuildTrackRoutingMasks();
+   }
+   fNofRoutedTracks.assign(fEngines.size(), 0);
+   fRoutedEkin.assign(fEngines.size(), 0.);
+   fRunNofRoutedTracks.assign(fEngines.size(), 0);
+   fRunRoutedEkin.assign(fEngines.size(), 0.);
+
    fIsInitialized = kTRUE;
 
    // Send warning if only one engine ==> overhead
@@ -428,16 +808,56 @@ void TMCManager::Run(Int_t nEvents)
       ::Fatal("TMCManager::Run", "Need at least one event to process but %i events specified.", nEvents);
    }
 
+   TMC_TRACE_SCOPE_ARG("Run", "events", nEvents);
+
+   fRunNofRoutedTracks.assign(fEngines.size(), 0);
+   fRunRoutedEkin.assign(fEngines.size(), 0.);
+
+   if (fIsConcurrent) {
+      StartEngineThreads();
+   } else if (fNofSubEventWorkers > 0) {
+      StartSubEventWorkers();
+   }
+
    // Run 1 event nEvents times
    for (Int_t i = 0; i < nEvents; i++) {
+      TMC_TRACE_SCOPE_ARG("Event", "event", i);
       ::Info("TMCManager::Run", "Start event %i", i + 1);
       PrepareNewEvent();
-      fApplication->BeginEvent();
-      // Loop as long as there are tracks in any engine stack
-      while (GetNextEngine()) {
-         fCurrentEngine->ProcessEvent(i, kTRUE);
+      {
+         TMC_TRACE_SCOPE("BeginEvent");
+         fApplication->BeginEvent();
+      }
+      if (fConcurrentState) {
+         ProcessEventConcurrently(i);
+      } else if (fSubEventState) {
+         ProcessEventInSubEvents(i);
+      } else {
+         // Loop as long as there are tracks in any engine stack
+         while (GetNextEngine()) {
+            TMC_TRACE_SCOPE_ARG("ProcessEvent", "engine", fCurrentEngine->GetId());
+            fgIsInTransport = kTRUE;
+            fCurrentEngine->ProcessEvent(i, kTRUE);
+            fgIsInTransport = kFALSE;
+         }
+      }
+      {
+         TMC_TRACE_SCOPE("FinishEvent");
+         fApplication->FinishEvent();
       }
-      fApplication->FinishEvent();
+      for (UInt_t j = 0; j < fEngines.size(); ++j) {
+         fRunNofRoutedTracks[j] += fNofRoutedTracks[j];
+         fRunRoutedEkin[j] += fRoutedEkin[j];
+      }
+   }
+   if (fTrackRoutingFunction || !fTrackRoutingRules.empty()) {
+      PrintTrackRoutingStatistics(kTRUE);
+   }
+   if (fConcurrentState) {
+      StopEngineThreads();
+   }
+   if (fSubEventState) {
+      StopSubEventWorkers();
    }
    TerminateRun();
 }
@@ -454,13 +874,24 @@ void TMCManager::PrepareNewEvent()
    for (auto &stack : fStacks) {
       stack->ResetInternals();
    }
-   for (UInt_t i = 0; i < fParticles.size(); i++) {
-      fParticlesStatus.clear();
-      fParticlesStatus.resize(fParticles.size());
-      fParticles[i] = nullptr;
+   // The containers keep their size, the tracks of the previous event are removed
+   for (auto &particle : fParticles) {
+      particle = nullptr;
+   }
+   fParticlesStatus.clear();
+   fParticlesStatus.resize(fParticles.size());
+   fTrackIndices.clear();
+   fNextTrackId = 0;
+   fNofRoutedTracks.assign(fEngines.size(), 0);
+   fRoutedEkin.assign(fEngines.size(), 0.);
+
+   // The primaries of a sub-event worker are distributed by the master
+   if (fSubEventMaster) {
+      return;
    }
 
    // GeneratePrimaries centrally
+   TMC_TRACE_SCOPE("GeneratePrimaries");
    fApplication->GeneratePrimaries();
 }
 
@@ -474,6 +905,9 @@ Bool_t TMCManager::GetNextEngine()
    // Select next engine based on finite number of particles on the stack
    for (UInt_t i = 0; i < fStacks.size(); i++) {
       if (fStacks[i]->GetStackedNtrack() > 0) {
+         if (fEngines[i] != fCurrentEngine) {
+            TMC_TRACE_INSTANT("EngineSwitch", "engine", i);
+         }
          UpdateEnginePointers(fEngines[i]);
          return kTRUE;
       }
@@ -495,6 +929,856 @@ void TMCManager::UpdateEnginePointers(TVirtualMC *mc)
    }
    // Make sure TVirtualMC::GetMC() returns the current engine.
    TVirtualMC::fgMC = mc;
+   TMCThreadContext::SetMC(mc);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Switch on/off the concurrent mode, where each engine runs in its own
+/// thread and the engines process the same event concurrently; to be called
+/// before Run(). The engines must run sequentially (IsMT() false): the
+/// manager gives each of them a single thread.
+///
+
+void TMCManager::SetConcurrentMode(Bool_t isConcurrent)
+{
+   if (fConcurrentState) {
+      ::Fatal("TMCManager::SetConcurrentMode", "The mode cannot be changed during a run.");
+   }
+   if (isConcurrent && fNofSubEventWorkers > 0) {
+      ::Fatal("TMCManager::SetConcurrentMode", "The concurrent mode cannot be combined with the sub-event mode.");
+   }
+   fIsConcurrent = isConcurrent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true if the concurrent mode is switched on
+///
+
+Bool_t TMCManager::IsConcurrentMode() const
+{
+   return fIsConcurrent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the engine of this thread in the concurrent mode, the current
+/// engine otherwise
+///
+
+TVirtualMC *TMCManager::CurrentEngine() const
+{
+   return fConcurrentState ? TVirtualMC::GetMC() : fCurrentEngine;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex of the track containers in the concurrent mode; the
+/// returned lock does not own any mutex in the sequential mode
+///
+
+std::unique_lock<TMCMutex> TMCManager::LockTracks() const
+{
+   return fConcurrentState ? std::unique_lock<TMCMutex>(fConcurrentState->fTracksMutex) : std::unique_lock<TMCMutex>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex of the track routing in the concurrent mode; the
+/// returned lock does not own any mutex in the sequential mode
+///
+
+std::unique_lock<TMCMutex> TMCManager::LockRouting() const
+{
+   return fConcurrentState ? std::unique_lock<TMCMutex>(fConcurrentState->fRoutingMutex)
+                           : std::unique_lock<TMCMutex>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Notify the thread of the given engine about new tracks in its stack; the
+/// track ids are pushed under the queue mutex, so no wake-up can be lost
+///
+
+void TMCManager::NotifyEngine(Int_t engineId)
+{
+   if (fConcurrentState) {
+      fConcurrentState->fQueues[engineId]->fCondition.notify_one();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Wake up all engine threads after a change of the concurrent state; each
+/// queue mutex is taken so that a thread cannot miss the change between
+/// checking its condition and waiting
+///
+
+void TMCManager::WakeEngines()
+{
+   for (auto &queue : fConcurrentState->fQueues) {
+      { std::lock_guard<TMCMutex> lock(queue->fMutex); }
+      queue->fCondition.notify_one();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Start the engine threads of the concurrent mode; each stack gets its queue
+/// and the geometry is prepared for one navigator per engine thread
+///
+
+void TMCManager::StartEngineThreads()
+{
+   for (auto &mc : fEngines) {
+      if (mc->IsMT()) {
+         ::Fatal("TMCManager::StartEngineThreads",
+                 "Engine %s runs in the multi-threaded mode, which is not supported in the concurrent mode.",
+                 mc->GetName());
+      }
+   }
+
+   fConcurrentState.reset(new TConcurrentState());
+   TConcurrentState &state = *fConcurrentState;
+   for (auto &stack : fStacks) {
+      state.fQueues.emplace_back(new TConcurrentState::TEngineQueue());
+      stack->SetMutexes(&state.fQueues.back()->fMutex, &state.fTracksMutex, &state.fUserStackMutex);
+   }
+
+   // The routing tables are not built lazily by the engine threads
+   if (!fRoutingRules.empty() && !fIsRoutingTableBuilt) {
+      BuildRoutingTables();
+   }
+   if ((fTrackRoutingFunction || !fTrackRoutingRules.empty()) && !fIsTrackRoutingMaskBuilt) {
+      BuildTrackRoutingMasks();
+   }
+
+   // One navigator per engine thread in addition to the master one
+   Int_t nofThreads = fEngines.size() + 1;
+   if (gGeoManager->GetMaxThreads() < nofThreads) {
+      gGeoManager->SetMaxThreads(nofThreads);
+   }
+
+   for (UInt_t i = 0; i < fEngines.size(); i++) {
+      fConcurrentState->fThreads.emplace_back(&TMCManager::EngineThreadLoop, this, i);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Stop the engine threads of the concurrent mode
+///
+
+void TMCManager::StopEngineThreads()
+{
+   fConcurrentState->fStop = kTRUE;
+   WakeEngines();
+   for (auto &thread : fConcurrentState->fThreads) {
+      thread.join();
+   }
+   for (auto &stack : fStacks) {
+      stack->SetMutexes(nullptr, nullptr, nullptr);
+   }
+   fConcurrentState.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The loop of the thread of the engine with the given id: the engine
+/// waits on its own queue and processes the current event whenever tracks
+/// are handed over to it
+///
+
+void TMCManager::EngineThreadLoop(Int_t engineId)
+{
+   TVirtualMC *mc = fEngines[engineId];
+
+   // The thread-local instances seen by the engine and the user code
+   fgInstance = this;
+   TVirtualMCApplication::fgInstance = fApplication;
+   TVirtualMC::fgMC = mc;
+   TMCThreadContext &context = TMCThreadContext::Instance();
+   context.fApplication = fApplication;
+   context.fManager = this;
+   TMCThreadContext::SetMC(mc);
+
+   // Each engine thread navigates with its own navigator
+   if (!gGeoManager->GetCurrentNavigator()) {
+      gGeoManager->AddNavigator();
+   }
+
+   TConcurrentState &state = *fConcurrentState;
+   TConcurrentState::TEngineQueue &queue = *state.fQueues[engineId];
+   TMCManagerStack *stack = fStacks[engineId].get();
+   while (kTRUE) {
+      {
+         std::unique_lock<TMCMutex> queueLock(queue.fMutex);
+         queue.fCondition.wait(queueLock, [&state, stack] {
+            return state.fStop || (state.fIsEventActive && stack->HasQueuedTracks());
+         });
+      }
+      if (state.fStop) {
+         break;
+      }
+      // Only this engine pops from its queue, so the tracks are still there
+      // when the master sees the engine busy
+      {
+         std::lock_guard<TMCMutex> lock(state.fMutex);
+         ++state.fNofBusyEngines;
+      }
+      {
+         TMC_TRACE_SCOPE_ARG("ProcessEvent", "engine", engineId);
+         fgIsInTransport = kTRUE;
+         mc->ProcessEvent(state.fEventId, kTRUE);
+         fgIsInTransport = kFALSE;
+      }
+      {
+         std::lock_guard<TMCMutex> lock(state.fMutex);
+         --state.fNofBusyEngines;
+      }
+      state.fCondition.notify_all();
+   }
+
+   fgInstance = nullptr;
+   TVirtualMCApplication::fgInstance = nullptr;
+   TVirtualMC::fgMC = nullptr;
+   context.fApplication = nullptr;
+   context.fManager = nullptr;
+   TMCThreadContext::SetMC(nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Process the current event with all engines concurrently; the event is
+/// finished when no engine is busy and all stacks are empty
+///
+
+void TMCManager::ProcessEventConcurrently(Int_t eventId)
+{
+   TMC_TRACE_SCOPE("ProcessEventConcurrently");
+   TConcurrentState &state = *fConcurrentState;
+   state.fEventId = eventId;
+   state.fIsEventActive = kTRUE;
+   WakeEngines();
+
+   std::unique_lock<TMCMutex> lock(state.fMutex);
+   state.fCondition.wait(lock, [this, &state] {
+      if (state.fNofBusyEngines > 0) {
+         return kFALSE;
+      }
+      for (auto &stack : fStacks) {
+         if (stack->GetStackedNtrack() > 0) {
+            return kFALSE;
+         }
+      }
+      return kTRUE;
+   });
+   state.fIsEventActive = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Switch on the sub-event mode where the primaries of each event are split
+/// across nofWorkers worker threads (0 = switched off); to be called
+/// before Run(). The routing rules, track routing rules and function of this
+/// manager are copied to the worker managers after InitOnWorker(); the
+/// function must then be safe to call from several threads.
+///
+
+void TMCManager::SetSubEventMode(Int_t nofWorkers)
+{
+   if (fSubEventState) {
+      ::Fatal("TMCManager::SetSubEventMode", "The mode cannot be changed during a run.");
+   }
+   if (fSubEventMaster) {
+      ::Fatal("TMCManager::SetSubEventMode", "The sub-event mode cannot be set on a worker.");
+   }
+   if (nofWorkers < 0) {
+      ::Fatal("TMCManager::SetSubEventMode", "Negative number of workers %i.", nofWorkers);
+   }
+   if (nofWorkers > 0 && fIsConcurrent) {
+      ::Fatal("TMCManager::SetSubEventMode", "The sub-event mode cannot be combined with the concurrent mode.");
+   }
+   fNofSubEventWorkers = nofWorkers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of the sub-event workers (0 if the mode is off)
+///
+
+Int_t TMCManager::GetNofSubEventWorkers() const
+{
+   return fNofSubEventWorkers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the id for a new track. On a sub-event worker the ids are allocated
+/// atomically from the range shared by all workers and they are recorded for
+/// the canonical numbering; otherwise the next free index is returned.
+///
+
+Int_t TMCManager::NextTrackId()
+{
+   if (!fSubEventMaster) {
+      return fNextTrackId;
+   }
+   if (fImportedTrackId >= 0) {
+      return fImportedTrackId;
+   }
+
+   Int_t trackId = fSubEventMaster->fSubEventState->fNextTrackId++;
+   fTrackKeys.push_back(trackId);
+   fTrackKeys.push_back(fCurrentPrimaryId);
+   fTrackKeys.push_back(fPrimarySequence++);
+   return trackId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the canonical id of the given track, which does not depend on the
+/// number of the sub-event workers: the generated tracks keep their ids, the
+/// tracks created by the workers are numbered in the order of their primary
+/// and of their creation. The map is valid from MergeSubEvent() until
+/// the next event; the track id is returned if the mode is off.
+///
+
+Int_t TMCManager::GetCanonicalTrackId(Int_t trackId) const
+{
+   if (fSubEventMaster) {
+      return fSubEventMaster->GetCanonicalTrackId(trackId);
+   }
+   if (trackId < 0 || trackId >= static_cast<Int_t>(fCanonicalTrackIds.size())) {
+      return trackId;
+   }
+   return fCanonicalTrackIds[trackId];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true if this thread is a sub-event worker
+///
+
+Bool_t TMCManager::IsSubEventWorker()
+{
+   return fgSubEventMaster != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Start the sub-event worker threads and wait for their initialization
+///
+
+void TMCManager::StartSubEventWorkers()
+{
+   fSubEventState.reset(new TSubEventState());
+   fSubEventState->fWorkers.resize(fNofSubEventWorkers);
+   fSubEventState->fNofPending = fNofSubEventWorkers;
+
+   // One navigator per worker thread in addition to the master one
+   Int_t nofThreads = fNofSubEventWorkers + 1;
+   if (gGeoManager->GetMaxThreads() < nofThreads) {
+      gGeoManager->SetMaxThreads(nofThreads);
+   }
+
+   for (Int_t i = 0; i < fNofSubEventWorkers; i++) {
+      fSubEventState->fWorkers[i].fThread = std::thread(&TMCManager::SubEventWorkerLoop, this, i);
+   }
+
+   std::unique_lock<std::mutex> lock(fSubEventState->fMutex);
+   fSubEventState->fCondition.wait(lock, [this] { return fSubEventState->fNofPending == 0; });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Stop the sub-event worker threads; the workers finish their run and
+/// they are merged to the master application
+///
+
+void TMCManager::StopSubEventWorkers()
+{
+   {
+      std::unique_lock<std::mutex> lock(fSubEventState->fMutex);
+      fSubEventState->fStop = kTRUE;
+      fSubEventState->fCondition.notify_all();
+   }
+   for (auto &worker : fSubEventState->fWorkers) {
+      worker.fThread.join();
+   }
+   fSubEventState.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The loop of the sub-event worker thread with the given id: the worker
+/// application is cloned and initialized, then the worker processes its
+/// share of the primaries of each event
+///
+
+void TMCManager::SubEventWorkerLoop(Int_t workerId)
+{
+   TSubEventState &state = *fSubEventState;
+   fgSubEventMaster = this;
+
+   // Each worker thread navigates with its own navigator
+   if (!gGeoManager->GetCurrentNavigator()) {
+      gGeoManager->AddNavigator();
+   }
+
+   TVirtualMCApplication *application = fApplication->CloneForWorker();
+   if (!application) {
+      ::Fatal("TMCManager::SubEventWorkerLoop",
+              "The application must implement CloneForWorker() in the sub-event mode.");
+   }
+   application->InitOnWorker();
+   TMCManager *manager = TMCManager::Instance();
+   if (!manager || manager == this || !manager->fIsInitialized) {
+      ::Fatal("TMCManager::SubEventWorkerLoop",
+              "The worker application must request the TMCManager and initialize its engines in InitOnWorker().");
+   }
+   // The workers route as the master, the tables are rebuilt on the worker thread at the first use
+   manager->fRoutingRules = fRoutingRules;
+   manager->fIsRoutingTableBuilt = kFALSE;
+   manager->fTrackRoutingFunction = fTrackRoutingFunction;
+   manager->fTrackRoutingRules = fTrackRoutingRules;
+   manager->fIsTrackRoutingMaskBuilt = kFALSE;
+   application->BeginRunOnWorker();
+
+   std::unique_lock<std::mutex> lock(state.fMutex);
+   state.fWorkers[workerId].fApplication = application;
+   state.fWorkers[workerId].fManager = manager;
+   if (--state.fNofPending == 0) {
+      state.fCondition.notify_all();
+   }
+
+   ULong64_t eventNumber = 0;
+   while (kTRUE) {
+      state.fCondition.wait(lock, [&state, eventNumber] { return state.fStop || state.fEventNumber != eventNumber; });
+      if (state.fStop) {
+         break;
+      }
+      eventNumber = state.fEventNumber;
+      Int_t eventId = state.fEventId;
+      lock.unlock();
+      manager->ProcessSubEvent(eventId);
+      lock.lock();
+      if (--state.fNofPending == 0) {
+         state.fCondition.notify_all();
+      }
+   }
+   lock.unlock();
+
+   application->FinishRunOnWorker();
+   manager->TerminateRun();
+   {
+      std::lock_guard<std::mutex> mergeLock(state.fMergeMutex);
+      fApplication->Merge(application);
+   }
+   // The worker manager and its engines are deleted with the application
+   delete application;
+   fgSubEventMaster = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Split the primaries of the current event across the sub-event workers,
+/// wait for the workers, build the canonical track ids and let the master
+/// application merge the sub-events
+///
+
+void TMCManager::ProcessEventInSubEvents(Int_t eventId)
+{
+   TMC_TRACE_SCOPE("ProcessEventInSubEvents");
+   TSubEventState &state = *fSubEventState;
+
+   // Take over the tracks stacked by the generator, ordered by their ids
+   state.fPrimaries.clear();
+   for (UInt_t i = 0; i < fStacks.size(); i++) {
+      TMCManagerStack &stack = *fStacks[i];
+      for (std::stack<Int_t> *trackIds : {&stack.fPrimariesStack, &stack.fSecondariesStack}) {
+         while (!trackIds->empty()) {
+            Int_t trackId = trackIds->top();
+            state.fPrimaries.push_back({trackId, static_cast<Int_t>(i), fParticles[trackId]});
+            trackIds->pop();
+         }
+      }
+   }
+   using TPrimary = TSubEventState::TPrimary;
+   std::sort(state.fPrimaries.begin(), state.fPrimaries.end(),
+             [](const TPrimary &a, const TPrimary &b) { return a.fTrackId < b.fTrackId; });
+   state.fNextPrimary = 0;
+   state.fNextTrackId = fNextTrackId;
+
+   {
+      std::unique_lock<std::mutex> lock(state.fMutex);
+      state.fEventId = eventId;
+      state.fEventNumber++;
+      state.fNofPending = state.fWorkers.size();
+      state.fCondition.notify_all();
+      state.fCondition.wait(lock, [&state] { return state.fNofPending == 0; });
+   }
+
+   BuildCanonicalTrackIds();
+   for (auto &worker : state.fWorkers) {
+      // The tracks created by the worker were routed by its manager
+      const TMCManager &manager = *worker.fManager;
+      for (UInt_t i = 0; i < fNofRoutedTracks.size() && i < manager.fNofRoutedTracks.size(); i++) {
+         fNofRoutedTracks[i] += manager.fNofRoutedTracks[i];
+         fRoutedEkin[i] += manager.fRoutedEkin[i];
+      }
+      fApplication->MergeSubEvent(worker.fApplication);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Process the primaries distributed by the master, one after the other:
+/// each primary is pushed via the user stack to the engine chosen by the
+/// master and all its tracks are processed with the random stream of the
+/// primary before the next one is taken (on a sub-event worker)
+///
+
+void TMCManager::ProcessSubEvent(Int_t eventId)
+{
+   using TPrimary = TSubEventState::TPrimary;
+   TSubEventState &state = *fSubEventMaster->fSubEventState;
+
+   PrepareNewEvent();
+   fTrackKeys.clear();
+   {
+      TMC_TRACE_SCOPE("BeginEvent");
+      fApplication->BeginEvent();
+   }
+
+   Int_t nofPrimaries = state.fPrimaries.size();
+   for (Int_t index = state.fNextPrimary++; index < nofPrimaries; index = state.fNextPrimary++) {
+      const TPrimary &primary = state.fPrimaries[index];
+      TParticle *particle = primary.fParticle;
+      TMC_TRACE_SCOPE_ARG("Primary", "track", primary.fTrackId);
+
+      // Import the primary via the user stack to the engine chosen by the master
+      UpdateEnginePointers(fEngines[primary.fEngineId]);
+      fCurrentPrimaryId = primary.fTrackId;
+      fPrimarySequence = 0;
+      fImportedTrackId = primary.fTrackId;
+      TVector3 polarization;
+      particle->GetPolarisation(polarization);
+      Int_t trackId = -1;
+      fUserStack->PushTrack(1, fSubEventMaster->fParticlesStatus[primary.fTrackId]->fParentId,
+                            particle->GetPdgCode(), particle->Px(), particle->Py(), particle->Pz(),
+                            particle->Energy(), particle->Vx(), particle->Vy(), particle->Vz(), particle->T(),
+                            polarization.X(), polarization.Y(), polarization.Z(), kPPrimary, trackId,
+                            particle->GetWeight(), particle->GetStatusCode());
+      fImportedTrackId = -1;
+      if (trackId != primary.fTrackId) {
+         ::Fatal("TMCManager::ProcessSubEvent",
+                 "The user stack must number the tracks with TMCManager::NextTrackId(); got %i instead of %i.",
+                 trackId, primary.fTrackId);
+      }
+
+      // The random numbers of the primary do not depend on the worker
+      TMCPhiloxRandom *random = TMCRandomStreams::Instance()->SelectStream(eventId, 0, primary.fTrackId + 1);
+      // Only the engines get the stream, gRandom is shared by all threads
+      for (auto &mc : fEngines) {
+         if (mc->GetRandom() != random) {
+            mc->SetEngineRandom(random);
+         }
+      }
+
+      while (GetNextEngine()) {
+         TMC_TRACE_SCOPE_ARG("ProcessEvent", "engine", fCurrentEngine->GetId());
+         fgIsInTransport = kTRUE;
+         fCurrentEngine->ProcessEvent(eventId, kTRUE);
+         fgIsInTransport = kFALSE;
+      }
+   }
+   fCurrentPrimaryId = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the map of the track ids to the canonical ones: the generated tracks
+/// keep their ids, the tracks created by the workers follow in the order
+/// of their primary and of their creation
+///
+
+void TMCManager::BuildCanonicalTrackIds()
+{
+   TSubEventState &state = *fSubEventState;
+   Int_t nofGenerated = fNextTrackId;
+   Int_t nofTracks = state.fNextTrackId;
+
+   // The (primary id, sequence, track id) keys of all workers
+   std::vector<std::array<Int_t, 3>> keys;
+   keys.reserve(nofTracks - nofGenerated);
+   for (auto &worker : state.fWorkers) {
+      const std::vector<Int_t> &trackKeys = worker.fManager->fTrackKeys;
+      for (UInt_t i = 0; i + 2 < trackKeys.size(); i += 3) {
+         keys.push_back({{trackKeys[i + 1], trackKeys[i + 2], trackKeys[i]}});
+      }
+   }
+   std::sort(keys.begin(), keys.end());
+
+   fCanonicalTrackIds.resize(nofTracks);
+   for (Int_t i = 0; i < nofTracks; i++) {
+      fCanonicalTrackIds[i] = i;
+   }
+   for (UInt_t i = 0; i < keys.size(); i++) {
+      fCanonicalTrackIds[keys[i][2]] = nofGenerated + i;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the index of the given track in the track containers: the track id
+/// itself, except on a sub-event worker (-1 if the track is unknown there)
+///
+
+Int_t TMCManager::GetTrackIndex(Int_t trackId) const
+{
+   if (!fSubEventMaster) {
+      return trackId;
+   }
+   auto it = fTrackIndices.find(trackId);
+   return it != fTrackIndices.end() ? it->second : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the per-engine and per-volume lookup tables of the routing rules.
+/// The media are expanded to the volumes made of them; the volume names are
+/// translated to the volume ids of each engine.
+///
+
+void TMCManager::BuildRoutingTables()
+{
+   Int_t nofEngines = fEngines.size();
+   fRoutingTableOffsets.assign(nofEngines, std::vector<UInt_t>());
+   fRoutingTableRules.assign(nofEngines, std::vector<Int_t>());
+
+   // The volume names of each rule, with the media expanded
+   std::vector<std::vector<std::string>> ruleVolumes(fRoutingRules.size());
+   for (UInt_t i = 0; i < fRoutingRules.size(); ++i) {
+      const TMCRoutingRule &rule = fRoutingRules[i];
+      if (rule.fEngineId < 0 || rule.fEngineId >= nofEngines) {
+         ::Fatal("TMCManager::BuildRoutingTables", "Engine ID %i of routing rule %u out of bounds. Have %i engines.",
+                 rule.fEngineId, i, nofEngines);
+      }
+      ruleVolumes[i] = rule.fVolumes;
+      for (const std::string &mediumName : rule.fMedia) {
+         Bool_t isFound = kFALSE;
+         TIter next(gGeoManager->GetListOfVolumes());
+         while (TGeoVolume *volume = static_cast<TGeoVolume *>(next())) {
+            if (volume->GetMedium() && mediumName == volume->GetMedium()->GetName()) {
+               ruleVolumes[i].push_back(volume->GetName());
+               isFound = kTRUE;
+            }
+         }
+         if (!isFound) {
+            ::Warning("TMCManager::BuildRoutingTables", "No volume with medium %s.", mediumName.c_str());
+         }
+      }
+   }
+
+   for (Int_t engineId = 0; engineId < nofEngines; ++engineId) {
+      TVirtualMC *mc = fEngines[engineId];
+
+      // The rule indices per volume id, in the order of the rules
+      std::vector<std::vector<Int_t>> volumeRules;
+      for (UInt_t i = 0; i < fRoutingRules.size(); ++i) {
+         for (const std::string &volName : ruleVolumes[i]) {
+            Int_t volId = mc->VolId(volName.c_str());
+            if (volId < 0) {
+               ::Warning("TMCManager::BuildRoutingTables", "Unknown volume %s in engine %s.", volName.c_str(),
+                         mc->GetName());
+               continue;
+            }
+            if (volId >= static_cast<Int_t>(volumeRules.size())) {
+               volumeRules.resize(volId + 1);
+            }
+            std::vector<Int_t> &rules = volumeRules[volId];
+            if (rules.empty() || rules.back() != static_cast<Int_t>(i)) {
+               rules.push_back(i);
+            }
+         }
+      }
+
+      // Flatten to the offsets and the rule indices
+      std::vector<UInt_t> &offsets = fRoutingTableOffsets[engineId];
+      std::vector<Int_t> &ruleIds = fRoutingTableRules[engineId];
+      offsets.reserve(volumeRules.size() + 1);
+      offsets.push_back(0);
+      for (const std::vector<Int_t> &rules : volumeRules) {
+         ruleIds.insert(ruleIds.end(), rules.begin(), rules.end());
+         offsets.push_back(ruleIds.size());
+      }
+   }
+
+   fIsRoutingTableBuilt = kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the volume masks of the track routing rules, indexed by the
+/// TGeoVolume numbers; the media are expanded to the volumes made of them.
+/// Build also the look-ups of the production volumes: the TGeoVolume number
+/// per volume id of each engine, for the secondaries, and the private
+/// navigator locating the primaries.
+///
+
+void TMCManager::BuildTrackRoutingMasks()
+{
+   Int_t nofEngines = fEngines.size();
+   Int_t nofVolumes = gGeoManager->GetListOfVolumes()->GetEntriesFast();
+   fTrackRoutingMasks.assign(fTrackRoutingRules.size(), std::vector<UChar_t>());
+
+   fEngineVolNumbers.assign(nofEngines, std::vector<Int_t>());
+   for (Int_t engineId = 0; engineId < nofEngines; ++engineId) {
+      std::vector<Int_t> &volNumbers = fEngineVolNumbers[engineId];
+      TIter next(gGeoManager->GetListOfVolumes());
+      while (TGeoVolume *volume = static_cast<TGeoVolume *>(next())) {
+         Int_t volId = fEngines[engineId]->VolId(volume->GetName());
+         if (volId < 0) {
+            continue;
+         }
+         if (volId >= static_cast<Int_t>(volNumbers.size())) {
+            volNumbers.resize(volId + 1, -1);
+         }
+         volNumbers[volId] = volume->GetNumber();
+      }
+   }
+
+   if (!fRoutingNavigator || fRoutingNavigator->GetGeometry() != gGeoManager) {
+      fRoutingNavigator.reset(new TGeoNavigator(gGeoManager));
+      fRoutingNavigator->BuildCache(kTRUE, kFALSE);
+   }
+
+   for (UInt_t i = 0; i < fTrackRoutingRules.size(); ++i) {
+      const TMCRoutingRule &rule = fTrackRoutingRules[i];
+      if (rule.fEngineId < 0 || rule.fEngineId >= nofEngines) {
+         ::Fatal("TMCManager::BuildTrackRoutingMasks",
+                 "Engine ID %i of track routing rule %u out of bounds. Have %i engines.", rule.fEngineId, i,
+                 nofEngines);
+      }
+      if (rule.fVolumes.empty() && rule.fMedia.empty()) {
+         continue;
+      }
+
+      std::vector<UChar_t> &mask = fTrackRoutingMasks[i];
+      mask.assign(nofVolumes, 0);
+      for (const std::string &volName : rule.fVolumes) {
+         TGeoVolume *volume = gGeoManager->GetVolume(volName.c_str());
+         if (!volume) {
+            ::Warning("TMCManager::BuildTrackRoutingMasks", "Unknown volume %s.", volName.c_str());
+            continue;
+         }
+         mask[volume->GetNumber()] = 1;
+      }
+      for (const std::string &mediumName : rule.fMedia) {
+         Bool_t isFound = kFALSE;
+         TIter next(gGeoManager->GetListOfVolumes());
+         while (TGeoVolume *volume = static_cast<TGeoVolume *>(next())) {
+            if (volume->GetMedium() && mediumName == volume->GetMedium()->GetName()) {
+               mask[volume->GetNumber()] = 1;
+               isFound = kTRUE;
+            }
+         }
+         if (!isFound) {
+            ::Warning("TMCManager::BuildTrackRoutingMasks", "No volume with medium %s.", mediumName.c_str());
+         }
+      }
+   }
+
+   fIsTrackRoutingMaskBuilt = kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Choose the engines of a batch of new tracks. The PDG codes, kinetic
+/// energies and production volumes are gathered in the routing buffers,
+/// then the routing function and each rule are applied to the whole batch;
+/// the tracks left without engine stay in the current engine.
+///
+
+void TMCManager::RouteTracks(Int_t nofTracks, TParticle **particles)
+{
+   fRoutingPdg.resize(nofTracks);
+   fRoutingEkin.resize(nofTracks);
+   fRoutingVolNumbers.resize(nofTracks);
+   fRoutingEngineIds.assign(nofTracks, -1);
+
+   if (!fIsTrackRoutingMaskBuilt) {
+      BuildTrackRoutingMasks();
+   }
+
+   // The tracks forwarded during the transport are produced in the current
+   // volume of the producing engine; all others, ie. the primaries, their
+   // generator daughters and the imported tracks, are located at their vertex
+   // with the private navigator, which leaves the engine navigators untouched
+   TVirtualMC *currentEngine = CurrentEngine();
+   Int_t currentVolNumber = -1;
+   Bool_t isCurrentVolNumberSet = kFALSE;
+   for (Int_t i = 0; i < nofTracks; ++i) {
+      TParticle *particle = particles[i];
+      fRoutingPdg[i] = particle->GetPdgCode();
+      fRoutingEkin[i] = particle->Ek();
+      if (!fgIsInTransport || particle->IsPrimary()) {
+         fRoutingNavigator->FindNode(particle->Vx(), particle->Vy(), particle->Vz());
+         TGeoVolume *volume = fRoutingNavigator->GetCurrentVolume();
+         fRoutingVolNumbers[i] = volume ? volume->GetNumber() : -1;
+         continue;
+      }
+      if (!isCurrentVolNumberSet) {
+         if (currentEngine) {
+            Int_t copyNo;
+            Int_t volId = currentEngine->CurrentVolID(copyNo);
+            const std::vector<Int_t> &volNumbers = fEngineVolNumbers[currentEngine->GetId()];
+            if (volId >= 0 && volId < static_cast<Int_t>(volNumbers.size())) {
+               currentVolNumber = volNumbers[volId];
+            }
+         }
+         isCurrentVolNumberSet = kTRUE;
+      }
+      fRoutingVolNumbers[i] = currentVolNumber;
+   }
+
+   if (fTrackRoutingFunction) {
+      fTrackRoutingFunction(nofTracks, fRoutingPdg.data(), fRoutingEkin.data(), fRoutingVolNumbers.data(),
+                            fRoutingEngineIds.data());
+   }
+
+   for (UInt_t r = 0; r < fTrackRoutingRules.size(); ++r) {
+      const TMCRoutingRule &rule = fTrackRoutingRules[r];
+      const std::vector<UChar_t> &mask = fTrackRoutingMasks[r];
+      Int_t maskSize = mask.size();
+      for (Int_t i = 0; i < nofTracks; ++i) {
+         if (fRoutingEngineIds[i] >= 0 || fRoutingEkin[i] < rule.fEkinMin || fRoutingEkin[i] >= rule.fEkinMax ||
+             !rule.IsPdgSelected(fRoutingPdg[i])) {
+            continue;
+         }
+         if (maskSize &&
+             (fRoutingVolNumbers[i] < 0 || fRoutingVolNumbers[i] >= maskSize || !mask[fRoutingVolNumbers[i]])) {
+            continue;
+         }
+         fRoutingEngineIds[i] = rule.fEngineId;
+      }
+   }
+
+   Int_t nofEngines = fEngines.size();
+   for (Int_t i = 0; i < nofTracks; ++i) {
+      if (fRoutingEngineIds[i] < 0) {
+         if (!currentEngine) {
+            ::Fatal("TMCManager::RouteTracks", "No routing for the track with PDG %i and no current engine.",
+                    fRoutingPdg[i]);
+         }
+         fRoutingEngineIds[i] = currentEngine->GetId();
+      } else if (fRoutingEngineIds[i] >= nofEngines) {
+         ::Fatal("TMCManager::RouteTracks", "Engine ID %i out of bounds. Have %i engines.", fRoutingEngineIds[i],
+                 nofEngines);
+      }
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -504,6 +1788,7 @@ void TMCManager::UpdateEnginePointers(TVirtualMC *mc)
 
 void TMCManager::TerminateRun()
 {
+   TMC_TRACE_SCOPE("TerminateRun");
    for (auto &mc : fEngines) {
       mc->TerminateRun();
    }
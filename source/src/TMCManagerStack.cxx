@@ -28,6 +28,19 @@
     \ingroup vmc
 
 Concrete implementation of particles stack used by the TMCManager.
+
+In the concurrent mode of the TMCManager the engines access their stacks
+from their own threads and the tracks are pushed from the other engines.
+Each stack then has its own queue mutex, taken only by its engine and by
+the engines handing tracks over to it; the track containers shared by all
+engines and the calls to the user stack are protected by two other
+mutexes, which are held only for the duration of one access.
+
+The current track is kept per engine stack. In the concurrent mode, the
+current track of the user stack is set to the one of the calling engine
+before each PushTrack() forwarded to it, so that the user stack sees
+the right parent; the user code must otherwise get the current track
+from the engine stack, eg. via TVirtualMC::GetMC()->GetStack().
 */
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -37,7 +50,9 @@ Concrete implementation of particles stack used by the TMCManager.
 
 TMCManagerStack::TMCManagerStack()
    : TVirtualMCStack(), fCurrentTrackId(-1), fUserStack(nullptr), fTotalNPrimaries(nullptr), fTotalNTracks(nullptr),
-     fParticles(nullptr), fParticlesStatus(nullptr), fBranchArrayContainer(nullptr)
+     fParticles(nullptr), fParticlesStatus(nullptr), fTrackIndices(nullptr), fBranchArrayContainer(nullptr),
+     fQueueMutex(nullptr),
+     fTracksMutex(nullptr), fUserStackMutex(nullptr)
 {
 }
 
@@ -50,6 +65,11 @@ void TMCManagerStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg, Double_
                                 Double_t e, Double_t vx, Double_t vy, Double_t vz, Double_t tof, Double_t polx,
                                 Double_t poly, Double_t polz, TMCProcess mech, Int_t &ntr, Double_t weight, Int_t is)
 {
+   auto lock = LockUserStack();
+   // The user stack is shared by the engines running concurrently
+   if (fUserStackMutex && fCurrentTrackId >= 0) {
+      fUserStack->SetCurrentTrack(fCurrentTrackId);
+   }
    // Just forward to user stack
    fUserStack->PushTrack(toBeDone, parent, pdg, px, py, pz, e, vx, vy, vz, tof, polx, poly, polz, mech, ntr, weight,
                          is);
@@ -62,21 +82,25 @@ void TMCManagerStack::PushTrack(Int_t toBeDone, Int_t parent, Int_t pdg, Double_
 
 TParticle *TMCManagerStack::PopNextTrack(Int_t &itrack)
 {
-
-   if (fPrimariesStack.empty() && fSecondariesStack.empty()) {
-      itrack = -1;
-      return nullptr;
+   {
+      auto queueLock = LockQueue();
+      if (fPrimariesStack.empty() && fSecondariesStack.empty()) {
+         itrack = -1;
+         return nullptr;
+      }
+
+      std::stack<Int_t> *mcStack = &fPrimariesStack;
+
+      if (fPrimariesStack.empty()) {
+         mcStack = &fSecondariesStack;
+      }
+      itrack = mcStack->top();
+      mcStack->pop();
    }
 
-   std::stack<Int_t> *mcStack = &fPrimariesStack;
-
-   if (fPrimariesStack.empty()) {
-      mcStack = &fSecondariesStack;
-   }
-   itrack = mcStack->top();
-   mcStack->pop();
    SetCurrentTrack(itrack);
-   return fParticles->operator[](itrack);
+   auto lock = LockTracks();
+   return fParticles->operator[](GetTrackIndex(itrack));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -101,13 +125,18 @@ TParticle *TMCManagerStack::PopPrimaryForTracking(Int_t i, Int_t &itrack)
    // Completely ignore the index i, that is meaningless since the user does not
    // know how the stack is handled internally.
    Warning("PopPrimaryForTracking", "Lookup index %i is ignored.", i);
-   if (fPrimariesStack.empty()) {
-      itrack = -1;
-      return nullptr;
+   {
+      auto queueLock = LockQueue();
+      if (fPrimariesStack.empty()) {
+         itrack = -1;
+         return nullptr;
+      }
+      itrack = fPrimariesStack.top();
+      fPrimariesStack.pop();
    }
-   itrack = fPrimariesStack.top();
-   fPrimariesStack.pop();
-   return fParticles->operator[](itrack);
+
+   auto lock = LockTracks();
+   return fParticles->operator[](GetTrackIndex(itrack));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -117,6 +146,7 @@ TParticle *TMCManagerStack::PopPrimaryForTracking(Int_t i, Int_t &itrack)
 
 Int_t TMCManagerStack::GetNtrack() const
 {
+   auto lock = LockTracks();
    return *fTotalNTracks;
 }
 
@@ -127,6 +157,7 @@ Int_t TMCManagerStack::GetNtrack() const
 
 Int_t TMCManagerStack::GetStackedNtrack() const
 {
+   auto lock = LockQueue();
    return fPrimariesStack.size() + fSecondariesStack.size();
 }
 
@@ -137,6 +168,7 @@ Int_t TMCManagerStack::GetStackedNtrack() const
 
 Int_t TMCManagerStack::GetNprimary() const
 {
+   auto lock = LockTracks();
    return *fTotalNPrimaries;
 }
 
@@ -147,6 +179,7 @@ Int_t TMCManagerStack::GetNprimary() const
 
 Int_t TMCManagerStack::GetStackedNprimary() const
 {
+   auto lock = LockQueue();
    return fPrimariesStack.size();
 }
 
@@ -157,12 +190,13 @@ Int_t TMCManagerStack::GetStackedNprimary() const
 
 TParticle *TMCManagerStack::GetCurrentTrack() const
 {
+   auto lock = LockTracks();
    if (fCurrentTrackId < 0) {
       Fatal("GetCurrentTrack", "There is no current track set");
    }
    // That is not actually the current track but the user's TParticle at the
    // vertex.
-   return fParticles->operator[](fCurrentTrackId);
+   return fParticles->operator[](GetTrackIndex(fCurrentTrackId));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -182,7 +216,8 @@ Int_t TMCManagerStack::GetCurrentTrackNumber() const
 
 Int_t TMCManagerStack::GetCurrentParentTrackNumber() const
 {
-   return fParticlesStatus->operator[](fCurrentTrackId)->fParentId;
+   auto lock = LockTracks();
+   return fParticlesStatus->operator[](GetTrackIndex(fCurrentTrackId))->fParentId;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,10 +228,15 @@ Int_t TMCManagerStack::GetCurrentParentTrackNumber() const
 
 void TMCManagerStack::SetCurrentTrack(Int_t trackId)
 {
-   if (!HasTrackId(trackId)) {
-      Fatal("SetCurrentTrack", "Invalid track ID %i", trackId);
+   {
+      auto lock = LockTracks();
+      if (!HasTrackId(trackId)) {
+         Fatal("SetCurrentTrack", "Invalid track ID %i", trackId);
+      }
    }
    fCurrentTrackId = trackId;
+
+   auto userStackLock = LockUserStack();
    fUserStack->SetCurrentTrack(trackId);
 }
 
@@ -207,10 +247,11 @@ void TMCManagerStack::SetCurrentTrack(Int_t trackId)
 
 const TMCParticleStatus *TMCManagerStack::GetParticleStatus(Int_t trackId) const
 {
+   auto lock = LockTracks();
    if (!HasTrackId(trackId)) {
       Fatal("GetParticleStatus", "Invalid track ID %i", trackId);
    }
-   return fParticlesStatus->operator[](trackId).get();
+   return fParticlesStatus->operator[](GetTrackIndex(trackId)).get();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -220,10 +261,11 @@ const TMCParticleStatus *TMCManagerStack::GetParticleStatus(Int_t trackId) const
 
 const TGeoBranchArray *TMCManagerStack::GetGeoState(Int_t trackId) const
 {
+   auto lock = LockTracks();
    if (!HasTrackId(trackId)) {
       Fatal("GetParticleStatus", "Invalid track ID %i", trackId);
    }
-   return fBranchArrayContainer->GetGeoState(fParticlesStatus->operator[](trackId)->fGeoStateIndex);
+   return fBranchArrayContainer->GetGeoState(fParticlesStatus->operator[](GetTrackIndex(trackId))->fGeoStateIndex);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -233,7 +275,9 @@ const TGeoBranchArray *TMCManagerStack::GetGeoState(Int_t trackId) const
 
 const TGeoBranchArray *TMCManagerStack::GetCurrentGeoState() const
 {
-   return fBranchArrayContainer->GetGeoState(fParticlesStatus->operator[](fCurrentTrackId)->fGeoStateIndex);
+   auto lock = LockTracks();
+   const TMCParticleStatus *status = fParticlesStatus->operator[](GetTrackIndex(fCurrentTrackId)).get();
+   return fBranchArrayContainer->GetGeoState(status->fGeoStateIndex);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -243,12 +287,28 @@ const TGeoBranchArray *TMCManagerStack::GetCurrentGeoState() const
 
 Bool_t TMCManagerStack::HasTrackId(Int_t trackId) const
 {
-   if (trackId >= 0 && trackId < static_cast<Int_t>(fParticles->size()) && fParticles->operator[](trackId)) {
+   Int_t index = GetTrackIndex(trackId);
+   if (index >= 0 && index < static_cast<Int_t>(fParticles->size()) && fParticles->operator[](index)) {
       return kTRUE;
    }
    return kFALSE;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the index of track trackId in the track containers: the track id
+/// itself, except on a sub-event worker of the TMCManager (-1 if unknown)
+///
+
+Int_t TMCManagerStack::GetTrackIndex(Int_t trackId) const
+{
+   if (!fTrackIndices) {
+      return trackId;
+   }
+   auto it = fTrackIndices->find(trackId);
+   return it != fTrackIndices->end() ? it->second : -1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ///
 /// Set the user stack
@@ -261,16 +321,20 @@ void TMCManagerStack::SetUserStack(TVirtualMCStack *stack)
 
 ////////////////////////////////////////////////////////////////////////////////
 ///
-/// Connect an engine's stack to the centrally managed vectors
+/// Connect an engine's stack to the centrally managed vectors; trackIndices
+/// maps the track ids to the indices in the vectors on a sub-event worker
+/// of the TMCManager (nullptr otherwise)
 ///
 
 void TMCManagerStack::ConnectTrackContainers(std::vector<TParticle *> *particles,
                                              std::vector<std::unique_ptr<TMCParticleStatus>> *tracksStatus,
                                              TGeoMCBranchArrayContainer *branchArrayContainer, Int_t *totalNPrimaries,
-                                             Int_t *totalNTracks)
+                                             Int_t *totalNTracks,
+                                             const std::unordered_map<Int_t, Int_t> *trackIndices)
 {
    fParticles = particles;
    fParticlesStatus = tracksStatus;
+   fTrackIndices = trackIndices;
    fBranchArrayContainer = branchArrayContainer;
    fTotalNPrimaries = totalNPrimaries;
    fTotalNTracks = totalNTracks;
@@ -283,6 +347,7 @@ void TMCManagerStack::ConnectTrackContainers(std::vector<TParticle *> *particles
 
 void TMCManagerStack::PushPrimaryTrackId(Int_t trackId)
 {
+   auto lock = LockQueue();
    fPrimariesStack.push(trackId);
 }
 
@@ -293,6 +358,7 @@ void TMCManagerStack::PushPrimaryTrackId(Int_t trackId)
 
 void TMCManagerStack::PushSecondaryTrackId(Int_t trackId)
 {
+   auto lock = LockQueue();
    fSecondariesStack.push(trackId);
 }
 
@@ -304,6 +370,7 @@ void TMCManagerStack::PushSecondaryTrackId(Int_t trackId)
 void TMCManagerStack::ResetInternals()
 {
    // Reset current stack and track IDs
+   auto lock = LockQueue();
    fCurrentTrackId = -1;
    while (!fPrimariesStack.empty()) {
       fPrimariesStack.pop();
@@ -312,3 +379,53 @@ void TMCManagerStack::ResetInternals()
       fSecondariesStack.pop();
    }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the mutexes of the concurrent mode of the TMCManager
+/// (nullptr in the sequential mode)
+/// - queueMutex      The mutex of this engine queue
+/// - tracksMutex     The mutex of the track containers shared by all engines
+/// - userStackMutex  The mutex serializing the calls to the user stack
+///
+
+void TMCManagerStack::SetMutexes(TMCMutex *queueMutex, TMCMutex *tracksMutex, TMCRecursiveMutex *userStackMutex)
+{
+   fQueueMutex = queueMutex;
+   fTracksMutex = tracksMutex;
+   fUserStackMutex = userStackMutex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex of this engine queue, if any; the returned lock does not
+/// own any mutex in the sequential mode
+///
+
+std::unique_lock<TMCMutex> TMCManagerStack::LockQueue() const
+{
+   return fQueueMutex ? std::unique_lock<TMCMutex>(*fQueueMutex) : std::unique_lock<TMCMutex>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex of the track containers, if any; the returned lock does not
+/// own any mutex in the sequential mode
+///
+
+std::unique_lock<TMCMutex> TMCManagerStack::LockTracks() const
+{
+   return fTracksMutex ? std::unique_lock<TMCMutex>(*fTracksMutex) : std::unique_lock<TMCMutex>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Lock the mutex of the user stack, if any; the returned lock does not
+/// own any mutex in the sequential mode
+///
+
+std::unique_lock<TMCRecursiveMutex> TMCManagerStack::LockUserStack() const
+{
+   return fUserStackMutex ? std::unique_lock<TMCRecursiveMutex>(*fUserStackMutex)
+                          : std::unique_lock<TMCRecursiveMutex>();
+}
@@ -0,0 +1,209 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCMergeDriver.h"
+#include "TVirtualMCApplication.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+/** \class TMCMergeDriver
+    \ingroup vmc
+
+Driver merging the worker applications in the master application via
+a pairwise tree reduction.
+
+At the level k of the tree, the worker application i merges the worker
+application i + 2^k for all i multiple of 2^(k+1), the pairs being merged
+in parallel; after log2(N) levels, the master application merges the first
+worker application. The user hook remains
+TVirtualMCApplication::Merge(TVirtualMCApplication*), which must then
+support merging a worker application in another worker application,
+and the data of the different pairs must be independent so that they can
+be merged concurrently. Note that the worker applications accumulate the
+data of the merged ones, so they should reset their data at the beginning
+of the next run.
+
+When the worker applications live on the threads of a worker pool, the
+pool passes its executor to Merge() and each pair is merged on the thread
+of the receiving worker application, so that the thread-local state of the
+worker (eg. the TVirtualMCApplication instance or the TMCRootManager) is
+the one seen by its Merge(); otherwise the pairs are merged by the own
+threads of the driver.
+
+The merge time per level is recorded and it can be printed with PrintTimes().
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+/// - nofThreads  The maximum number of merging threads (0 = hardware concurrency)
+///
+
+TMCMergeDriver::TMCMergeDriver(Int_t nofThreads) : fNofThreads(nofThreads), fVerbose(kFALSE), fLevelTimes() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCMergeDriver::~TMCMergeDriver() {}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Merge the applications i + stride in the applications i,
+/// for i multiple of 2*stride, in parallel
+///
+
+void TMCMergeDriver::MergeLevel(std::vector<TVirtualMCApplication *> &applications, size_t stride) const
+{
+   std::vector<std::pair<TVirtualMCApplication *, TVirtualMCApplication *>> pairs;
+   for (size_t i = 0; i + stride < applications.size(); i += 2 * stride) {
+      pairs.emplace_back(applications[i], applications[i + stride]);
+   }
+
+   size_t nofThreads = (fNofThreads > 0) ? fNofThreads : std::thread::hardware_concurrency();
+   if (nofThreads < 1)
+      nofThreads = 1;
+   if (nofThreads > pairs.size())
+      nofThreads = pairs.size();
+
+   std::atomic<size_t> next(0);
+   auto mergePairs = [&pairs, &next]() {
+      for (size_t i = next++; i < pairs.size(); i = next++) {
+         pairs[i].first->Merge(pairs[i].second);
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (size_t i = 1; i < nofThreads; ++i) {
+      threads.emplace_back(mergePairs);
+   }
+   mergePairs();
+   for (auto &thread : threads) {
+      thread.join();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Merge the applications at the positions i + stride in the applications
+/// at the positions i, for i multiple of 2*stride, each on the thread of the
+/// receiving worker via the executor
+/// - workerApplications  The worker applications, indexed as by the executor
+/// - positions           The position of each worker application in the
+///                       reduction (-1 if it is not merged)
+///
+
+void TMCMergeDriver::MergeLevel(const std::vector<TVirtualMCApplication *> &workerApplications,
+                                const std::vector<Int_t> &positions, size_t stride, const TExecutor &executor) const
+{
+   // The worker application index per position
+   std::vector<Int_t> indices;
+   for (size_t i = 0; i < positions.size(); ++i) {
+      if (positions[i] >= 0) {
+         if (positions[i] >= Int_t(indices.size()))
+            indices.resize(positions[i] + 1, -1);
+         indices[positions[i]] = i;
+      }
+   }
+
+   executor([&workerApplications, &positions, &indices, stride](Int_t index) {
+      if (index < 0 || index >= Int_t(positions.size()) || positions[index] < 0)
+         return;
+      size_t position = positions[index];
+      if (position % (2 * stride) != 0 || position + stride >= indices.size())
+         return;
+      workerApplications[index]->Merge(workerApplications[indices[position + stride]]);
+   });
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Merge the worker applications in the master application
+/// - masterApplication   The master application, merged on this thread
+/// - workerApplications  The worker applications (nullptr are skipped)
+/// - executor            The function calling a function on the thread of
+///                       each worker with the index of its application in
+///                       workerApplications; if not defined, the pairs are
+///                       merged by the own threads of the driver
+///
+
+void TMCMergeDriver::Merge(TVirtualMCApplication *masterApplication,
+                           const std::vector<TVirtualMCApplication *> &workerApplications, const TExecutor &executor)
+{
+   fLevelTimes.clear();
+
+   std::vector<TVirtualMCApplication *> applications;
+   std::vector<Int_t> positions(workerApplications.size(), -1);
+   for (size_t i = 0; i < workerApplications.size(); ++i) {
+      if (workerApplications[i]) {
+         positions[i] = applications.size();
+         applications.push_back(workerApplications[i]);
+      }
+   }
+   if (applications.empty())
+      return;
+
+   for (size_t stride = 1; stride < applications.size(); stride *= 2) {
+      auto start = std::chrono::steady_clock::now();
+      if (executor) {
+         MergeLevel(workerApplications, positions, stride, executor);
+      } else {
+         MergeLevel(applications, stride);
+      }
+      fLevelTimes.push_back(std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count());
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   masterApplication->Merge(applications[0]);
+   fLevelTimes.push_back(std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count());
+
+   if (fVerbose) {
+      PrintTimes();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the merge time per level of the last merge
+///
+
+void TMCMergeDriver::PrintTimes() const
+{
+   // The format of std::cout is restored at the end
+   std::ios::fmtflags flags = std::cout.flags();
+   std::streamsize precision = std::cout.precision();
+
+   Double_t total = 0.;
+   std::cout << "TMCMergeDriver: merge times" << std::endl;
+   for (size_t level = 0; level < fLevelTimes.size(); ++level) {
+      if (level + 1 < fLevelTimes.size()) {
+         std::cout << "   level " << std::setw(2) << level << ": ";
+      } else {
+         std::cout << "   master  : ";
+      }
+      std::cout << std::fixed << std::setprecision(3) << fLevelTimes[level] << " s" << std::endl;
+      total += fLevelTimes[level];
+   }
+   std::cout << "   total   : " << std::fixed << std::setprecision(3) << total << " s" << std::endl;
+   std::cout.flags(flags);
+   std::cout.precision(precision);
+}
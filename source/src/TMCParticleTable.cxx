@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCParticleTable.h"
+#include "TMCAutoLock.h"
+#include "TVirtualMC.h"
+#include "TDatabasePDG.h"
+#include "TParticlePDG.h"
+#include "TArrayI.h"
+#include "TError.h"
+
+#include <iostream>
+
+/** \class TMCParticleTable
+    \ingroup vmc
+
+Immutable table of the particle properties (mass, charge, life time and
+VMC particle type) as defined in the MC engine, with a dense index per PDG
+code.
+
+The table should be built once all particles and ions are defined, that is
+after TVirtualMCApplication::AddParticles() and AddIons() were called by
+the engine initialization:
+~~~{.cpp}
+TMCParticleTable::Build(*gMC);
+~~~
+Build() publishes the table; it is then accessible via Instance() from all
+threads without locking. In the stepping code, TVirtualMC::TrackPidIndex()
+gives the index of the current track, which replaces the hash look-ups in
+TDatabasePDG and the virtual calls per step with array accesses. The index
+is -1 for a particle which is not in the table and must be checked:
+~~~{.cpp}
+const TMCParticleTable *table = TMCParticleTable::Instance();
+Int_t index = gMC->TrackPidIndex();
+Double_t mass = index >= 0 ? table->GetMass(index) : gMC->ParticleMass(gMC->TrackPid());
+~~~
+Without an explicit list of PDG codes, Build() takes the particles defined
+in the engine, see TVirtualMC::GetDefinedParticles().
+A table replaced by a new Build() is kept until the end of the program
+as the pointers to it may still be in use.
+*/
+
+namespace {
+// Mutex protecting the list of the retired tables
+TMCMutex publishMutex = TMCMUTEX_INITIALIZER;
+
+std::vector<const TMCParticleTable *> &GetRetiredTables()
+{
+   static std::vector<const TMCParticleTable *> retiredTables;
+   return retiredTables;
+}
+} // namespace
+
+std::atomic<const TMCParticleTable *> TMCParticleTable::fgInstance(nullptr);
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCParticleTable::TMCParticleTable() : fDirectIndex(2 * kDirectRange + 1, -1) {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCParticleTable::~TMCParticleTable() {}
+
+//
+// static methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Build the table with the properties defined in the given engine and
+/// publish it
+/// - mc    The MC engine
+/// - pdgs  The PDG codes of the particles; if empty, the particles defined
+///         in the engine (TVirtualMC::GetDefinedParticles()) are used, or,
+///         if the engine does not provide them, all particles defined
+///         in TDatabasePDG
+///
+
+const TMCParticleTable *TMCParticleTable::Build(const TVirtualMC &mc, const std::vector<Int_t> &pdgs)
+{
+   std::vector<Int_t> codes(pdgs);
+   if (codes.empty()) {
+      TArrayI definedPdgs;
+      if (mc.GetDefinedParticles(definedPdgs)) {
+         codes.assign(definedPdgs.GetArray(), definedPdgs.GetArray() + definedPdgs.GetSize());
+      } else {
+         ::Warning("TMCParticleTable::Build",
+                   "The engine does not provide its particles, all TDatabasePDG particles are used.");
+         TIter next(TDatabasePDG::Instance()->ParticleList());
+         while (TParticlePDG *particle = static_cast<TParticlePDG *>(next())) {
+            codes.push_back(particle->PdgCode());
+         }
+      }
+   }
+   std::sort(codes.begin(), codes.end());
+   codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+   TMCParticleTable *table = new TMCParticleTable();
+   for (auto pdg : codes) {
+      Int_t index = table->fPdg.size();
+      table->fPdg.push_back(pdg);
+      table->fName.push_back(mc.ParticleName(pdg));
+      table->fMass.push_back(mc.ParticleMass(pdg));
+      table->fCharge.push_back(mc.ParticleCharge(pdg));
+      table->fLifeTime.push_back(mc.ParticleLifeTime(pdg));
+      table->fMCType.push_back(mc.ParticleMCType(pdg));
+
+      if (pdg >= -kDirectRange && pdg <= kDirectRange) {
+         table->fDirectIndex[pdg + kDirectRange] = index;
+      } else {
+         // the codes are sorted
+         table->fSortedPdg.push_back(pdg);
+         table->fSortedIndex.push_back(index);
+      }
+   }
+
+   TMCAutoLock lk(&publishMutex);
+   const TMCParticleTable *oldTable = fgInstance.exchange(table, std::memory_order_acq_rel);
+   if (oldTable)
+      GetRetiredTables().push_back(oldTable);
+
+   return table;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the table
+///
+
+void TMCParticleTable::Print() const
+{
+   std::cout << "TMCParticleTable: " << fPdg.size() << " particles" << std::endl;
+   for (Int_t i = 0; i < GetNofParticles(); ++i) {
+      std::cout << "   " << i << ": " << fName[i] << " (" << fPdg[i] << ")  mass = " << fMass[i]
+                << "  charge = " << fCharge[i] << "  lifetime = " << fLifeTime[i] << "  type = " << fMCType[i]
+                << std::endl;
+   }
+}
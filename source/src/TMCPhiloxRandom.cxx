@@ -0,0 +1,239 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCPhiloxRandom.h"
+
+/** \class TMCPhiloxRandom
+    \ingroup vmc
+
+Counter-based random number generator implementing Philox4x32-10
+(J. K. Salmon et al., "Parallel random numbers: as easy as 1, 2, 3",
+SC11) with the TRandom interface.
+
+The generated numbers are a function of the key, defined by the master
+seed and the engine number, and of the counter, defined by the run, event
+and sub-stream numbers and by the position in the stream. Setting the
+stream with SetStream() and jumping ahead with Skip() are therefore O(1)
+operations, and the numbers of an event do not depend on the events
+processed before it or on the thread processing it.
+
+Each double value consumes 64 random bits; a stream provides 2^33 values.
+*/
+
+ClassImp(TMCPhiloxRandom);
+
+namespace {
+
+const UInt_t kPhiloxM0 = 0xD2511F53;
+const UInt_t kPhiloxM1 = 0xCD9E8D57;
+const UInt_t kPhiloxW0 = 0x9E3779B9;
+const UInt_t kPhiloxW1 = 0xBB67AE85;
+
+const Double_t kInv53 = 1. / 9007199254740992.; // 2^-53
+const Float_t kInv23 = 1.f / 8388608.f;         // 2^-23
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+
+TMCPhiloxRandom::TMCPhiloxRandom(ULong64_t seed) : TRandom(), fMasterSeed(0), fPosition(0), fIsBufferValid(kFALSE)
+{
+   SetName("TMCPhiloxRandom");
+   SetTitle("Random number generator: Philox4x32-10");
+   fCounter[0] = fCounter[1] = fCounter[2] = fCounter[3] = 0;
+   fBuffer[0] = fBuffer[1] = fBuffer[2] = fBuffer[3] = 0;
+   fKey[0] = fKey[1] = 0;
+   SetMasterSeed(seed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCPhiloxRandom::~TMCPhiloxRandom() {}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Restart the current stream
+///
+
+void TMCPhiloxRandom::Reset()
+{
+   fPosition = 0;
+   fIsBufferValid = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the next 64 random bits of the stream
+///
+
+ULong64_t TMCPhiloxRandom::NextBits()
+{
+   if (!fIsBufferValid || (fPosition & 1) == 0) {
+      fCounter[0] = UInt_t(fPosition >> 1);
+      Philox(fCounter, fKey, fBuffer);
+      fIsBufferValid = kTRUE;
+   }
+   const UInt_t *words = fBuffer + 2 * (fPosition & 1);
+   ++fPosition;
+   return (ULong64_t(words[0]) << 32) | words[1];
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Apply the Philox4x32-10 function on the counter and key
+/// - counter  The counter (array of size 4)
+/// - key      The key (array of size 2)
+/// - result   The random bits (array of size 4)
+///
+
+void TMCPhiloxRandom::Philox(const UInt_t *counter, const UInt_t *key, UInt_t *result)
+{
+   UInt_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+   UInt_t k[2] = {key[0], key[1]};
+
+   for (Int_t round = 0; round < 10; ++round) {
+      ULong64_t product0 = ULong64_t(kPhiloxM0) * c[0];
+      ULong64_t product1 = ULong64_t(kPhiloxM1) * c[2];
+      UInt_t hi0 = UInt_t(product0 >> 32);
+      UInt_t lo0 = UInt_t(product0);
+      UInt_t hi1 = UInt_t(product1 >> 32);
+      UInt_t lo1 = UInt_t(product1);
+      c[0] = hi1 ^ c[1] ^ k[0];
+      c[1] = lo1;
+      c[2] = hi0 ^ c[3] ^ k[1];
+      c[3] = lo0;
+      k[0] += kPhiloxW0;
+      k[1] += kPhiloxW1;
+   }
+
+   result[0] = c[0];
+   result[1] = c[1];
+   result[2] = c[2];
+   result[3] = c[3];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return a uniformly distributed random number in ]0, 1[
+///
+
+Double_t TMCPhiloxRandom::Rndm()
+{
+   ULong64_t bits;
+   do {
+      bits = NextBits() >> 11;
+   } while (bits == 0);
+   return bits * kInv53;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return an array of n uniformly distributed random numbers in ]0, 1[
+///
+
+void TMCPhiloxRandom::RndmArray(Int_t n, Float_t *array)
+{
+   for (Int_t i = 0; i < n; ++i) {
+      array[i] = ((NextBits() >> 41) + 0.5f) * kInv23;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return an array of n uniformly distributed random numbers in ]0, 1[
+///
+
+void TMCPhiloxRandom::RndmArray(Int_t n, Double_t *array)
+{
+   for (Int_t i = 0; i < n; ++i) {
+      array[i] = Rndm();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Jump ahead by n values in the current stream
+///
+
+void TMCPhiloxRandom::Skip(ULong64_t n)
+{
+   if (n == 0)
+      return;
+
+   fPosition += n;
+   fIsBufferValid = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the master seed and restart the current stream.
+/// Unlike in TRandom3, the seed 0 is used as it is.
+///
+
+void TMCPhiloxRandom::SetSeed(ULong_t seed)
+{
+   SetMasterSeed(seed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the master seed and restart the current stream
+///
+
+void TMCPhiloxRandom::SetMasterSeed(ULong64_t seed)
+{
+   UInt_t engine = fKey[1] ^ UInt_t(fMasterSeed >> 32);
+   fMasterSeed = seed;
+   fSeed = UInt_t(seed);
+   fKey[0] = UInt_t(seed);
+   fKey[1] = UInt_t(seed >> 32) ^ engine;
+   Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Select the stream
+/// - run        The run number
+/// - event      The event number
+/// - engine     The engine number (eg. TVirtualMC::GetId())
+/// - subStream  The sub-stream number (eg. the primary track number)
+///
+
+void TMCPhiloxRandom::SetStream(UInt_t run, UInt_t event, UInt_t engine, UInt_t subStream)
+{
+   fKey[0] = UInt_t(fMasterSeed);
+   fKey[1] = UInt_t(fMasterSeed >> 32) ^ engine;
+   fCounter[1] = subStream;
+   fCounter[2] = event;
+   fCounter[3] = run;
+   Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the master seed (lower 32 bits)
+///
+
+UInt_t TMCPhiloxRandom::GetSeed() const
+{
+   return UInt_t(fMasterSeed);
+}
@@ -0,0 +1,541 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCProfiler.h"
+#include "TDatabasePDG.h"
+#include "TError.h"
+#include "TH1D.h"
+#include "TMCAutoLock.h"
+#include "TMCParticleTable.h"
+#include "TMCRootManager.h"
+#include "TParticlePDG.h"
+#include "TVirtualMC.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+
+/** \class TMCProfiler
+    \ingroup vmc
+
+Opt-in profiler attributing the transport time and the number of steps
+to the (volume, particle, engine) buckets.
+
+The user application owns the profiler, as TMCVerbose, and calls its
+PreTrack(), Stepping() and PostTrack() at the beginning of its own hooks.
+The time between two calls in the same track is read from a cheap clock
+(the time stamp counter on x86) and it is attributed to the volume of the
+step reported by Stepping(), together with the step; it thus includes the
+engine step and the user code of the previous step. The time after the last
+step is attributed to the last volume of the track. The engine of the
+bucket is the one performing the step, so the parts of a track transferred
+between engines by TMCManager are attributed to each engine.
+
+With a sampling period n > 1 (SetSamplingPeriod()), only one track out
+of n, chosen at random, is measured and its values are scaled by n.
+The other tracks cost one branch per step, which keeps the overhead
+small in productions. The sampling uses its own generator and does not
+consume the random numbers of the simulation.
+
+In multi-threaded applications the profiler follows the worker lifecycle
+of TMCScoringMesh: CloneForWorker() in
+TVirtualMCApplication::CloneForWorker(), FinishRunOnWorker() in
+TVirtualMCApplication::FinishRunOnWorker() and Merge() on the master.
+
+At the end of run, Print() writes the report sorted by the time per
+volume, per particle and per bucket, and Write() saves the same
+distributions as histograms via TMCRootManager.
+*/
+
+namespace {
+TMCMutex gProfilerMergeMutex = TMCMUTEX_INITIALIZER;
+
+/// Return the particle name from the particle table or the PDG database
+TString GetParticleName(Int_t pdg)
+{
+   const TMCParticleTable *table = TMCParticleTable::Instance();
+   Int_t index = table ? table->GetIndex(pdg) : -1;
+   if (index >= 0)
+      return table->GetName(index);
+
+   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(pdg);
+   if (particle)
+      return particle->GetName();
+
+   return TString::Format("pdg %d", pdg);
+}
+
+/// The values summed per name
+struct TSum {
+   ULong64_t fTicks = 0;
+   ULong64_t fNofSteps = 0;
+   ULong64_t fNofTracks = 0;
+};
+
+/// Return the sums sorted by decreasing time
+std::vector<std::pair<TString, TSum>> SortByTime(const std::map<TString, TSum> &sums)
+{
+   std::vector<std::pair<TString, TSum>> sorted(sums.begin(), sums.end());
+   std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<TString, TSum> &a,
+                                                     const std::pair<TString, TSum> &b) {
+      return a.second.fTicks > b.second.fTicks;
+   });
+   return sorted;
+}
+
+/// Print the table of the sums sorted by decreasing time
+void PrintTable(std::ostream &out, const char *title, const std::map<TString, TSum> &sums, ULong64_t totalTicks,
+                Int_t nofRows)
+{
+   Double_t ticksPerSecond = TMCProfiler::GetTicksPerSecond();
+   // The format of the caller's stream is restored at the end
+   std::ios::fmtflags flags = out.flags();
+   std::streamsize precision = out.precision();
+
+   out << "--- " << title << std::endl;
+   out << std::setw(40) << std::left << "name" << std::right << std::setw(12) << "time (s)" << std::setw(9)
+       << "time (%)" << std::setw(14) << "steps" << std::setw(12) << "ns/step" << std::setw(12) << "tracks"
+       << std::endl;
+
+   Int_t nofPrinted = 0;
+   for (const auto &entry : SortByTime(sums)) {
+      if (nofPrinted++ == nofRows)
+         break;
+      const TSum &sum = entry.second;
+      Double_t time = sum.fTicks / ticksPerSecond;
+      out << std::setw(40) << std::left << entry.first.Data() << std::right << std::fixed << std::setprecision(3)
+          << std::setw(12) << time << std::setprecision(2) << std::setw(9)
+          << (totalTicks ? 100. * sum.fTicks / totalTicks : 0.) << std::setw(14) << sum.fNofSteps
+          << std::setprecision(1) << std::setw(12) << (sum.fNofSteps ? 1.e9 * time / sum.fNofSteps : 0.)
+          << std::setw(12) << sum.fNofTracks << std::endl;
+   }
+   out.flags(flags);
+   out.precision(precision);
+}
+
+/// Create the histogram of the time per name, sorted by decreasing time
+TH1D *CreateHistogram(const char *name, const char *title, const std::map<TString, TSum> &sums)
+{
+   Double_t ticksPerSecond = TMCProfiler::GetTicksPerSecond();
+   std::vector<std::pair<TString, TSum>> sorted = SortByTime(sums);
+   Int_t nbins = std::max<Int_t>(sorted.size(), 1);
+
+   TH1D *histogram = new TH1D(name, title, nbins, 0., nbins);
+   histogram->SetDirectory(nullptr);
+   histogram->GetYaxis()->SetTitle("time (s)");
+   for (Int_t i = 0; i < Int_t(sorted.size()); ++i) {
+      histogram->GetXaxis()->SetBinLabel(i + 1, sorted[i].first);
+      histogram->SetBinContent(i + 1, sorted[i].second.fTicks / ticksPerSecond);
+   }
+   return histogram;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+
+TMCProfiler::TMCProfiler(const char *name)
+   : fName(name),
+     fSamplingPeriod(1),
+     fRandomState(0x853c49e6748fea9bULL),
+     fBuckets(),
+     fShared(std::make_shared<TSharedData>()),
+     fMC(nullptr),
+     fIsSampled(kFALSE),
+     fIsFirstStep(kFALSE),
+     fPdg(0),
+     fEngineId(0),
+     fLastVolId(-1),
+     fLastBucket(nullptr),
+     fLastClock(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Constructor of a worker clone sharing the merge data with the master
+///
+
+TMCProfiler::TMCProfiler(const TMCProfiler &master, Bool_t /*isWorker*/)
+   : fName(master.fName),
+     fSamplingPeriod(master.fSamplingPeriod),
+     fRandomState(master.fRandomState ^ ULong64_t(reinterpret_cast<uintptr_t>(this))),
+     fBuckets(),
+     fShared(master.fShared),
+     fMC(nullptr),
+     fIsSampled(kFALSE),
+     fIsFirstStep(kFALSE),
+     fPdg(0),
+     fEngineId(0),
+     fLastVolId(-1),
+     fLastBucket(nullptr),
+     fLastClock(0)
+{
+   if (!fRandomState)
+      fRandomState = 0x853c49e6748fea9bULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCProfiler::~TMCProfiler() {}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the buckets of the other map
+///
+
+void TMCProfiler::Add(TBucketMap &buckets, const TBucketMap &other)
+{
+   for (const auto &entry : other) {
+      TBucket &bucket = buckets[entry.first];
+      if (bucket.fVolName.IsNull())
+         bucket.fVolName = entry.second.fVolName;
+      bucket.fTicks += entry.second.fTicks;
+      bucket.fNofSteps += entry.second.fNofSteps;
+      bucket.fNofTracks += entry.second.fNofTracks;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the bucket of the given volume and the current track;
+/// the volume name is resolved when the bucket is created
+///
+
+TMCProfiler::TBucket &TMCProfiler::FindBucket(Int_t volId)
+{
+   if (volId == fLastVolId && fLastBucket)
+      return *fLastBucket;
+
+   TBucket &bucket = fBuckets[TKey{volId, fPdg, fEngineId}];
+   if (bucket.fVolName.IsNull())
+      bucket.fVolName = fMC->CurrentVolName();
+
+   // the map nodes are not moved by a rehash
+   fLastVolId = volId;
+   fLastBucket = &bucket;
+   return bucket;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Decide whether the next track is measured
+///
+
+Bool_t TMCProfiler::SampleTrack()
+{
+   if (fSamplingPeriod == 1)
+      return kTRUE;
+
+   // xorshift64
+   fRandomState ^= fRandomState << 13;
+   fRandomState ^= fRandomState >> 7;
+   fRandomState ^= fRandomState << 17;
+   return fRandomState % fSamplingPeriod == 0;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of clock ticks per second, calibrated against the steady
+/// clock at the first call
+///
+
+Double_t TMCProfiler::GetTicksPerSecond()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   static const Double_t ticksPerSecond = []() {
+      auto start = std::chrono::steady_clock::now();
+      ULong64_t startTicks = ReadClock();
+      Double_t elapsed = 0.;
+      do {
+         elapsed = std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - start).count();
+      } while (elapsed < 0.02);
+      return (ReadClock() - startTicks) / elapsed;
+   }();
+   return ticksPerSecond;
+#else
+   return 1.e9;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create the profiler for a worker thread; the returned object is owned by
+/// the caller (the worker application)
+///
+
+TMCProfiler *TMCProfiler::CloneForWorker() const
+{
+   return new TMCProfiler(*this, kTRUE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the buckets of this worker to the sum of the finished workers
+/// and reset them for the next run
+///
+
+void TMCProfiler::FinishRunOnWorker()
+{
+   TMCAutoLock lock(&gProfilerMergeMutex);
+   Add(fShared->fBuckets, fBuckets);
+   lock.unlock();
+
+   Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the sum of the finished workers to this profiler; to be called by
+/// the master after all workers finished the run
+///
+
+void TMCProfiler::Merge()
+{
+   TBucketMap sum;
+   TMCAutoLock lock(&gProfilerMergeMutex);
+   sum.swap(fShared->fBuckets);
+   lock.unlock();
+
+   Add(fBuckets, sum);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the buckets of the other profiler
+///
+
+void TMCProfiler::Merge(const TMCProfiler &other)
+{
+   Add(fBuckets, other.fBuckets);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Start a track; to be called at the beginning of
+/// TVirtualMCApplication::PreTrack()
+///
+
+void TMCProfiler::PreTrack()
+{
+   fIsSampled = SampleTrack();
+   if (!fIsSampled)
+      return;
+
+   fMC = TVirtualMC::GetMC();
+   if (!fMC) {
+      fIsSampled = kFALSE;
+      return;
+   }
+   fPdg = fMC->TrackPid();
+   fEngineId = fMC->GetId();
+   fIsFirstStep = kTRUE;
+   fLastVolId = -1;
+   fLastBucket = nullptr;
+   fLastClock = ReadClock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Attribute the time since the previous call and the step to the current
+/// volume; to be called at the beginning of TVirtualMCApplication::Stepping().
+/// The engine is checked at each step: a track transferred by TMCManager is
+/// resumed by the target engine without PreTrack(), its steps are then
+/// attributed to the new engine and the time of the transfer is not counted.
+///
+
+void TMCProfiler::Stepping()
+{
+   if (!fIsSampled)
+      return;
+
+   ULong64_t clock = ReadClock();
+   TVirtualMC *mc = TVirtualMC::GetMC();
+   if (mc != fMC) {
+      fMC = mc;
+      fPdg = mc->TrackPid();
+      fEngineId = mc->GetId();
+      fLastVolId = -1;
+      fLastBucket = nullptr;
+      fLastClock = clock;
+   }
+   Int_t copyNo;
+   TBucket &bucket = FindBucket(fMC->CurrentVolID(copyNo));
+   bucket.fTicks += (clock - fLastClock) * fSamplingPeriod;
+   bucket.fNofSteps += fSamplingPeriod;
+   if (fIsFirstStep) {
+      bucket.fNofTracks += fSamplingPeriod;
+      fIsFirstStep = kFALSE;
+   }
+   fLastClock = clock;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Attribute the time since the last step to the last volume of the track;
+/// to be called at the beginning of TVirtualMCApplication::PostTrack()
+///
+
+void TMCProfiler::PostTrack()
+{
+   if (!fIsSampled)
+      return;
+
+   if (fLastBucket)
+      fLastBucket->fTicks += (ReadClock() - fLastClock) * fSamplingPeriod;
+
+   fIsSampled = kFALSE;
+   fMC = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Clear the accumulated values of this thread
+///
+
+void TMCProfiler::Reset()
+{
+   fBuckets.clear();
+   fIsSampled = kFALSE;
+   fLastVolId = -1;
+   fLastBucket = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the report sorted by decreasing time: the time per volume, per
+/// particle and per engine, and the nofRows most expensive buckets
+///
+
+void TMCProfiler::Print(std::ostream &out, Int_t nofRows) const
+{
+   std::map<TString, TSum> volumes;
+   std::map<TString, TSum> particles;
+   std::map<TString, TSum> engines;
+   std::map<TString, TSum> buckets;
+   ULong64_t totalTicks = 0;
+
+   std::unordered_map<Int_t, TString> particleNames;
+   for (const auto &entry : fBuckets) {
+      auto it = particleNames.find(entry.first.fPdg);
+      if (it == particleNames.end())
+         it = particleNames.emplace(entry.first.fPdg, GetParticleName(entry.first.fPdg)).first;
+
+      TString engineName = TString::Format("engine %d", entry.first.fEngineId);
+      TString bucketName = entry.second.fVolName + " / " + it->second + " / " + engineName;
+      for (TSum *sum : {&volumes[entry.second.fVolName], &particles[it->second], &engines[engineName],
+                        &buckets[bucketName]}) {
+         sum->fTicks += entry.second.fTicks;
+         sum->fNofSteps += entry.second.fNofSteps;
+         sum->fNofTracks += entry.second.fNofTracks;
+      }
+      totalTicks += entry.second.fTicks;
+   }
+
+   out << "=== " << fName << ": " << TString::Format("%.3f", totalTicks / GetTicksPerSecond()) << " s in "
+       << GetTotalSteps() << " steps";
+   if (fSamplingPeriod > 1)
+      out << " (estimated from 1/" << fSamplingPeriod << " of the tracks)";
+   out << std::endl;
+
+   PrintTable(out, "Time per volume", volumes, totalTicks, nofRows);
+   PrintTable(out, "Time per particle", particles, totalTicks, nofRows);
+   PrintTable(out, "Time per engine", engines, totalTicks, nofRows);
+   PrintTable(out, "Time per volume / particle / engine", buckets, totalTicks, nofRows);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the histograms of the time per volume, per particle and per engine
+/// (sorted by decreasing time) in the file of the given manager
+///
+
+void TMCProfiler::Write(TMCRootManager *rootManager) const
+{
+   if (!rootManager) {
+      ::Error("TMCProfiler::Write", "Profiler %s: no TMCRootManager is defined.", fName.Data());
+      return;
+   }
+
+   std::map<TString, TSum> volumes;
+   std::map<TString, TSum> particles;
+   std::map<TString, TSum> engines;
+   for (const auto &entry : fBuckets) {
+      for (TSum *sum : {&volumes[entry.second.fVolName], &particles[GetParticleName(entry.first.fPdg)],
+                        &engines[TString::Format("engine %d", entry.first.fEngineId)]}) {
+         sum->fTicks += entry.second.fTicks;
+      }
+   }
+
+   for (TH1D *histogram :
+        {CreateHistogram(fName + "_volumes", "Time per volume", volumes),
+         CreateHistogram(fName + "_particles", "Time per particle", particles),
+         CreateHistogram(fName + "_engines", "Time per engine", engines)}) {
+      rootManager->WriteObject(histogram);
+      delete histogram;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the sampling period: one track out of period (chosen at random)
+/// is measured; the values are scaled by the period
+///
+
+void TMCProfiler::SetSamplingPeriod(Int_t period)
+{
+   if (period < 1) {
+      ::Error("TMCProfiler::SetSamplingPeriod", "Profiler %s: wrong period %d.", fName.Data(), period);
+      return;
+   }
+
+   fSamplingPeriod = period;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the total attributed time (in s) of this profiler
+///
+
+Double_t TMCProfiler::GetTotalTime() const
+{
+   ULong64_t totalTicks = 0;
+   for (const auto &entry : fBuckets)
+      totalTicks += entry.second.fTicks;
+
+   return totalTicks / GetTicksPerSecond();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the total number of steps of this profiler
+///
+
+ULong64_t TMCProfiler::GetTotalSteps() const
+{
+   ULong64_t totalSteps = 0;
+   for (const auto &entry : fBuckets)
+      totalSteps += entry.second.fNofSteps;
+
+   return totalSteps;
+}
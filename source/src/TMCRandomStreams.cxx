@@ -0,0 +1,152 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCRandomStreams.h"
+#include "TMCPhiloxRandom.h"
+#include "TMCtls.h"
+#include "TVirtualMC.h"
+
+/** \class TMCRandomStreams
+    \ingroup vmc
+
+Service providing reproducible random number streams in sequential and
+multi-threaded applications.
+
+Each thread gets its own TMCPhiloxRandom generator. At the beginning of
+each event, the application calls BeginEvent() which positions the
+generator of the calling thread on the stream defined by the master
+seed, the run number, the event number and the engine id, and installs
+it in the current engine via the virtual TVirtualMC::SetEngineRandom(),
+which the engines wrapping their generator override as SetRandom(). The
+random numbers of an event then do not depend on the thread processing it
+or on the events processed before, and any event can be reproduced in
+isolation:
+
+~~~ {.cpp}
+void MyApplication::BeginEvent()
+{
+   TMCRandomStreams::Instance()->BeginEvent(fEventNo);
+   ...
+}
+~~~
+
+No lock is involved: the master seed and the run number are shared
+atomically, the generators are thread-local. The global gRandom is not
+changed as it is shared by all threads; the user code has to draw its
+numbers from the generator returned by BeginEvent() or from
+TVirtualMC::GetRandom() of the current engine.
+*/
+
+namespace {
+// The random number generator of each thread; it is not deleted
+// at the thread exit as it may be still referred to by an engine
+TMCThreadLocal TMCPhiloxRandom *threadRandom = nullptr;
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCRandomStreams::TMCRandomStreams() : fMasterSeed(0), fRunNumber(0) {}
+
+//
+// static methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the service instance (shared by all threads)
+///
+
+TMCRandomStreams *TMCRandomStreams::Instance()
+{
+   static TMCRandomStreams instance;
+   return &instance;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position the generator of this thread on the stream of the event eventId
+/// and install it in the current engine.
+/// - eventId   The event number
+/// - engineId  The engine id; the id of the current engine is used if -1
+/// - Return:   The generator of this thread
+///
+
+TMCPhiloxRandom *TMCRandomStreams::BeginEvent(Int_t eventId, Int_t engineId)
+{
+   TVirtualMC *mc = TVirtualMC::GetMC();
+   if (engineId < 0) {
+      engineId = mc ? mc->GetId() : 0;
+   }
+
+   TMCPhiloxRandom *random = SelectStream(eventId, engineId, 0);
+   if (mc && mc->GetRandom() != random) {
+      mc->SetEngineRandom(random);
+   }
+   return random;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position the generator of this thread on the given stream.
+/// - eventId    The event number
+/// - engineId   The engine id
+/// - subStream  The sub-stream number, eg. the primary track number
+/// - Return:    The generator of this thread
+///
+
+TMCPhiloxRandom *TMCRandomStreams::SelectStream(Int_t eventId, Int_t engineId, Int_t subStream)
+{
+   TMCPhiloxRandom *random = GetRandom();
+   if (random->GetMasterSeed() != fMasterSeed) {
+      random->SetMasterSeed(fMasterSeed);
+   }
+   random->SetStream(fRunNumber, eventId, engineId, subStream);
+   return random;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the master seed; it is applied in the next BeginEvent() call
+/// on each thread
+///
+
+void TMCRandomStreams::SetMasterSeed(ULong64_t seed)
+{
+   fMasterSeed = seed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the run number; it is applied in the next BeginEvent() call
+/// on each thread
+///
+
+void TMCRandomStreams::SetRunNumber(Int_t runNumber)
+{
+   fRunNumber = runNumber;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the generator of this thread (created on the first call)
+///
+
+TMCPhiloxRandom *TMCRandomStreams::GetRandom() const
+{
+   if (!threadRandom) {
+      threadRandom = new TMCPhiloxRandom(fMasterSeed);
+   }
+   return threadRandom;
+}
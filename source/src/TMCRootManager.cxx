@@ -17,6 +17,8 @@
 #include "TError.h"
 #include "TFile.h"
 #include "TMCAutoLock.h"
+#include "TMCThreadContext.h"
+#include "TMCTrace.h"
 #include "TThread.h"
 #include "TTree.h"
 
@@ -99,6 +101,7 @@ TMCRootManager::TMCRootManager(const char *projectName, TMCRootManager::FileMode
    }
 
    fgInstance = this;
+   TMCThreadContext::Instance().fRootManager = this;
 
    // open file and create a tree
    OpenFile(projectName, fileMode, threadRank);
@@ -127,6 +130,10 @@ TMCRootManager::~TMCRootManager()
 
    --fgCounter;
 
+   if (TMCThreadContext::Instance().fRootManager == this) {
+      TMCThreadContext::Instance().fRootManager = nullptr;
+   }
+
    // unlock mutex
    lk.unlock();
 
@@ -210,6 +217,7 @@ void TMCRootManager::Fill()
 {
    /// Fill the Root tree.
 
+   TMC_TRACE_SCOPE("TMCRootManager::Fill");
    fFile->cd();
    fTree->Fill();
 }
@@ -219,10 +227,23 @@ void TMCRootManager::WriteAll()
 {
    /// Write the Root tree in the file.
 
+   TMC_TRACE_SCOPE("TMCRootManager::WriteAll");
    fFile->cd();
    fFile->Write();
 }
 
+//_____________________________________________________________________________
+void TMCRootManager::WriteObject(const TObject *object, const char *name)
+{
+   /// Write the given object (eg. a histogram) in the file.
+   /// An object with the same name written before is overwritten.
+   /// \param object  The object to be written
+   /// \param name    The key name (the object name is used if not given)
+
+   fFile->cd();
+   fFile->WriteTObject(object, name, "Overwrite");
+}
+
 //_____________________________________________________________________________
 void TMCRootManager::Close()
 {
@@ -233,6 +254,7 @@ void TMCRootManager::Close()
       return;
    }
 
+   TMC_TRACE_SCOPE("TMCRootManager::Close");
    fFile->cd();
    fFile->Close();
    fIsClosed = true;
@@ -0,0 +1,298 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCScoringMesh.h"
+#include "TError.h"
+#include "TH3D.h"
+#include "TMCRootManager.h"
+
+#include <algorithm>
+
+/** \class TMCTemplateScoringMesh
+    \ingroup vmc
+
+Dense 3D scoring mesh with uniform bins, available in double
+(TMCScoringMesh) and single (TMCScoringMeshF) precision.
+
+The mesh follows the worker lifecycle of TVirtualMCApplication:
+- the master application creates the mesh;
+- each worker application gets its clone with CloneForWorker() in
+  TVirtualMCApplication::CloneForWorker();
+- the stepping code calls Fill() or FillN() on the mesh of its own thread,
+  which updates a private grid without any lock or virtual call;
+- TVirtualMCApplication::FinishRunOnWorker() calls FinishRunOnWorker(),
+  which adds the worker grid to the partial sum of the other finished
+  workers;
+- the master calls Merge() after the workers finished and writes the result
+  with Write() through its TMCRootManager.
+
+The partial sum is exchanged via one atomic pointer: a finishing worker
+takes the sum published by the others, adds it to its own grid and tries to
+publish the result, repeating until the slot is empty. The workers finishing
+at the same time thus reduce their grids pairwise in parallel and no lock is
+taken. Alternatively, the meshes can be merged explicitly with
+Merge(const TMCTemplateScoringMesh&) in TVirtualMCApplication::Merge().
+
+The points outside the mesh are ignored.
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+/// - name   The mesh name (used for the output histogram)
+/// - nx, xmin, xmax  The number of bins and the limits in x; and the same
+///   for y and z
+///
+
+template <typename T>
+TMCTemplateScoringMesh<T>::TMCTemplateScoringMesh(const char *name, Int_t nx, Double_t xmin, Double_t xmax, Int_t ny,
+                                                  Double_t ymin, Double_t ymax, Int_t nz, Double_t zmin,
+                                                  Double_t zmax)
+   : fName(name), fGrid(), fShared(std::make_shared<TSharedData>())
+{
+   Int_t nbins[3] = {nx, ny, nz};
+   Double_t min[3] = {xmin, ymin, zmin};
+   Double_t max[3] = {xmax, ymax, zmax};
+
+   for (Int_t i = 0; i < 3; ++i) {
+      if (nbins[i] < 1 || !(max[i] > min[i])) {
+         ::Fatal("TMCTemplateScoringMesh::TMCTemplateScoringMesh", "Mesh %s: wrong binning on axis %d.", name, i);
+      }
+      fNbins[i] = nbins[i];
+      fMin[i] = min[i];
+      fMax[i] = max[i];
+      fInvWidth[i] = nbins[i] / (max[i] - min[i]);
+   }
+
+   fGrid.fValues.assign(Long64_t(nx) * ny * nz, T(0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Constructor of a worker clone sharing the merge data with the master
+///
+
+template <typename T>
+TMCTemplateScoringMesh<T>::TMCTemplateScoringMesh(const TMCTemplateScoringMesh &master, Bool_t /*isWorker*/)
+   : fName(master.fName), fGrid(), fShared(master.fShared)
+{
+   for (Int_t i = 0; i < 3; ++i) {
+      fNbins[i] = master.fNbins[i];
+      fMin[i] = master.fMin[i];
+      fMax[i] = master.fMax[i];
+      fInvWidth[i] = master.fInvWidth[i];
+   }
+
+   fGrid.fValues.assign(master.fGrid.fValues.size(), T(0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+template <typename T>
+TMCTemplateScoringMesh<T>::~TMCTemplateScoringMesh()
+{
+}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the values of the other grid
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::Add(TGrid &grid, const TGrid &other)
+{
+   T *values = grid.fValues.data();
+   const T *otherValues = other.fValues.data();
+   size_t size = grid.fValues.size();
+   for (size_t i = 0; i < size; ++i)
+      values[i] += otherValues[i];
+   grid.fNofEntries += other.fNofEntries;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create the mesh for a worker thread; the returned object is owned by
+/// the caller (the worker application)
+///
+
+template <typename T>
+TMCTemplateScoringMesh<T> *TMCTemplateScoringMesh<T>::CloneForWorker() const
+{
+   return new TMCTemplateScoringMesh(*this, kTRUE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the grid of this worker to the partial sum of the finished workers
+/// and reset it for the next run
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::FinishRunOnWorker()
+{
+   TGrid *grid = new TGrid();
+   grid->fValues.swap(fGrid.fValues);
+   grid->fNofEntries = fGrid.fNofEntries;
+   Reset();
+
+   while (true) {
+      TGrid *other = fShared->fMergeSlot.exchange(nullptr, std::memory_order_acq_rel);
+      if (!other) {
+         TGrid *expected = nullptr;
+         if (fShared->fMergeSlot.compare_exchange_strong(expected, grid, std::memory_order_acq_rel))
+            return;
+         // another worker published its sum meanwhile
+         continue;
+      }
+      Add(*grid, *other);
+      delete other;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the sum of the finished workers to this mesh; to be called by
+/// the master after all workers finished the run
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::Merge()
+{
+   TGrid *sum = fShared->fMergeSlot.exchange(nullptr, std::memory_order_acq_rel);
+   if (!sum)
+      return;
+
+   Add(fGrid, *sum);
+   delete sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the values of the other mesh with the same binning
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::Merge(const TMCTemplateScoringMesh &other)
+{
+   if (other.fGrid.fValues.size() != fGrid.fValues.size()) {
+      ::Error("TMCTemplateScoringMesh::Merge", "Mesh %s: incompatible binning of %s.", fName.Data(),
+              other.fName.Data());
+      return;
+   }
+
+   Add(fGrid, other.fGrid);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Fill n points; the bin indices are computed in chunks before the values
+/// are accumulated, which lets the compiler vectorize the index computation
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::FillN(Int_t n, const Double_t *x, const Double_t *y, const Double_t *z,
+                                      const Double_t *w)
+{
+   const Int_t kChunkSize = 64;
+   Long64_t index[kChunkSize];
+   T *values = fGrid.fValues.data();
+
+   for (Int_t start = 0; start < n; start += kChunkSize) {
+      Int_t size = std::min(kChunkSize, n - start);
+      for (Int_t i = 0; i < size; ++i) {
+         index[i] = FindBin(x[start + i], y[start + i], z[start + i]);
+      }
+      for (Int_t i = 0; i < size; ++i) {
+         if (index[i] < 0)
+            continue;
+         values[index[i]] += T(w[start + i]);
+         ++fGrid.fNofEntries;
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Reset the grid of this thread
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::Reset()
+{
+   fGrid.fValues.assign(Long64_t(fNbins[0]) * fNbins[1] * fNbins[2], T(0));
+   fGrid.fNofEntries = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create a histogram with the content of this mesh; the histogram
+/// is not attached to any directory and is owned by the caller
+/// - name  The histogram name (the mesh name is used if not given)
+///
+
+template <typename T>
+TH3D *TMCTemplateScoringMesh<T>::CreateHistogram(const char *name) const
+{
+   TH3D *histogram = new TH3D(name ? name : fName.Data(), fName.Data(), fNbins[0], fMin[0], fMax[0], fNbins[1],
+                              fMin[1], fMax[1], fNbins[2], fMin[2], fMax[2]);
+   histogram->SetDirectory(0);
+
+   for (Int_t iz = 0; iz < fNbins[2]; ++iz) {
+      for (Int_t iy = 0; iy < fNbins[1]; ++iy) {
+         for (Int_t ix = 0; ix < fNbins[0]; ++ix) {
+            histogram->SetBinContent(ix + 1, iy + 1, iz + 1, GetBinContent(ix, iy, iz));
+         }
+      }
+   }
+   histogram->SetEntries(fGrid.fNofEntries);
+
+   return histogram;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the mesh as a TH3D histogram in the file of the given manager
+///
+
+template <typename T>
+void TMCTemplateScoringMesh<T>::Write(TMCRootManager *rootManager) const
+{
+   if (!rootManager) {
+      ::Error("TMCTemplateScoringMesh::Write", "Mesh %s: no TMCRootManager is defined.", fName.Data());
+      return;
+   }
+
+   TH3D *histogram = CreateHistogram();
+   rootManager->WriteObject(histogram);
+   delete histogram;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the content of the given bin (numbered from 0)
+///
+
+template <typename T>
+T TMCTemplateScoringMesh<T>::GetBinContent(Int_t ix, Int_t iy, Int_t iz) const
+{
+   return fGrid.fValues[(Long64_t(iz) * fNbins[1] + iy) * fNbins[0] + ix];
+}
+
+template class TMCTemplateScoringMesh<Float_t>;
+template class TMCTemplateScoringMesh<Double_t>;
@@ -0,0 +1,329 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCStepRecorder.h"
+#include "RZip.h"
+#include "TError.h"
+#include "TVirtualMC.h"
+#include "TVirtualMCStack.h"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+/** \class TMCStepRecorder
+    \ingroup vmc
+
+Recorder of the step history in a compact binary trace, for the validation
+of the engines (see TMCStepTraceReader and the vmc_steptrace tool).
+
+The user application owns the recorder, as TMCVerbose, and calls its
+BeginEvent(eventId), Stepping() and FinishEvent() in its own hooks.
+Each step is stored as one fixed-size TMCStepRecord (56 bytes); the
+records are accumulated in a buffer of the thread and written as one block
+per event, or per SetBufferSize() records in long events. With
+a compression setting (the ROOT setting, eg. 101 for zlib or 505 for zstd),
+the blocks are compressed with R__zip in the recording thread. The names
+of the volumes are written once per thread in the volume blocks, so that
+the traces of engines with different volume ids can be compared.
+
+In multi-threaded applications the workers get their recorders with
+CloneForWorker() in TVirtualMCApplication::CloneForWorker() and call
+FinishRunOnWorker() at the end of run; all recorders write in the same
+file, the blocks are written under a lock. The master calls Close() after
+the workers finished.
+
+The file format is described in TMCStepRecorder.h; the values are stored
+in the native byte order.
+*/
+
+/// The output file shared by the master recorder and its worker clones
+struct TMCStepRecorder::TSharedFile {
+   std::ofstream fStream; ///< The output stream
+   std::mutex fMutex;     ///< The mutex protecting the stream
+   Int_t fCompression;    ///< The ROOT compression setting
+};
+
+namespace {
+/// The maximal block size accepted by R__zip
+const Int_t kMaxBlockSize = 0xffffff;
+
+/// Compress the content if required; write the block header and the content
+void WriteBlock(std::ofstream &stream, Int_t compression, TMCStepTrace::TBlockHeader header, const char *content,
+                std::vector<char> &zipBuffer, std::mutex &mutex)
+{
+   const char *stored = content;
+   header.fStoredSize = header.fRawSize;
+   if (compression > 0 && header.fRawSize > 0) {
+      zipBuffer.resize(header.fRawSize);
+      Int_t srcSize = header.fRawSize;
+      Int_t tgtSize = header.fRawSize;
+      Int_t zipSize = 0;
+      R__zip(compression, &srcSize, const_cast<char *>(content), &tgtSize, zipBuffer.data(), &zipSize);
+      // zipSize is 0 if the compressed content would not be smaller
+      if (zipSize > 0 && zipSize < Int_t(header.fRawSize)) {
+         stored = zipBuffer.data();
+         header.fStoredSize = zipSize;
+      }
+   }
+
+   std::lock_guard<std::mutex> lock(mutex);
+   stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   stream.write(stored, header.fStoredSize);
+}
+
+/// Append the value to the buffer
+template <typename T>
+void Append(std::vector<char> &buffer, const T &value)
+{
+   const char *bytes = reinterpret_cast<const char *>(&value);
+   buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+/// - fileName     The output file (overwritten)
+/// - compression  The ROOT compression setting (0 = no compression)
+///
+
+TMCStepRecorder::TMCStepRecorder(const char *fileName, Int_t compression)
+   : fFile(std::make_shared<TSharedFile>()),
+     fRecords(),
+     fBufferSize(16384),
+     fEventId(-1),
+     fNofRecords(0),
+     fProcesses(),
+     fKnownVolumes(),
+     fNewVolumes(),
+     fNofNewVolumes(0)
+{
+   fFile->fCompression = compression;
+   fFile->fStream.open(fileName, std::ios::binary | std::ios::trunc);
+   if (!fFile->fStream) {
+      ::Fatal("TMCStepRecorder::TMCStepRecorder", "Cannot open the file %s.", fileName);
+   }
+
+   TMCStepTrace::TFileHeader header;
+   std::memcpy(header.fMagic, TMCStepTrace::kMagic, sizeof(header.fMagic));
+   header.fVersion = TMCStepTrace::kVersion;
+   header.fRecordSize = sizeof(TMCStepRecord);
+   header.fCompression = compression;
+   header.fReserved = 0;
+   fFile->fStream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   fRecords.reserve(fBufferSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Constructor of a worker clone writing in the file of the master
+///
+
+TMCStepRecorder::TMCStepRecorder(const TMCStepRecorder &master, Bool_t /*isWorker*/)
+   : fFile(master.fFile),
+     fRecords(),
+     fBufferSize(master.fBufferSize),
+     fEventId(-1),
+     fNofRecords(0),
+     fProcesses(),
+     fKnownVolumes(),
+     fNewVolumes(),
+     fNofNewVolumes(0)
+{
+   fRecords.reserve(fBufferSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor; the pending records are written
+///
+
+TMCStepRecorder::~TMCStepRecorder()
+{
+   FlushBuffer();
+}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the new volume names and the buffered records
+///
+
+void TMCStepRecorder::FlushBuffer()
+{
+   if (fRecords.empty() && !fNofNewVolumes)
+      return;
+
+   if (!fFile->fStream.is_open()) {
+      ::Error("TMCStepRecorder::FlushBuffer", "The file was already closed, %d records are lost.",
+              Int_t(fRecords.size()));
+      fRecords.clear();
+      return;
+   }
+
+   std::vector<char> zipBuffer;
+   if (fNofNewVolumes) {
+      TMCStepTrace::TBlockHeader header = {TMCStepTrace::kVolumeBlock, -1, fNofNewVolumes, UInt_t(fNewVolumes.size()),
+                                           0, 0};
+      WriteBlock(fFile->fStream, fFile->fCompression, header, fNewVolumes.data(), zipBuffer, fFile->fMutex);
+      fNewVolumes.clear();
+      fNofNewVolumes = 0;
+   }
+
+   if (!fRecords.empty()) {
+      TMCStepTrace::TBlockHeader header = {TMCStepTrace::kStepBlock,
+                                           fEventId,
+                                           UInt_t(fRecords.size()),
+                                           UInt_t(fRecords.size() * sizeof(TMCStepRecord)),
+                                           0,
+                                           0};
+      WriteBlock(fFile->fStream, fFile->fCompression, header, reinterpret_cast<const char *>(fRecords.data()),
+                 zipBuffer, fFile->fMutex);
+      fRecords.clear();
+   }
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Create the recorder for a worker thread; the returned object is owned by
+/// the caller (the worker application)
+///
+
+TMCStepRecorder *TMCStepRecorder::CloneForWorker() const
+{
+   return new TMCStepRecorder(*this, kTRUE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the pending records of this worker
+///
+
+void TMCStepRecorder::FinishRunOnWorker()
+{
+   FlushBuffer();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Start recording the event with the given id
+///
+
+void TMCStepRecorder::BeginEvent(Int_t eventId)
+{
+   FlushBuffer();
+   fEventId = eventId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Record the current step; to be called from
+/// TVirtualMCApplication::Stepping()
+///
+
+void TMCStepRecorder::Stepping()
+{
+   TVirtualMC *mc = TVirtualMC::GetMC();
+
+   TMCStepRecord record;
+   record.fTrackId = mc->GetStack()->GetCurrentTrackNumber();
+   record.fStepNumber = mc->StepNumber();
+   record.fPdg = mc->TrackPid();
+   Int_t copyNo;
+   record.fVolId = mc->CurrentVolID(copyNo);
+   record.fEngineId = mc->GetId();
+
+   Double_t x, y, z, t;
+   mc->TrackPosition(x, y, z);
+   t = mc->TrackTime();
+   record.fX = x;
+   record.fY = y;
+   record.fZ = z;
+   record.fT = t;
+
+   Double_t px, py, pz, etot;
+   mc->TrackMomentum(px, py, pz, etot);
+   record.fEkin = etot - mc->TrackMass();
+   record.fEdep = mc->Edep();
+   record.fStep = mc->TrackStep();
+
+   record.fProcessMask = 0;
+   Int_t nofProcesses = mc->StepProcesses(fProcesses);
+   for (Int_t i = 0; i < nofProcesses; ++i) {
+      if (fProcesses[i] >= 0 && fProcesses[i] < 64)
+         record.fProcessMask |= ULong64_t(1) << fProcesses[i];
+   }
+
+   // the volume name, once per thread
+   if (fKnownVolumes.insert(std::make_pair(record.fEngineId, record.fVolId)).second) {
+      const char *volName = mc->CurrentVolName();
+      Int_t length = volName ? std::strlen(volName) : 0;
+      Append(fNewVolumes, record.fEngineId);
+      Append(fNewVolumes, record.fVolId);
+      Append(fNewVolumes, length);
+      fNewVolumes.insert(fNewVolumes.end(), volName, volName + length);
+      ++fNofNewVolumes;
+   }
+
+   fRecords.push_back(record);
+   ++fNofRecords;
+   if (Int_t(fRecords.size()) >= fBufferSize)
+      FlushBuffer();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the records of the current event
+///
+
+void TMCStepRecorder::FinishEvent()
+{
+   FlushBuffer();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the pending records and close the file; to be called by the master
+/// after the workers finished
+///
+
+void TMCStepRecorder::Close()
+{
+   FlushBuffer();
+
+   std::lock_guard<std::mutex> lock(fFile->fMutex);
+   if (fFile->fStream.is_open())
+      fFile->fStream.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the number of records which triggers the writing of a block
+/// within an event
+///
+
+void TMCStepRecorder::SetBufferSize(Int_t nofRecords)
+{
+   Int_t maxNofRecords = kMaxBlockSize / sizeof(TMCStepRecord);
+   if (nofRecords < 1 || nofRecords > maxNofRecords) {
+      ::Error("TMCStepRecorder::SetBufferSize", "The buffer size must be in [1, %d].", maxNofRecords);
+      return;
+   }
+
+   fBufferSize = nofRecords;
+   fRecords.reserve(fBufferSize);
+}
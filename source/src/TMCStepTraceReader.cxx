@@ -0,0 +1,184 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCStepTraceReader.h"
+#include "RZip.h"
+#include "TError.h"
+
+#include <cstring>
+
+/** \class TMCStepTraceReader
+    \ingroup vmc
+
+Reader of the step trace files written by TMCStepRecorder.
+
+ReadBlock() returns the records block by block, in the file order;
+ReadEvents() collects the records of all events (or of one selected event),
+merging the blocks of the same event. The volume names are available
+with GetVolumeName() for the volumes of the blocks read so far.
+*/
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor; the file header is checked
+///
+
+TMCStepTraceReader::TMCStepTraceReader(const char *fileName)
+   : fStream(fileName, std::ios::binary), fFileName(fileName), fIsOpen(kFALSE), fHeader(), fVolNames(), fContent(),
+     fZipBuffer()
+{
+   if (!fStream) {
+      ::Error("TMCStepTraceReader::TMCStepTraceReader", "Cannot open the file %s.", fileName);
+      return;
+   }
+
+   fStream.read(reinterpret_cast<char *>(&fHeader), sizeof(fHeader));
+   if (!fStream || std::memcmp(fHeader.fMagic, TMCStepTrace::kMagic, sizeof(fHeader.fMagic)) != 0) {
+      ::Error("TMCStepTraceReader::TMCStepTraceReader", "%s is not a step trace file.", fileName);
+      return;
+   }
+   if (fHeader.fVersion != TMCStepTrace::kVersion || fHeader.fRecordSize != sizeof(TMCStepRecord)) {
+      ::Error("TMCStepTraceReader::TMCStepTraceReader", "%s: unsupported version %u or record size %u.", fileName,
+              fHeader.fVersion, fHeader.fRecordSize);
+      return;
+   }
+
+   fIsOpen = kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCStepTraceReader::~TMCStepTraceReader() {}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Read the block content and uncompress it if needed
+///
+
+Bool_t TMCStepTraceReader::ReadContent(const TMCStepTrace::TBlockHeader &header, std::vector<char> &content)
+{
+   content.resize(header.fRawSize);
+   if (header.fStoredSize == header.fRawSize) {
+      fStream.read(content.data(), header.fRawSize);
+      return bool(fStream);
+   }
+
+   fZipBuffer.resize(header.fStoredSize);
+   fStream.read(fZipBuffer.data(), header.fStoredSize);
+   if (!fStream)
+      return kFALSE;
+
+   Int_t srcSize = header.fStoredSize;
+   Int_t tgtSize = header.fRawSize;
+   Int_t unzipSize = 0;
+   R__unzip(&srcSize, reinterpret_cast<unsigned char *>(fZipBuffer.data()), &tgtSize,
+            reinterpret_cast<unsigned char *>(content.data()), &unzipSize);
+   return unzipSize == Int_t(header.fRawSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Add the volume names of the volume block
+///
+
+void TMCStepTraceReader::AddVolumes(const TMCStepTrace::TBlockHeader &header, const std::vector<char> &content)
+{
+   const char *data = content.data();
+   const char *end = data + content.size();
+   for (UInt_t i = 0; i < header.fNofEntries && data + 3 * sizeof(Int_t) <= end; ++i) {
+      Int_t ids[3];
+      std::memcpy(ids, data, sizeof(ids));
+      data += sizeof(ids);
+      if (ids[2] < 0 || data + ids[2] > end)
+         break;
+      fVolNames[std::make_pair(ids[0], ids[1])].assign(data, ids[2]);
+      data += ids[2];
+   }
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Read the next block of steps; the volume blocks are processed on the way.
+/// Return false at the end of the file or on an error.
+///
+
+Bool_t TMCStepTraceReader::ReadBlock(Int_t &eventId, std::vector<TMCStepRecord> &records)
+{
+   if (!fIsOpen)
+      return kFALSE;
+
+   TMCStepTrace::TBlockHeader header;
+   while (fStream.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+      if (!ReadContent(header, fContent)) {
+         ::Error("TMCStepTraceReader::ReadBlock", "%s: corrupted block.", fFileName.Data());
+         return kFALSE;
+      }
+
+      if (header.fType == TMCStepTrace::kVolumeBlock) {
+         AddVolumes(header, fContent);
+         continue;
+      }
+      if (header.fType != TMCStepTrace::kStepBlock ||
+          header.fRawSize != header.fNofEntries * sizeof(TMCStepRecord)) {
+         ::Error("TMCStepTraceReader::ReadBlock", "%s: unknown block type %u.", fFileName.Data(), header.fType);
+         return kFALSE;
+      }
+
+      eventId = header.fEventId;
+      records.resize(header.fNofEntries);
+      std::memcpy(records.data(), fContent.data(), header.fRawSize);
+      return kTRUE;
+   }
+
+   return kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Read all the remaining blocks and collect the records per event;
+/// only the selected event is kept if selectedEvent >= 0
+///
+
+Bool_t TMCStepTraceReader::ReadEvents(std::map<Int_t, std::vector<TMCStepRecord>> &events, Int_t selectedEvent)
+{
+   if (!fIsOpen)
+      return kFALSE;
+
+   Int_t eventId;
+   std::vector<TMCStepRecord> records;
+   while (ReadBlock(eventId, records)) {
+      if (selectedEvent >= 0 && eventId != selectedEvent)
+         continue;
+      std::vector<TMCStepRecord> &eventRecords = events[eventId];
+      eventRecords.insert(eventRecords.end(), records.begin(), records.end());
+   }
+
+   return fStream.eof();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the name of the given volume, or "unknown"
+///
+
+const char *TMCStepTraceReader::GetVolumeName(Int_t engineId, Int_t volId) const
+{
+   auto it = fVolNames.find(std::make_pair(engineId, volId));
+   return it != fVolNames.end() ? it->second.c_str() : "unknown";
+}
@@ -0,0 +1,61 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCThreadContext.h"
+#include "TMCtls.h"
+#include "TVirtualMC.h"
+
+/** \struct TMCThreadContext
+    \ingroup vmc
+
+The VMC objects of the current thread gathered in one thread-local
+structure, so that they can be obtained with a single thread-local
+storage access instead of one access per singleton:
+
+~~~ {.cpp}
+TMCThreadContext &context = TMCThreadContext::Instance();
+Int_t trackId = context.fStack->GetCurrentTrackNumber();
+context.fMC->TrackPosition(x, y, z);
+~~~
+
+The reference returned by Instance() stays valid for the lifetime of the
+thread; it can be therefore kept, eg. by the worker application in
+InitOnWorker(), and passed explicitly to the code called at each step.
+
+The context is kept up-to-date by the VMC classes whenever their
+singleton instances change; the existing static accessors,
+TVirtualMC::GetMC(), TVirtualMCApplication::Instance(),
+TMCManager::Instance() and TMCRootManager::Instance(), are not affected.
+*/
+
+namespace {
+// The context of this thread
+TMCThreadLocal TMCThreadContext threadContext;
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the context of this thread
+///
+
+TMCThreadContext &TMCThreadContext::Instance()
+{
+   return threadContext;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the current engine and its stack
+///
+
+void TMCThreadContext::SetMC(TVirtualMC *mc)
+{
+   TMCThreadContext &context = threadContext;
+   context.fMC = mc;
+   context.fStack = mc ? mc->GetStack() : nullptr;
+}
@@ -0,0 +1,320 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCTrace.h"
+#include "TError.h"
+
+#if defined(VMC_WITH_TRACING)
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#endif
+
+/** \class TMCTrace
+    \ingroup vmc
+
+Event-trace recorder of the VMC run lifecycle.
+
+The spans are recorded with the TMC_TRACE_SCOPE, TMC_TRACE_SCOPE_ARG and
+TMC_TRACE_INSTANT macros, placed in TMCManager (the event loop, the engine
+switches and the ProcessEvent slices of each engine) and in TMCRootManager
+(Fill, WriteAll, Close); the user code can add its own spans.
+
+Each thread records in its own ring buffer: the owner thread writes the
+event in the next slot and publishes it by advancing an atomic index, so
+the recording takes neither a lock nor an allocation. When a buffer is
+full, the oldest events are overwritten. The buffers are registered once
+per thread and kept until Clear(), so the events of the finished threads
+are still written.
+
+Write() serializes all buffers in the Chrome trace JSON format, which is
+read by Perfetto (ui.perfetto.dev) and chrome://tracing; it should be
+called when the threads do not record (eg. at the end of run).
+If the environment variable VMC_TRACE_FILE is set, the trace is also
+written in this file at the program exit.
+
+The recording is available only when the library is built with
+VMC_WITH_TRACING; otherwise the macros expand to nothing and the
+functions of this class have no effect.
+*/
+
+#if defined(VMC_WITH_TRACING)
+
+namespace {
+
+/// The recorded event; a negative duration means an instant event
+struct TTraceEvent {
+   const char *fName;
+   const char *fArgName;
+   Long64_t fArgValue;
+   Long64_t fStart;
+   Long64_t fDuration;
+};
+
+/// The ring buffer of one thread
+struct TTraceBuffer {
+   Int_t fThreadId;                  ///< The sequential thread id
+   std::vector<TTraceEvent> fEvents; ///< The events (the size is a power of 2)
+   std::atomic<ULong64_t> fHead;     ///< The number of recorded events
+
+   TTraceBuffer(Int_t threadId, Int_t size) : fThreadId(threadId), fEvents(size), fHead(0) {}
+};
+
+/// The registry of the buffers; never deleted, the threads may record
+/// during the static destruction
+struct TTraceRegistry {
+   std::mutex fMutex;
+   std::deque<TTraceBuffer> fBuffers;
+   std::atomic<Bool_t> fIsEnabled{kTRUE};
+   Int_t fBufferSize = 1 << 16;
+   Long64_t fStartTime = TMCTrace::Now();
+   std::atomic<ULong64_t> fGeneration{0};
+};
+
+TTraceRegistry &GetRegistry()
+{
+   static TTraceRegistry *registry = new TTraceRegistry();
+   return *registry;
+}
+
+thread_local TTraceBuffer *tlsBuffer = nullptr;
+thread_local ULong64_t tlsGeneration = 0;
+
+/// Write the trace in the file given by VMC_TRACE_FILE
+void WriteAtExit()
+{
+   const char *fileName = std::getenv("VMC_TRACE_FILE");
+   if (fileName && *fileName)
+      TMCTrace::Write(fileName);
+}
+
+/// Return the buffer of this thread, registering it at the first call
+/// (and after Clear())
+TTraceBuffer *GetBuffer()
+{
+   TTraceRegistry &registry = GetRegistry();
+   ULong64_t generation = registry.fGeneration.load(std::memory_order_acquire);
+   if (tlsBuffer && tlsGeneration == generation)
+      return tlsBuffer;
+
+   std::lock_guard<std::mutex> lock(registry.fMutex);
+   if (registry.fBuffers.empty() && generation == 0) {
+      // the first buffer: install the writing at exit
+      std::atexit(WriteAtExit);
+   }
+   registry.fBuffers.emplace_back(Int_t(registry.fBuffers.size()), registry.fBufferSize);
+   tlsBuffer = &registry.fBuffers.back();
+   tlsGeneration = generation;
+   return tlsBuffer;
+}
+
+/// Record the event in the buffer of this thread
+void Record(const char *name, const char *argName, Long64_t argValue, Long64_t start, Long64_t duration)
+{
+   TTraceBuffer *buffer = GetBuffer();
+   ULong64_t head = buffer->fHead.load(std::memory_order_relaxed);
+   TTraceEvent &event = buffer->fEvents[head & (buffer->fEvents.size() - 1)];
+   event.fName = name;
+   event.fArgName = argName;
+   event.fArgValue = argValue;
+   event.fStart = start;
+   event.fDuration = duration;
+   buffer->fHead.store(head + 1, std::memory_order_release);
+}
+
+/// Write the string with the JSON escapes
+void WriteString(std::ostream &out, const char *string)
+{
+   out << '"';
+   for (const char *c = string ? string : ""; *c; ++c) {
+      if (*c == '"' || *c == '\\')
+         out << '\\' << *c;
+      else if (static_cast<unsigned char>(*c) < 0x20)
+         out << ' ';
+      else
+         out << *c;
+   }
+   out << '"';
+}
+
+/// Write the time in us with the ns precision
+void WriteTime(std::ostream &out, Long64_t ns)
+{
+   char value[32];
+   std::snprintf(value, sizeof(value), "%lld.%03lld", ns / 1000, ns % 1000);
+   out << value;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return true if the events are recorded
+///
+
+Bool_t TMCTrace::IsEnabled()
+{
+   return GetRegistry().fIsEnabled.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Switch the recording on or off (on by default)
+///
+
+void TMCTrace::SetEnabled(Bool_t enabled)
+{
+   GetRegistry().fIsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the number of events kept per thread (rounded up to a power of 2);
+/// it applies to the buffers created after this call
+///
+
+void TMCTrace::SetBufferSize(Int_t nofEvents)
+{
+   if (nofEvents < 1) {
+      ::Error("TMCTrace::SetBufferSize", "Wrong buffer size %d.", nofEvents);
+      return;
+   }
+
+   Int_t size = 1;
+   while (size < nofEvents)
+      size <<= 1;
+
+   TTraceRegistry &registry = GetRegistry();
+   std::lock_guard<std::mutex> lock(registry.fMutex);
+   registry.fBufferSize = size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Write the recorded events in the Chrome trace JSON format;
+/// return false if the file cannot be opened
+///
+
+Bool_t TMCTrace::Write(const char *fileName)
+{
+   std::ofstream out(fileName);
+   if (!out) {
+      ::Error("TMCTrace::Write", "Cannot open the file %s.", fileName);
+      return kFALSE;
+   }
+
+   TTraceRegistry &registry = GetRegistry();
+   std::lock_guard<std::mutex> lock(registry.fMutex);
+
+   out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+   Bool_t isFirst = kTRUE;
+   for (TTraceBuffer &buffer : registry.fBuffers) {
+      out << (isFirst ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+          << buffer.fThreadId << ", \"args\": {\"name\": \"VMC thread " << buffer.fThreadId << "\"}}";
+      isFirst = kFALSE;
+
+      ULong64_t head = buffer.fHead.load(std::memory_order_acquire);
+      ULong64_t size = buffer.fEvents.size();
+      for (ULong64_t i = (head > size ? head - size : 0); i < head; ++i) {
+         const TTraceEvent &event = buffer.fEvents[i & (size - 1)];
+         out << ",\n{\"name\": ";
+         WriteString(out, event.fName);
+         out << ", \"cat\": \"vmc\", \"pid\": 1, \"tid\": " << buffer.fThreadId << ", \"ts\": ";
+         WriteTime(out, event.fStart - registry.fStartTime);
+         if (event.fDuration >= 0) {
+            out << ", \"ph\": \"X\", \"dur\": ";
+            WriteTime(out, event.fDuration);
+         } else {
+            out << ", \"ph\": \"i\", \"s\": \"t\"";
+         }
+         if (event.fArgName) {
+            out << ", \"args\": {";
+            WriteString(out, event.fArgName);
+            out << ": " << event.fArgValue << "}";
+         }
+         out << "}";
+      }
+      if (head > size) {
+         ::Warning("TMCTrace::Write", "Thread %d: %llu oldest events were overwritten.", buffer.fThreadId,
+                   head - size);
+      }
+   }
+   out << "\n]}" << std::endl;
+
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Remove all recorded events; the threads get new buffers at their next
+/// event. To be called when the threads do not record.
+///
+
+void TMCTrace::Clear()
+{
+   TTraceRegistry &registry = GetRegistry();
+   std::lock_guard<std::mutex> lock(registry.fMutex);
+   registry.fBuffers.clear();
+   registry.fStartTime = Now();
+   registry.fGeneration.fetch_add(1, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Record the span with the given start and end times
+///
+
+void TMCTrace::RecordSpan(const char *name, const char *argName, Long64_t argValue, Long64_t start, Long64_t end)
+{
+   if (!IsEnabled())
+      return;
+
+   Record(name, argName, argValue, start, end - start);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Record the instant event at the current time
+///
+
+void TMCTrace::RecordInstant(const char *name, const char *argName, Long64_t argValue)
+{
+   if (!IsEnabled())
+      return;
+
+   Record(name, argName, argValue, Now(), -1);
+}
+
+#else
+
+Bool_t TMCTrace::IsEnabled()
+{
+   return kFALSE;
+}
+
+void TMCTrace::SetEnabled(Bool_t) {}
+
+void TMCTrace::SetBufferSize(Int_t) {}
+
+Bool_t TMCTrace::Write(const char *)
+{
+   ::Warning("TMCTrace::Write", "The tracing is not enabled (build with VMC_WITH_TRACING=ON).");
+   return kFALSE;
+}
+
+void TMCTrace::Clear() {}
+
+void TMCTrace::RecordSpan(const char *, const char *, Long64_t, Long64_t, Long64_t) {}
+
+void TMCTrace::RecordInstant(const char *, const char *, Long64_t) {}
+
+#endif // defined(VMC_WITH_TRACING)
@@ -23,9 +23,22 @@
 #include "TDatabasePDG.h"
 #include "TParticlePDG.h"
 #include "TArrayI.h"
+#include "TError.h"
+#include "TMCAutoLock.h"
+#include "TMCParticleTable.h"
 
 #include "TMCVerbose.h"
 
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
 /** \class TMCVerbose
     \ingroup vmc
 
@@ -36,22 +49,234 @@ Defined levels:
 - 1  info up to event level
 - 2  info up to tracking level
 - 3  detailed info for each step
+
+The output is formatted in a buffer, without the iostream manipulators,
+and it is written when the buffer exceeds the buffer size (SetBufferSize(),
+64 kB by default), at the end of each event and run, and with Flush().
+With the buffer size 0, each line is written immediately.
+
+The output goes to std::cout, or to the file set with SetOutputFile(),
+which is written by a background thread; the TMCVerbose objects of all
+threads using the same file name share the same writer, the lines of
+different threads are then interleaved by blocks.
+
+The tracking and stepping info (levels 2 and 3) can be restricted with
+the filters on the track id range, the particle PDG code, the volume
+(the steps in other volumes are not printed) and the event range (the
+event number is given by TVirtualMC::CurrentEvent(), so that the same
+events are selected in all threads); the steps which do not pass the
+filters are not formatted.
 */
 
+//
+// Class TMCVerboseSink
+//
+
+/// The file written by a background thread
+class TMCVerboseSink {
+public:
+   TMCVerboseSink(const char *fileName);
+   ~TMCVerboseSink();
+
+   Bool_t IsOpen() const { return fFile.is_open(); }
+   void Write(std::string &chunk);
+
+private:
+   void Run();
+
+   static const size_t fgkMaxNofChunks = 64; ///< The maximal number of pending chunks
+
+   std::ofstream fFile;               ///< The output file
+   std::mutex fMutex;                 ///< The mutex protecting the chunks
+   std::condition_variable fNotEmpty; ///< Signals a new chunk or the stop
+   std::condition_variable fNotFull;  ///< Signals the written chunks
+   std::deque<std::string> fChunks;   ///< The chunks to be written
+   Bool_t fStop;                      ///< Whether the writer should stop
+   std::thread fThread;               ///< The writer thread
+};
+
+namespace {
+TMCMutex sinkRegistryMutex = TMCMUTEX_INITIALIZER;
+
+/// The sinks shared by the file name
+std::map<std::string, std::weak_ptr<TMCVerboseSink>> &GetSinkRegistry()
+{
+   static std::map<std::string, std::weak_ptr<TMCVerboseSink>> registry;
+   return registry;
+}
+
+/// Append the integer right-aligned in the given width
+void AppendInt(std::string &out, Long64_t value, Int_t width)
+{
+   char digits[24];
+   Int_t n = 0;
+   ULong64_t magnitude = value < 0 ? 0 - ULong64_t(value) : ULong64_t(value);
+   do {
+      digits[n++] = char('0' + magnitude % 10);
+      magnitude /= 10;
+   } while (magnitude);
+   if (value < 0)
+      digits[n++] = '-';
+
+   for (Int_t i = n; i < width; ++i)
+      out += ' ';
+   while (n)
+      out += digits[--n];
+}
+
+/// Append the value in the fixed notation with the given precision (up to 6),
+/// right-aligned in the given width, as std::fixed with std::setprecision
+/// and std::setw
+void AppendFixed(std::string &out, Double_t value, Int_t width, Int_t precision)
+{
+   static const ULong64_t kScale[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+   if (!std::isfinite(value) || std::fabs(value) >= 1.e15) {
+      char text[64];
+      std::snprintf(text, sizeof(text), "%*.*f", width, precision, value);
+      out += text;
+      return;
+   }
+
+   // the fraction is separated exactly before the scaling
+   Double_t magnitude = std::fabs(value);
+   ULong64_t integer = ULong64_t(magnitude);
+   ULong64_t fraction = ULong64_t((magnitude - integer) * kScale[precision] + 0.5);
+   if (fraction >= kScale[precision]) {
+      fraction -= kScale[precision];
+      ++integer;
+   }
+
+   char digits[40];
+   Int_t n = 0;
+   for (Int_t i = 0; i < precision; ++i) {
+      digits[n++] = char('0' + fraction % 10);
+      fraction /= 10;
+   }
+   if (precision > 0)
+      digits[n++] = '.';
+   do {
+      digits[n++] = char('0' + integer % 10);
+      integer /= 10;
+   } while (integer);
+   if (std::signbit(value))
+      digits[n++] = '-';
+
+   for (Int_t i = n; i < width; ++i)
+      out += ' ';
+   while (n)
+      out += digits[--n];
+}
+
+/// Append the string right-aligned in the given width
+void AppendString(std::string &out, const char *text, Int_t width)
+{
+   for (Int_t i = Int_t(std::strlen(text)); i < width; ++i)
+      out += ' ';
+   out += text;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// Open the file and start the writer thread
+
+TMCVerboseSink::TMCVerboseSink(const char *fileName) : fFile(fileName), fStop(kFALSE)
+{
+   if (fFile.is_open())
+      fThread = std::thread(&TMCVerboseSink::Run, this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write the pending chunks, stop the writer thread and close the file
+
+TMCVerboseSink::~TMCVerboseSink()
+{
+   if (fThread.joinable()) {
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         fStop = kTRUE;
+      }
+      fNotEmpty.notify_one();
+      fThread.join();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Queue the chunk (its content is moved); wait if the writer is behind
+
+void TMCVerboseSink::Write(std::string &chunk)
+{
+   std::unique_lock<std::mutex> lock(fMutex);
+   fNotFull.wait(lock, [this]() { return fChunks.size() < fgkMaxNofChunks; });
+   fChunks.emplace_back();
+   fChunks.back().swap(chunk);
+   lock.unlock();
+   fNotEmpty.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The writer thread loop
+
+void TMCVerboseSink::Run()
+{
+   std::deque<std::string> chunks;
+   while (true) {
+      {
+         std::unique_lock<std::mutex> lock(fMutex);
+         fNotEmpty.wait(lock, [this]() { return fStop || !fChunks.empty(); });
+         if (fChunks.empty() && fStop)
+            break;
+         chunks.swap(fChunks);
+      }
+      fNotFull.notify_all();
+
+      for (const std::string &chunk : chunks)
+         fFile.write(chunk.data(), chunk.size());
+      chunks.clear();
+   }
+   fFile.flush();
+}
+
+//
+// Class TMCVerbose
+//
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Standard constructor
 
-TMCVerbose::TMCVerbose(Int_t level) : TObject(), fLevel(level), fStepNumber(0) {}
+TMCVerbose::TMCVerbose(Int_t level)
+   : TObject(),
+     fLevel(level),
+     fStepNumber(0),
+     fProcesses(),
+     fBuffer(),
+     fBufferSize(65536),
+     fSink(),
+     fMinTrackId(0),
+     fMaxTrackId(-1),
+     fPdg(0),
+     fVolName(),
+     fVolId(-1),
+     fVolIdMC(nullptr),
+     fMinEvent(0),
+     fMaxEvent(-1),
+     fIsEventSelected(kTRUE),
+     fIsTrackSelected(kTRUE)
+{
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Default constructor
 
-TMCVerbose::TMCVerbose() : TObject(), fLevel(0), fStepNumber(0) {}
+TMCVerbose::TMCVerbose() : TMCVerbose(0) {}
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Destructor
 
-TMCVerbose::~TMCVerbose() {}
+TMCVerbose::~TMCVerbose()
+{
+   Flush();
+}
 
 //
 // private methods
@@ -60,53 +285,113 @@ TMCVerbose::~TMCVerbose() {}
 ////////////////////////////////////////////////////////////////////////////////
 /// Prints banner for track information
 
-void TMCVerbose::PrintBanner() const
+void TMCVerbose::PrintBanner()
 {
-   std::cout << std::endl;
+   fBuffer += '\n';
    for (Int_t i = 0; i < 10; i++)
-      std::cout << "**********";
-   std::cout << std::endl;
+      fBuffer += "**********";
+   EndLine();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Prints track information
 
-void TMCVerbose::PrintTrackInfo() const
+void TMCVerbose::PrintTrackInfo()
 {
    // Particle
    //
-   std::cout << "  Particle = ";
-   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(gMC->TrackPid());
-   if (particle)
-      std::cout << particle->GetName() << "  ";
-   else
-      std::cout << "unknown"
-                << "  ";
+   fBuffer += "  Particle = ";
+   const TMCParticleTable *table = TMCParticleTable::Instance();
+   Int_t index = table ? gMC->TrackPidIndex() : -1;
+   if (index >= 0) {
+      fBuffer += table->GetName(index).Data();
+   } else {
+      TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(gMC->TrackPid());
+      fBuffer += particle ? particle->GetName() : "unknown";
+   }
+   fBuffer += "  ";
 
    // Track ID
    //
-   std::cout << "   Track ID = " << gMC->GetStack()->GetCurrentTrackNumber() << "  ";
+   fBuffer += "   Track ID = ";
+   AppendInt(fBuffer, gMC->GetStack()->GetCurrentTrackNumber(), 0);
+   fBuffer += "  ";
 
    // Parent ID
    //
-   std::cout << "   Parent ID = " << gMC->GetStack()->GetCurrentParentTrackNumber();
+   fBuffer += "   Parent ID = ";
+   AppendInt(fBuffer, gMC->GetStack()->GetCurrentParentTrackNumber(), 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Prints the header for stepping information
 
-void TMCVerbose::PrintStepHeader() const
+void TMCVerbose::PrintStepHeader()
+{
+   PrintLine("Step#     "
+             "X(cm)    "
+             "Y(cm)    "
+             "Z(cm)  "
+             "KinE(MeV)   "
+             "dE(MeV) "
+             "Step(cm) "
+             "TrackL(cm) "
+             "Volume  "
+             "Process ");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Prints the given text as one line
+
+void TMCVerbose::PrintLine(const char *text)
 {
-   std::cout << "Step#     "
-             << "X(cm)    "
-             << "Y(cm)    "
-             << "Z(cm)  "
-             << "KinE(MeV)   "
-             << "dE(MeV) "
-             << "Step(cm) "
-             << "TrackL(cm) "
-             << "Volume  "
-             << "Process " << std::endl;
+   fBuffer += text;
+   EndLine();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Ends the current line and writes the buffer if it is full
+
+void TMCVerbose::EndLine()
+{
+   fBuffer += '\n';
+   if (Int_t(fBuffer.size()) >= fBufferSize)
+      Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns true if the current step passes the filters
+
+Bool_t TMCVerbose::IsStepSelected()
+{
+   if (!fIsEventSelected || !fIsTrackSelected)
+      return kFALSE;
+
+   if (fVolName.IsNull())
+      return kTRUE;
+
+   // the volume id is resolved once per engine
+   if (fVolIdMC != gMC) {
+      fVolIdMC = gMC;
+      fVolId = gMC->VolId(fVolName.Data());
+   }
+   Int_t copyNo;
+   return gMC->CurrentVolID(copyNo) == fVolId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Apply the event range to the event of the current engine; this is
+/// repeated at each primary and track as, with TMCManager, the engine
+/// starts the event only after the application BeginEvent()
+
+void TMCVerbose::SelectEvent()
+{
+   if (fMinEvent == 0 && fMaxEvent < 0) {
+      fIsEventSelected = kTRUE;
+      return;
+   }
+   Int_t eventNumber = gMC ? gMC->CurrentEvent() : -1;
+   fIsEventSelected = eventNumber >= fMinEvent && (fMaxEvent < 0 || eventNumber <= fMaxEvent);
 }
 
 //
@@ -119,7 +404,7 @@ void TMCVerbose::PrintStepHeader() const
 void TMCVerbose::InitMC()
 {
    if (fLevel > 0)
-      std::cout << "--- Init MC " << std::endl;
+      PrintLine("--- Init MC ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -127,8 +412,11 @@ void TMCVerbose::InitMC()
 
 void TMCVerbose::RunMC(Int_t nofEvents)
 {
-   if (fLevel > 0)
-      std::cout << "--- Run MC for " << nofEvents << " events" << std::endl;
+   if (fLevel > 0) {
+      fBuffer += "--- Run MC for ";
+      AppendInt(fBuffer, nofEvents, 0);
+      PrintLine(" events");
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -137,7 +425,8 @@ void TMCVerbose::RunMC(Int_t nofEvents)
 void TMCVerbose::FinishRun()
 {
    if (fLevel > 0)
-      std::cout << "--- Finish Run MC " << std::endl;
+      PrintLine("--- Finish Run MC ");
+   Flush();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -146,7 +435,7 @@ void TMCVerbose::FinishRun()
 void TMCVerbose::ConstructGeometry()
 {
    if (fLevel > 0)
-      std::cout << "--- Construct geometry " << std::endl;
+      PrintLine("--- Construct geometry ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -155,7 +444,7 @@ void TMCVerbose::ConstructGeometry()
 void TMCVerbose::ConstructOpGeometry()
 {
    if (fLevel > 0)
-      std::cout << "--- Construct geometry for optical processes" << std::endl;
+      PrintLine("--- Construct geometry for optical processes");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -164,7 +453,7 @@ void TMCVerbose::ConstructOpGeometry()
 void TMCVerbose::InitGeometry()
 {
    if (fLevel > 0)
-      std::cout << "--- Init geometry " << std::endl;
+      PrintLine("--- Init geometry ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -173,7 +462,7 @@ void TMCVerbose::InitGeometry()
 void TMCVerbose::AddParticles()
 {
    if (fLevel > 0)
-      std::cout << "--- Add particles " << std::endl;
+      PrintLine("--- Add particles ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -182,7 +471,7 @@ void TMCVerbose::AddParticles()
 void TMCVerbose::AddIons()
 {
    if (fLevel > 0)
-      std::cout << "--- Add ions " << std::endl;
+      PrintLine("--- Add ions ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -191,7 +480,7 @@ void TMCVerbose::AddIons()
 void TMCVerbose::GeneratePrimaries()
 {
    if (fLevel > 0)
-      std::cout << "--- Generate primaries " << std::endl;
+      PrintLine("--- Generate primaries ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -199,8 +488,10 @@ void TMCVerbose::GeneratePrimaries()
 
 void TMCVerbose::BeginEvent()
 {
+   SelectEvent();
+
    if (fLevel > 0)
-      std::cout << "--- Begin event " << std::endl;
+      PrintLine("--- Begin event ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -208,8 +499,9 @@ void TMCVerbose::BeginEvent()
 
 void TMCVerbose::BeginPrimary()
 {
-   if (fLevel > 1)
-      std::cout << "--- Begin primary " << std::endl;
+   SelectEvent();
+   if (fLevel > 1 && fIsEventSelected)
+      PrintLine("--- Begin primary ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -217,19 +509,33 @@ void TMCVerbose::BeginPrimary()
 
 void TMCVerbose::PreTrack()
 {
+   fStepNumber = 0;
+   if (fLevel < 2)
+      return;
+
+   // apply the event and track filters
+   SelectEvent();
+   fIsTrackSelected = fIsEventSelected;
+   if (fIsTrackSelected && (fMinTrackId > 0 || fMaxTrackId >= 0)) {
+      Int_t trackId = gMC->GetStack()->GetCurrentTrackNumber();
+      fIsTrackSelected = trackId >= fMinTrackId && (fMaxTrackId < 0 || trackId <= fMaxTrackId);
+   }
+   if (fIsTrackSelected && fPdg != 0)
+      fIsTrackSelected = gMC->TrackPid() == fPdg;
+
+   if (!fIsTrackSelected)
+      return;
+
    if (fLevel > 2) {
       PrintBanner();
       PrintTrackInfo();
       PrintBanner();
       PrintStepHeader();
 
-      fStepNumber = 0;
-
       return;
    }
 
-   if (fLevel > 1)
-      std::cout << "--- Pre track " << std::endl;
+   PrintLine("--- Pre track ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -239,57 +545,63 @@ void TMCVerbose::Stepping()
 {
    if (fLevel > 2) {
 
-#if __GNUC__ >= 3
-      std::cout << std::fixed;
-#endif
-
       // Step number
       //
-      // std::cout << "#" << std::setw(4) << gMC->StepNumber() << "  ";
-      std::cout << "#" << std::setw(4) << fStepNumber++ << "  ";
+      // the steps are counted also when they are filtered out
+      Int_t stepNumber = fStepNumber++;
+      if (!IsStepSelected())
+         return;
+      fBuffer += '#';
+      AppendInt(fBuffer, stepNumber, 4);
+      fBuffer += "  ";
 
       // Position
       //
       Double_t x, y, z;
       gMC->TrackPosition(x, y, z);
-      std::cout << std::setw(8) << std::setprecision(3) << x << " " << std::setw(8) << std::setprecision(3) << y << " "
-                << std::setw(8) << std::setprecision(3) << z << "  ";
+      AppendFixed(fBuffer, x, 8, 3);
+      fBuffer += ' ';
+      AppendFixed(fBuffer, y, 8, 3);
+      fBuffer += ' ';
+      AppendFixed(fBuffer, z, 8, 3);
+      fBuffer += "  ";
 
       // Kinetic energy
       //
       Double_t px, py, pz, etot;
       gMC->TrackMomentum(px, py, pz, etot);
       Double_t ekin = etot - gMC->TrackMass();
-      std::cout << std::setw(9) << std::setprecision(4) << ekin * 1e03 << " ";
+      AppendFixed(fBuffer, ekin * 1e03, 9, 4);
+      fBuffer += ' ';
 
       // Energy deposit
       //
-      std::cout << std::setw(9) << std::setprecision(4) << gMC->Edep() * 1e03 << " ";
+      AppendFixed(fBuffer, gMC->Edep() * 1e03, 9, 4);
+      fBuffer += ' ';
 
       // Step length
       //
-      std::cout << std::setw(8) << std::setprecision(3) << gMC->TrackStep() << " ";
+      AppendFixed(fBuffer, gMC->TrackStep(), 8, 3);
+      fBuffer += ' ';
 
       // Track length
       //
-      std::cout << std::setw(8) << std::setprecision(3) << gMC->TrackLength() << "     ";
+      AppendFixed(fBuffer, gMC->TrackLength(), 8, 3);
+      fBuffer += "     ";
 
       // Volume
       //
-      if (gMC->CurrentVolName() != 0)
-         std::cout << std::setw(4) << gMC->CurrentVolName() << "  ";
-      else
-         std::cout << std::setw(4) << "None"
-                   << "  ";
+      const char *volName = gMC->CurrentVolName();
+      AppendString(fBuffer, volName ? volName : "None", 4);
+      fBuffer += "  ";
 
       // Process
       //
-      TArrayI processes;
-      Int_t nofProcesses = gMC->StepProcesses(processes);
+      Int_t nofProcesses = gMC->StepProcesses(fProcesses);
       if (nofProcesses > 0)
-         std::cout << TMCProcessName[processes[nofProcesses - 1]];
+         fBuffer += TMCProcessName[fProcesses[nofProcesses - 1]];
 
-      std::cout << std::endl;
+      EndLine();
    }
 }
 
@@ -298,8 +610,8 @@ void TMCVerbose::Stepping()
 
 void TMCVerbose::PostTrack()
 {
-   if (fLevel == 2)
-      std::cout << "--- Post track " << std::endl;
+   if (fLevel == 2 && fIsTrackSelected)
+      PrintLine("--- Post track ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -308,7 +620,7 @@ void TMCVerbose::PostTrack()
 void TMCVerbose::FinishPrimary()
 {
    if (fLevel == 1)
-      std::cout << "--- Finish primary " << std::endl;
+      PrintLine("--- Finish primary ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -317,7 +629,7 @@ void TMCVerbose::FinishPrimary()
 void TMCVerbose::EndOfEvent()
 {
    if (fLevel > 0)
-      std::cout << "--- End of event " << std::endl;
+      PrintLine("--- End of event ");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -326,5 +638,116 @@ void TMCVerbose::EndOfEvent()
 void TMCVerbose::FinishEvent()
 {
    if (fLevel > 0)
-      std::cout << "--- Finish event " << std::endl;
+      PrintLine("--- Finish event ");
+   Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write the buffered output to the file sink or to std::cout
+
+void TMCVerbose::Flush()
+{
+   if (fBuffer.empty())
+      return;
+
+   if (fSink) {
+      // the buffer content is moved to the sink
+      fSink->Write(fBuffer);
+      fBuffer.clear();
+      fBuffer.reserve(fBufferSize + 256);
+      return;
+   }
+
+   std::cout.write(fBuffer.data(), fBuffer.size());
+   std::cout.flush();
+   fBuffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write the output to the given file via a background thread;
+/// the TMCVerbose objects with the same file name share the file.
+/// An empty name restores the output to std::cout.
+
+void TMCVerbose::SetOutputFile(const char *fileName)
+{
+   Flush();
+   fSink.reset();
+   if (!fileName || !*fileName)
+      return;
+
+   TMCAutoLock lock(&sinkRegistryMutex);
+   std::weak_ptr<TMCVerboseSink> &entry = GetSinkRegistry()[fileName];
+   fSink = entry.lock();
+   if (fSink)
+      return;
+
+   fSink = std::make_shared<TMCVerboseSink>(fileName);
+   if (!fSink->IsOpen()) {
+      ::Error("TMCVerbose::SetOutputFile", "Cannot open the file %s, the output goes to std::cout.", fileName);
+      fSink.reset();
+      return;
+   }
+   entry = fSink;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Set the size of the buffered output which triggers its writing;
+/// with 0, each line is written immediately
+
+void TMCVerbose::SetBufferSize(Int_t bufferSize)
+{
+   fBufferSize = bufferSize > 0 ? bufferSize : 0;
+   if (Int_t(fBuffer.size()) >= fBufferSize)
+      Flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Select the tracks with the id in the given range (a negative maximum
+/// means no upper limit)
+
+void TMCVerbose::SetTrackIdRange(Int_t minTrackId, Int_t maxTrackId)
+{
+   fMinTrackId = minTrackId;
+   fMaxTrackId = maxTrackId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Select the tracks of the given particle (0 means all particles)
+
+void TMCVerbose::SetPdgFilter(Int_t pdg)
+{
+   fPdg = pdg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Select the steps in the given volume (an empty name means all volumes)
+
+void TMCVerbose::SetVolumeFilter(const char *volName)
+{
+   fVolName = volName ? volName : "";
+   fVolId = -1;
+   fVolIdMC = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Select the events in the given range of TVirtualMC::CurrentEvent()
+/// (a negative maximum means no upper limit)
+
+void TMCVerbose::SetEventRange(Int_t minEvent, Int_t maxEvent)
+{
+   fMinEvent = minEvent;
+   fMaxEvent = maxEvent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Remove all filters
+
+void TMCVerbose::ResetFilters()
+{
+   SetTrackIdRange(0, -1);
+   SetPdgFilter(0);
+   SetVolumeFilter("");
+   SetEventRange(0, -1);
+   fIsEventSelected = kTRUE;
+   fIsTrackSelected = kTRUE;
 }
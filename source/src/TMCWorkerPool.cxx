@@ -0,0 +1,511 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCWorkerPool.h"
+#include "TError.h"
+#include "TMCAutoLock.h"
+#include "TMCtls.h"
+#include "TVirtualMCApplication.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/** \class TMCWorkerPool
+    \ingroup vmc
+
+Pool of worker threads which drives the multi-threading hooks of the MC
+application with a configurable CPU affinity.
+
+The worker threads are started and pinned to their CPUs in Initialize(),
+before the worker applications are created on them with
+TVirtualMCApplication::CloneForWorker() and initialized with
+TVirtualMCApplication::InitOnWorker(). The data allocated by the worker
+applications is then placed in the memory of the worker NUMA node by the
+first-touch policy of the operating system.
+
+If a replica hook is set, it is called once per NUMA node, on the first
+worker of the node and before the worker applications of the node are
+created. It can be used to create a read-only replica of the geometry or
+field data per node; the workers can find the node they run on with
+GetCurrentNumaNode().
+
+Run() calls TVirtualMCApplication::BeginRunOnWorker(), the user process
+function and TVirtualMCApplication::FinishRunOnWorker() on all workers
+and then merges the worker applications in the master application with
+TVirtualMCApplication::Merge(), one after another or, if SetTreeMerge() is
+activated, via the parallel tree reduction of TMCMergeDriver on the worker
+threads.
+The worker applications are deleted on their threads in Terminate().
+
+~~~ {.cpp}
+TMCWorkerPool pool(masterApplication, 64, TMCWorkerPool::kScatter);
+pool.Initialize();
+pool.Run([](Int_t workerId) { ... process the worker events ... });
+pool.Terminate();
+~~~
+
+The CPU affinity and the NUMA topology are supported on Linux only;
+on other systems the workers are not pinned.
+*/
+
+namespace {
+
+// Mutex serializing the creation and initialization of the worker applications
+TMCMutex initMutex = TMCMUTEX_INITIALIZER;
+
+// The worker id and NUMA node of this thread
+TMCThreadLocal Int_t currentWorkerId = -1;
+TMCThreadLocal Int_t currentNumaNode = -1;
+
+/// The CPUs per NUMA node
+struct TCpuTopology {
+   std::vector<std::vector<Int_t>> fNodeCpus; ///< The CPUs of each NUMA node
+   std::vector<Int_t> fCpuNode;               ///< The NUMA node of each CPU
+};
+
+//_____________________________________________________________________________
+std::vector<Int_t> ParseCpuList(const std::string &list)
+{
+   /// Parse the Linux CPU list format, eg. "0-3,8,10-11"
+
+   std::vector<Int_t> cpus;
+   std::stringstream stream(list);
+   std::string range;
+   while (std::getline(stream, range, ',')) {
+      if (range.empty() || range == "\n")
+         continue;
+      Int_t first = 0;
+      Int_t last = 0;
+      Int_t nofRead = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+      if (nofRead < 1)
+         continue;
+      if (nofRead == 1)
+         last = first;
+      for (Int_t cpu = first; cpu <= last; ++cpu) {
+         cpus.push_back(cpu);
+      }
+   }
+   return cpus;
+}
+
+//_____________________________________________________________________________
+TCpuTopology ReadTopology()
+{
+   /// Read the NUMA topology from /sys restricted to the CPUs
+   /// allowed for this process
+
+   TCpuTopology topology;
+
+#ifdef __linux__
+   cpu_set_t allowed;
+   CPU_ZERO(&allowed);
+   Bool_t hasAllowed = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+   std::ifstream online("/sys/devices/system/node/online");
+   std::string nodeList;
+   if (online.good() && std::getline(online, nodeList)) {
+      for (Int_t node : ParseCpuList(nodeList)) {
+         std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+         std::string cpuList;
+         if (!cpuListFile.good() || !std::getline(cpuListFile, cpuList))
+            continue;
+         std::vector<Int_t> cpus;
+         for (Int_t cpu : ParseCpuList(cpuList)) {
+            if (!hasAllowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+               cpus.push_back(cpu);
+         }
+         if (cpus.empty())
+            continue;
+         for (Int_t cpu : cpus) {
+            if (cpu >= Int_t(topology.fCpuNode.size()))
+               topology.fCpuNode.resize(cpu + 1, 0);
+            topology.fCpuNode[cpu] = topology.fNodeCpus.size();
+         }
+         topology.fNodeCpus.push_back(cpus);
+      }
+   }
+#endif
+
+   if (topology.fNodeCpus.empty()) {
+      // Single node with all CPUs
+      Int_t nofCpus = std::thread::hardware_concurrency();
+      if (nofCpus < 1)
+         nofCpus = 1;
+      topology.fNodeCpus.resize(1);
+      for (Int_t cpu = 0; cpu < nofCpus; ++cpu) {
+         topology.fNodeCpus[0].push_back(cpu);
+      }
+      topology.fCpuNode.assign(nofCpus, 0);
+   }
+   return topology;
+}
+
+//_____________________________________________________________________________
+const TCpuTopology &GetTopology()
+{
+   /// Return the topology (read on the first call)
+
+   static const TCpuTopology topology = ReadTopology();
+   return topology;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+/// - masterApplication  The master application
+/// - nofWorkers         The number of workers
+/// - affinity           The CPU affinity policy
+///
+
+TMCWorkerPool::TMCWorkerPool(TVirtualMCApplication *masterApplication, Int_t nofWorkers, EAffinity affinity)
+   : fMasterApplication(masterApplication), fAffinity(affinity), fCpus(), fWorkers(), fNodeReplicaHook(),
+     fTreeMerge(kFALSE), fMergeDriver(), fMutex(), fTaskCondition(), fDoneCondition(), fTask(), fTaskNumber(0),
+     fNofPending(0), fIsInitialized(kFALSE), fStop(kFALSE)
+{
+   if (!fMasterApplication) {
+      ::Fatal("TMCWorkerPool::TMCWorkerPool", "The master application must be defined.");
+   }
+   if (nofWorkers < 1) {
+      ::Fatal("TMCWorkerPool::TMCWorkerPool", "Wrong number of workers %d.", nofWorkers);
+   }
+
+   fWorkers.resize(nofWorkers);
+   for (Int_t i = 0; i < nofWorkers; ++i) {
+      fWorkers[i].fId = i;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCWorkerPool::~TMCWorkerPool()
+{
+   Terminate();
+}
+
+//
+// static methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the number of NUMA nodes available for this process
+///
+
+Int_t TMCWorkerPool::GetNofNumaNodes()
+{
+   return GetTopology().fNodeCpus.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the id of the worker running on this thread (-1 if none)
+///
+
+Int_t TMCWorkerPool::GetCurrentWorkerId()
+{
+   return currentWorkerId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the NUMA node of the worker running on this thread (-1 if none)
+///
+
+Int_t TMCWorkerPool::GetCurrentNumaNode()
+{
+   return currentNumaNode;
+}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Assign the CPUs and NUMA nodes to the workers
+///
+
+void TMCWorkerPool::AssignCpus()
+{
+   const TCpuTopology &topology = GetTopology();
+   Int_t nofNodes = topology.fNodeCpus.size();
+
+   std::vector<Int_t> compactCpus;
+   for (const auto &nodeCpus : topology.fNodeCpus) {
+      compactCpus.insert(compactCpus.end(), nodeCpus.begin(), nodeCpus.end());
+   }
+
+   for (auto &worker : fWorkers) {
+      Int_t id = worker.fId;
+      if (!fCpus.empty()) {
+         worker.fCpu = fCpus[id % fCpus.size()];
+      } else if (fAffinity == kCompact) {
+         worker.fCpu = compactCpus[id % compactCpus.size()];
+      } else if (fAffinity == kScatter) {
+         const auto &nodeCpus = topology.fNodeCpus[id % nofNodes];
+         worker.fCpu = nodeCpus[(id / nofNodes) % nodeCpus.size()];
+      } else {
+         worker.fCpu = -1;
+      }
+
+      worker.fNumaNode = 0;
+      if (worker.fCpu >= 0 && worker.fCpu < Int_t(topology.fCpuNode.size())) {
+         worker.fNumaNode = topology.fCpuNode[worker.fCpu];
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The worker thread function: pin the thread and execute the tasks
+///
+
+void TMCWorkerPool::WorkerLoop(TWorker &worker)
+{
+#ifdef __linux__
+   if (worker.fCpu >= 0 && worker.fCpu < CPU_SETSIZE) {
+      cpu_set_t cpuSet;
+      CPU_ZERO(&cpuSet);
+      CPU_SET(worker.fCpu, &cpuSet);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+         ::Warning("TMCWorkerPool::WorkerLoop", "Worker %d could not be pinned to CPU %d.", worker.fId, worker.fCpu);
+      }
+   }
+#endif
+   currentWorkerId = worker.fId;
+   currentNumaNode = worker.fNumaNode;
+
+   // The task number is reset in Initialize() before the threads start
+   ULong64_t lastTaskNumber = 0;
+   while (true) {
+      std::function<void(TWorker &)> task;
+      {
+         std::unique_lock<std::mutex> lock(fMutex);
+         fTaskCondition.wait(lock, [&] { return fStop || fTaskNumber != lastTaskNumber; });
+         if (fStop)
+            break;
+         lastTaskNumber = fTaskNumber;
+         task = fTask;
+      }
+
+      task(worker);
+
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         if (--fNofPending == 0)
+            fDoneCondition.notify_one();
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Execute the task on all workers and wait for its completion
+///
+
+void TMCWorkerPool::Execute(const std::function<void(TWorker &)> &task)
+{
+   std::unique_lock<std::mutex> lock(fMutex);
+   fTask = task;
+   fNofPending = fWorkers.size();
+   ++fTaskNumber;
+   fTaskCondition.notify_all();
+   fDoneCondition.wait(lock, [this] { return fNofPending == 0; });
+   fTask = nullptr;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Start and pin the worker threads and create and initialize
+/// the worker applications
+///
+
+void TMCWorkerPool::Initialize()
+{
+   if (fIsInitialized) {
+      ::Warning("TMCWorkerPool::Initialize", "The worker pool is already initialized.");
+      return;
+   }
+
+   AssignCpus();
+
+   // No thread is running: the tasks of a previous initialization are forgotten
+   fStop = kFALSE;
+   fTaskNumber = 0;
+   for (auto &worker : fWorkers) {
+      worker.fThread = std::thread(&TMCWorkerPool::WorkerLoop, this, std::ref(worker));
+   }
+   fIsInitialized = kTRUE;
+
+   std::unique_ptr<std::once_flag[]> nodeFlags(new std::once_flag[GetNofNumaNodes()]);
+   Execute([this, &nodeFlags](TWorker &worker) {
+      if (fNodeReplicaHook) {
+         std::call_once(nodeFlags[worker.fNumaNode], fNodeReplicaHook, worker.fNumaNode);
+      }
+
+      // Only the cloning reads the master application; the worker
+      // applications are initialized in parallel on their threads
+      {
+         TMCAutoLock lk(&initMutex);
+         worker.fApplication = fMasterApplication->CloneForWorker();
+      }
+      if (!worker.fApplication) {
+         ::Error("TMCWorkerPool::Initialize", "The application does not implement CloneForWorker().");
+         return;
+      }
+      worker.fApplication->InitOnWorker();
+   });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Run the process function on all workers between BeginRunOnWorker()
+/// and FinishRunOnWorker() and merge the worker applications
+/// in the master application.
+/// - process  The function called on each worker with the worker id,
+///            eg. processing the worker events with the worker engine
+///
+
+void TMCWorkerPool::Run(const std::function<void(Int_t)> &process)
+{
+   if (!fIsInitialized) {
+      Initialize();
+   }
+
+   Execute([&process](TWorker &worker) {
+      if (!worker.fApplication)
+         return;
+      worker.fApplication->BeginRunOnWorker();
+      process(worker.fId);
+      worker.fApplication->FinishRunOnWorker();
+   });
+
+   if (fTreeMerge) {
+      std::vector<TVirtualMCApplication *> applications;
+      for (auto &worker : fWorkers) {
+         applications.push_back(worker.fApplication);
+      }
+      // Each pair is merged on the thread of the receiving worker
+      fMergeDriver.Merge(fMasterApplication, applications, [this](const std::function<void(Int_t)> &function) {
+         Execute([&function](TWorker &worker) { function(worker.fId); });
+      });
+      return;
+   }
+
+   for (auto &worker : fWorkers) {
+      if (worker.fApplication) {
+         fMasterApplication->Merge(worker.fApplication);
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Delete the worker applications on their threads and stop the threads
+///
+
+void TMCWorkerPool::Terminate()
+{
+   if (!fIsInitialized)
+      return;
+
+   Execute([](TWorker &worker) {
+      delete worker.fApplication;
+      worker.fApplication = nullptr;
+   });
+
+   {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStop = kTRUE;
+   }
+   fTaskCondition.notify_all();
+   for (auto &worker : fWorkers) {
+      worker.fThread.join();
+   }
+   fIsInitialized = kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Print the workers CPUs and NUMA nodes
+///
+
+void TMCWorkerPool::Print() const
+{
+   std::cout << "TMCWorkerPool: " << fWorkers.size() << " workers on " << GetNofNumaNodes() << " NUMA node(s)"
+             << std::endl;
+   for (const auto &worker : fWorkers) {
+      std::cout << "   worker " << worker.fId << ": CPU ";
+      if (worker.fCpu >= 0)
+         std::cout << worker.fCpu;
+      else
+         std::cout << "any";
+      std::cout << ", NUMA node " << worker.fNumaNode << std::endl;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the CPUs explicitly; the worker i is pinned to the CPU
+/// cpus[i % cpus.size()]. It overrides the affinity policy.
+///
+
+void TMCWorkerPool::SetCpus(const std::vector<Int_t> &cpus)
+{
+   if (fIsInitialized) {
+      ::Warning("TMCWorkerPool::SetCpus", "The CPUs must be set before the pool initialization.");
+      return;
+   }
+   fCpus = cpus;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the function creating the replica of the shared read-only data
+/// for the NUMA node given in argument
+///
+
+void TMCWorkerPool::SetNodeReplicaHook(const std::function<void(Int_t)> &hook)
+{
+   if (fIsInitialized) {
+      ::Warning("TMCWorkerPool::SetNodeReplicaHook", "The hook must be set before the pool initialization.");
+      return;
+   }
+   fNodeReplicaHook = hook;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the application of the worker workerId
+///
+
+TVirtualMCApplication *TMCWorkerPool::GetWorkerApplication(Int_t workerId) const
+{
+   if (workerId < 0 || workerId >= Int_t(fWorkers.size()))
+      return nullptr;
+   return fWorkers[workerId].fApplication;
+}
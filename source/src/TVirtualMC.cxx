@@ -18,7 +18,11 @@
  *************************************************************************/
 
 #include "TVirtualMC.h"
+#include "TVirtualMCMagField.h"
+#include "TMCParticleTable.h"
+#include "TMCThreadContext.h"
 #include "TError.h"
+#include "TArrayI.h"
 #include "TMCVersion.h"
 #include "Riostream.h"
 
@@ -61,7 +65,7 @@ TMCThreadLocal TVirtualMC *TVirtualMC::fgMC = nullptr;
 
 TVirtualMC::TVirtualMC(const char *name, const char *title, Bool_t /*isRootGeometrySupported*/)
    : TNamed(name, title), fApplication(nullptr), fId(0), fStack(nullptr), fManagerStack(nullptr), fDecayer(nullptr),
-     fRandom(nullptr), fMagField(nullptr)
+     fRandom(nullptr), fMagField(nullptr), fMCMagField(nullptr)
 {
    PrintVersion();
 
@@ -73,6 +77,7 @@ TVirtualMC::TVirtualMC(const char *name, const char *title, Bool_t /*isRootGeome
       ::Fatal("TVirtualMC::TVirtualMC", "No user MC application is defined.");
    }
    fgMC = this;
+   TMCThreadContext::SetMC(this);
    fRandom = gRandom;
 }
 
@@ -83,7 +88,7 @@ TVirtualMC::TVirtualMC(const char *name, const char *title, Bool_t /*isRootGeome
 
 TVirtualMC::TVirtualMC()
    : TNamed(), fApplication(nullptr), fId(0), fStack(nullptr), fManagerStack(nullptr), fDecayer(nullptr),
-     fRandom(nullptr), fMagField(nullptr)
+     fRandom(nullptr), fMagField(nullptr), fMCMagField(nullptr)
 {
 }
 
@@ -95,6 +100,7 @@ TVirtualMC::TVirtualMC()
 TVirtualMC::~TVirtualMC()
 {
    fgMC = nullptr;
+   TMCThreadContext::SetMC(nullptr);
 }
 
 //
@@ -129,6 +135,9 @@ void TVirtualMC::ProcessEvent(Int_t eventId)
 void TVirtualMC::SetStack(TVirtualMCStack *stack)
 {
    fStack = stack;
+   if (TMCThreadContext::Instance().fMC == this) {
+      TMCThreadContext::Instance().fStack = stack;
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -152,6 +161,21 @@ void TVirtualMC::SetRandom(TRandom *random)
    fRandom = random;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set random number generator of this engine only.
+/// Unlike SetRandom(), the global gRandom is not changed, so this function
+/// can be called concurrently from several threads; the engine and the
+/// user code then have to draw their numbers via GetRandom().
+/// The engines which cache or wrap their generator must override this
+/// function, as they override SetRandom(), and call this implementation.
+///
+
+void TVirtualMC::SetEngineRandom(TRandom *random)
+{
+   fRandom = random;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ///
 /// Set magnetic field.
@@ -160,6 +184,68 @@ void TVirtualMC::SetRandom(TRandom *random)
 void TVirtualMC::SetMagField(TVirtualMagField *field)
 {
    fMagField = field;
+   fMCMagField = dynamic_cast<TVirtualMCMagField *>(field);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Evaluate the magnetic field at n points xyz (arrays of size 3*n).
+///
+/// The batched evaluation of the field set via SetMagField() is used
+/// if it is derived from TVirtualMCMagField, the field is evaluated point
+/// by point otherwise; if no field is set, the field defined in the user
+/// application is used.
+/// This function is provided for the engines which can evaluate the field
+/// for all Runge-Kutta stages of a step at once.
+///
+
+void TVirtualMC::EvaluateField(Int_t n, const Double_t *xyz, Double_t *bxyz) const
+{
+   if (fMCMagField) {
+      fMCMagField->Field(n, xyz, bxyz);
+   } else if (fMagField) {
+      for (Int_t i = 0; i < n; ++i) {
+         fMagField->Field(xyz + 3 * i, bxyz + 3 * i);
+      }
+   } else if (fApplication) {
+      fApplication->Field(n, xyz, bxyz);
+   } else {
+      for (Int_t i = 0; i < 3 * n; ++i) {
+         bxyz[i] = 0.;
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Fill the PDG codes of all particles and ions defined in the engine.
+/// The default implementation does not provide them and returns false;
+/// the engines should override it so that TMCParticleTable::Build() can
+/// be called without an explicit list of PDG codes.
+///
+
+Bool_t TVirtualMC::GetDefinedParticles(TArrayI &pdgs) const
+{
+   pdgs.Set(0);
+   return kFALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the index of the particle transported in the published
+/// TMCParticleTable, or -1 if no table is built or the particle is not
+/// in the table.
+/// The engines may override this function to return an index cached
+/// per track.
+///
+
+Int_t TVirtualMC::TrackPidIndex() const
+{
+   const TMCParticleTable *table = TMCParticleTable::Instance();
+   if (!table)
+      return -1;
+
+   return table->GetIndex(TrackPid());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
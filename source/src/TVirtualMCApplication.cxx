@@ -21,6 +21,7 @@
 #include "TError.h"
 #include "TVirtualMC.h"
 #include "TMCManager.h"
+#include "TMCThreadContext.h"
 
 /** \class TVirtualMCApplication
     \ingroup vmc
@@ -44,11 +45,12 @@ TVirtualMCApplication::TVirtualMCApplication(const char *name, const char *title
    }
 
    // This is set to true if a TMCManager was reuqested.
-   if (fLockMultiThreading) {
+   if (fLockMultiThreading && !TMCManager::IsSubEventWorker()) {
       ::Fatal("TVirtualMCApplication::TVirtualMCApplication", "In multi-engine run ==> multithreading is disabled.");
    }
 
    fgInstance = this;
+   TMCThreadContext::Instance().fApplication = this;
    // There cannot be a TVirtualMC since it must have registered to this
    // TVirtualMCApplication
    fMC = nullptr;
@@ -63,6 +65,7 @@ TVirtualMCApplication::TVirtualMCApplication(const char *name, const char *title
 TVirtualMCApplication::TVirtualMCApplication() : TNamed()
 {
    fgInstance = this;
+   TMCThreadContext::Instance().fApplication = this;
    fMC = nullptr;
    fMCManager = nullptr;
 }
@@ -75,6 +78,7 @@ TVirtualMCApplication::TVirtualMCApplication() : TNamed()
 TVirtualMCApplication::~TVirtualMCApplication()
 {
    fgInstance = nullptr;
+   TMCThreadContext::Instance().fApplication = nullptr;
    if (fMCManager) {
       delete fMCManager;
    }
@@ -100,7 +104,10 @@ void TVirtualMCApplication::RequestMCManager()
    fMCManager = new TMCManager();
    fMCManager->Register(this);
    fMCManager->ConnectEnginePointer(&fMC);
-   fLockMultiThreading = kTRUE;
+   // Already locked by the master of a sub-event worker
+   if (!TMCManager::IsSubEventWorker()) {
+      fLockMultiThreading = kTRUE;
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
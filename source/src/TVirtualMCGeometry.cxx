@@ -19,6 +19,8 @@
 
 #include "TVirtualMCGeometry.h"
 
+#include <vector>
+
 /** \class TVirtualMCGeometry
     \ingroup vmc
 
@@ -50,3 +52,79 @@ TVirtualMCGeometry::TVirtualMCGeometry() : TNamed() {}
 ///
 
 TVirtualMCGeometry::~TVirtualMCGeometry() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position n copies of a previously defined volume in the mother.
+///
+/// - name   Volume name
+/// - n      Number of copies
+/// - nr     Copy numbers of the volume (array of size n)
+/// - mother Mother volume name
+/// - x      X coords. of the copies in mother ref. sys. (array of size n)
+/// - y      Y coords. of the copies in mother ref. sys. (array of size n)
+/// - z      Z coords. of the copies in mother ref. sys. (array of size n)
+/// - irot   Rotation matrix number w.r.t. mother ref. sys. (all copies)
+/// - konly  ONLY/MANY flag
+///
+/// The default implementation calls Gspos() for each copy;
+/// implementations can override it to resolve the names only once.
+///
+
+void TVirtualMCGeometry::GsposArray(const char *name, Int_t n, const Int_t *nr, const char *mother, const Double_t *x,
+                                    const Double_t *y, const Double_t *z, Int_t irot, const char *konly)
+{
+   for (Int_t i = 0; i < n; ++i) {
+      Gspos(name, nr[i], mother, x[i], y[i], z[i], irot, konly);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Position nx*ny*nz copies of a previously defined volume in the mother
+/// on a regular lattice.
+///
+/// - name   Volume name
+/// - nr0    Copy number of the first copy; the copy (ix, iy, iz)
+///          gets the copy number nr0 + ix + nx*(iy + ny*iz)
+/// - mother Mother volume name
+/// - nx, ny, nz   Number of copies along X, Y, Z
+/// - x0, y0, z0   Position of the first copy in mother ref. sys.
+/// - dx, dy, dz   Lattice steps along X, Y, Z
+/// - irot   Rotation matrix number w.r.t. mother ref. sys. (all copies)
+/// - konly  ONLY/MANY flag
+///
+/// The default implementation builds the arrays of copy numbers and
+/// positions and calls GsposArray().
+///
+
+void TVirtualMCGeometry::GsposLattice(const char *name, Int_t nr0, const char *mother, Int_t nx, Int_t ny, Int_t nz,
+                                      Double_t x0, Double_t y0, Double_t z0, Double_t dx, Double_t dy, Double_t dz,
+                                      Int_t irot, const char *konly)
+{
+   if (nx <= 0 || ny <= 0 || nz <= 0) {
+      Error("GsposLattice", "Wrong lattice dimensions %d x %d x %d for volume %s", nx, ny, nz, name);
+      return;
+   }
+
+   Int_t n = nx * ny * nz;
+   std::vector<Int_t> nr(n);
+   std::vector<Double_t> x(n);
+   std::vector<Double_t> y(n);
+   std::vector<Double_t> z(n);
+
+   Int_t i = 0;
+   for (Int_t iz = 0; iz < nz; ++iz) {
+      for (Int_t iy = 0; iy < ny; ++iy) {
+         for (Int_t ix = 0; ix < nx; ++ix) {
+            nr[i] = nr0 + i;
+            x[i] = x0 + ix * dx;
+            y[i] = y0 + iy * dy;
+            z[i] = z0 + iz * dz;
+            ++i;
+         }
+      }
+   }
+
+   GsposArray(name, n, nr.data(), mother, x.data(), y.data(), z.data(), irot, konly);
+}
@@ -0,0 +1,55 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TVirtualMCMagField.h"
+
+/** \class TVirtualMCMagField
+    \ingroup vmc
+
+Interface to a magnetic field which can be evaluated at several points
+at once, eg. for all Runge-Kutta stages of a step.
+
+The users can implement a vectorized kernel by overriding
+Field(Int_t n, const Double_t *xyz, Double_t *bxyz); the engines
+get the batched evaluation via TVirtualMC::EvaluateField().
+*/
+
+ClassImp(TVirtualMCMagField);
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+
+TVirtualMCMagField::TVirtualMCMagField(const char *name) : TVirtualMagField(name) {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TVirtualMCMagField::TVirtualMCMagField() : TVirtualMagField() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TVirtualMCMagField::~TVirtualMCMagField() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Calculate the field at n points by calling the single point Field()
+///
+
+void TVirtualMCMagField::Field(Int_t n, const Double_t *xyz, Double_t *bxyz)
+{
+   for (Int_t i = 0; i < n; ++i) {
+      Field(xyz + 3 * i, bxyz + 3 * i);
+   }
+}
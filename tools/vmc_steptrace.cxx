@@ -0,0 +1,286 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+//
+// vmc_steptrace: the converter and comparator of the step traces written
+// by TMCStepRecorder
+//
+// Usage:
+//   vmc_steptrace dump FILE [--event=N]
+//       print the steps as text
+//   vmc_steptrace root FILE OUTPUT.root [--event=N]
+//       write the steps in the TTree "steps"
+//   vmc_steptrace diff FILE1 FILE2 [--event=N] [--tolerance=CM] [--energy-tolerance=REL] [--max-reports=N]
+//       compare two traces, eg. the same event simulated with two engines;
+//       the steps are matched by event, track id and their order in the track,
+//       the volumes by name; the exit code is 1 if the traces differ
+//
+
+#include "TMCProcess.h"
+#include "TMCStepTraceReader.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+using TEvents = std::map<Int_t, std::vector<TMCStepRecord>>;
+
+/// The command line options
+struct TOptions {
+   Int_t fEvent = -1;
+   Double_t fTolerance = 1.e-4;
+   Double_t fEnergyTolerance = 1.e-4;
+   Int_t fMaxReports = 20;
+};
+
+/// Return the names of the processes in the mask
+std::string GetProcessNames(ULong64_t mask)
+{
+   std::string names;
+   for (Int_t i = 0; i < kMaxMCProcess; ++i) {
+      if (mask & (ULong64_t(1) << i)) {
+         if (!names.empty())
+            names += ",";
+         names += TMCProcessName[i];
+      }
+   }
+   return names.empty() ? "-" : names;
+}
+
+/// Open the trace and read its events
+Bool_t ReadTrace(const char *fileName, const TOptions &options, TMCStepTraceReader *&reader, TEvents &events)
+{
+   reader = new TMCStepTraceReader(fileName);
+   if (!reader->IsOpen())
+      return kFALSE;
+
+   return reader->ReadEvents(events, options.fEvent);
+}
+
+/// Print the steps as text
+Int_t Dump(const char *fileName, const TOptions &options)
+{
+   TMCStepTraceReader reader(fileName);
+   if (!reader.IsOpen())
+      return 2;
+
+   std::printf("%6s %7s %6s %11s %-16s %11s %11s %11s %11s %11s %11s %10s  %s\n", "event", "track", "step", "pdg",
+               "volume", "x(cm)", "y(cm)", "z(cm)", "t(ns)", "Ekin(MeV)", "Edep(MeV)", "step(cm)", "processes");
+
+   Int_t eventId;
+   std::vector<TMCStepRecord> records;
+   while (reader.ReadBlock(eventId, records)) {
+      if (options.fEvent >= 0 && eventId != options.fEvent)
+         continue;
+      for (const TMCStepRecord &record : records) {
+         std::printf("%6d %7d %6d %11d %-16s %11.4f %11.4f %11.4f %11.4f %11.5g %11.5g %10.4f  %s\n", eventId,
+                     record.fTrackId, record.fStepNumber, record.fPdg,
+                     reader.GetVolumeName(record.fEngineId, record.fVolId), record.fX, record.fY, record.fZ,
+                     record.fT * 1.e9, record.fEkin * 1.e3, record.fEdep * 1.e3, record.fStep,
+                     GetProcessNames(record.fProcessMask).c_str());
+      }
+   }
+   return 0;
+}
+
+/// Write the steps in a TTree
+Int_t ConvertToRoot(const char *fileName, const char *outputName, const TOptions &options)
+{
+   TMCStepTraceReader reader(fileName);
+   if (!reader.IsOpen())
+      return 2;
+
+   TFile output(outputName, "RECREATE");
+   if (output.IsZombie())
+      return 2;
+
+   Int_t eventId;
+   TMCStepRecord record;
+   char volName[256];
+   TTree *tree = new TTree("steps", "VMC step trace");
+   tree->Branch("event", &eventId, "event/I");
+   tree->Branch("track", &record.fTrackId, "track/I");
+   tree->Branch("step", &record.fStepNumber, "step/I");
+   tree->Branch("pdg", &record.fPdg, "pdg/I");
+   tree->Branch("engine", &record.fEngineId, "engine/I");
+   tree->Branch("volume", volName, "volume/C");
+   tree->Branch("x", &record.fX, "x/F");
+   tree->Branch("y", &record.fY, "y/F");
+   tree->Branch("z", &record.fZ, "z/F");
+   tree->Branch("t", &record.fT, "t/F");
+   tree->Branch("ekin", &record.fEkin, "ekin/F");
+   tree->Branch("edep", &record.fEdep, "edep/F");
+   tree->Branch("length", &record.fStep, "length/F");
+   tree->Branch("processes", &record.fProcessMask, "processes/l");
+
+   std::vector<TMCStepRecord> records;
+   while (reader.ReadBlock(eventId, records)) {
+      if (options.fEvent >= 0 && eventId != options.fEvent)
+         continue;
+      for (const TMCStepRecord &entry : records) {
+         record = entry;
+         std::strncpy(volName, reader.GetVolumeName(entry.fEngineId, entry.fVolId), sizeof(volName) - 1);
+         volName[sizeof(volName) - 1] = '\0';
+         tree->Fill();
+      }
+   }
+
+   std::cout << "Written " << tree->GetEntries() << " steps in " << outputName << std::endl;
+   output.Write();
+   output.Close();
+   return 0;
+}
+
+/// Group the records of one event per track, in the recorded order
+std::map<Int_t, std::vector<const TMCStepRecord *>> GetTracks(const std::vector<TMCStepRecord> &records)
+{
+   std::map<Int_t, std::vector<const TMCStepRecord *>> tracks;
+   for (const TMCStepRecord &record : records)
+      tracks[record.fTrackId].push_back(&record);
+   return tracks;
+}
+
+/// Compare two traces
+Int_t Diff(const char *fileName1, const char *fileName2, const TOptions &options)
+{
+   TMCStepTraceReader *reader[2] = {nullptr, nullptr};
+   TEvents events[2];
+   Bool_t isRead = ReadTrace(fileName1, options, reader[0], events[0]) &&
+                   ReadTrace(fileName2, options, reader[1], events[1]);
+   if (!isRead) {
+      delete reader[0];
+      delete reader[1];
+      return 2;
+   }
+
+   Long64_t nofCompared = 0;
+   Long64_t nofDifferences = 0;
+   Long64_t nofMissing = 0;
+   Double_t maxDistance = 0.;
+   auto report = [&](Int_t eventId, Int_t trackId, Int_t index, const std::string &what) {
+      if (nofDifferences + nofMissing <= options.fMaxReports) {
+         std::cout << "event " << eventId << " track " << trackId << " step index " << index << ": " << what
+                   << std::endl;
+      }
+   };
+
+   // the union of the event ids
+   std::set<Int_t> eventIds;
+   for (const TEvents &trace : events) {
+      for (const auto &event : trace)
+         eventIds.insert(event.first);
+   }
+   for (Int_t eventId : eventIds) {
+      auto tracks1 = GetTracks(events[0][eventId]);
+      auto tracks2 = GetTracks(events[1][eventId]);
+      auto allTracks = tracks1;
+      allTracks.insert(tracks2.begin(), tracks2.end());
+
+      for (const auto &track : allTracks) {
+         Int_t trackId = track.first;
+         const auto &steps1 = tracks1[trackId];
+         const auto &steps2 = tracks2[trackId];
+         size_t nofSteps = std::min(steps1.size(), steps2.size());
+         for (size_t i = 0; i < nofSteps; ++i) {
+            const TMCStepRecord &a = *steps1[i];
+            const TMCStepRecord &b = *steps2[i];
+            ++nofCompared;
+
+            std::string what;
+            Double_t distance =
+               std::sqrt((a.fX - b.fX) * (a.fX - b.fX) + (a.fY - b.fY) * (a.fY - b.fY) + (a.fZ - b.fZ) * (a.fZ - b.fZ));
+            maxDistance = std::max(maxDistance, distance);
+            if (distance > options.fTolerance)
+               what += " position differs by " + std::to_string(distance) + " cm;";
+            Double_t scale = std::max(std::fabs(a.fEkin), std::fabs(b.fEkin));
+            if (std::fabs(a.fEkin - b.fEkin) > options.fEnergyTolerance * scale)
+               what += " Ekin " + std::to_string(a.fEkin) + " vs " + std::to_string(b.fEkin) + " GeV;";
+            if (a.fPdg != b.fPdg)
+               what += " pdg " + std::to_string(a.fPdg) + " vs " + std::to_string(b.fPdg) + ";";
+            const char *volName1 = reader[0]->GetVolumeName(a.fEngineId, a.fVolId);
+            const char *volName2 = reader[1]->GetVolumeName(b.fEngineId, b.fVolId);
+            if (std::strcmp(volName1, volName2) != 0)
+               what += std::string(" volume ") + volName1 + " vs " + volName2 + ";";
+            if (a.fProcessMask != b.fProcessMask)
+               what += " processes " + GetProcessNames(a.fProcessMask) + " vs " + GetProcessNames(b.fProcessMask) + ";";
+
+            if (!what.empty()) {
+               ++nofDifferences;
+               report(eventId, trackId, i, what);
+            }
+         }
+         if (steps1.size() != steps2.size()) {
+            nofMissing += std::max(steps1.size(), steps2.size()) - nofSteps;
+            report(eventId, trackId, nofSteps,
+                   std::to_string(steps1.size()) + " steps in the first trace, " + std::to_string(steps2.size()) +
+                      " in the second");
+         }
+      }
+   }
+
+   std::cout << "Compared " << nofCompared << " steps in " << eventIds.size() << " events: " << nofDifferences
+             << " differ, " << nofMissing << " are missing in one trace, the maximal distance is " << maxDistance
+             << " cm" << std::endl;
+
+   delete reader[0];
+   delete reader[1];
+   return (nofDifferences || nofMissing) ? 1 : 0;
+}
+
+/// Print the usage
+Int_t Usage()
+{
+   std::cerr << "Usage:\n"
+             << "  vmc_steptrace dump FILE [--event=N]\n"
+             << "  vmc_steptrace root FILE OUTPUT.root [--event=N]\n"
+             << "  vmc_steptrace diff FILE1 FILE2 [--event=N] [--tolerance=CM] [--energy-tolerance=REL] "
+             << "[--max-reports=N]" << std::endl;
+   return 2;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+   TOptions options;
+   std::vector<std::string> arguments;
+   for (Int_t i = 1; i < argc; ++i) {
+      std::string argument(argv[i]);
+      if (argument.compare(0, 8, "--event=") == 0)
+         options.fEvent = std::atoi(argument.c_str() + 8);
+      else if (argument.compare(0, 12, "--tolerance=") == 0)
+         options.fTolerance = std::atof(argument.c_str() + 12);
+      else if (argument.compare(0, 19, "--energy-tolerance=") == 0)
+         options.fEnergyTolerance = std::atof(argument.c_str() + 19);
+      else if (argument.compare(0, 14, "--max-reports=") == 0)
+         options.fMaxReports = std::atoi(argument.c_str() + 14);
+      else if (argument.compare(0, 2, "--") == 0)
+         return Usage();
+      else
+         arguments.push_back(argument);
+   }
+
+   if (arguments.size() == 2 && arguments[0] == "dump")
+      return Dump(arguments[1].c_str(), options);
+   if (arguments.size() == 3 && arguments[0] == "root")
+      return ConvertToRoot(arguments[1].c_str(), arguments[2].c_str(), options);
+   if (arguments.size() == 3 && arguments[0] == "diff")
+      return Diff(arguments[1].c_str(), arguments[2].c_str(), options);
+
+   return Usage();
+}
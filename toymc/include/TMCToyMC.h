@@ -0,0 +1,347 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#ifndef ROOT_TMCToyMC
+#define ROOT_TMCToyMC
+
+//
+// Class TMCToyMC
+// --------------
+// Minimal transport engine with the TGeo navigation and a configurable
+// toy physics, used for testing and benchmarking the VMC
+//
+
+#include <map>
+#include <vector>
+
+#include "TLorentzVector.h"
+#include "TVirtualMC.h"
+
+class TGeoMCGeometry;
+class TGeoNavigator;
+class TParticle;
+
+class TMCToyMC : public TVirtualMC {
+public:
+   TMCToyMC(const char *title);
+   TMCToyMC();
+   virtual ~TMCToyMC();
+
+   //
+   // toy physics configuration
+   // ------------------------------------------------
+   //
+
+   void SetEnergyLoss(Double_t dEdx);
+   void SetInteractionLength(Double_t lambda);
+   void SetSecondaries(Int_t nofSecondaries, Double_t energyFraction, Int_t pdg = 22);
+   void SetEnergyCut(Double_t energyCut);
+   void SetMaxBendingAngle(Double_t angle);
+
+   //
+   // geometry
+   // ------------------------------------------------
+   //
+
+   virtual Bool_t IsRootGeometrySupported() const { return kTRUE; }
+
+   virtual void Material(Int_t &kmat, const char *name, Double_t a, Double_t z, Double_t dens, Double_t radl,
+                         Double_t absl, Float_t *buf, Int_t nwbuf);
+   virtual void Material(Int_t &kmat, const char *name, Double_t a, Double_t z, Double_t dens, Double_t radl,
+                         Double_t absl, Double_t *buf, Int_t nwbuf);
+   virtual void Mixture(Int_t &kmat, const char *name, Float_t *a, Float_t *z, Double_t dens, Int_t nlmat,
+                        Float_t *wmat);
+   virtual void Mixture(Int_t &kmat, const char *name, Double_t *a, Double_t *z, Double_t dens, Int_t nlmat,
+                        Double_t *wmat);
+   virtual void Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isvol, Int_t ifield, Double_t fieldm,
+                       Double_t tmaxfd, Double_t stemax, Double_t deemax, Double_t epsil, Double_t stmin,
+                       Float_t *ubuf, Int_t nbuf);
+   virtual void Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isvol, Int_t ifield, Double_t fieldm,
+                       Double_t tmaxfd, Double_t stemax, Double_t deemax, Double_t epsil, Double_t stmin,
+                       Double_t *ubuf, Int_t nbuf);
+   virtual void Matrix(Int_t &krot, Double_t thetaX, Double_t phiX, Double_t thetaY, Double_t phiY, Double_t thetaZ,
+                       Double_t phiZ);
+   virtual void Gstpar(Int_t itmed, const char *param, Double_t parval);
+
+   virtual Int_t Gsvolu(const char *name, const char *shape, Int_t nmed, Float_t *upar, Int_t np);
+   virtual Int_t Gsvolu(const char *name, const char *shape, Int_t nmed, Double_t *upar, Int_t np);
+   virtual void Gsdvn(const char *name, const char *mother, Int_t ndiv, Int_t iaxis);
+   virtual void Gsdvn2(const char *name, const char *mother, Int_t ndiv, Int_t iaxis, Double_t c0i, Int_t numed);
+   virtual void Gsdvt(const char *name, const char *mother, Double_t step, Int_t iaxis, Int_t numed, Int_t ndvmx);
+   virtual void Gsdvt2(const char *name, const char *mother, Double_t step, Int_t iaxis, Double_t c0, Int_t numed,
+                       Int_t ndvmx);
+   virtual void Gsord(const char *name, Int_t iax);
+   virtual void Gspos(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                      const char *konly = "ONLY");
+   virtual void Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                       const char *konly, Float_t *upar, Int_t np);
+   virtual void Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                       const char *konly, Double_t *upar, Int_t np);
+   virtual void Gsbool(const char *onlyVolName, const char *manyVolName);
+
+   virtual void SetCerenkov(Int_t itmed, Int_t npckov, Float_t *ppckov, Float_t *absco, Float_t *effic,
+                            Float_t *rindex, Bool_t aspline = false, Bool_t rspline = false);
+   virtual void SetCerenkov(Int_t itmed, Int_t npckov, Double_t *ppckov, Double_t *absco, Double_t *effic,
+                            Double_t *rindex, Bool_t aspline = false, Bool_t rspline = false);
+   virtual void DefineOpSurface(const char *name, EMCOpSurfaceModel model, EMCOpSurfaceType surfaceType,
+                                EMCOpSurfaceFinish surfaceFinish, Double_t sigmaAlpha);
+   virtual void SetBorderSurface(const char *name, const char *vol1Name, int vol1CopyNo, const char *vol2Name,
+                                 int vol2CopyNo, const char *opSurfaceName);
+   virtual void SetSkinSurface(const char *name, const char *volName, const char *opSurfaceName);
+   virtual void SetMaterialProperty(Int_t itmed, const char *propertyName, Int_t np, Double_t *pp, Double_t *values,
+                                    Bool_t createNewKey = false, Bool_t spline = false);
+   virtual void SetMaterialProperty(Int_t itmed, const char *propertyName, Double_t value);
+   virtual void SetMaterialProperty(const char *surfaceName, const char *propertyName, Int_t np, Double_t *pp,
+                                    Double_t *values, Bool_t createNewKey = false, Bool_t spline = false);
+
+   virtual Bool_t GetTransformation(const TString &volumePath, TGeoHMatrix &matrix);
+   virtual Bool_t GetShape(const TString &volumePath, TString &shapeType, TArrayD &par);
+   virtual Bool_t GetMaterial(Int_t imat, TString &name, Double_t &a, Double_t &z, Double_t &density,
+                              Double_t &radl, Double_t &inter, TArrayD &par);
+   virtual Bool_t GetMaterial(const TString &volumeName, TString &name, Int_t &imat, Double_t &a, Double_t &z,
+                              Double_t &density, Double_t &radl, Double_t &inter, TArrayD &par);
+   virtual Bool_t GetMedium(const TString &volumeName, TString &name, Int_t &imed, Int_t &nmat, Int_t &isvol,
+                            Int_t &ifield, Double_t &fieldm, Double_t &tmaxfd, Double_t &stemax, Double_t &deemax,
+                            Double_t &epsil, Double_t &stmin, TArrayD &par);
+
+   virtual void WriteEuclid(const char *filnam, const char *topvol, Int_t number, Int_t nlevel);
+   virtual void SetRootGeometry();
+   virtual void SetUserParameters(Bool_t isUserParameters);
+
+   virtual Int_t VolId(const char *volName) const;
+   virtual const char *VolName(Int_t id) const;
+   virtual Int_t MediumId(const char *mediumName) const;
+   virtual Int_t NofVolumes() const;
+   virtual Int_t VolId2Mate(Int_t id) const;
+   virtual Int_t NofVolDaughters(const char *volName) const;
+   virtual const char *VolDaughterName(const char *volName, Int_t i) const;
+   virtual Int_t VolDaughterCopyNo(const char *volName, Int_t i) const;
+
+   //
+   // sensitive detectors
+   // ------------------------------------------------
+   //
+
+   virtual void SetSensitiveDetector(const TString &volName, TVirtualMCSensitiveDetector *sd);
+   virtual TVirtualMCSensitiveDetector *GetSensitiveDetector(const TString &volName) const;
+   virtual void SetExclusiveSDScoring(Bool_t exclusiveSDScoring);
+
+   //
+   // physics
+   // ------------------------------------------------
+   //
+
+   virtual Bool_t SetCut(const char *cutName, Double_t cutValue);
+   virtual Bool_t SetProcess(const char *flagName, Int_t flagValue);
+   virtual Bool_t DefineParticle(Int_t pdg, const char *name, TMCParticleType mcType, Double_t mass, Double_t charge,
+                                 Double_t lifetime);
+   virtual Bool_t DefineParticle(Int_t pdg, const char *name, TMCParticleType mcType, Double_t mass, Double_t charge,
+                                 Double_t lifetime, const TString &pType, Double_t width, Int_t iSpin, Int_t iParity,
+                                 Int_t iConjugation, Int_t iIsospin, Int_t iIsospinZ, Int_t gParity, Int_t lepton,
+                                 Int_t baryon, Bool_t stable, Bool_t shortlived = kFALSE,
+                                 const TString &subType = "", Int_t antiEncoding = 0, Double_t magMoment = 0.0,
+                                 Double_t excitation = 0.0);
+   virtual Bool_t DefineIon(const char *name, Int_t Z, Int_t A, Int_t Q, Double_t excEnergy, Double_t mass = 0.);
+   virtual Bool_t SetDecayMode(Int_t pdg, Float_t bratio[6], Int_t mode[6][3]);
+   virtual Double_t Xsec(char *, Double_t, Int_t, Int_t);
+
+   virtual Int_t IdFromPDG(Int_t pdg) const;
+   virtual Int_t PDGFromId(Int_t id) const;
+   virtual TString ParticleName(Int_t pdg) const;
+   virtual Double_t ParticleMass(Int_t pdg) const;
+   virtual Double_t ParticleCharge(Int_t pdg) const;
+   virtual Double_t ParticleLifeTime(Int_t pdg) const;
+   virtual TMCParticleType ParticleMCType(Int_t pdg) const;
+   virtual Bool_t GetDefinedParticles(TArrayI &pdgs) const;
+
+   //
+   // run control
+   // ------------------------------------------------
+   //
+
+   virtual void StopTrack();
+   virtual void StopEvent();
+   virtual void StopRun();
+   virtual void SetMaxStep(Double_t step);
+   virtual void SetMaxNStep(Int_t nstep);
+   virtual void SetUserDecay(Int_t pdg);
+   virtual void ForceDecayTime(Float_t time);
+
+   //
+   // tracking volume
+   // ------------------------------------------------
+   //
+
+   virtual Int_t CurrentVolID(Int_t &copyNo) const;
+   virtual Int_t CurrentVolOffID(Int_t off, Int_t &copyNo) const;
+   virtual const char *CurrentVolName() const;
+   virtual const char *CurrentVolOffName(Int_t off) const;
+   virtual const char *CurrentVolPath();
+   virtual Bool_t CurrentBoundaryNormal(Double_t &x, Double_t &y, Double_t &z) const;
+   virtual Int_t CurrentMaterial(Float_t &a, Float_t &z, Float_t &dens, Float_t &radl, Float_t &absl) const;
+   virtual Int_t CurrentMedium() const;
+   virtual Int_t CurrentEvent() const;
+   virtual void Gmtod(Float_t *xm, Float_t *xd, Int_t iflag);
+   virtual void Gmtod(Double_t *xm, Double_t *xd, Int_t iflag);
+   virtual void Gdtom(Float_t *xd, Float_t *xm, Int_t iflag);
+   virtual void Gdtom(Double_t *xd, Double_t *xm, Int_t iflag);
+   virtual Double_t MaxStep() const;
+   virtual Int_t GetMaxNStep() const;
+
+   //
+   // tracking particle
+   // ------------------------------------------------
+   //
+
+   virtual void TrackPosition(TLorentzVector &position) const;
+   virtual void TrackPosition(Double_t &x, Double_t &y, Double_t &z) const;
+   virtual void TrackPosition(Float_t &x, Float_t &y, Float_t &z) const;
+   virtual void TrackMomentum(TLorentzVector &momentum) const;
+   virtual void TrackMomentum(Double_t &px, Double_t &py, Double_t &pz, Double_t &etot) const;
+   virtual void TrackMomentum(Float_t &px, Float_t &py, Float_t &pz, Float_t &etot) const;
+   virtual Double_t TrackStep() const { return fStepLength; }
+   virtual Double_t TrackLength() const { return fTrackLength; }
+   virtual Double_t TrackTime() const { return fTime; }
+   virtual Double_t Edep() const { return fEdep; }
+   virtual Double_t NIELEdep() const { return 0.; }
+   virtual Int_t StepNumber() const { return fStepNumber; }
+   virtual Double_t TrackWeight() const { return fWeight; }
+   virtual void TrackPolarization(Double_t &polX, Double_t &polY, Double_t &polZ) const;
+   virtual void TrackPolarization(TVector3 &pol) const;
+   virtual Int_t TrackPid() const { return fPdg; }
+   virtual Double_t TrackCharge() const { return fCharge; }
+   virtual Double_t TrackMass() const { return fMass; }
+   virtual Double_t Etot() const { return fKinEnergy + fMass; }
+
+   virtual Bool_t IsNewTrack() const { return fIsNewTrack; }
+   virtual Bool_t IsTrackInside() const { return !fIsEntering && !fIsExiting && !fIsOut; }
+   virtual Bool_t IsTrackEntering() const { return fIsEntering; }
+   virtual Bool_t IsTrackExiting() const { return fIsExiting; }
+   virtual Bool_t IsTrackOut() const { return fIsOut; }
+   virtual Bool_t IsTrackDisappeared() const { return fIsDisappeared; }
+   virtual Bool_t IsTrackStop() const { return fIsStop; }
+   virtual Bool_t IsTrackAlive() const { return !fIsStop && !fIsDisappeared && !fIsOut; }
+
+   //
+   // secondaries
+   // ------------------------------------------------
+   //
+
+   virtual Int_t NSecondaries() const { return fSecondaries.size(); }
+   virtual void GetSecondary(Int_t isec, Int_t &particleId, TLorentzVector &position, TLorentzVector &momentum);
+   virtual TMCProcess ProdProcess(Int_t isec) const;
+   virtual Int_t StepProcesses(TArrayI &proc) const;
+   virtual Bool_t SecondariesAreOrdered() const { return kTRUE; }
+
+   //
+   // control methods
+   // ------------------------------------------------
+   //
+
+   virtual void Init();
+   virtual void BuildPhysics();
+   virtual void ProcessEvent();
+   virtual void ProcessEvent(Int_t eventId) { TVirtualMC::ProcessEvent(eventId); }
+   virtual Bool_t ProcessRun(Int_t nevent);
+   virtual void InitLego();
+   virtual void SetCollectTracks(Bool_t collectTracks);
+   virtual Bool_t IsCollectTracks() const;
+
+private:
+   /// The properties of the particles defined by the user
+   struct TParticleProperties {
+      TString fName;                          ///< The particle name
+      TMCParticleType fMCType = kPTUndefined; ///< The VMC particle type
+      Double_t fMass = 0.;                    ///< The mass (GeV)
+      Double_t fCharge = 0.;                  ///< The charge (e)
+      Double_t fLifeTime = 0.;                ///< The life time (s)
+   };
+
+   /// The secondary produced in the current step
+   struct TSecondary {
+      Int_t fPdg;               ///< The PDG code
+      TLorentzVector fPosition; ///< The position and time
+      TLorentzVector fMomentum; ///< The momentum and total energy
+   };
+
+   // not implemented
+   TMCToyMC(const TMCToyMC &rhs);
+   TMCToyMC &operator=(const TMCToyMC &rhs);
+
+   // methods
+   virtual void ProcessEvent(Int_t eventId, Bool_t isInterruptible);
+   virtual void InterruptTrack();
+
+   void TransportTracks();
+   void TransportTrack(TParticle *particle, Int_t trackId);
+   void Step();
+   void CallStepping();
+   void ProduceSecondaries();
+   void UpdateKinematics(Double_t kinEnergy);
+   void BendInField(Double_t step);
+   Double_t BendingRadius();
+   const TParticleProperties *FindParticle(Int_t pdg) const;
+
+   // data members
+   TGeoMCGeometry *fGeometry;  //!< The geometry builder
+   TGeoNavigator *fNavigator;  //!< The navigator
+   Bool_t fExclusiveSDScoring; //!< Option to call only the SD in the sensitive volumes
+   Bool_t fIsCollectTracks;    //!< The collect tracks option (not used)
+   Bool_t fIsInitialized;      //!< Whether Init() was called
+   std::map<TString, TVirtualMCSensitiveDetector *> fSensitiveDetectors; //!< The SDs per volume name
+   std::vector<TVirtualMCSensitiveDetector *> fVolumeSD;                 //!< The SDs per volume number
+   std::map<Int_t, TParticleProperties> fParticles;                      //!< The particles defined by the user
+
+   // toy physics
+   Double_t fDEdx;              //!< The energy loss of the charged particles (GeV cm2/g)
+   Double_t fInteractionLength; //!< The interaction length (g/cm2), 0 if no interactions
+   Int_t fNofSecondaries;       //!< The number of secondaries per interaction
+   Double_t fSecondaryFraction; //!< The fraction of the kinetic energy given to the secondaries
+   Int_t fSecondaryPdg;         //!< The PDG code of the secondaries
+   Double_t fEnergyCut;         //!< The kinetic energy below which the tracks are stopped (GeV)
+   Double_t fMaxBendingAngle;   //!< The maximum bending angle per step in a magnetic field
+   Double_t fMaxStep;           //!< The maximum step (cm)
+   Int_t fMaxNStep;             //!< The maximum number of steps per track
+
+   // event state
+   Int_t fCurrentEvent;     //!< The current event number
+   Int_t fNofEvents;        //!< The number of processed events
+   Bool_t fIsInterruptible; //!< Whether the current event is processed in the interruptible mode
+   Bool_t fStopEvent;       //!< Request to stop the event
+   Bool_t fStopRun;         //!< Request to stop the run
+
+   // track state
+   Int_t fTrackId;                       //!< The current track number
+   Int_t fPdg;                           //!< The current particle PDG code
+   Double_t fMass;                       //!< The current particle mass (GeV)
+   Double_t fCharge;                     //!< The current particle charge (e)
+   Double_t fKinEnergy;                  //!< The kinetic energy (GeV)
+   Double_t fMomentum;                   //!< The momentum magnitude (GeV/c)
+   Double_t fPosition[3];                //!< The post-step position (cm)
+   Double_t fDirection[3];               //!< The post-step direction
+   Double_t fPolarization[3];            //!< The polarization
+   Double_t fTime;                       //!< The time of flight (s)
+   Double_t fWeight;                     //!< The track weight
+   Double_t fStepLength;                 //!< The current step length (cm)
+   Double_t fTrackLength;                //!< The track length (cm)
+   Double_t fEdep;                       //!< The energy deposit in the current step (GeV)
+   Int_t fStepNumber;                    //!< The step number
+   Bool_t fIsNewTrack;                   //!< Whether the track starts
+   Bool_t fIsEntering;                   //!< Whether the step starts on the boundary of the current volume
+   Bool_t fIsExiting;                    //!< Whether the step ends on the boundary of the current volume
+   Bool_t fIsOut;                        //!< Whether the track leaves the world
+   Bool_t fIsStop;                       //!< Whether the track is stopped
+   Bool_t fIsDisappeared;                //!< Whether the track disappeared in an interaction
+   Bool_t fIsInterrupted;                //!< Whether the track was interrupted
+   TMCProcess fStepProcess;              //!< The process limiting the current step
+   std::vector<TSecondary> fSecondaries; //!< The secondaries of the current step
+
+   ClassDef(TMCToyMC, 1) // Toy transport engine
+};
+
+#endif // ROOT_TMCToyMC
@@ -0,0 +1,1375 @@
+// -----------------------------------------------------------------------
+// Copyright (C) 2019 CERN and copyright holders of VMC Project.
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "LICENSE".
+//
+// See https://github.com/vmc-project/vmc for full licensing information.
+// -----------------------------------------------------------------------
+
+#include "TMCToyMC.h"
+#include "TGeoMCGeometry.h"
+#include "TMCManager.h"
+#include "TMCManagerStack.h"
+#include "TMCParticleStatus.h"
+#include "TVirtualMCApplication.h"
+#include "TVirtualMCSensitiveDetector.h"
+#include "TVirtualMCStack.h"
+
+#include "TArrayI.h"
+#include "TDatabasePDG.h"
+#include "TError.h"
+#include "TGeoManager.h"
+#include "TGeoMaterial.h"
+#include "TGeoMedium.h"
+#include "TGeoNavigator.h"
+#include "TGeoNode.h"
+#include "TGeoVolume.h"
+#include "TMath.h"
+#include "TParticle.h"
+#include "TParticlePDG.h"
+#include "TRandom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+/** \class TMCToyMC
+    \ingroup vmc
+
+Minimal transport engine implementing TVirtualMC, which allows to run
+the VMC applications, the TMCManager and the I/O without Geant3 or Geant4.
+It is meant for testing and benchmarking, not for physics.
+
+The geometry is built with TGeoMCGeometry and navigated with
+TGeoNavigator. The particles move along straight lines; when a magnetic
+field is set with SetMagField(), the charged particles follow a helix,
+approximated by steps with a bending angle limited by
+SetMaxBendingAngle() and with the direction rotated after each step.
+
+The toy physics is configurable:
+- the charged particles lose the energy dE/dx * density per unit length
+  in the media defined as sensitive (SetEnergyLoss());
+- all particles interact after an exponentially distributed path with
+  the mean interaction length / density (SetInteractionLength()), producing
+  a given number of secondaries, which take a given fraction of
+  the kinetic energy and are emitted isotropically (SetSecondaries());
+- the tracks are stopped below the kinetic energy cut (SetEnergyCut()).
+
+Both the standalone running with ProcessRun() and the interruptible events
+processed by TMCManager, including InterruptTrack() and the resuming of the
+transferred tracks, are supported. The sensitive detectors set with
+SetSensitiveDetector() are called at each step in their volumes.
+*/
+
+ClassImp(TMCToyMC);
+
+namespace {
+// The speed of light (cm/s)
+const Double_t kSpeedOfLight = 2.99792458e10;
+// The bending constant (GeV/c per kGauss and cm)
+const Double_t kBendingConstant = 2.99792458e-4;
+// The unlimited step
+const Double_t kBigStep = 1e10;
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Standard constructor
+///
+
+TMCToyMC::TMCToyMC(const char *title)
+   : TVirtualMC("TMCToyMC", title, kTRUE), fGeometry(new TGeoMCGeometry("TGeoMCGeometry", "TGeo geometry builder")),
+     fNavigator(nullptr), fExclusiveSDScoring(kFALSE), fIsCollectTracks(kFALSE), fIsInitialized(kFALSE),
+     fDEdx(0.002), fInteractionLength(0.), fNofSecondaries(0), fSecondaryFraction(0.), fSecondaryPdg(22),
+     fEnergyCut(0.001), fMaxBendingAngle(0.1), fMaxStep(kBigStep), fMaxNStep(10000), fCurrentEvent(-1),
+     fNofEvents(0), fIsInterruptible(kFALSE), fStopEvent(kFALSE), fStopRun(kFALSE), fTrackId(-1), fPdg(0),
+     fMass(0.), fCharge(0.), fKinEnergy(0.), fMomentum(0.), fTime(0.), fWeight(1.), fStepLength(0.),
+     fTrackLength(0.), fEdep(0.), fStepNumber(0), fIsNewTrack(kFALSE), fIsEntering(kFALSE), fIsExiting(kFALSE),
+     fIsOut(kFALSE), fIsStop(kFALSE), fIsDisappeared(kFALSE), fIsInterrupted(kFALSE), fStepProcess(kPNull)
+{
+   for (Int_t i = 0; i < 3; ++i) {
+      fPosition[i] = 0.;
+      fDirection[i] = 0.;
+      fPolarization[i] = 0.;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Default constructor
+///
+
+TMCToyMC::TMCToyMC()
+   : TVirtualMC(), fGeometry(nullptr), fNavigator(nullptr), fExclusiveSDScoring(kFALSE), fIsCollectTracks(kFALSE),
+     fIsInitialized(kFALSE), fDEdx(0.), fInteractionLength(0.), fNofSecondaries(0), fSecondaryFraction(0.),
+     fSecondaryPdg(22), fEnergyCut(0.), fMaxBendingAngle(0.1), fMaxStep(kBigStep), fMaxNStep(0), fCurrentEvent(-1),
+     fNofEvents(0), fIsInterruptible(kFALSE), fStopEvent(kFALSE), fStopRun(kFALSE), fTrackId(-1), fPdg(0),
+     fMass(0.), fCharge(0.), fKinEnergy(0.), fMomentum(0.), fTime(0.), fWeight(1.), fStepLength(0.),
+     fTrackLength(0.), fEdep(0.), fStepNumber(0), fIsNewTrack(kFALSE), fIsEntering(kFALSE), fIsExiting(kFALSE),
+     fIsOut(kFALSE), fIsStop(kFALSE), fIsDisappeared(kFALSE), fIsInterrupted(kFALSE), fStepProcess(kPNull)
+{
+   for (Int_t i = 0; i < 3; ++i) {
+      fPosition[i] = 0.;
+      fDirection[i] = 0.;
+      fPolarization[i] = 0.;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Destructor
+///
+
+TMCToyMC::~TMCToyMC()
+{
+   delete fGeometry;
+}
+
+//
+// private methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the properties of the particle defined by the user, or nullptr
+///
+
+const TMCToyMC::TParticleProperties *TMCToyMC::FindParticle(Int_t pdg) const
+{
+   auto it = fParticles.find(pdg);
+   if (it == fParticles.end())
+      return nullptr;
+
+   return &it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the kinetic energy and update the momentum magnitude
+///
+
+void TMCToyMC::UpdateKinematics(Double_t kinEnergy)
+{
+   fKinEnergy = kinEnergy > 0. ? kinEnergy : 0.;
+   fMomentum = std::sqrt(fKinEnergy * (fKinEnergy + 2. * fMass));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Return the bending radius (cm) of the current track in the field at its
+/// position, or 0 if the track is not bent
+///
+
+Double_t TMCToyMC::BendingRadius()
+{
+   if (fCharge == 0. || fMomentum <= 0. || !GetMagField())
+      return 0.;
+
+   Double_t b[3];
+   EvaluateField(1, fPosition, b);
+   Double_t bmag = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+   if (bmag <= 0.)
+      return 0.;
+
+   return fMomentum / (kBendingConstant * std::abs(fCharge) * bmag);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Rotate the direction as on a helix after the given step
+///
+
+void TMCToyMC::BendInField(Double_t step)
+{
+   if (fCharge == 0. || fMomentum <= 0. || !GetMagField())
+      return;
+
+   Double_t b[3];
+   EvaluateField(1, fPosition, b);
+   Double_t bmag = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+   if (bmag <= 0.)
+      return;
+
+   // the rotation around the field direction n by the angle theta:
+   // d' = d cos(theta) + (n x d) sin(theta) + n (n.d) (1 - cos(theta))
+   Double_t n[3] = {b[0] / bmag, b[1] / bmag, b[2] / bmag};
+   Double_t theta = -fCharge * kBendingConstant * bmag * step / fMomentum;
+   Double_t cost = std::cos(theta);
+   Double_t sint = std::sin(theta);
+   Double_t nd = n[0] * fDirection[0] + n[1] * fDirection[1] + n[2] * fDirection[2];
+   Double_t cross[3] = {n[1] * fDirection[2] - n[2] * fDirection[1], n[2] * fDirection[0] - n[0] * fDirection[2],
+                        n[0] * fDirection[1] - n[1] * fDirection[0]};
+   Double_t norm = 0.;
+   for (Int_t i = 0; i < 3; ++i) {
+      fDirection[i] = fDirection[i] * cost + cross[i] * sint + n[i] * nd * (1. - cost);
+      norm += fDirection[i] * fDirection[i];
+   }
+   norm = 1. / std::sqrt(norm);
+   for (Int_t i = 0; i < 3; ++i)
+      fDirection[i] *= norm;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Call the sensitive detector of the current volume and/or the user
+/// stepping
+///
+
+void TMCToyMC::CallStepping()
+{
+   TVirtualMCSensitiveDetector *sd = nullptr;
+   TGeoVolume *volume = fNavigator->GetCurrentVolume();
+   if (volume && volume->GetNumber() < Int_t(fVolumeSD.size()))
+      sd = fVolumeSD[volume->GetNumber()];
+
+   if (sd)
+      sd->ProcessHits();
+   if (!sd || !fExclusiveSDScoring)
+      fApplication->Stepping();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Produce the secondaries of an interaction and push them on the stack
+///
+
+void TMCToyMC::ProduceSecondaries()
+{
+   TRandom *random = GetRandom() ? GetRandom() : gRandom;
+   Double_t secondaryMass = ParticleMass(fSecondaryPdg);
+   Double_t secondaryKinEnergy = fSecondaryFraction * fKinEnergy / fNofSecondaries;
+
+   for (Int_t i = 0; i < fNofSecondaries; ++i) {
+      if (secondaryKinEnergy < fEnergyCut) {
+         // deposit the energy of the secondaries below the cut
+         fEdep += secondaryKinEnergy;
+         continue;
+      }
+      Double_t p = std::sqrt(secondaryKinEnergy * (secondaryKinEnergy + 2. * secondaryMass));
+      Double_t cost = 2. * random->Rndm() - 1.;
+      Double_t sint = std::sqrt(1. - cost * cost);
+      Double_t phi = TMath::TwoPi() * random->Rndm();
+      Double_t px = p * sint * std::cos(phi);
+      Double_t py = p * sint * std::sin(phi);
+      Double_t pz = p * cost;
+      Double_t e = secondaryKinEnergy + secondaryMass;
+
+      TSecondary secondary;
+      secondary.fPdg = fSecondaryPdg;
+      secondary.fPosition.SetXYZT(fPosition[0], fPosition[1], fPosition[2], fTime);
+      secondary.fMomentum.SetPxPyPzE(px, py, pz, e);
+      fSecondaries.push_back(secondary);
+
+      Int_t ntr;
+      GetStack()->PushTrack(1, fTrackId, fSecondaryPdg, px, py, pz, e, fPosition[0], fPosition[1], fPosition[2], fTime,
+                            0., 0., 0., kPHadronic, ntr, fWeight, 0);
+   }
+
+   UpdateKinematics(fKinEnergy * (1. - fSecondaryFraction));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Make one step of the current track
+///
+
+void TMCToyMC::Step()
+{
+   // the state of the step
+   fSecondaries.clear();
+   fEdep = 0.;
+   fIsEntering = fIsExiting;
+   fIsExiting = kFALSE;
+   ++fStepNumber;
+
+   TGeoNode *node = fNavigator->GetCurrentNode();
+   if (fNavigator->IsOutside() || !node) {
+      fIsOut = kTRUE;
+      return;
+   }
+   TGeoMedium *medium = node->GetVolume()->GetMedium();
+   Double_t density = medium ? medium->GetMaterial()->GetDensity() : 0.;
+   Bool_t isSensitive = medium && medium->GetParam(0) > 0.;
+
+   // the physics step limits
+   Double_t stepMax = fMaxStep;
+   fStepProcess = kPTransportation;
+   Double_t interactionStep = kBigStep;
+   if (fInteractionLength > 0. && density > 0. && fNofSecondaries > 0) {
+      TRandom *random = GetRandom() ? GetRandom() : gRandom;
+      interactionStep = -std::log(1. - random->Rndm()) * fInteractionLength / density;
+      if (interactionStep < stepMax) {
+         stepMax = interactionStep;
+         fStepProcess = kPHadronic;
+      }
+   }
+   Double_t dEdx = (fCharge != 0. && isSensitive) ? fDEdx * density : 0.;
+   if (dEdx > 0. && fKinEnergy / dEdx < stepMax) {
+      stepMax = fKinEnergy / dEdx;
+      fStepProcess = kPStop;
+   }
+   Double_t radius = BendingRadius();
+   if (radius > 0. && fMaxBendingAngle * radius < stepMax) {
+      stepMax = fMaxBendingAngle * radius;
+      fStepProcess = kPMagneticFieldL;
+   }
+
+   // the geometry step limit
+   fNavigator->SetCurrentDirection(fDirection);
+   fNavigator->FindNextBoundary(stepMax);
+   Double_t step = fNavigator->GetStep();
+   Bool_t isCrossing = step < stepMax;
+   if (isCrossing) {
+      fStepProcess = kPTransportation;
+      fIsExiting = kTRUE;
+      fIsOut = fNavigator->GetLevel() == 0 && fNavigator->IsStepExiting();
+   } else {
+      step = stepMax;
+   }
+
+   // update the track
+   for (Int_t i = 0; i < 3; ++i)
+      fPosition[i] += step * fDirection[i];
+   Double_t beta = (fKinEnergy + fMass) > 0. ? fMomentum / (fKinEnergy + fMass) : 1.;
+   fTime += step / (beta * kSpeedOfLight);
+   fStepLength = step;
+   fTrackLength += step;
+
+   if (dEdx > 0.) {
+      Double_t eloss = dEdx * step;
+      if (fStepProcess == kPStop || eloss >= fKinEnergy)
+         eloss = fKinEnergy;
+      fEdep += eloss;
+      UpdateKinematics(fKinEnergy - eloss);
+   }
+   if (fStepProcess == kPHadronic) {
+      ProduceSecondaries();
+   }
+   if (fKinEnergy < fEnergyCut) {
+      if (fCharge != 0. && isSensitive)
+         fEdep += fKinEnergy;
+      UpdateKinematics(0.);
+   }
+   fIsStop = fKinEnergy <= 0. || fStepNumber >= fMaxNStep;
+
+   // the user actions see the volume of the pre-step point
+   CallStepping();
+   if (fIsInterrupted)
+      return;
+
+   // move the navigator to the post-step point
+   if (isCrossing) {
+      fNavigator->SetStep(step);
+      fNavigator->Step(kTRUE, kTRUE);
+      fIsOut = fIsOut || fNavigator->IsOutside();
+   } else {
+      fNavigator->SetCurrentPoint(fPosition);
+   }
+   BendInField(step);
+
+   Double_t rmax = fApplication->TrackingRmax();
+   Double_t zmax = fApplication->TrackingZmax();
+   if (fPosition[0] * fPosition[0] + fPosition[1] * fPosition[1] > rmax * rmax || std::abs(fPosition[2]) > zmax)
+      fIsOut = kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Transport one track until it stops, leaves the world or is interrupted
+///
+
+void TMCToyMC::TransportTrack(TParticle *particle, Int_t trackId)
+{
+   fTrackId = trackId;
+   fPdg = particle->GetPdgCode();
+   fMass = ParticleMass(fPdg);
+   fCharge = ParticleCharge(fPdg);
+   fEdep = 0.;
+   fStepLength = 0.;
+   fSecondaries.clear();
+   fIsEntering = fIsExiting = fIsOut = fIsStop = fIsDisappeared = fIsInterrupted = kFALSE;
+   fStepProcess = kPNull;
+
+   // the track transferred from another engine (with its geometry state saved,
+   // possibly before its first step) is resumed from its last state
+   const TMCParticleStatus *status = GetManagerStack() ? GetManagerStack()->GetParticleStatus(trackId) : nullptr;
+   Bool_t isResumed = status && (status->fStepNumber > 0 || status->fGeoStateIndex > 0);
+
+   TLorentzVector position;
+   TLorentzVector momentum;
+   TVector3 polarization;
+   if (isResumed) {
+      position = status->fPosition;
+      momentum = status->fMomentum;
+      polarization = status->fPolarization;
+      fWeight = status->fWeight;
+      fStepNumber = status->fStepNumber;
+      fTrackLength = status->fTrackLength;
+   } else {
+      particle->ProductionVertex(position);
+      particle->Momentum(momentum);
+      particle->GetPolarisation(polarization);
+      fWeight = particle->GetWeight();
+      fStepNumber = 0;
+      fTrackLength = 0.;
+   }
+
+   fPosition[0] = position.X();
+   fPosition[1] = position.Y();
+   fPosition[2] = position.Z();
+   fTime = position.T();
+   fPolarization[0] = polarization.X();
+   fPolarization[1] = polarization.Y();
+   fPolarization[2] = polarization.Z();
+   Double_t p = momentum.P();
+   if (p > 0.) {
+      fDirection[0] = momentum.Px() / p;
+      fDirection[1] = momentum.Py() / p;
+      fDirection[2] = momentum.Pz() / p;
+   } else {
+      fDirection[0] = fDirection[1] = 0.;
+      fDirection[2] = 1.;
+   }
+   UpdateKinematics(momentum.E() - fMass);
+
+   if (isResumed && TMCManager::Instance() && TMCManager::Instance()->RestoreGeometryState(trackId)) {
+      // the navigator state is restored, only the point and direction are updated
+      fNavigator->SetCurrentPoint(fPosition);
+      fNavigator->SetCurrentDirection(fDirection);
+   } else {
+      fNavigator->InitTrack(fPosition, fDirection);
+   }
+
+   if (!isResumed) {
+      fIsNewTrack = kTRUE;
+      fApplication->PreTrack();
+      // the zero step of the new track
+      CallStepping();
+      fIsNewTrack = kFALSE;
+   }
+
+   while (!fIsInterrupted && IsTrackAlive()) {
+      Step();
+   }
+   if (fIsInterrupted)
+      return;
+
+   fApplication->PostTrack();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Transport all tracks from the stack
+///
+
+void TMCToyMC::TransportTracks()
+{
+   Bool_t isPrimaryOpen = kFALSE;
+   Int_t trackId;
+   while (!fStopEvent) {
+      TParticle *particle = GetStack()->PopNextTrack(trackId);
+      if (!particle)
+         break;
+
+      if (GetStack()->GetCurrentParentTrackNumber() < 0 && !fIsInterruptible) {
+         if (isPrimaryOpen)
+            fApplication->FinishPrimary();
+         fApplication->BeginPrimary();
+         isPrimaryOpen = kTRUE;
+      }
+      TransportTrack(particle, trackId);
+   }
+   if (isPrimaryOpen)
+      fApplication->FinishPrimary();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Process one event. In the interruptible mode (used by TMCManager)
+/// the primaries are not generated and the begin/finish event actions
+/// are not called.
+///
+
+void TMCToyMC::ProcessEvent(Int_t eventId, Bool_t isInterruptible)
+{
+   if (!fIsInitialized) {
+      ::Error("TMCToyMC::ProcessEvent", "The engine is not initialized.");
+      return;
+   }
+
+   fCurrentEvent = eventId;
+   fIsInterruptible = isInterruptible;
+   fStopEvent = kFALSE;
+
+   // The navigator of this thread: in the concurrent mode of TMCManager the
+   // engine runs in its own thread, not in the one where it was initialized
+   fNavigator = gGeoManager->GetCurrentNavigator();
+   if (!fNavigator)
+      fNavigator = gGeoManager->AddNavigator();
+
+   if (!isInterruptible) {
+      fApplication->BeginEvent();
+      fApplication->GeneratePrimaries();
+   }
+
+   TransportTracks();
+
+   if (!isInterruptible) {
+      for (auto &entry : fSensitiveDetectors)
+         entry.second->EndOfEvent();
+      fApplication->FinishEvent();
+      ++fNofEvents;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Stop the transport of the current track without calling the user
+/// post-track action (the track is continued by another engine)
+///
+
+void TMCToyMC::InterruptTrack()
+{
+   fIsInterrupted = kTRUE;
+}
+
+//
+// public methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the energy loss of the charged particles in the sensitive media
+/// (GeV cm2/g); the default is 0.002
+///
+
+void TMCToyMC::SetEnergyLoss(Double_t dEdx)
+{
+   fDEdx = dEdx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the interaction length (g/cm2); interactions are switched off if 0
+/// (default)
+///
+
+void TMCToyMC::SetInteractionLength(Double_t lambda)
+{
+   fInteractionLength = lambda;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the secondaries produced per interaction
+/// - nofSecondaries  The number of secondaries
+/// - energyFraction  The fraction of the kinetic energy shared by the secondaries
+/// - pdg             The PDG code of the secondaries
+///
+
+void TMCToyMC::SetSecondaries(Int_t nofSecondaries, Double_t energyFraction, Int_t pdg)
+{
+   fNofSecondaries = nofSecondaries;
+   fSecondaryFraction = energyFraction;
+   fSecondaryPdg = pdg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the kinetic energy cut (GeV); the default is 1 MeV
+///
+
+void TMCToyMC::SetEnergyCut(Double_t energyCut)
+{
+   fEnergyCut = energyCut;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Set the maximum bending angle per step in the magnetic field (rad);
+/// the default is 0.1
+///
+
+void TMCToyMC::SetMaxBendingAngle(Double_t angle)
+{
+   fMaxBendingAngle = angle;
+}
+
+//
+// geometry: delegated to TGeoMCGeometry
+//
+
+void TMCToyMC::Material(Int_t &kmat, const char *name, Double_t a, Double_t z, Double_t dens, Double_t radl,
+                        Double_t absl, Float_t *buf, Int_t nwbuf)
+{
+   fGeometry->Material(kmat, name, a, z, dens, radl, absl, buf, nwbuf);
+}
+
+void TMCToyMC::Material(Int_t &kmat, const char *name, Double_t a, Double_t z, Double_t dens, Double_t radl,
+                        Double_t absl, Double_t *buf, Int_t nwbuf)
+{
+   fGeometry->Material(kmat, name, a, z, dens, radl, absl, buf, nwbuf);
+}
+
+void TMCToyMC::Mixture(Int_t &kmat, const char *name, Float_t *a, Float_t *z, Double_t dens, Int_t nlmat,
+                       Float_t *wmat)
+{
+   fGeometry->Mixture(kmat, name, a, z, dens, nlmat, wmat);
+}
+
+void TMCToyMC::Mixture(Int_t &kmat, const char *name, Double_t *a, Double_t *z, Double_t dens, Int_t nlmat,
+                       Double_t *wmat)
+{
+   fGeometry->Mixture(kmat, name, a, z, dens, nlmat, wmat);
+}
+
+void TMCToyMC::Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isvol, Int_t ifield, Double_t fieldm,
+                      Double_t tmaxfd, Double_t stemax, Double_t deemax, Double_t epsil, Double_t stmin, Float_t *ubuf,
+                      Int_t nbuf)
+{
+   fGeometry->Medium(kmed, name, nmat, isvol, ifield, fieldm, tmaxfd, stemax, deemax, epsil, stmin, ubuf, nbuf);
+}
+
+void TMCToyMC::Medium(Int_t &kmed, const char *name, Int_t nmat, Int_t isvol, Int_t ifield, Double_t fieldm,
+                      Double_t tmaxfd, Double_t stemax, Double_t deemax, Double_t epsil, Double_t stmin,
+                      Double_t *ubuf, Int_t nbuf)
+{
+   fGeometry->Medium(kmed, name, nmat, isvol, ifield, fieldm, tmaxfd, stemax, deemax, epsil, stmin, ubuf, nbuf);
+}
+
+void TMCToyMC::Matrix(Int_t &krot, Double_t thetaX, Double_t phiX, Double_t thetaY, Double_t phiY, Double_t thetaZ,
+                      Double_t phiZ)
+{
+   fGeometry->Matrix(krot, thetaX, phiX, thetaY, phiY, thetaZ, phiZ);
+}
+
+void TMCToyMC::Gstpar(Int_t /*itmed*/, const char * /*param*/, Double_t /*parval*/) {}
+
+Int_t TMCToyMC::Gsvolu(const char *name, const char *shape, Int_t nmed, Float_t *upar, Int_t np)
+{
+   return fGeometry->Gsvolu(name, shape, nmed, upar, np);
+}
+
+Int_t TMCToyMC::Gsvolu(const char *name, const char *shape, Int_t nmed, Double_t *upar, Int_t np)
+{
+   return fGeometry->Gsvolu(name, shape, nmed, upar, np);
+}
+
+void TMCToyMC::Gsdvn(const char *name, const char *mother, Int_t ndiv, Int_t iaxis)
+{
+   fGeometry->Gsdvn(name, mother, ndiv, iaxis);
+}
+
+void TMCToyMC::Gsdvn2(const char *name, const char *mother, Int_t ndiv, Int_t iaxis, Double_t c0i, Int_t numed)
+{
+   fGeometry->Gsdvn2(name, mother, ndiv, iaxis, c0i, numed);
+}
+
+void TMCToyMC::Gsdvt(const char *name, const char *mother, Double_t step, Int_t iaxis, Int_t numed, Int_t ndvmx)
+{
+   fGeometry->Gsdvt(name, mother, step, iaxis, numed, ndvmx);
+}
+
+void TMCToyMC::Gsdvt2(const char *name, const char *mother, Double_t step, Int_t iaxis, Double_t c0, Int_t numed,
+                      Int_t ndvmx)
+{
+   fGeometry->Gsdvt2(name, mother, step, iaxis, c0, numed, ndvmx);
+}
+
+void TMCToyMC::Gsord(const char *name, Int_t iax)
+{
+   fGeometry->Gsord(name, iax);
+}
+
+void TMCToyMC::Gspos(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                     const char *konly)
+{
+   fGeometry->Gspos(name, nr, mother, x, y, z, irot, konly);
+}
+
+void TMCToyMC::Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                      const char *konly, Float_t *upar, Int_t np)
+{
+   fGeometry->Gsposp(name, nr, mother, x, y, z, irot, konly, upar, np);
+}
+
+void TMCToyMC::Gsposp(const char *name, Int_t nr, const char *mother, Double_t x, Double_t y, Double_t z, Int_t irot,
+                      const char *konly, Double_t *upar, Int_t np)
+{
+   fGeometry->Gsposp(name, nr, mother, x, y, z, irot, konly, upar, np);
+}
+
+void TMCToyMC::Gsbool(const char *onlyVolName, const char *manyVolName)
+{
+   fGeometry->Gsbool(onlyVolName, manyVolName);
+}
+
+Bool_t TMCToyMC::GetTransformation(const TString &volumePath, TGeoHMatrix &matrix)
+{
+   return fGeometry->GetTransformation(volumePath, matrix);
+}
+
+Bool_t TMCToyMC::GetShape(const TString &volumePath, TString &shapeType, TArrayD &par)
+{
+   return fGeometry->GetShape(volumePath, shapeType, par);
+}
+
+Bool_t TMCToyMC::GetMaterial(Int_t imat, TString &name, Double_t &a, Double_t &z, Double_t &density, Double_t &radl,
+                             Double_t &inter, TArrayD &par)
+{
+   if (!gGeoManager)
+      return kFALSE;
+
+   TIter next(gGeoManager->GetListOfMaterials());
+   while (TGeoMaterial *material = static_cast<TGeoMaterial *>(next())) {
+      if (Int_t(material->GetUniqueID()) != imat)
+         continue;
+      name = material->GetName();
+      name = name.Strip(TString::kTrailing, '$');
+      a = material->GetA();
+      z = material->GetZ();
+      density = material->GetDensity();
+      radl = material->GetRadLen();
+      inter = material->GetIntLen();
+      par.Set(0);
+      return kTRUE;
+   }
+   return kFALSE;
+}
+
+Bool_t TMCToyMC::GetMaterial(const TString &volumeName, TString &name, Int_t &imat, Double_t &a, Double_t &z,
+                             Double_t &density, Double_t &radl, Double_t &inter, TArrayD &par)
+{
+   return fGeometry->GetMaterial(volumeName, name, imat, a, z, density, radl, inter, par);
+}
+
+Bool_t TMCToyMC::GetMedium(const TString &volumeName, TString &name, Int_t &imed, Int_t &nmat, Int_t &isvol,
+                           Int_t &ifield, Double_t &fieldm, Double_t &tmaxfd, Double_t &stemax, Double_t &deemax,
+                           Double_t &epsil, Double_t &stmin, TArrayD &par)
+{
+   return fGeometry->GetMedium(volumeName, name, imed, nmat, isvol, ifield, fieldm, tmaxfd, stemax, deemax, epsil,
+                               stmin, par);
+}
+
+Int_t TMCToyMC::VolId(const char *volName) const
+{
+   return fGeometry->VolId(volName);
+}
+
+const char *TMCToyMC::VolName(Int_t id) const
+{
+   return fGeometry->VolName(id);
+}
+
+Int_t TMCToyMC::MediumId(const char *mediumName) const
+{
+   return fGeometry->MediumId(mediumName);
+}
+
+Int_t TMCToyMC::NofVolumes() const
+{
+   return fGeometry->NofVolumes();
+}
+
+Int_t TMCToyMC::VolId2Mate(Int_t id) const
+{
+   return fGeometry->VolId2Mate(id);
+}
+
+Int_t TMCToyMC::NofVolDaughters(const char *volName) const
+{
+   return fGeometry->NofVolDaughters(volName);
+}
+
+const char *TMCToyMC::VolDaughterName(const char *volName, Int_t i) const
+{
+   return fGeometry->VolDaughterName(volName, i);
+}
+
+Int_t TMCToyMC::VolDaughterCopyNo(const char *volName, Int_t i) const
+{
+   return fGeometry->VolDaughterCopyNo(volName, i);
+}
+
+//
+// geometry: not supported
+//
+
+void TMCToyMC::SetCerenkov(Int_t, Int_t, Float_t *, Float_t *, Float_t *, Float_t *, Bool_t, Bool_t) {}
+
+void TMCToyMC::SetCerenkov(Int_t, Int_t, Double_t *, Double_t *, Double_t *, Double_t *, Bool_t, Bool_t) {}
+
+void TMCToyMC::DefineOpSurface(const char *, EMCOpSurfaceModel, EMCOpSurfaceType, EMCOpSurfaceFinish, Double_t) {}
+
+void TMCToyMC::SetBorderSurface(const char *, const char *, int, const char *, int, const char *) {}
+
+void TMCToyMC::SetSkinSurface(const char *, const char *, const char *) {}
+
+void TMCToyMC::SetMaterialProperty(Int_t, const char *, Int_t, Double_t *, Double_t *, Bool_t, Bool_t) {}
+
+void TMCToyMC::SetMaterialProperty(Int_t, const char *, Double_t) {}
+
+void TMCToyMC::SetMaterialProperty(const char *, const char *, Int_t, Double_t *, Double_t *, Bool_t, Bool_t) {}
+
+void TMCToyMC::WriteEuclid(const char *, const char *, Int_t, Int_t)
+{
+   ::Warning("TMCToyMC::WriteEuclid", "Not supported.");
+}
+
+void TMCToyMC::SetRootGeometry() {}
+
+void TMCToyMC::SetUserParameters(Bool_t) {}
+
+//
+// sensitive detectors
+//
+
+void TMCToyMC::SetSensitiveDetector(const TString &volName, TVirtualMCSensitiveDetector *sd)
+{
+   fSensitiveDetectors[volName] = sd;
+}
+
+TVirtualMCSensitiveDetector *TMCToyMC::GetSensitiveDetector(const TString &volName) const
+{
+   auto it = fSensitiveDetectors.find(volName);
+   if (it == fSensitiveDetectors.end())
+      return nullptr;
+
+   return it->second;
+}
+
+void TMCToyMC::SetExclusiveSDScoring(Bool_t exclusiveSDScoring)
+{
+   fExclusiveSDScoring = exclusiveSDScoring;
+}
+
+//
+// physics
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The cuts are not used by the toy physics (use SetEnergyCut())
+///
+
+Bool_t TMCToyMC::SetCut(const char *, Double_t)
+{
+   return kTRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// The process flags are not used by the toy physics
+///
+
+Bool_t TMCToyMC::SetProcess(const char *, Int_t)
+{
+   return kTRUE;
+}
+
+Bool_t TMCToyMC::DefineParticle(Int_t pdg, const char *name, TMCParticleType mcType, Double_t mass, Double_t charge,
+                                Double_t lifetime)
+{
+   TParticleProperties &properties = fParticles[pdg];
+   properties.fName = name;
+   properties.fMCType = mcType;
+   properties.fMass = mass;
+   properties.fCharge = charge;
+   properties.fLifeTime = lifetime;
+   return kTRUE;
+}
+
+Bool_t TMCToyMC::DefineParticle(Int_t pdg, const char *name, TMCParticleType mcType, Double_t mass, Double_t charge,
+                                Double_t lifetime, const TString &, Double_t, Int_t, Int_t, Int_t, Int_t, Int_t,
+                                Int_t, Int_t, Int_t, Bool_t, Bool_t, const TString &, Int_t, Double_t, Double_t)
+{
+   return DefineParticle(pdg, name, mcType, mass, charge, lifetime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Define an ion with the PDG code 10LZZZAAAI; the mass is A * 0.9315 GeV
+/// if not given
+///
+
+Bool_t TMCToyMC::DefineIon(const char *name, Int_t Z, Int_t A, Int_t Q, Double_t excEnergy, Double_t mass)
+{
+   Int_t pdg = 1000000000 + Z * 10000 + A * 10 + (excEnergy > 0. ? 1 : 0);
+   if (mass <= 0.)
+      mass = A * 0.931494 + excEnergy;
+
+   return DefineParticle(pdg, name, kPTIon, mass, Q, 0.);
+}
+
+Bool_t TMCToyMC::SetDecayMode(Int_t, Float_t[6], Int_t[6][3])
+{
+   ::Warning("TMCToyMC::SetDecayMode", "The decays are not supported.");
+   return kFALSE;
+}
+
+Double_t TMCToyMC::Xsec(char *, Double_t, Int_t, Int_t)
+{
+   return 0.;
+}
+
+Int_t TMCToyMC::IdFromPDG(Int_t pdg) const
+{
+   return pdg;
+}
+
+Int_t TMCToyMC::PDGFromId(Int_t id) const
+{
+   return id;
+}
+
+TString TMCToyMC::ParticleName(Int_t pdg) const
+{
+   if (const TParticleProperties *properties = FindParticle(pdg))
+      return properties->fName;
+
+   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(pdg);
+   return particle ? TString(particle->GetName()) : TString("unknown");
+}
+
+Double_t TMCToyMC::ParticleMass(Int_t pdg) const
+{
+   if (const TParticleProperties *properties = FindParticle(pdg))
+      return properties->fMass;
+
+   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(pdg);
+   return particle ? particle->Mass() : 0.;
+}
+
+Double_t TMCToyMC::ParticleCharge(Int_t pdg) const
+{
+   if (const TParticleProperties *properties = FindParticle(pdg))
+      return properties->fCharge;
+
+   // TParticlePDG charge is in units of |e|/3
+   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(pdg);
+   return particle ? particle->Charge() / 3. : 0.;
+}
+
+Double_t TMCToyMC::ParticleLifeTime(Int_t pdg) const
+{
+   if (const TParticleProperties *properties = FindParticle(pdg))
+      return properties->fLifeTime;
+
+   TParticlePDG *particle = TDatabasePDG::Instance()->GetParticle(pdg);
+   return particle ? particle->Lifetime() : 0.;
+}
+
+TMCParticleType TMCToyMC::ParticleMCType(Int_t pdg) const
+{
+   if (const TParticleProperties *properties = FindParticle(pdg))
+      return properties->fMCType;
+
+   switch (std::abs(pdg)) {
+   case 22: return kPTGamma;
+   case 11: return kPTElectron;
+   case 13: return kPTMuon;
+   case 2112: return kPTNeutron;
+   case 0: return kPTGeantino;
+   default: break;
+   }
+   if (std::abs(pdg) > 1000000000)
+      return kPTIon;
+   return TDatabasePDG::Instance()->GetParticle(pdg) ? kPTHadron : kPTUndefined;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Fill the PDG codes of the particles handled by the toy physics and of
+/// the particles and ions defined by the user
+///
+
+Bool_t TMCToyMC::GetDefinedParticles(TArrayI &pdgs) const
+{
+   static const Int_t kStandardPdgs[] = {0, 22, 11, -11, 13, -13, 111, 211, -211, 2212, -2212, 2112};
+   std::vector<Int_t> codes(std::begin(kStandardPdgs), std::end(kStandardPdgs));
+   codes.push_back(fSecondaryPdg);
+   for (const auto &particle : fParticles) {
+      codes.push_back(particle.first);
+   }
+   std::sort(codes.begin(), codes.end());
+   codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+   pdgs.Set(codes.size());
+   for (std::size_t i = 0; i < codes.size(); ++i) {
+      pdgs[i] = codes[i];
+   }
+   return kTRUE;
+}
+
+//
+// run control
+//
+
+void TMCToyMC::StopTrack()
+{
+   fIsStop = kTRUE;
+}
+
+void TMCToyMC::StopEvent()
+{
+   fIsStop = kTRUE;
+   fStopEvent = kTRUE;
+}
+
+void TMCToyMC::StopRun()
+{
+   StopEvent();
+   fStopRun = kTRUE;
+}
+
+void TMCToyMC::SetMaxStep(Double_t step)
+{
+   fMaxStep = step > 0. ? step : kBigStep;
+}
+
+void TMCToyMC::SetMaxNStep(Int_t nstep)
+{
+   fMaxNStep = nstep;
+}
+
+void TMCToyMC::SetUserDecay(Int_t)
+{
+   ::Warning("TMCToyMC::SetUserDecay", "The decays are not supported.");
+}
+
+void TMCToyMC::ForceDecayTime(Float_t)
+{
+   ::Warning("TMCToyMC::ForceDecayTime", "The decays are not supported.");
+}
+
+//
+// tracking volume
+//
+
+Int_t TMCToyMC::CurrentVolID(Int_t &copyNo) const
+{
+   TGeoNode *node = fNavigator->GetCurrentNode();
+   if (!node) {
+      copyNo = 0;
+      return 0;
+   }
+   copyNo = node->GetNumber();
+   return node->GetVolume()->GetNumber();
+}
+
+Int_t TMCToyMC::CurrentVolOffID(Int_t off, Int_t &copyNo) const
+{
+   if (off == 0)
+      return CurrentVolID(copyNo);
+
+   TGeoNode *node = off <= fNavigator->GetLevel() ? fNavigator->GetMother(off) : nullptr;
+   if (!node) {
+      copyNo = 0;
+      return 0;
+   }
+   copyNo = node->GetNumber();
+   return node->GetVolume()->GetNumber();
+}
+
+const char *TMCToyMC::CurrentVolName() const
+{
+   TGeoVolume *volume = fNavigator->GetCurrentVolume();
+   return volume ? volume->GetName() : "";
+}
+
+const char *TMCToyMC::CurrentVolOffName(Int_t off) const
+{
+   if (off == 0)
+      return CurrentVolName();
+
+   TGeoNode *node = off <= fNavigator->GetLevel() ? fNavigator->GetMother(off) : nullptr;
+   return node ? node->GetVolume()->GetName() : "";
+}
+
+const char *TMCToyMC::CurrentVolPath()
+{
+   return fNavigator->GetPath();
+}
+
+Bool_t TMCToyMC::CurrentBoundaryNormal(Double_t &x, Double_t &y, Double_t &z) const
+{
+   if (!fIsExiting)
+      return kFALSE;
+
+   Double_t *normal = fNavigator->FindNormal(kTRUE);
+   if (!normal)
+      return kFALSE;
+
+   x = normal[0];
+   y = normal[1];
+   z = normal[2];
+   return kTRUE;
+}
+
+Int_t TMCToyMC::CurrentMaterial(Float_t &a, Float_t &z, Float_t &dens, Float_t &radl, Float_t &absl) const
+{
+   TGeoVolume *volume = fNavigator->GetCurrentVolume();
+   TGeoMedium *medium = volume ? volume->GetMedium() : nullptr;
+   if (!medium) {
+      a = z = dens = radl = absl = 0.;
+      return -1;
+   }
+   TGeoMaterial *material = medium->GetMaterial();
+   a = material->GetA();
+   z = material->GetZ();
+   dens = material->GetDensity();
+   radl = material->GetRadLen();
+   absl = material->GetIntLen();
+   return material->GetUniqueID();
+}
+
+Int_t TMCToyMC::CurrentMedium() const
+{
+   TGeoVolume *volume = fNavigator->GetCurrentVolume();
+   TGeoMedium *medium = volume ? volume->GetMedium() : nullptr;
+   return medium ? medium->GetId() : 0;
+}
+
+Int_t TMCToyMC::CurrentEvent() const
+{
+   return fCurrentEvent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Transform the position (iflag = 1) or the direction (iflag = 2) from
+/// the master to the current volume reference system
+///
+
+void TMCToyMC::Gmtod(Double_t *xm, Double_t *xd, Int_t iflag)
+{
+   if (iflag == 1)
+      fNavigator->MasterToLocal(xm, xd);
+   else
+      fNavigator->MasterToLocalVect(xm, xd);
+}
+
+void TMCToyMC::Gmtod(Float_t *xm, Float_t *xd, Int_t iflag)
+{
+   Double_t master[3] = {xm[0], xm[1], xm[2]};
+   Double_t local[3];
+   Gmtod(master, local, iflag);
+   for (Int_t i = 0; i < 3; ++i)
+      xd[i] = local[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Transform the position (iflag = 1) or the direction (iflag = 2) from
+/// the current volume to the master reference system
+///
+
+void TMCToyMC::Gdtom(Double_t *xd, Double_t *xm, Int_t iflag)
+{
+   if (iflag == 1)
+      fNavigator->LocalToMaster(xd, xm);
+   else
+      fNavigator->LocalToMasterVect(xd, xm);
+}
+
+void TMCToyMC::Gdtom(Float_t *xd, Float_t *xm, Int_t iflag)
+{
+   Double_t local[3] = {xd[0], xd[1], xd[2]};
+   Double_t master[3];
+   Gdtom(local, master, iflag);
+   for (Int_t i = 0; i < 3; ++i)
+      xm[i] = master[i];
+}
+
+Double_t TMCToyMC::MaxStep() const
+{
+   return fMaxStep;
+}
+
+Int_t TMCToyMC::GetMaxNStep() const
+{
+   return fMaxNStep;
+}
+
+//
+// tracking particle
+//
+
+void TMCToyMC::TrackPosition(TLorentzVector &position) const
+{
+   position.SetXYZT(fPosition[0], fPosition[1], fPosition[2], fTime);
+}
+
+void TMCToyMC::TrackPosition(Double_t &x, Double_t &y, Double_t &z) const
+{
+   x = fPosition[0];
+   y = fPosition[1];
+   z = fPosition[2];
+}
+
+void TMCToyMC::TrackPosition(Float_t &x, Float_t &y, Float_t &z) const
+{
+   x = fPosition[0];
+   y = fPosition[1];
+   z = fPosition[2];
+}
+
+void TMCToyMC::TrackMomentum(TLorentzVector &momentum) const
+{
+   momentum.SetPxPyPzE(fMomentum * fDirection[0], fMomentum * fDirection[1], fMomentum * fDirection[2], Etot());
+}
+
+void TMCToyMC::TrackMomentum(Double_t &px, Double_t &py, Double_t &pz, Double_t &etot) const
+{
+   px = fMomentum * fDirection[0];
+   py = fMomentum * fDirection[1];
+   pz = fMomentum * fDirection[2];
+   etot = Etot();
+}
+
+void TMCToyMC::TrackMomentum(Float_t &px, Float_t &py, Float_t &pz, Float_t &etot) const
+{
+   px = fMomentum * fDirection[0];
+   py = fMomentum * fDirection[1];
+   pz = fMomentum * fDirection[2];
+   etot = Etot();
+}
+
+void TMCToyMC::TrackPolarization(Double_t &polX, Double_t &polY, Double_t &polZ) const
+{
+   polX = fPolarization[0];
+   polY = fPolarization[1];
+   polZ = fPolarization[2];
+}
+
+void TMCToyMC::TrackPolarization(TVector3 &pol) const
+{
+   pol.SetXYZ(fPolarization[0], fPolarization[1], fPolarization[2]);
+}
+
+//
+// secondaries
+//
+
+void TMCToyMC::GetSecondary(Int_t isec, Int_t &particleId, TLorentzVector &position, TLorentzVector &momentum)
+{
+   if (isec < 0 || isec >= NSecondaries()) {
+      ::Error("TMCToyMC::GetSecondary", "Secondary %d out of range.", isec);
+      return;
+   }
+   particleId = fSecondaries[isec].fPdg;
+   position = fSecondaries[isec].fPosition;
+   momentum = fSecondaries[isec].fMomentum;
+}
+
+TMCProcess TMCToyMC::ProdProcess(Int_t isec) const
+{
+   return (isec >= 0 && isec < NSecondaries()) ? kPHadronic : kPNoProcess;
+}
+
+Int_t TMCToyMC::StepProcesses(TArrayI &proc) const
+{
+   proc.Set(1);
+   proc[0] = fStepProcess;
+   return 1;
+}
+
+//
+// control methods
+//
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Initialize the engine: build the geometry (unless it was built and closed
+/// before, eg. by another engine) and the sensitive detectors
+///
+
+void TMCToyMC::Init()
+{
+   if (fIsInitialized)
+      return;
+
+   if (!gGeoManager || !gGeoManager->IsClosed()) {
+      fApplication->ConstructGeometry();
+      fApplication->MisalignGeometry();
+      // The transformations queried during the construction may be outdated
+      fGeometry->ClearGeometryCache();
+      if (!gGeoManager) {
+         ::Fatal("TMCToyMC::Init", "No geometry was built.");
+         return;
+      }
+      if (!gGeoManager->IsClosed())
+         gGeoManager->CloseGeometry();
+   }
+   fNavigator = gGeoManager->GetCurrentNavigator();
+   if (!fNavigator)
+      fNavigator = gGeoManager->AddNavigator();
+
+   fApplication->ConstructOpGeometry();
+   fApplication->ConstructSensitiveDetectors();
+
+   // the sensitive detectors per volume number
+   fVolumeSD.assign(gGeoManager->GetListOfVolumes()->GetEntriesFast() + 1, nullptr);
+   for (auto &entry : fSensitiveDetectors) {
+      TGeoVolume *volume = gGeoManager->GetVolume(entry.first.Data());
+      if (!volume) {
+         ::Warning("TMCToyMC::Init", "Volume %s of the sensitive detector %s not found.", entry.first.Data(),
+                   entry.second->GetName());
+         continue;
+      }
+      if (volume->GetNumber() >= Int_t(fVolumeSD.size()))
+         fVolumeSD.resize(volume->GetNumber() + 1, nullptr);
+      fVolumeSD[volume->GetNumber()] = entry.second;
+   }
+   for (auto &entry : fSensitiveDetectors)
+      entry.second->Initialize();
+
+   fApplication->InitGeometry();
+   fApplication->AddParticles();
+   fApplication->AddIons();
+
+   fIsInitialized = kTRUE;
+}
+
+void TMCToyMC::BuildPhysics() {}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Process the next event
+///
+
+void TMCToyMC::ProcessEvent()
+{
+   ProcessEvent(fNofEvents, kFALSE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Process nevent events; return false if the run was stopped
+///
+
+Bool_t TMCToyMC::ProcessRun(Int_t nevent)
+{
+   fStopRun = kFALSE;
+   for (Int_t i = 0; i < nevent && !fStopRun; ++i) {
+      ProcessEvent(fNofEvents, kFALSE);
+   }
+   TerminateRun();
+
+   return !fStopRun;
+}
+
+void TMCToyMC::InitLego()
+{
+   ::Warning("TMCToyMC::InitLego", "Not supported.");
+}
+
+void TMCToyMC::SetCollectTracks(Bool_t collectTracks)
+{
+   fIsCollectTracks = collectTracks;
+}
+
+Bool_t TMCToyMC::IsCollectTracks() const
+{
+   return fIsCollectTracks;
+}